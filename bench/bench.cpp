@@ -0,0 +1,281 @@
+/*
+ * bench.cpp
+ *
+ * Benchmark runner, see bench.h
+ *
+ * usage: libfirmware_bench [--filter substring] [--reps N] [--runs N] [--min-sample-us N] [--scalar]
+ *            [--out results.json] [--baseline baseline.json] [--threshold percent]
+ *            [--update baseline.json]
+ *
+ * --scalar runs the plain C++ variants of kernels with SIMD ones, see cpu_features.h
+ *
+ * Every benchmark runs in --runs rounds (3 by default) and keeps its best figures.
+ * With --baseline, the fastest sample of each benchmark is compared against the stored
+ * one and the exit code is 2 if any benchmark got slower by more than threshold percent
+ * (35 by default). On a shared single core host, medians of back to back runs moved by
+ * up to 100%, these minima by up to 30%, mostly under 15%.
+ *
+ * Baselines only mean something on the machine they were recorded on:
+ * `--out baseline.json` writes a new one. A change adding benchmarks runs
+ * `--update baseline.json`, which adds missing benchmarks and keeps recorded ones;
+ * entries without min_ns are recorded again, never merged with figures of another run.
+ */
+
+#include "bench.h"
+
+#include <gerefi/cpu_features.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+struct BenchEntry {
+	const char* name;
+	BenchFunction function;
+};
+
+static std::vector<BenchEntry>& registry() {
+	static std::vector<BenchEntry> entries;
+	return entries;
+}
+
+BenchRegistration::BenchRegistration(const char* name, BenchFunction function) {
+	registry().push_back({ name, function });
+}
+
+void BenchLoop::finish(size_t iterations, std::vector<double>& samples) {
+	std::sort(samples.begin(), samples.end());
+
+	m_result.iterations = iterations;
+	m_result.minNs = samples[0];
+	m_result.medianNs = samples[samples.size() / 2];
+	// nearest rank
+	size_t rank = (samples.size() * 99 + 99) / 100;
+	m_result.p99Ns = samples[std::min(rank, samples.size()) - 1];
+}
+
+static std::string formatNumber(const char* key, double value) {
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), ", \"%s\": %.3f", key, value);
+	return buffer;
+}
+
+// One benchmark as a line of the json file
+static std::string formatEntry(const BenchResult& r) {
+	std::string entry = std::string("{ \"name\": \"") + r.name + "\", \"iterations\": " + std::to_string(r.iterations);
+	entry += formatNumber("median_ns", r.medianNs);
+	entry += formatNumber("p99_ns", r.p99Ns);
+	entry += formatNumber("min_ns", r.minNs);
+	if (r.counterName) {
+		entry += formatNumber(r.counterName, r.counter);
+	}
+	return entry + " }";
+}
+
+static bool writeJson(const char* path, const std::vector<std::string>& entries) {
+	FILE* f = fopen(path, "w");
+	if (!f) {
+		return false;
+	}
+
+	fprintf(f, "{\n\t\"benchmarks\": [\n");
+	for (size_t i = 0; i < entries.size(); i++) {
+		fprintf(f, "\t\t%s%s\n", entries[i].c_str(), i + 1 < entries.size() ? "," : "");
+	}
+	fprintf(f, "\t]\n}\n");
+
+	return fclose(f) == 0;
+}
+
+struct BaselineEntry {
+	std::string name;
+	// 0 if not recorded
+	double minNs;
+	// as written, kept by --update
+	std::string text;
+};
+
+// Reads what writeJson wrote, one entry per benchmark
+static bool readBaseline(const char* path, std::vector<BaselineEntry>& baseline) {
+	FILE* f = fopen(path, "r");
+	if (!f) {
+		return false;
+	}
+
+	std::string text;
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+		text.append(buffer, n);
+	}
+	fclose(f);
+
+	const char* nameKey = "\"name\": \"";
+	const char* minKey = "\"min_ns\": ";
+	for (size_t start = text.find("{ \"name\""); start != std::string::npos; start = text.find("{ \"name\"", start)) {
+		size_t end = text.find(" }", start);
+		if (end == std::string::npos) {
+			return false;
+		}
+		std::string entry = text.substr(start, end + 2 - start);
+		start = end;
+
+		size_t name = entry.find(nameKey) + strlen(nameKey);
+		size_t min = entry.find(minKey);
+		baseline.push_back({ entry.substr(name, entry.find('"', name) - name),
+			min == std::string::npos ? 0 : strtod(entry.c_str() + min + strlen(minKey), nullptr), entry });
+	}
+
+	return true;
+}
+
+// Baseline entries as recorded, plus benchmarks it does not have yet. Entries recorded
+// without min_ns are written again from this run as a whole: figures of one entry
+// always come from the same run.
+static std::vector<std::string> updateBaseline(const std::vector<BaselineEntry>& baseline, const std::vector<BenchResult>& results) {
+	std::vector<std::string> entries;
+	for (const auto& b : baseline) {
+		std::string entry = b.text;
+		for (const auto& r : results) {
+			if (b.name == r.name && b.minNs == 0) {
+				entry = formatEntry(r);
+			}
+		}
+		entries.push_back(entry);
+	}
+
+	for (const auto& r : results) {
+		bool known = std::any_of(baseline.begin(), baseline.end(), [&](const BaselineEntry& b) {
+			return b.name == r.name;
+		});
+		if (!known) {
+			entries.push_back(formatEntry(r));
+		}
+	}
+	return entries;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: libfirmware_bench [--filter substring] [--reps N] [--runs N] [--min-sample-us N] [--scalar]\n"
+		"           [--out results.json] [--baseline baseline.json] [--threshold percent]\n"
+		"           [--update baseline.json]\n");
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	const char* filter = nullptr;
+	const char* out = nullptr;
+	const char* baselinePath = nullptr;
+	const char* updatePath = nullptr;
+	double threshold = 35;
+
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--filter") == 0 && hasValue) {
+			filter = argv[++i];
+		} else if (strcmp(argv[i], "--reps") == 0 && hasValue) {
+			options.repetitions = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--runs") == 0 && hasValue) {
+			options.runs = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--min-sample-us") == 0 && hasValue) {
+			options.minSampleUs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--scalar") == 0) {
+			cpuForceScalar(true);
+		} else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+			out = argv[++i];
+		} else if (strcmp(argv[i], "--baseline") == 0 && hasValue) {
+			baselinePath = argv[++i];
+		} else if (strcmp(argv[i], "--threshold") == 0 && hasValue) {
+			threshold = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--update") == 0 && hasValue) {
+			updatePath = argv[++i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	std::vector<BaselineEntry> baseline;
+	if (baselinePath && !readBaseline(baselinePath, baseline)) {
+		fprintf(stderr, "can not read baseline %s\n", baselinePath);
+		return 1;
+	}
+
+	std::vector<BaselineEntry> previous;
+	if (updatePath && !readBaseline(updatePath, previous)) {
+		fprintf(stderr, "can not read baseline %s\n", updatePath);
+		return 1;
+	}
+
+	std::vector<BenchResult> results;
+	int regressions = 0;
+
+	for (size_t i = 0; i < cpuGetKernelCount(); i++) {
+		printf("kernel %s: %s\n", cpuGetKernel(i).getName(), cpuGetKernel(i).getVariant());
+	}
+
+	std::vector<const BenchEntry*> selected;
+	for (const auto& entry : registry()) {
+		if (!filter || strstr(entry.name, filter)) {
+			selected.push_back(&entry);
+			results.push_back({ entry.name, 0, 0, 0, 0, nullptr, 0 });
+		}
+	}
+
+	for (size_t run = 0; run < options.runs; run++) {
+		for (size_t i = 0; i < selected.size(); i++) {
+			auto& best = results[i];
+			// keeps the batch size of the first round
+			BenchResult result = best;
+			BenchLoop loop(options, result);
+			selected[i]->function(loop);
+
+			if (run == 0) {
+				best = result;
+			} else {
+				best.minNs = std::min(best.minNs, result.minNs);
+				best.medianNs = std::min(best.medianNs, result.medianNs);
+				best.p99Ns = std::min(best.p99Ns, result.p99Ns);
+			}
+		}
+	}
+
+	printf("%-28s %12s %12s %12s %12s\n", "benchmark", "min ns", "median ns", "p99 ns", baselinePath ? "vs baseline" : "");
+	for (const auto& result : results) {
+		printf("%-28s %12.2f %12.2f %12.2f", result.name, result.minNs, result.medianNs, result.p99Ns);
+
+		for (const auto& b : baseline) {
+			if (b.name == result.name && b.minNs > 0) {
+				double change = (result.minNs / b.minNs - 1) * 100;
+				bool regressed = change > threshold;
+				regressions += regressed;
+				printf(" %+11.1f%%%s", change, regressed ? "  SLOWER" : "");
+			}
+		}
+		if (result.counterName) {
+			printf("  %s %.2f", result.counterName, result.counter);
+		}
+		printf("\n");
+	}
+
+	std::vector<std::string> entries;
+	for (const auto& r : results) {
+		entries.push_back(formatEntry(r));
+	}
+	if (out && !writeJson(out, entries)) {
+		fprintf(stderr, "can not write %s\n", out);
+		return 1;
+	}
+	if (updatePath && !writeJson(updatePath, updateBaseline(previous, results))) {
+		fprintf(stderr, "can not write %s\n", updatePath);
+		return 1;
+	}
+
+	if (regressions) {
+		printf("%d benchmark(s) slower than baseline by more than %.0f%%\n", regressions, threshold);
+		return 2;
+	}
+	return 0;
+}
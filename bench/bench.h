@@ -0,0 +1,139 @@
+/*
+ * bench.h
+ *
+ * Micro-benchmark harness: each BENCH runs its operation in batches long enough
+ * to time reliably, after warmup, and reports minimum, median and p99 time per
+ * operation.
+ *
+ * BENCH(crc32_256) {
+ *     loop.run([&] { benchKeep(crc32(data, 256)); });
+ * }
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BenchOptions {
+	// samples per benchmark, minimum, median and p99 are taken over these
+	size_t repetitions = 101;
+	// operation is repeated until one sample takes at least this long
+	uint32_t minSampleUs = 2000;
+	uint32_t warmupMs = 50;
+	// rounds over all benchmarks, figures are the best round's: a noisy spell of the
+	// host hits one benchmark's samples in one round only
+	size_t runs = 3;
+};
+
+struct BenchResult {
+	const char* name;
+	// operations per sample, 0 until calibrated
+	size_t iterations;
+	// fastest sample: interference only ever adds time, baselines compare this
+	double minNs;
+	double medianNs;
+	double p99Ns;
+
+	// optional figure other than time, e.g. write amplification; nullptr if none
+	const char* counterName;
+	double counter;
+};
+
+// Keep the compiler from optimizing away a result
+template <typename T>
+inline void benchKeep(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class BenchLoop {
+public:
+	BenchLoop(const BenchOptions& options, BenchResult& result)
+		: m_options(options)
+		, m_result(result)
+	{
+	}
+
+	template <typename TOp>
+	void run(TOp op) {
+		// warmup: caches, branch predictors, CPU frequency
+		auto warmupEnd = clock::now() + std::chrono::milliseconds(m_options.warmupMs);
+		while (clock::now() < warmupEnd) {
+			op();
+		}
+
+		// batch size: double until one batch takes long enough to time, later rounds keep it
+		size_t iterations = m_result.iterations;
+		if (iterations == 0) {
+			iterations = 1;
+			while (time(op, iterations) < m_options.minSampleUs * 1000.0 && iterations < (1u << 30)) {
+				iterations *= 2;
+			}
+		}
+
+		std::vector<double> samples;
+		for (size_t i = 0; i < m_options.repetitions; i++) {
+			samples.push_back(time(op, iterations) / iterations);
+		}
+
+		finish(iterations, samples);
+	}
+
+	// Report a figure of the benchmark next to its timing
+	void counter(const char* name, double value) {
+		m_result.counterName = name;
+		m_result.counter = value;
+	}
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	template <typename TOp>
+	static double time(TOp& op, size_t iterations) {
+		auto start = clock::now();
+		for (size_t i = 0; i < iterations; i++) {
+			op();
+		}
+		return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+	}
+
+	void finish(size_t iterations, std::vector<double>& samples);
+
+	const BenchOptions& m_options;
+	BenchResult& m_result;
+};
+
+using BenchFunction = void (*)(BenchLoop& loop);
+
+struct BenchRegistration {
+	BenchRegistration(const char* name, BenchFunction function);
+};
+
+#define BENCH(name) \
+	static void bench_##name(BenchLoop& loop); \
+	static BenchRegistration benchRegistration_##name(#name, bench_##name); \
+	static void bench_##name(BenchLoop& loop)
+
+// Deterministic input generator, same sequence on every run
+class BenchRandom {
+public:
+	explicit BenchRandom(uint32_t seed = 0x2545F491) : m_state(seed) { }
+
+	uint32_t next() {
+		// xorshift32
+		m_state ^= m_state << 13;
+		m_state ^= m_state >> 17;
+		m_state ^= m_state << 5;
+		return m_state;
+	}
+
+	// uniform in [low, high)
+	float uniform(float low, float high) {
+		return low + (high - low) * (next() >> 8) * (1.0f / (1 << 24));
+	}
+
+private:
+	uint32_t m_state;
+};
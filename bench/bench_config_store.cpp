@@ -0,0 +1,96 @@
+/*
+ * bench_config_store.cpp
+ *
+ * Config storage on emulated flash: boot time to recover the image, cost of a save
+ * while tuning, compared to rewriting the whole image each time.
+ */
+
+#include "bench.h"
+
+#include <gerefi/config_store.h>
+#include <gerefi/flash_emulator.h>
+
+#include <cstring>
+
+// tune sized image in 64k sectors, STM32F7 like
+#define IMAGE_SIZE 16384
+#define SECTOR_SIZE 65536
+#define SECTOR_COUNT 4
+#define PROGRAM_UNIT 4
+
+struct BenchImage {
+	uint8_t data[IMAGE_SIZE];
+};
+
+static BenchImage image;
+static BenchImage shadow;
+
+static void fillImage() {
+	BenchRandom random;
+	for (auto& b : image.data) {
+		b = random.next();
+	}
+}
+
+// one table cell or scalar changed per burn
+static void tuneStep(BenchRandom& random) {
+	size_t offset = random.next() % (IMAGE_SIZE - 2);
+	image.data[offset]++;
+	image.data[offset + 1]--;
+}
+
+BENCH(config_store_boot) {
+	// snapshot followed by a day of tuning in the active sector
+	static FlashEmulator flash(nullptr, SECTOR_SIZE, SECTOR_COUNT, PROGRAM_UNIT);
+	fillImage();
+	ConfigStore store(flash, &shadow, sizeof(image));
+	store.save(&image);
+
+	BenchRandom random;
+	for (int i = 0; i < 1000 && !store.needsCompaction(); i++) {
+		tuneStep(random);
+		store.save(&image);
+	}
+
+	static BenchImage loaded;
+	loop.run([&] {
+		ConfigStore boot(flash, &shadow, sizeof(image));
+		benchKeep(boot.load(&loaded));
+	});
+}
+
+BENCH(config_store_save) {
+	static FlashEmulator flash(nullptr, SECTOR_SIZE, SECTOR_COUNT, PROGRAM_UNIT);
+	fillImage();
+	ConfigStore store(flash, &shadow, sizeof(image));
+	store.save(&image);
+	store.resetStats();
+
+	BenchRandom random;
+	loop.run([&] {
+		tuneStep(random);
+		store.save(&image);
+		// background compaction, cost shared by the saves before it
+		if (store.needsCompaction()) {
+			store.compact();
+		}
+	});
+
+	loop.counter("write_amplification", store.getStats().getWriteAmplification());
+}
+
+BENCH(config_rewrite_save) {
+	// erase and program the whole image on every burn
+	static FlashEmulator flash(nullptr, SECTOR_SIZE, SECTOR_COUNT, PROGRAM_UNIT);
+	fillImage();
+
+	BenchRandom random;
+	loop.run([&] {
+		tuneStep(random);
+		flash.erase(0);
+		flash.program(0, &image, sizeof(image));
+	});
+
+	// two bytes changed per save
+	loop.counter("write_amplification", sizeof(image) / 2.0);
+}
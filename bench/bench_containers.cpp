@@ -0,0 +1,210 @@
+/*
+ * bench_containers.cpp
+ *
+ * Fixed capacity containers against the linear scans they replace:
+ * SENT slow channel mailbox, CAN listener lookup, active fault iteration,
+ * in-use flags of CAN frame buffers.
+ */
+
+#include "bench.h"
+
+#include "flat_map.h"
+#include "bitset.h"
+#include "static_vector.h"
+#include "object_pool.h"
+
+#define LOOKUPS 4096
+
+// SENT slow channel messages: 32 mailboxes, ids 0..255, ~20 in use
+struct ScMsg {
+	uint16_t data;
+	uint8_t id;
+	bool valid;
+};
+
+static void makeSlowChannelIds(uint8_t* ids, uint8_t* lookups) {
+	BenchRandom random;
+	for (size_t i = 0; i < 20; i++) {
+		ids[i] = random.next() % 256;
+	}
+	// mostly hits, some ids that never arrived
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		lookups[i] = random.next() % 8 ? ids[random.next() % 20] : random.next() % 256;
+	}
+}
+
+BENCH(sc_mailbox_linear) {
+	static ScMsg scMsg[32];
+	static uint8_t ids[20];
+	static uint8_t lookups[LOOKUPS];
+	makeSlowChannelIds(ids, lookups);
+	for (size_t i = 0; i < 20; i++) {
+		scMsg[i] = { static_cast<uint16_t>(i), ids[i], true };
+	}
+
+	size_t n = 0;
+	loop.run([&] {
+		uint8_t id = lookups[n++ % LOOKUPS];
+		int32_t found = -1;
+		for (size_t i = 0; i < 32; i++) {
+			if (scMsg[i].valid && scMsg[i].id == id) {
+				found = scMsg[i].data;
+				break;
+			}
+		}
+		benchKeep(found);
+	});
+}
+
+BENCH(sc_mailbox_flat_map) {
+	static flat_map<uint8_t, uint16_t, 32> map;
+	static uint8_t ids[20];
+	static uint8_t lookups[LOOKUPS];
+	makeSlowChannelIds(ids, lookups);
+	for (size_t i = 0; i < 20; i++) {
+		map.insert_or_assign(ids[i], i);
+	}
+
+	size_t n = 0;
+	loop.run([&] {
+		auto value = map.find(lookups[n++ % LOOKUPS]);
+		benchKeep(value ? *value : -1);
+	});
+}
+
+// CAN rx: 64 listeners for 11 bit ids, frames of ids that are listened to
+struct CanListener {
+	uint32_t id;
+	uint32_t counter;
+};
+
+static void makeCanIds(uint32_t* ids, uint32_t* frames) {
+	BenchRandom random;
+	for (size_t i = 0; i < 64; i++) {
+		ids[i] = 0x100 + i * 7 + random.next() % 7;
+	}
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		frames[i] = ids[random.next() % 64];
+	}
+}
+
+BENCH(can_listeners_linear) {
+	static static_vector<CanListener, 64> listeners;
+	static uint32_t ids[64];
+	static uint32_t frames[LOOKUPS];
+	makeCanIds(ids, frames);
+	listeners.clear();
+	for (auto id : ids) {
+		listeners.push_back({ id, 0 });
+	}
+
+	size_t n = 0;
+	loop.run([&] {
+		uint32_t id = frames[n++ % LOOKUPS];
+		for (auto& listener : listeners) {
+			if (listener.id == id) {
+				listener.counter++;
+				break;
+			}
+		}
+	});
+	benchKeep(listeners[0].counter);
+}
+
+BENCH(can_listeners_flat_map) {
+	static flat_map<uint32_t, uint32_t, 64> listeners;
+	static uint32_t ids[64];
+	static uint32_t frames[LOOKUPS];
+	makeCanIds(ids, frames);
+	for (auto id : ids) {
+		listeners.insert_or_assign(id, 0);
+	}
+
+	size_t n = 0;
+	loop.run([&] {
+		if (auto counter = listeners.find(frames[n++ % LOOKUPS])) {
+			(*counter)++;
+		}
+	});
+	benchKeep(listeners.valueAt(0));
+}
+
+// 128 possible faults, 3 active: report the active ones
+static const size_t activeFaults[] = { 17, 70, 121 };
+
+BENCH(faults_bool_scan) {
+	static bool faults[128];
+	for (auto i : activeFaults) {
+		faults[i] = true;
+	}
+
+	loop.run([&] {
+		size_t sum = 0;
+		for (size_t i = 0; i < 128; i++) {
+			if (faults[i]) {
+				sum += i;
+			}
+		}
+		benchKeep(sum);
+	});
+}
+
+BENCH(faults_bitset) {
+	static bitset<128> faults;
+	for (auto i : activeFaults) {
+		faults.set(i);
+	}
+
+	loop.run([&] {
+		size_t sum = 0;
+		for (size_t i : faults) {
+			sum += i;
+		}
+		benchKeep(sum);
+	});
+}
+
+// CAN frames in flight: 32 buffers, ~8 held at a time.
+// The flags version is only correct inside of a critical section, not included here.
+struct BenchFrame {
+	uint32_t id;
+	uint8_t data[8];
+};
+
+BENCH(frames_in_use_flags) {
+	static BenchFrame frames[32];
+	static bool inUse[32];
+	static BenchFrame* held[8];
+
+	size_t n = 0;
+	loop.run([&] {
+		size_t slot = n++ % 8;
+		if (held[slot]) {
+			inUse[held[slot] - frames] = false;
+		}
+
+		BenchFrame* frame = nullptr;
+		for (size_t i = 0; i < 32; i++) {
+			if (!inUse[i]) {
+				inUse[i] = true;
+				frame = &frames[i];
+				break;
+			}
+		}
+		held[slot] = frame;
+	});
+	benchKeep(held[0]);
+}
+
+BENCH(frames_object_pool) {
+	static object_pool<BenchFrame, 32> pool;
+	static BenchFrame* held[8];
+
+	size_t n = 0;
+	loop.run([&] {
+		size_t slot = n++ % 8;
+		pool.free(held[slot]);
+		held[slot] = pool.allocate();
+	});
+	benchKeep(held[0]);
+}
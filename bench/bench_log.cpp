@@ -0,0 +1,211 @@
+/*
+ * bench_log.cpp
+ *
+ * Log record codec: encode cost per output channel sample inline with the sampling task,
+ * and host side decode.
+ */
+
+#include "bench.h"
+
+#include <gerefi/log_codec.h>
+#include <gerefi/log_reader.h>
+
+#include <cstring>
+
+// output channels sized record
+#define RECORD_SIZE 512
+#define SAMPLES 1024
+
+// sensors drift, a few flags and counters change, most bytes hold still
+struct LogSamples {
+	uint8_t data[SAMPLES][RECORD_SIZE];
+
+	LogSamples() {
+		BenchRandom random;
+		uint8_t current[RECORD_SIZE];
+		for (size_t j = 0; j < RECORD_SIZE; j++) {
+			current[j] = random.next();
+		}
+
+		for (size_t i = 0; i < SAMPLES; i++) {
+			// rpm, map, afr, temperatures: 16 bit values that move a little
+			for (size_t j = 0; j < 24; j++) {
+				uint16_t value;
+				memcpy(&value, current + j * 2, sizeof(value));
+				value += random.next() % 7 - 3;
+				memcpy(current + j * 2, &value, sizeof(value));
+			}
+			// tick counter
+			uint32_t tick = i * 1000;
+			memcpy(current + 64, &tick, sizeof(tick));
+			// occasional status bit
+			if (random.next() % 16 == 0) {
+				current[100 + random.next() % 32] ^= 1 << (random.next() % 8);
+			}
+			memcpy(data[i], current, RECORD_SIZE);
+		}
+	}
+};
+
+static const LogSamples samples;
+
+static bool discardBlock(void* context, const uint8_t*, size_t size) {
+	*reinterpret_cast<size_t*>(context) += size;
+	return true;
+}
+
+static void benchEncode(BenchLoop& loop, bool lz) {
+	static uint8_t previous[RECORD_SIZE];
+	static uint8_t block[8192];
+	static uint8_t lzBuffer[sizeof(block)];
+	size_t written = 0;
+	LogEncoder encoder(RECORD_SIZE, previous, block, sizeof(block), lz ? lzBuffer : nullptr,
+		discardBlock, &written, LOG_FLAG_DELTA);
+
+	size_t i = 0;
+	loop.run([&] {
+		encoder.add(i * 1000, samples.data[i % SAMPLES]);
+		i++;
+	});
+
+	loop.counter("ratio", encoder.getStats().getRatio());
+}
+
+BENCH(log_encode_512) {
+	benchEncode(loop, false);
+}
+
+BENCH(log_encode_512_lz) {
+	benchEncode(loop, true);
+}
+
+struct BlockSink {
+	std::vector<uint8_t> data;
+
+	static bool write(void* context, const uint8_t* block, size_t size) {
+		auto& sink = *reinterpret_cast<BlockSink*>(context);
+		if (sink.data.empty()) {
+			sink.data.assign(block, block + size);
+		}
+		return true;
+	}
+};
+
+BENCH(log_decode_block_lz) {
+	// per record cost of decoding one 8k block
+	static uint8_t previous[RECORD_SIZE];
+	static uint8_t block[8192];
+	static uint8_t lzBuffer[sizeof(block)];
+	BlockSink sink;
+	LogEncoder encoder(RECORD_SIZE, previous, block, sizeof(block), lzBuffer, BlockSink::write, &sink, LOG_FLAG_DELTA);
+	for (size_t i = 0; sink.data.empty(); i++) {
+		encoder.add(i * 1000, samples.data[i % SAMPLES]);
+	}
+
+	LogBlockInfo info;
+	logReadBlockHeader(sink.data.data(), sink.data.size(), info);
+
+	std::vector<uint8_t> records;
+	std::vector<uint64_t> timestamps;
+	loop.run([&] {
+		benchKeep(logDecodeBlock(sink.data.data(), sink.data.size(), records, timestamps));
+	});
+
+	loop.counter("records", info.recordCount);
+}
+
+// a few minutes of 1kHz output channels, indexed in memory
+struct BenchLog {
+	std::vector<uint8_t> data;
+	LogReader reader;
+
+	static bool append(void* context, const uint8_t* block, size_t size) {
+		auto& log = *reinterpret_cast<std::vector<uint8_t>*>(context);
+		log.insert(log.end(), block, block + size);
+		return true;
+	}
+
+	BenchLog() {
+		static uint8_t previous[RECORD_SIZE];
+		static uint8_t block[8192];
+		static uint8_t lzBuffer[sizeof(block)];
+		LogEncoder encoder(RECORD_SIZE, previous, block, sizeof(block), lzBuffer, append, &data, LOG_FLAG_DELTA);
+		for (size_t i = 0; i < 100000; i++) {
+			encoder.add(i * 1000, samples.data[i % SAMPLES]);
+		}
+		encoder.flush();
+		reader.open(data.data(), data.size());
+	}
+};
+
+static BenchLog& benchLog() {
+	static BenchLog log;
+	return log;
+}
+
+static const LogChannel benchChannels[] = {
+	{ 0, LogChannelType::U16, 1 },
+	{ 2, LogChannelType::U16, 0.01f },
+	{ 64, LogChannelType::U32, 1 },
+	{ 100, LogChannelType::U8, 1 },
+};
+
+static void benchReadColumns(BenchLoop& loop, size_t threads) {
+	auto& log = benchLog();
+	LogColumns columns;
+	loop.run([&] {
+		benchKeep(log.reader.readColumns(0, log.reader.getBlockCount(), benchChannels, 4, columns, threads));
+	});
+	loop.counter("records", columns.timestamps.size());
+}
+
+BENCH(log_read_columns_1_thread) {
+	benchReadColumns(loop, 1);
+}
+
+BENCH(log_read_columns_all_threads) {
+	benchReadColumns(loop, 0);
+}
+
+BENCH(log_seek) {
+	auto& log = benchLog();
+	BenchRandom random;
+	loop.run([&] {
+		benchKeep(log.reader.seek((random.next() % 100000) * 1000ull));
+	});
+}
+
+BENCH(timeline_merge_8_streams) {
+	// SENT, CAN, diagnostics, ... each at its own rate; one op merges all of them
+	static std::vector<TimelineSourceEvent> events[8];
+	size_t count = 0;
+	for (size_t s = 0; s < 8; s++) {
+		events[s].clear();
+		for (uint64_t t = s; t < 100000; t += 100 + s * 37) {
+			events[s].push_back({ t, nullptr, 0 });
+		}
+		count += events[s].size();
+	}
+
+	loop.run([&] {
+		TimelineArraySource sources[] = {
+			{ events[0].data(), events[0].size() }, { events[1].data(), events[1].size() },
+			{ events[2].data(), events[2].size() }, { events[3].data(), events[3].size() },
+			{ events[4].data(), events[4].size() }, { events[5].data(), events[5].size() },
+			{ events[6].data(), events[6].size() }, { events[7].data(), events[7].size() },
+		};
+		TimelineMerge merge;
+		for (auto& source : sources) {
+			merge.addSource(source, TimelineClock::Wrapped32);
+		}
+
+		TimelineEvent event;
+		efitick_t sum = 0;
+		while (merge.next(event)) {
+			sum += event.time;
+		}
+		benchKeep(sum);
+	});
+
+	loop.counter("events", count);
+}
@@ -0,0 +1,30 @@
+/*
+ * bench_sent.cpp
+ *
+ * SENT decoder benchmark: time per pulse of a 12 bit sensor stream with tick jitter
+ */
+
+#include "bench.h"
+
+#include "sent_decoder.h"
+#include "sent_test_frames.h"
+
+BENCH(sent_decoder_pulse) {
+	BenchRandom random;
+	std::vector<uint32_t> pulses;
+	for (int i = 0; i < 1000; i++) {
+		// slowly changing signal like a pressure sensor
+		sentTestAddFrame(pulses, 0x400 + i % 0x200);
+	}
+	// capture jitter of +-1 timer clock
+	for (auto& p : pulses) {
+		p += random.next() % 3 - 1;
+	}
+
+	static sent_channel ch{};
+	size_t i = 0;
+	loop.run([&] {
+		benchKeep(ch.Decoder(pulses[i]));
+		i = (i + 1) % pulses.size();
+	});
+}
@@ -0,0 +1,210 @@
+/*
+ * bench_util.cpp
+ *
+ * util module benchmarks, inputs shaped like what the firmware sees:
+ * RPM/load following an engine trajectory, config sized buffers, console numbers.
+ */
+
+#include "bench.h"
+
+#include <gerefi/interpolation.h>
+#include <gerefi/crc.h>
+#include <gerefi/config_diff.h>
+#include "cyclic_buffer.h"
+#include <cstring>
+#include <gerefi/fragments.h>
+#include <gerefi/efistringutil.h>
+
+#define INPUTS 4096
+
+// RPM and MAP kPa operating points: accelerations, cruise, idle dips
+struct EngineTrajectory {
+	float rpm[INPUTS];
+	float load[INPUTS];
+
+	EngineTrajectory() {
+		BenchRandom random;
+		float r = 800;
+		float rate = 0;
+		for (size_t i = 0; i < INPUTS; i++) {
+			rate = rate * 0.95f + random.uniform(-40, 40);
+			r += rate;
+			if (r < 700 || r > 7000) {
+				rate = -rate;
+				r = r < 700 ? 700 : 7000;
+			}
+			rpm[i] = r;
+			// load follows rpm with throttle noise
+			load[i] = 25 + (r - 700) / 6300 * 150 + random.uniform(-15, 15);
+		}
+	}
+};
+
+static const EngineTrajectory trajectory;
+
+static const float rpmBins[16] = {
+	650, 800, 1100, 1400, 1700, 2000, 2300, 2600,
+	3000, 3500, 4000, 4500, 5000, 5700, 6400, 7000,
+};
+
+static const float loadBins[16] = {
+	20, 30, 40, 50, 60, 70, 80, 90,
+	100, 115, 130, 150, 170, 200, 225, 250,
+};
+
+BENCH(getBin_16) {
+	size_t i = 0;
+	loop.run([&] {
+		benchKeep(priv::getBin(trajectory.rpm[i++ % INPUTS], rpmBins));
+	});
+}
+
+BENCH(getBin_16_scaled) {
+	// RPM bins stored in bytes as RPM / 50, as in firmware configs
+	static scaled_channel<uint8_t, 1, 50> bins[16];
+	for (size_t i = 0; i < 16; i++) {
+		bins[i] = rpmBins[i];
+	}
+
+	size_t i = 0;
+	loop.run([&] {
+		benchKeep(priv::getBin(trajectory.rpm[i++ % INPUTS], bins));
+	});
+}
+
+BENCH(interpolate3d_16x16) {
+	static float table[16][16];
+	BenchRandom random;
+	for (size_t r = 0; r < 16; r++) {
+		for (size_t c = 0; c < 16; c++) {
+			table[r][c] = 60 + r * 2 + c + random.uniform(-3, 3);
+		}
+	}
+
+	size_t i = 0;
+	loop.run([&] {
+		size_t n = i++ % INPUTS;
+		benchKeep(interpolate3d(table, loadBins, trajectory.load[n], rpmBins, trajectory.rpm[n]));
+	});
+}
+
+// config page and whole config image
+static uint8_t crcData[16384];
+
+static void fillCrcData() {
+	BenchRandom random;
+	for (auto& b : crcData) {
+		b = random.next();
+	}
+}
+
+BENCH(crc32_256) {
+	fillCrcData();
+	loop.run([&] {
+		benchKeep(crc32(crcData, 256));
+	});
+}
+
+BENCH(crc32_16k) {
+	fillCrcData();
+	loop.run([&] {
+		benchKeep(crc32(crcData, sizeof(crcData)));
+	});
+}
+
+BENCH(config_diff_16k) {
+	// tuning software burn: a few cells of a table and some scalars changed
+	fillCrcData();
+	static uint8_t edited[sizeof(crcData)];
+	memcpy(edited, crcData, sizeof(edited));
+	for (size_t offset : { 120, 121, 4000, 4016, 4032, 9999, 16000 }) {
+		edited[offset] ^= 1;
+	}
+
+	ConfigRange ranges[16];
+	loop.run([&] {
+		benchKeep(configDiff(crcData, edited, sizeof(edited), ranges, 16));
+	});
+}
+
+BENCH(cyclic_buffer_add) {
+	// sensor samples, e.g. MAP averaging
+	static cyclic_buffer<int> buffer(64);
+	BenchRandom random;
+	int samples[INPUTS];
+	for (auto& s : samples) {
+		s = 100 + random.next() % 20;
+	}
+
+	size_t i = 0;
+	loop.run([&] {
+		buffer.add(samples[i++ % INPUTS]);
+	});
+	benchKeep(buffer.get(0));
+}
+
+BENCH(cyclic_buffer_max_16) {
+	static cyclic_buffer<int> buffer(64);
+	BenchRandom random;
+	for (int i = 0; i < 64; i++) {
+		buffer.add(random.next() % 1000);
+	}
+
+	loop.run([&] {
+		benchKeep(buffer.maxValue(16));
+	});
+}
+
+// live data structs of output channel sizes
+struct BenchLive1 { uint8_t data[280]; };
+struct BenchLive2 { uint8_t data[96]; };
+struct BenchLive3 { uint8_t data[512]; };
+
+static BenchLive1 live1;
+static BenchLive2 live2;
+static BenchLive3 live3;
+
+template<>
+const BenchLive1* getLiveData(size_t) {
+	return &live1;
+}
+
+template<>
+const BenchLive2* getLiveData(size_t) {
+	return &live2;
+}
+
+template<>
+const BenchLive3* getLiveData(size_t) {
+	return &live3;
+}
+
+static const FragmentEntry liveFragments[] = {
+	decl_frag<BenchLive1>{},
+	decl_frag<BenchLive2>{},
+	decl_frag<BenchLive3>{},
+};
+
+BENCH(copyRange_256) {
+	FragmentList list = { liveFragments, 3 };
+	static uint8_t destination[256];
+
+	// tuning software chunks of the output channels, sliding across fragment borders
+	size_t offset = 0;
+	loop.run([&] {
+		benchKeep(copyRange(destination, list, offset, sizeof(destination)));
+		offset = (offset + 100) % (280 + 96 + 512 - 256);
+	});
+}
+
+BENCH(atoff) {
+	// console and tuning values
+	static const char* const numbers[] = {
+		"1500", "-12.5", "0.0625", "3.14159", "100.25", "7000", "-0.001", "14.7",
+	};
+
+	size_t i = 0;
+	loop.run([&] {
+		benchKeep(atoff(numbers[i++ % 8]));
+	});
+}
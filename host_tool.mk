@@ -0,0 +1,54 @@
+##############################################################################
+# Shared build settings for host-side executables (tools, benchmarks)
+#
+# Before including this file set:
+#   PROJECT      - name of the executable
+#   PROJECT_DIR  - path to root of this repository
+#   CPPSRC/CSRC  - sources, usually $(GEREFI_LIB_CPP) $(GEREFI_LIB_HOST_CPP) + main
+#   INCDIR       - include paths, usually $(GEREFI_LIB_INC)
+#
+
+ifeq ($(USE_OPT),)
+  USE_OPT = -c -Wall -O2 -ggdb -g
+  USE_OPT += -Werror=missing-field-initializers -Werror=shadow
+endif
+
+ifeq ($(USE_COPT),)
+  USE_COPT = -std=gnu99 -fgnu89-inline
+endif
+
+ifeq ($(USE_CPPOPT),)
+  USE_CPPOPT = -std=gnu++2a -fno-rtti -fno-use-cxa-atexit
+endif
+
+ifeq ($(USE_LINK_GC),)
+  USE_LINK_GC = yes
+endif
+
+ifeq ($(USE_VERBOSE_COMPILE),)
+  USE_VERBOSE_COMPILE = no
+endif
+
+ACSRC =
+ACPPSRC =
+ASMSRC =
+
+CC   = gcc
+CPPC = g++
+LD   = g++
+CP   = objcopy
+AS   = gcc -x assembler-with-cpp
+OD   = objdump
+
+CWARN = -Wall -Wextra -Wstrict-prototypes -pedantic -Wmissing-prototypes -Wold-style-definition
+CPPWARN = -Wall -Wextra -Werror -pedantic -Wno-error=sign-compare
+
+ifeq ($(OS),Windows_NT)
+  DLIBS = -static-libgcc -static -static-libstdc++
+else
+  DLIBS = -pthread
+endif
+
+ULIBS = -lm
+
+include $(PROJECT_DIR)/rules.mk
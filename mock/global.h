@@ -1,3 +1,5 @@
 // test value just for unit tests
 
-#define US_TO_NT_MULTIPLIER 100
\ No newline at end of file
+#define US_TO_NT_MULTIPLIER 100
+
+#define EFI_UNIT_TEST 1
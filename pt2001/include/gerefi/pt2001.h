@@ -11,6 +11,10 @@
 #include <cstdint>
 
 #include "pt2001_memory_map.h"
+#include "pt2001_conversion.h"
+
+#include <gerefi/timer.h>
+#include <gerefi/pt2001_trace.h>
 
 void initMc33816();
 
@@ -28,18 +32,196 @@ enum class McFault : uint8_t
 
 const char * mcFaultToString(McFault fault);
 
+// Steps of non-blocking restart, each names the step executed by next restartStep()
+enum class Pt2001RestartState : uint8_t
+{
+	Idle = 0,
+	CheckVbatt,
+	ReleaseReset,
+	DownloadRam,
+	DownloadRegisters,
+	CheckFlash,
+	EnableDriven,
+	CheckDriven,
+	// restart finished successfully
+	Running,
+	// restart gave up, see fault
+	Failed,
+};
+
+const char * pt2001RestartStateToString(Pt2001RestartState state);
+
+// Memory regions downloaded by restart, bit number in region masks
+enum class Pt2001Region : uint8_t
+{
+	CodeRam1 = 0,
+	CodeRam2,
+	DataRam,
+	Main,
+	Ch1,
+	Ch2,
+	Io,
+	Diag,
+};
+
+#define PT2001_REGION_COUNT 8
+#define PT2001_ALL_REGIONS ((1 << PT2001_REGION_COUNT) - 1)
+
+// Value written after channel select command (0x7FE1)
+enum class Pt2001Page : uint16_t
+{
+	Unknown = 0,
+	CodeRam1 = 1,
+	CodeRam2 = 2,
+	// Data RAM and registers
+	Common = 4,
+};
+
+// Runtime faults decoded by periodic diagnostics, bit mask
+enum class Pt2001DiagFlag : uint8_t
+{
+	// driver status bit 0
+	VccPUnderVoltage = 1 << 0,
+	// driver status bit 1
+	V5UnderVoltage = 1 << 1,
+	// driver status bit 3
+	OverTemp = 1 << 2,
+	// DRIVEN was set by restart but driver status bit 4 is not
+	NotDriven = 1 << 3,
+	// flash enable status of ch1 or ch2 is gone, microcode not running
+	FlashStopped = 1 << 4,
+	// chip ID does not read back
+	NoComm = 1 << 5,
+};
+
+#define PT2001_DIAG_FLAG_COUNT 6
+
+const char * pt2001DiagFlagToString(Pt2001DiagFlag flag);
+
+struct Pt2001Diagnostics {
+	// raw words of last poll
+	uint16_t driverStatus;
+	uint16_t chipId;
+	uint16_t flashCh1;
+	uint16_t flashCh2;
+
+	// flags of last poll
+	uint8_t active;
+	// flags seen since last clear()
+	uint8_t latched;
+
+	// per flag, indexed by bit number: number of polls it was seen on, time of last occurrence
+	uint32_t counts[PT2001_DIAG_FLAG_COUNT];
+	efitick_t lastSeenNt[PT2001_DIAG_FLAG_COUNT];
+
+	// regions that differed on last verifyImage, see Pt2001Region
+	uint8_t imageMismatch;
+
+	uint32_t polls;
+	// restarts started by periodicCallback
+	uint32_t recoveries;
+
+	bool isActive(Pt2001DiagFlag flag) const {
+		return active & static_cast<uint8_t>(flag);
+	}
+
+	void clear() {
+		*this = {};
+	}
+};
+
+// SPI traffic counters, words include command words
+struct Pt2001SpiStats {
+	uint32_t words;
+	uint32_t selects;
+	uint32_t pageSelects;
+	uint32_t pageSelectsSkipped;
+	uint32_t spiSetups;
+};
+
+// Injector current profile, Data RAM words 0..9 read by both injector microcores
+// at the start of every phase. Currents in A, times in us.
+struct Pt2001InjectionProfile {
+	Pt2001Current boostCurrent;
+	Pt2001Current peakCurrent;
+	Pt2001Current holdCurrent;
+
+	uint16_t tpeakOff;
+	uint16_t tpeakTot;
+	uint16_t tbypass;
+	uint16_t tholdOff;
+	uint16_t tholdTot;
+	uint16_t tboostMin;
+	uint16_t tboostMax;
+};
+
+struct Pt2001RegionInfo;
+class Pt2001Image;
+
 class Pt2001Base {
 public:
 	// Reinitialize the PT2001 chip, returns true if successful
-	bool restart();
+	// Blocks in sleepMs() for ~27ms, use beginRestart/restartStep from a periodic task instead
+	// Warm restart does not reset the chip: code RAM, Data RAM and registers are read back
+	// and only regions that differ are downloaded again.
+	bool restart(bool warm = false);
+
+	// Non-blocking restart: call beginRestart(), then restartStep() while isRestarting(),
+	// waiting the returned number of milliseconds between calls.
+	// Bus is acquired and released inside of each step.
+	void beginRestart(bool warm = false);
+	size_t restartStep();
+	bool isRestarting() const;
+
+	Pt2001RestartState getRestartState() const {
+		return m_restartState;
+	}
+
+	// Mask of (1 << Pt2001Region) downloaded by last restart
+	uint8_t getDownloadedRegions() const {
+		return m_downloadedRegions;
+	}
+
+	// Read back all regions and compare CRC32 with what was downloaded,
+	// returns mask of (1 << Pt2001Region) that differ, zero if chip content is intact.
+	// Acquires the bus.
+	uint8_t verifyImage();
+
+	// Download regions from `image` instead of the compiled in arrays, starting with next
+	// restart; a warm restart only downloads regions that differ. Image must be loaded and
+	// outlive its use, nullptr goes back to the compiled in arrays.
+	void setImage(const Pt2001Image* image);
+
+	// Region content as downloaded, from image if one is set
+	const Pt2001RegionInfo& getRegion(Pt2001Region r) const;
 
 	// Disable the PT2001 chip.
 	void shutdown();
 
 	void onError(McFault p_fault) {
 	    fault = p_fault;
+	    // whatever went wrong, do not trust cached chip state
+	    invalidateSpiState();
 	}
 
+	// Forget cached SPI config and selected page, next access sends them again.
+	// Call after SPI errors or anything else that could have reset the chip.
+	void invalidateSpiState();
+
+	// Re-read timing configuration and write changed values to the chip.
+	// Acquires the bus, safe to call while operating.
+	void applyTimings();
+
+	// Switch injector profile, e.g. per cylinder from Pt2001ProfileTable.
+	// Only words that differ from chip content are sent, in a single chip select frame:
+	// at most 1 command + 10 data words. Call between injection events, microcode
+	// picks up the new values with the next event. Acquires the bus.
+	// applyTimings() goes back to the configured profile.
+	void setInjectionProfile(const Pt2001InjectionProfile& profile);
+
+	// Profile made of the timing configuration getters
+	Pt2001InjectionProfile getConfiguredProfile() const;
+
 private:
     // method not public since does not acquire/release bus yet!
 	// Re-read timing configuration and reconfigure the chip. This is safe to call while operating.
@@ -47,41 +229,174 @@ private:
 
     // method not public since does not acquire/release bus yet!
 	// Set the boost voltage target. This is safe to call while operating.
-	void setBoostVoltage(float volts);
+	void setBoostVoltage(Pt2001Voltage volts);
+
+	// Update Data RAM shadow with profile, flushDram sends it
+	void stageProfile(const Pt2001InjectionProfile& profile);
+	// Convert to DAC code / clocks and setDram, onError if out of range
+	void setDramCurrent(MC33816Mem addr, Pt2001Current current);
+	void setDramTime(MC33816Mem addr, uint16_t us);
 
 public:
     McFault fault = McFault::None;
     uint16_t status = 0;
+    Pt2001SpiStats spiStats = {};
+#if EFI_PT2001_TRACE
+	// SPI transactions, see pt2001_trace_decode.h
+	Pt2001Trace trace;
+#endif
 
-    void periodicCallback();
+	// Call often, e.g. every few milliseconds:
+	// - drives restart started by beginRestart() or by recovery, without blocking
+	// - every getDiagPeriodMs() reads driver status, chip ID and flash enable in one
+	//   chip select frame: 3 commands + 6 data words = 9 SPI words, plus 2 words to
+	//   clear latched status bits when any were set
+	// - restarts the chip when diagnostics find it not running, at most once per
+	//   getRecoveryIntervalMs(), interval doubles with every failed attempt
+	void periodicCallback();
 	uint16_t readStatus(int reg);
 
+	// Read and decode diagnostics once, caller must hold the bus
+	void pollDiagnostics();
+
+	Pt2001Diagnostics diagnostics = {};
+
 private:
-	// SPI tx/rx helpers
+	// SPI tx/rx helpers, every transfer goes through these so they are counted (and traced)
 	void send(uint16_t tx) {
+		spiStats.words++;
+#if EFI_PT2001_TRACE
+		trace.onWord(tx, getTraceTimeNt());
+#endif
 		sendRecv(tx);
+#if EFI_PT2001_TRACE
+		trace.onWordDone(getTraceTimeNt());
+#endif
 	}
 
 	uint16_t recv() {
-		return sendRecv(0xFFFF);
+		spiStats.words++;
+#if EFI_PT2001_TRACE
+		trace.onWord(0xFFFF, getTraceTimeNt());
+#endif
+		uint16_t rx = sendRecv(0xFFFF);
+#if EFI_PT2001_TRACE
+		trace.onWordDone(getTraceTimeNt());
+#endif
+		return rx;
+	}
+
+	void spiSelect() {
+		spiStats.selects++;
+#if EFI_PT2001_TRACE
+		trace.onSelect();
+#endif
+		select();
+	}
+
+	void spiDeselect() {
+		deselect();
+#if EFI_PT2001_TRACE
+		trace.onDeselect(getTraceTimeNt());
+#endif
+	}
+
+	void spiSendLarge(const uint16_t* data, size_t count) {
+		spiStats.words += count;
+#if EFI_PT2001_TRACE
+		efitick_t startNt = getTraceTimeNt();
+#endif
+		sendLarge(data, count);
+#if EFI_PT2001_TRACE
+		trace.onLarge(data, count, startNt, getTraceTimeNt());
+#endif
+	}
+
+	// Bus is not touched while Pt2001BusQueue holds it for us
+	void busAcquire() {
+		if (!m_busHeldByQueue) {
+			acquireBus();
+		}
+	}
+
+	void busRelease() {
+		if (!m_busHeldByQueue) {
+			releaseBus();
+		}
 	}
 
 	// Chip init logic
 	void setupSpi();
+	// setupSpi unless already done since last reset/error
+	void ensureSpi();
+	// Switch page inside of chip select frame, no-op if already there
+	void selectPage(Pt2001Page page);
 	uint16_t readId();
 
 	void enableFlash();
 	bool checkFlash();
 
-	void downloadRam(int target);
-	void downloadRegister(int target);
+	void disableFlash();
+
+	// Readback verification
+	uint32_t readRegionCrc(Pt2001Region r);
+	// false if expected content is not known
+	bool getExpectedRegionCrc(Pt2001Region r, uint32_t& crc) const;
+	uint8_t verifyRegions();
+	// download regions in mask, from..to inclusive, see Pt2001TransferBuilder
+	void downloadRegions(uint8_t mask, Pt2001Region from, Pt2001Region to);
+	// RAM region too large for the transfer buffer, streamed straight from its data
+	void downloadRamDirect(const Pt2001RegionInfo& region);
 
 	// Chip IO helpers
 	uint16_t readDram(MC33816Mem addr);
 	void writeDram(MC33816Mem addr, uint16_t data);
+
+	// Shadowed Data RAM: setDram only updates the shadow copy, flushDram
+	// burst-writes words that changed, skipping everything the chip already has
+	void setDram(MC33816Mem addr, uint16_t data);
+	void flushDram();
+	void invalidateDram();
+	void setDramShadow(const uint16_t* data, size_t count);
 	uint16_t readDriverStatus();
 	void clearDriverStatus();
 
+	// Copy of chip Data RAM
+	uint16_t m_dramShadow[PT2001_DRAM_SIZE] = {};
+
+	// word stream of one region download
+	uint16_t m_transferBuffer[PT2001_TRANSFER_BUFFER_SIZE];
+	// bit per word: shadow matches chip content (or pending write)
+	uint32_t m_dramValid[PT2001_DRAM_SIZE / 32] = {};
+	// bit per word: shadow has to be written to the chip
+	uint32_t m_dramDirty[PT2001_DRAM_SIZE / 32] = {};
+
+	// fail restart with given fault, returns delay for restartStep
+	size_t restartFailed(McFault p_fault);
+
+	Pt2001RestartState m_restartState = Pt2001RestartState::Idle;
+	bool m_flag0before = false;
+	bool m_warmRestart = false;
+	uint8_t m_downloadedRegions = 0;
+
+	// periodicCallback scheduling
+	Timer m_diagTimer;
+	Timer m_restartStepTimer;
+	size_t m_restartStepDelayMs = 0;
+	Timer m_recoveryTimer;
+	// consecutive recoveries that did not get the chip running
+	uint8_t m_recoveryAttempts = 0;
+	bool m_recoveryPending = false;
+
+	// see Pt2001BusQueue
+	friend class Pt2001BusQueue;
+	bool m_busHeldByQueue = false;
+
+	const Pt2001Image* m_image = nullptr;
+
+	bool m_spiConfigured = false;
+	Pt2001Page m_page = Pt2001Page::Unknown;
+
 protected:
 	// The consuming app must implement these functions!
 	virtual void acquireBus() = 0;
@@ -103,15 +418,18 @@ protected:
 	virtual float getVbatt() const = 0;
 
 	// CONFIGURATIONS: currents, timings, voltages
-	virtual float getBoostVoltage() const = 0;
+	virtual Pt2001Voltage getBoostVoltage() const = 0;
+
+	// Currents in amps, mA resolution
+	virtual Pt2001Current getBoostCurrent() const = 0;
+	virtual Pt2001Current getPeakCurrent() const = 0;
+	virtual Pt2001Current getHoldCurrent() const = 0;
 
-	// Currents in amps
-	virtual float getBoostCurrent() const = 0;
-	virtual float getPeakCurrent() const = 0;
-	virtual float getHoldCurrent() const = 0;
+	virtual Pt2001Current getPumpPeakCurrent() const = 0;
+	virtual Pt2001Current getPumpHoldCurrent() const = 0;
 
-	virtual float getPumpPeakCurrent() const = 0;
-	virtual float getPumpHoldCurrent() const = 0;
+	// Current sense resistor and amplifier gain of the board
+	virtual Pt2001CurrentSense getCurrentSense() const { return {}; }
 
 	// Timings in microseconds
 	virtual uint16_t getTpeakOff() const = 0;
@@ -132,4 +450,14 @@ protected:
 
 	// Sleep for some number of milliseconds
 	virtual void sleepMs(size_t ms) = 0;
+
+	// Diagnostics schedule, see periodicCallback
+	virtual uint32_t getDiagPeriodMs() const { return 100; }
+	// Minimum time between recovery restarts, zero disables automatic recovery
+	virtual uint32_t getRecoveryIntervalMs() const { return 1000; }
+
+#if EFI_PT2001_TRACE
+	// Timestamps of trace entries
+	virtual efitick_t getTraceTimeNt() const { return getTimeNowNt(); }
+#endif
 };
@@ -0,0 +1,88 @@
+/*
+ * @file pt2001_bus.h
+ *
+ * Several PT2001 on one SPI bus: queued chip operations are batched into a single
+ * bus acquisition and only run while they fit the bus time the caller has left
+ * before higher priority traffic.
+ */
+
+#pragma once
+
+#include <gerefi/pt2001.h>
+
+#define PT2001_BUS_MAX_CHIPS 4
+
+// Queued operations, bit mask; executed in this order of priority
+enum class Pt2001Request : uint8_t
+{
+	ApplyTimings = 1 << 0,
+	PollDiagnostics = 1 << 1,
+	VerifyImage = 1 << 2,
+};
+
+struct Pt2001BusStats {
+	// bus acquisitions by the queue
+	uint32_t transactions;
+	// chip operations executed, including periodic callbacks
+	uint32_t operations;
+	// operations postponed because they did not fit the budget
+	uint32_t deferred;
+
+	// SPI words of all chips and estimated bus time they took
+	uint32_t words;
+	uint64_t busyUs;
+	// longest single transaction, estimated
+	uint32_t maxTransactionUs;
+
+	efitick_t sinceNt;
+
+	// share of time since resetStats() the bus was busy with PT2001 traffic
+	float getOccupancy(efitick_t nowNt) const;
+};
+
+class Pt2001BusQueue {
+public:
+	// Chips must outlive the queue, returns false if there is no room
+	bool addChip(Pt2001Base& chip);
+
+	size_t getChipCount() const {
+		return m_chipCount;
+	}
+
+	// Queue operation for chip, repeated requests before next service() are merged
+	void submit(size_t chip, Pt2001Request request);
+	bool isPending(size_t chip, Pt2001Request request) const;
+
+	// Acquire bus once and run queued operations, then periodicCallback of every chip,
+	// round robin between chips.
+	// budgetUs: bus time available before higher priority traffic, 0 for no limit.
+	// Operations that would not fit stay queued for the next call, smaller ones still run.
+	void service(uint32_t budgetUs = 0);
+
+	const Pt2001BusStats& getStats() const {
+		return m_stats;
+	}
+
+	void resetStats();
+
+	// Cost of one SPI word for budget and occupancy estimates, 4MHz SPI by default
+	uint32_t spiWordNs = 4000;
+
+protected:
+	// The consuming app must implement these: lock the bus shared with other devices
+	virtual void acquireBus() = 0;
+	virtual void releaseBus() = 0;
+
+private:
+	// Worst case words of next operation of chip, 0 if nothing to do
+	uint32_t estimateWords(const Pt2001Base& chip, uint8_t pending) const;
+	void run(Pt2001Base& chip, uint8_t request);
+
+	Pt2001Base* m_chips[PT2001_BUS_MAX_CHIPS] = {};
+	uint8_t m_pending[PT2001_BUS_MAX_CHIPS] = {};
+	size_t m_chipCount = 0;
+	// round robin start
+	size_t m_next = 0;
+
+	Pt2001BusStats m_stats = {};
+};
@@ -0,0 +1,115 @@
+/*
+ * @file pt2001_conversion.h
+ *
+ * Integer only conversion of PT2001 settings to Data RAM values: currents to DAC
+ * codes for the sense resistor and gain the board uses, times to microcore clocks,
+ * boost voltage to the Vboost comparator code.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <gerefi/expected.h>
+#include <gerefi/scaled_channel.h>
+
+// Currents in mA resolution
+using Pt2001Current = scaled_channel<uint16_t, 1000>;
+// Volts in 10mV resolution
+using Pt2001Voltage = scaled_channel<uint16_t, 100>;
+
+// Current sense amplifier gain G_DA_DIFF
+enum class Pt2001SenseGain : uint8_t
+{
+	G5_79 = 0,
+	G8_68,
+	G12_53,
+	G19_25,
+};
+
+#define PT2001_SENSE_GAIN_COUNT 4
+
+// Current sense resistor R_SENSEx soldered on board
+enum class Pt2001SenseResistor : uint8_t
+{
+	R5mOhm = 0,
+	R10mOhm,
+	R20mOhm,
+};
+
+#define PT2001_SENSE_RESISTOR_COUNT 3
+
+struct Pt2001CurrentSense {
+	Pt2001SenseResistor resistor = Pt2001SenseResistor::R10mOhm;
+	Pt2001SenseGain gain = Pt2001SenseGain::G12_53;
+};
+
+// Microcore clock: PLL x24 / CLK_DIV 4 = 6MHz
+#define PT2001_CLOCK_MHZ 6
+
+// Current threshold DACs are 8 bit
+#define PT2001_CURRENT_DAC_MAX 0xFF
+
+namespace pt2001 {
+// I = (DAC_VALUE * V_DAC_LSB - V_DA_BIAS) / (G_DA_DIFF * R_SENSEx)
+// V_DAC_LSB = 9.77mV, V_DA_BIAS = 250mV, all in 10nV here:
+// sense voltage of 1mA is G_DA_DIFF * 100 * R_SENSEx in mOhm
+constexpr uint32_t dacLsb = 977000;
+constexpr uint32_t dacBias = 25000000;
+
+constexpr uint16_t senseGains[PT2001_SENSE_GAIN_COUNT] = { 579, 868, 1253, 1925 };
+constexpr uint16_t senseResistors[PT2001_SENSE_RESISTOR_COUNT] = { 5, 10, 20 };
+
+struct SenseTable {
+	// 10nV of sense voltage per mA
+	uint32_t perMa[PT2001_SENSE_RESISTOR_COUNT][PT2001_SENSE_GAIN_COUNT];
+
+	constexpr SenseTable() : perMa() {
+		for (size_t r = 0; r < PT2001_SENSE_RESISTOR_COUNT; r++) {
+			for (size_t g = 0; g < PT2001_SENSE_GAIN_COUNT; g++) {
+				perMa[r][g] = senseGains[g] * senseResistors[r];
+			}
+		}
+	}
+};
+
+constexpr SenseTable senseTable;
+
+static_assert(senseTable.perMa[1][2] == 12530);
+// largest current times largest factor plus bias still fits 32 bits
+static_assert(0xFFFFull * 1925 * 20 + dacBias <= UINT32_MAX);
+} // namespace pt2001
+
+// DAC code of current threshold, High if the DAC can not reach it
+constexpr expected<uint16_t> pt2001CurrentToDac(Pt2001Current current, Pt2001CurrentSense sense = {}) {
+	uint32_t perMa = pt2001::senseTable.perMa[static_cast<size_t>(sense.resistor)][static_cast<size_t>(sense.gain)];
+	uint32_t dac = (current.getRaw() * perMa + pt2001::dacBias) / pt2001::dacLsb;
+
+	if (dac > PT2001_CURRENT_DAC_MAX) {
+		return UnexpectedCode::High;
+	}
+	return static_cast<uint16_t>(dac);
+}
+
+// Microcore clocks of time in us, High if it does not fit a Data RAM word
+constexpr expected<uint16_t> pt2001UsToClocks(uint16_t us) {
+	uint32_t clocks = us * PT2001_CLOCK_MHZ;
+
+	if (clocks > 0xFFFF) {
+		return UnexpectedCode::High;
+	}
+	return static_cast<uint16_t>(clocks);
+}
+
+// Vboost comparator code: 1/32 divider on the input, then 9.77mV per LSB,
+// 3.25 counts per volt + 1.584 as tuned on boards. Datasheet limits 10..72V.
+constexpr expected<uint16_t> pt2001BoostToDac(Pt2001Voltage volts) {
+	if (volts.getRaw() > 7200) {
+		return UnexpectedCode::High;
+	}
+	if (volts.getRaw() < 1000) {
+		return UnexpectedCode::Low;
+	}
+
+	return static_cast<uint16_t>((volts.getRaw() * 325u + 15840) / 10000);
+}
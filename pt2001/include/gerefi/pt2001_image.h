@@ -0,0 +1,86 @@
+/*
+ * @file pt2001_image.h
+ *
+ * Code RAM, Data RAM and register images loaded at runtime from a blob (flash
+ * resident or mmap'd file) instead of the arrays compiled in from PT2001_LoadData.h.
+ *
+ * Blob layout, little endian:
+ *   Pt2001ImageHeader
+ *   words of every region in Pt2001Region order, size[region] words each
+ */
+
+#pragma once
+
+#include <gerefi/pt2001_transfer.h>
+
+#define PT2001_IMAGE_MAGIC 0x31325450 // "PT21"
+#define PT2001_IMAGE_VERSION 1
+// words of each code RAM
+#define PT2001_CODE_RAM_SIZE 1024
+
+struct Pt2001ImageHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	// words per region, indexed by Pt2001Region
+	uint16_t size[PT2001_REGION_COUNT];
+	// CRC32 of all region words
+	uint32_t payloadCrc;
+	// CRC32 of header up to this field
+	uint32_t headerCrc;
+};
+
+static_assert(sizeof(Pt2001ImageHeader) == 32);
+
+enum class Pt2001ImageError : uint8_t
+{
+	None = 0,
+	TooShort,
+	// blob must be 2 byte aligned, words are used in place
+	Misaligned,
+	BadMagic,
+	BadVersion,
+	BadHeaderCrc,
+	// code RAM empty or too large, Data RAM or register block not matching the chip
+	BadRegionSize,
+	// code width register of channel config does not match code RAM size
+	CodeWidthMismatch,
+	// blob shorter than header sizes say
+	Truncated,
+	BadPayloadCrc,
+};
+
+const char * pt2001ImageErrorToString(Pt2001ImageError error);
+
+// Validated view into an image blob. Region data points into the blob, so the blob
+// must stay mapped while the image is in use. See Pt2001Base::setImage.
+class Pt2001Image {
+public:
+	// Check header, sizes and CRCs, nothing of the blob is used unless all are fine
+	Pt2001ImageError load(const void* blob, size_t size);
+
+	bool isLoaded() const {
+		return m_loaded;
+	}
+
+	// Region of the image, page and addresses as in pt2001GetRegionInfo
+	const Pt2001RegionInfo& getRegion(Pt2001Region r) const {
+		return m_regions[static_cast<size_t>(r)];
+	}
+
+	uint32_t getCrc() const {
+		return m_crc;
+	}
+
+private:
+	Pt2001RegionInfo m_regions[PT2001_REGION_COUNT] = {};
+	uint32_t m_crc = 0;
+	bool m_loaded = false;
+};
+
+// Bytes of image blob holding regions of given sizes
+size_t pt2001ImageSize(const uint16_t (&size)[PT2001_REGION_COUNT]);
+
+// Write image blob of `regions` (indexed by Pt2001Region) to buffer,
+// returns bytes written or 0 if buffer is too small
+size_t pt2001BuildImage(void* buffer, size_t capacity, const Pt2001RegionInfo (&regions)[PT2001_REGION_COUNT]);
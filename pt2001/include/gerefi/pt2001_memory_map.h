@@ -6,6 +6,13 @@
 
 #include <PT2001_dram.h>
 
+// Data RAM size in 16 bit words, both channels: 0x00..0x3F ch1, 0x40..0x7F ch2
+#define PT2001_DRAM_SIZE 128
+
+// Words of largest single region download (Data RAM: page select, command, data),
+// checked against PT2001_REGION_TRANSFER_WORDS
+#define PT2001_TRANSFER_BUFFER_SIZE 131
+
 enum class MC33816Mem {
     // see dram1.def values
     Iboost = PT2001_D1_Iboost,
@@ -0,0 +1,40 @@
+/*
+ * @file pt2001_profile.h
+ *
+ * Injection profiles per cylinder and operating point (e.g. rail pressure),
+ * applied with Pt2001Base::setInjectionProfile between injection events.
+ */
+
+#pragma once
+
+#include <gerefi/pt2001.h>
+
+#define PT2001_PROFILE_CYLINDERS 8
+#define PT2001_PROFILE_POINTS 4
+
+class Pt2001ProfileTable {
+public:
+	// Operating point axis, must be increasing
+	void setBins(const float (&bins)[PT2001_PROFILE_POINTS]);
+
+	// Profile of cylinder at bin `point`, false if out of range
+	bool setProfile(size_t cylinder, size_t point, const Pt2001InjectionProfile& profile);
+	// Same profile at every point of the cylinder
+	bool setProfile(size_t cylinder, const Pt2001InjectionProfile& profile);
+
+	// Profile interpolated between bins, clamped at both ends.
+	// Returns false and leaves `out` alone if cylinder has no profile set.
+	bool getProfile(size_t cylinder, float operatingPoint, Pt2001InjectionProfile& out) const;
+
+private:
+	float m_bins[PT2001_PROFILE_POINTS] = {};
+	Pt2001InjectionProfile m_profiles[PT2001_PROFILE_CYLINDERS][PT2001_PROFILE_POINTS] = {};
+	// bit per cylinder
+	uint8_t m_set = 0;
+};
+
+// Switch chip to the profile of the cylinder about to be injected, call between
+// injection events. Cylinders without profile use the configured one.
+// Returns SPI words sent, 0 if chip already had that profile.
+uint32_t pt2001PrepareInjection(Pt2001Base& chip, const Pt2001ProfileTable& table,
+	size_t cylinder, float operatingPoint);
@@ -0,0 +1,156 @@
+/*
+ * @file pt2001_psc.h
+ *
+ * Host side assembler for the subset of PSC microcode used by ch1.psc/ch2.psc.
+ *
+ * Instructions are encoded in a documented format of our own, two words each,
+ * consumed by PscSim only. This is not the vendor encoding: the code RAM
+ * images in PT2001_LoadData.h still come from PT2001 Developer Studio, and
+ * PscProgram::simCode must never be downloaded or put into a Pt2001Image.
+ *
+ * word 0: opcode << 10 | a (10 bits: code address, Data RAM address, row mask, flag bit)
+ * word 1: b << 12 | c << 8 | d << 4 | e
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+enum class PscOp : uint8_t
+{
+	// set current sense gain: b gain index, c sense block
+	Stgn = 1,
+	// load jump register b with address a
+	Ldjr,
+	// wait table row d: condition c jumps to jump register b
+	Cwef,
+	// wait table row d: condition c jumps to a
+	Cwer,
+	// jump to a if start b is the only active start
+	Joslr,
+	// jump to jump register b
+	Jmpf,
+	// jump to a
+	Jmpr,
+	// jump to a if condition c
+	Jocr,
+	// shortcuts 1..3: b, c, d, see pscShortcut
+	Dfsct,
+	// DAC b threshold from Data RAM a, c offset
+	Load,
+	// counter b end count from Data RAM a, shortcut 1/2 output c/d, e bit0 reset, bit1 offset
+	Ldcd,
+	// flag a to b
+	Stf,
+	// shortcut outputs b, c, d
+	Stos,
+	// wait for rows in mask a
+	Wait,
+	// boost DAC access mode b
+	Stdm,
+	// DC-DC control mode b: 0 sync, 1 async
+	Stdcctl,
+};
+
+// Wait table / jump conditions, underscore prefix in source means negated
+enum class PscCond : uint8_t
+{
+	Start = 0,
+	NotStart,
+	Ocur,
+	NotOcur,
+	Tc1,
+	Tc2,
+	Tc3,
+	Tc4,
+	Cur1,
+	Cur2,
+	Cur3,
+	Cur4,
+	F0,
+	NotF0,
+	Vb,
+	NotVb,
+};
+
+// Shortcut output
+enum class PscOutput : uint8_t
+{
+	Keep = 0,
+	Off,
+	On,
+};
+
+// Sense gain, index used by stgn
+#define PSC_GAIN_COUNT 4
+extern const float pscGains[PSC_GAIN_COUNT];
+
+// dfsct operand: 0 undef, 1..7 hs1..hs7, 8..14 ls1..ls7
+constexpr uint8_t pscShortcut(bool lowSide, uint8_t n) {
+	return lowSide ? 7 + n : n;
+}
+
+constexpr bool pscIsLowSide(uint8_t shortcut) {
+	return shortcut >= 8;
+}
+
+#define PSC_WORDS_PER_INSTRUCTION 2
+#define PSC_ROWS 6
+
+struct PscInstruction {
+	PscOp op;
+	uint16_t a;
+	uint8_t b;
+	uint8_t c;
+	uint8_t d;
+	uint8_t e;
+};
+
+void pscEncode(const PscInstruction& instruction, uint16_t* words);
+bool pscDecode(const uint16_t* words, PscInstruction& instruction);
+
+struct PscProgram {
+	// pscEncode() words for PscSim, PSC_WORDS_PER_INSTRUCTION per instruction; not code RAM content
+	std::vector<uint16_t> simCode;
+	// label to instruction index
+	std::map<std::string, uint16_t> labels;
+	// source line of each instruction
+	std::vector<uint16_t> lines;
+
+	size_t getInstructionCount() const {
+		return simCode.size() / PSC_WORDS_PER_INSTRUCTION;
+	}
+
+	bool findLabel(const std::string& name, uint16_t& index) const;
+	// Closest label at or before instruction, nullptr if none
+	const char* getBlockLabel(uint16_t index) const;
+};
+
+class PscAssembler {
+public:
+	// Symbol usable as Data RAM address, as in dram1.def
+	void define(const std::string& name, uint16_t value);
+	// Parse `#define Name value;` lines
+	bool addDefinitions(const std::string& text);
+
+	// `#include "file";` is read relative to includeDir
+	bool assemble(const std::string& source, PscProgram& program, const std::string& includeDir = "");
+	bool assembleFile(const std::string& path, PscProgram& program);
+
+	// "line N: message" of the first error
+	const std::string& getError() const {
+		return m_error;
+	}
+
+private:
+	bool fail(int line, const std::string& message);
+	bool parseInstruction(int line, const std::vector<std::string>& tokens, const PscProgram& program, PscInstruction& out);
+	bool parseAddress(int line, const std::string& token, const PscProgram& program, uint16_t& address);
+	bool parseSymbol(int line, const std::string& token, uint16_t& value);
+
+	std::map<std::string, uint16_t> m_symbols;
+	std::string m_error;
+};
@@ -0,0 +1,151 @@
+/*
+ * @file pt2001_psc_sim.h
+ *
+ * Cycle level simulation of one PT2001 channel (two microcores sharing code RAM
+ * and their half of Data RAM) running a program from PscAssembler, driving a
+ * simple R/L injector load per microcore.
+ *
+ * Modelled: wait table, jump registers, counters, DAC thresholds with sense gain,
+ * shortcut outputs, flags, start inputs, boost voltage comparator against a fixed Vboost.
+ * Not modelled: offset register (ofs reads as 0), DC-DC converter, diagnostics.
+ *
+ * One instruction takes one clock; the clock runs at 6MHz like the counters.
+ */
+
+#pragma once
+
+#include <gerefi/pt2001_psc.h>
+
+#define PSC_CORES 2
+#define PSC_COUNTERS 4
+// Data RAM words of one channel
+#define PSC_DRAM_SIZE 64
+
+struct PscSimConfig {
+	float vbatt = 14;
+	float vboost = 65;
+
+	// injector coil
+	float resistance = 1.5f;
+	float inductance = 1.5e-3f;
+
+	// current sense resistor
+	float senseResistance = 0.01f;
+	// recirculation diode
+	float diodeDrop = 0.7f;
+};
+
+// Output change of a microcore
+struct PscTraceEvent {
+	uint32_t tick;
+	uint8_t core;
+	// label of the code block that changed the outputs
+	const char* label;
+
+	bool bat;
+	bool boost;
+	bool lowSide;
+	float current;
+};
+
+class PscSim {
+public:
+	static constexpr uint32_t ticksPerUs = 6;
+
+	explicit PscSim(const PscProgram& program);
+
+	PscSimConfig config;
+	// channel Data RAM, e.g. from PT2001_data_RAM; channel 2 starts at word 64
+	uint16_t dram[PSC_DRAM_SIZE] = {};
+	// flags set by stf, flag 0 is shared with the DC-DC microcore
+	uint16_t flags = 0;
+
+	// Start microcore at label, false if there is no such label
+	bool startCore(size_t core, const char* label);
+	// Start inputs 1..6 seen by the microcore, all by default
+	void setStartMask(size_t core, uint8_t mask);
+	void setStart(size_t start, bool active);
+
+	void run(uint32_t ticks);
+	void runUs(uint32_t us) {
+		run(us * ticksPerUs);
+	}
+
+	uint32_t getTick() const {
+		return m_tick;
+	}
+
+	float getCurrent(size_t core) const {
+		return m_cores[core].current;
+	}
+
+	// Current threshold of microcore DAC in A, sense gain applied
+	float getThreshold(size_t core) const;
+
+	const std::vector<PscTraceEvent>& getTrace() const {
+		return m_trace;
+	}
+
+	// First event of core at or after tick from code block `label`, nullptr if none
+	const PscTraceEvent* findEvent(size_t core, const char* label, uint32_t fromTick = 0) const;
+
+	// Set when a microcore stopped on bad code, nullptr otherwise
+	const char* getError() const {
+		return m_error;
+	}
+
+private:
+	struct Row {
+		bool set;
+		bool viaRegister;
+		uint8_t cond;
+		uint16_t target;
+	};
+
+	struct Counter {
+		bool loaded;
+		uint16_t count;
+		uint16_t end;
+	};
+
+	struct Core {
+		bool running;
+		uint16_t pc;
+		uint16_t jr[2];
+		Row rows[PSC_ROWS];
+		Counter counters[PSC_COUNTERS];
+
+		uint8_t gain;
+		uint16_t dac;
+		uint16_t dac4h;
+
+		uint8_t startMask;
+		// hs/ls of each shortcut, see pscShortcut
+		uint8_t shortcuts[3];
+		bool outputs[3];
+		float current;
+
+		bool lastBat;
+		bool lastBoost;
+		bool lastLowSide;
+	};
+
+	void step(size_t index);
+	// false and stops microcore on bad code
+	bool execute(Core& core, const PscInstruction& instruction);
+	bool condition(const Core& core, uint8_t cond) const;
+	bool jump(Core& core, uint16_t target);
+	void setOutput(Core& core, size_t shortcut, uint8_t output);
+	// battery, boost, low side switch states from shortcut roles
+	void getSwitches(const Core& core, bool& bat, bool& boost, bool& lowSide) const;
+	void updateLoad(Core& core);
+	void stop(Core& core, const char* error);
+
+	const PscProgram& m_program;
+	Core m_cores[PSC_CORES] = {};
+	uint8_t m_starts = 0;
+	uint32_t m_tick = 0;
+
+	std::vector<PscTraceEvent> m_trace;
+	const char* m_error = nullptr;
+};
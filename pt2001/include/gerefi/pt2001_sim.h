@@ -0,0 +1,178 @@
+/*
+ * @file pt2001_sim.h
+ *
+ * Host simulation of the PT2001 as seen over SPI and GPIO, for unit tests and
+ * measuring driver SPI traffic/latency without hardware.
+ *
+ * Modelled: Mode A SPI commands and channel select pages, code RAM 1/2 (0x000..0x3FF
+ * of their pages), Data RAM and registers 0x100..0x1FF (common page only), flash enable,
+ * driver status bits, ResetB/DRIVEN pins and flag0. Addresses with nothing behind them
+ * on the selected page read as zero and ignore writes.
+ * Not modelled: microcode execution, anything analog.
+ */
+
+#pragma once
+
+#include <gerefi/pt2001.h>
+#include <gerefi/gerefi_time_math.h>
+
+// Injectable faults, bit mask
+enum class Pt2001SimFault : uint8_t
+{
+	None = 0,
+	// VccP undervoltage, driver status bit 0
+	UnderVoltageVccP = 1 << 0,
+	// V5 undervoltage, driver status bit 1
+	UnderVoltageV5 = 1 << 1,
+	// over temperature, driver status bit 3
+	OverTemp = 1 << 2,
+	// MISO stuck low, every read returns 0
+	NoComm = 1 << 3,
+	// flash enable never reported, microcode does not start
+	BadFlash = 1 << 4,
+	// DRIVEN pin has no effect
+	NoDriven = 1 << 5,
+};
+
+// Values returned by the configuration getters
+struct Pt2001SimConfig {
+	float vbatt = 14;
+
+	Pt2001Voltage boostVoltage = 65;
+	Pt2001Current boostCurrent = 13;
+	Pt2001Current peakCurrent = 10;
+	Pt2001Current holdCurrent = 3;
+	Pt2001Current pumpPeakCurrent = 5;
+	Pt2001Current pumpHoldCurrent = 2;
+
+	uint16_t tpeakOff = 10;
+	uint16_t tpeakTot = 700;
+	uint16_t tbypass = 10;
+	uint16_t tholdOff = 60;
+	uint16_t tholdTot = 10000;
+	uint16_t tboostMin = 100;
+	uint16_t tboostMax = 400;
+	uint16_t pumpTholdOff = 10;
+	uint16_t pumpTholdTot = 10000;
+
+	bool errorOnUnexpectedFlag = true;
+};
+
+class Pt2001Sim : public Pt2001Base {
+public:
+	// McFault overload next to the const char* one below
+	using Pt2001Base::onError;
+
+	Pt2001SimConfig config;
+
+	// fault injection, see Pt2001SimFault
+	void setFault(Pt2001SimFault simFault, bool active);
+	bool hasFault(Pt2001SimFault simFault) const;
+
+	// Simulated time: advances with sleepMs and SPI traffic
+	uint64_t getTimeNs() const {
+		return m_timeNs;
+	}
+
+	// Cost of one 16 bit SPI word and of chip select toggle, 4MHz SPI by default
+	uint32_t spiWordNs = 4000;
+	uint32_t spiSelectNs = 1000;
+
+	// Traffic as seen by the chip
+	uint32_t simWords = 0;
+	uint32_t simSelects = 0;
+
+	// Longest time the bus was held between acquireBus and releaseBus
+	uint64_t maxBusHoldNs = 0;
+	int busDepth = 0;
+
+	// Last onError(const char*) message
+	const char* lastError = nullptr;
+
+	bool isDriveEnabled() const {
+		return m_driveEn;
+	}
+
+	bool isInReset() const {
+		return !m_resetB;
+	}
+
+	// Chip memory, writable for corruption tests
+	uint16_t codeRam1[1024] = {};
+	uint16_t codeRam2[1024] = {};
+	uint16_t dataRam[PT2001_DRAM_SIZE] = {};
+	// registers 0x100..0x1FF of common page
+	uint16_t regs[0x100] = {};
+
+	uint16_t chipId = 0x9D00;
+
+protected:
+	void acquireBus() override;
+	void releaseBus() override;
+	void select() override;
+	void deselect() override;
+	uint16_t sendRecv(uint16_t tx) override;
+	void sendLarge(const uint16_t* data, size_t count) override;
+
+	void setResetB(bool state) override;
+	void setDriveEN(bool state) override;
+	bool readFlag0() const override;
+
+	float getVbatt() const override { return config.vbatt; }
+
+	Pt2001Voltage getBoostVoltage() const override { return config.boostVoltage; }
+	Pt2001Current getBoostCurrent() const override { return config.boostCurrent; }
+	Pt2001Current getPeakCurrent() const override { return config.peakCurrent; }
+	Pt2001Current getHoldCurrent() const override { return config.holdCurrent; }
+	Pt2001Current getPumpPeakCurrent() const override { return config.pumpPeakCurrent; }
+	Pt2001Current getPumpHoldCurrent() const override { return config.pumpHoldCurrent; }
+
+	uint16_t getTpeakOff() const override { return config.tpeakOff; }
+	uint16_t getTpeakTot() const override { return config.tpeakTot; }
+	uint16_t getTbypass() const override { return config.tbypass; }
+	uint16_t getTholdOff() const override { return config.tholdOff; }
+	uint16_t getTHoldTot() const override { return config.tholdTot; }
+	uint16_t getTBoostMin() const override { return config.tboostMin; }
+	uint16_t getTBoostMax() const override { return config.tboostMax; }
+	uint16_t getPumpTholdOff() const override { return config.pumpTholdOff; }
+	uint16_t getPumpTholdTot() const override { return config.pumpTholdTot; }
+
+	void onError(const char* why) override;
+	bool errorOnUnexpectedFlag() override { return config.errorOnUnexpectedFlag; }
+
+public:
+	// Advances simulated time only, also for callers driving restartStep()
+	void sleepMs(size_t ms) override;
+
+#if EFI_PT2001_TRACE
+protected:
+	// simulated time, so traced bus time matches spiWordNs/spiSelectNs
+	efitick_t getTraceTimeNt() const override { return m_timeNs * US_TO_NT_MULTIPLIER / 1000; }
+#endif
+
+private:
+	uint16_t readWord(uint16_t addr);
+	void writeWord(uint16_t addr, uint16_t data);
+	bool isRegister(uint16_t addr) const;
+	// word at addr of selected page, nullptr if there is none
+	uint16_t* locate(uint16_t addr);
+	// condition bits of driver status register
+	uint16_t getStatusConditions() const;
+
+	enum class Expect : uint8_t { Command, Page, Data };
+	Expect m_expect = Expect::Command;
+	uint16_t m_page = 0;
+	uint16_t m_addr = 0;
+	uint16_t m_remaining = 0;
+	bool m_read = false;
+	bool m_selected = false;
+
+	bool m_resetB = false;
+	bool m_driveEn = false;
+	// latched driver status bits, cleared by writing 0x1D2
+	uint16_t m_statusLatched = 0;
+	uint8_t m_faults = 0;
+
+	uint64_t m_timeNs = 0;
+	uint64_t m_busAcquiredNs = 0;
+};
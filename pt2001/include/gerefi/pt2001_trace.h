@@ -0,0 +1,82 @@
+/*
+ * @file pt2001_trace.h
+ *
+ * SPI transaction trace of Pt2001Base: every Mode A command (and channel select)
+ * with its word count and bus time, kept in a ring buffer. See pt2001_trace_decode.h
+ * for turning it into text on the host.
+ *
+ * Enabled with EFI_PT2001_TRACE, compiles out completely otherwise. It changes the
+ * layout of Pt2001Base: define it on the compiler command line, for every file.
+ */
+
+#pragma once
+
+#include <gerefi/gerefi_time_types.h>
+
+#ifndef EFI_PT2001_TRACE
+#define EFI_PT2001_TRACE 0
+#endif
+
+// entries kept, oldest are overwritten
+#ifndef PT2001_TRACE_SIZE
+#define PT2001_TRACE_SIZE 64
+#endif
+
+#define PT2001_TRACE_CHANNEL_SELECT 0x7FE1
+
+struct Pt2001TraceEntry {
+	efitick_t startNt;
+	// from command word until last word of the command is transferred
+	uint32_t durationNt;
+	// Mode A command word, PT2001_TRACE_CHANNEL_SELECT for page selection
+	uint16_t command;
+	// words transferred after the command, including data of zero count (streamed) commands
+	uint16_t words;
+	// page selected while the command ran, page selected for channel select
+	uint8_t page;
+	// chip select frames since trace start, low bits, groups commands of one frame
+	uint8_t frame;
+};
+
+class Pt2001Trace {
+public:
+	// SPI hooks, called by Pt2001Base around every transfer
+	void onSelect();
+	void onDeselect(efitick_t nowNt);
+	// before the word goes out
+	void onWord(uint16_t tx, efitick_t nowNt);
+	// after it is done
+	void onWordDone(efitick_t nowNt);
+	void onLarge(const uint16_t* data, size_t count, efitick_t startNt, efitick_t endNt);
+
+	// Entries in order, 0 is the oldest one still kept
+	size_t getCount() const;
+	const Pt2001TraceEntry& get(size_t index) const;
+
+	// entries lost to ring wrap around
+	uint32_t getDropped() const {
+		return m_dropped;
+	}
+
+	void clear();
+
+private:
+	void finish();
+
+	enum class Expect : uint8_t { Command, Page, Data };
+
+	Pt2001TraceEntry m_entries[PT2001_TRACE_SIZE] = {};
+	size_t m_next = 0;
+	size_t m_count = 0;
+	uint32_t m_dropped = 0;
+
+	// command in progress
+	Pt2001TraceEntry m_current = {};
+	bool m_open = false;
+	Expect m_expect = Expect::Command;
+	uint16_t m_remaining = 0;
+	efitick_t m_lastNt = 0;
+
+	uint8_t m_page = 0;
+	uint8_t m_frame = 0;
+};
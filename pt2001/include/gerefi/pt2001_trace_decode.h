@@ -0,0 +1,33 @@
+/*
+ * @file pt2001_trace_decode.h
+ *
+ * Host side decoder of Pt2001Trace: one line per SPI transaction, e.g.
+ *
+ *   frame 3  R 0x1D2 x4   driver status       1.0us
+ *   frame 3  W page 4     common              0.4us
+ */
+
+#pragma once
+
+#include <gerefi/pt2001_trace.h>
+
+#include <string>
+
+struct Pt2001TraceSummary {
+	uint32_t reads;
+	uint32_t writes;
+	uint32_t pageSelects;
+	// words after command words, including selected pages
+	uint32_t dataWords;
+	efitick_t busNt;
+};
+
+// Region or register at address of page, e.g. "driver status", "ch1 config"
+const char* pt2001TraceAddressName(uint8_t page, uint16_t address);
+
+std::string pt2001TraceFormat(const Pt2001TraceEntry& entry);
+
+Pt2001TraceSummary pt2001TraceSummarize(const Pt2001Trace& trace);
+
+// All entries oldest first and summary
+std::string pt2001TraceDecode(const Pt2001Trace& trace);
@@ -0,0 +1,126 @@
+/*
+ * @file pt2001_transfer.h
+ *
+ * Builds the SPI word stream that downloads code RAM, Data RAM and register
+ * configuration into the PT2001, ready to be pushed with one sendLarge/DMA
+ * transfer per chip select frame.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gerefi/arrays.h>
+#include <gerefi/pt2001.h>
+#include <PT2001_LoadData.h>
+
+#define PT2001_MAX_TRANSFER_SIZE 31
+
+struct Pt2001RegionInfo {
+	Pt2001Page page;
+	uint16_t address;
+	// code width register written before code RAM download, 0 if none
+	uint16_t codeWidthAddress;
+	const uint16_t* data;
+	uint16_t size;
+};
+
+const Pt2001RegionInfo& pt2001GetRegionInfo(Pt2001Region r);
+
+// Mode A command words
+constexpr uint16_t pt2001WriteCommand(uint16_t address, uint16_t count) {
+	return (address << 5) | count;
+}
+
+constexpr uint16_t pt2001ReadCommand(uint16_t address, uint16_t count) {
+	return 0x8000 | pt2001WriteCommand(address, count);
+}
+
+// Words needed to write `size` words as commands of at most PT2001_MAX_TRANSFER_SIZE words
+constexpr size_t pt2001ChunkedWords(size_t size) {
+	return size + (size + PT2001_MAX_TRANSFER_SIZE - 1) / PT2001_MAX_TRANSFER_SIZE;
+}
+
+// RAM is streamed in one command: code width on common page, page select, start address, data
+constexpr size_t pt2001RamTransferWords(size_t size, bool codeRam) {
+	return (codeRam ? 2 + 2 : 0) + 2 + 1 + size;
+}
+
+// Register write, selecting common page first if needed
+constexpr size_t pt2001RegisterTransferWords(size_t size) {
+	return 2 + pt2001ChunkedWords(size);
+}
+
+constexpr size_t pt2001Max(size_t a, size_t b) {
+	return a > b ? a : b;
+}
+
+// Largest single region transfer
+#define PT2001_REGION_TRANSFER_WORDS pt2001Max( \
+	pt2001Max(pt2001RamTransferWords(efi::size(PT2001_code_RAM1), true), pt2001RamTransferWords(efi::size(PT2001_code_RAM2), true)), \
+	pt2001Max(pt2001RamTransferWords(efi::size(PT2001_data_RAM), false), pt2001RegisterTransferWords(efi::size(PT2001_io_config))))
+
+// Complete restart download, common page is selected again after code RAM 2
+#define PT2001_TRANSFER_WORDS ( \
+	pt2001RamTransferWords(efi::size(PT2001_code_RAM1), true) + \
+	pt2001RamTransferWords(efi::size(PT2001_code_RAM2), true) + \
+	pt2001RamTransferWords(efi::size(PT2001_data_RAM), false) + \
+	pt2001ChunkedWords(efi::size(PT2001_main_config)) + \
+	pt2001ChunkedWords(efi::size(PT2001_ch1_config)) + \
+	pt2001ChunkedWords(efi::size(PT2001_ch2_config)) + \
+	pt2001ChunkedWords(efi::size(PT2001_io_config)) + \
+	pt2001ChunkedWords(efi::size(PT2001_diag_config)))
+
+// Fills caller buffer with download word stream, split into chip select frames.
+// RAM is streamed with zero word count, so it always ends a frame; register
+// writes are chunked and share a frame.
+class Pt2001TransferBuilder {
+public:
+	// `page` is the page chip currently has selected, page select is skipped if it matches
+	Pt2001TransferBuilder(uint16_t* buffer, size_t capacity, Pt2001Page page = Pt2001Page::Unknown);
+
+	// Append download of one region, false if buffer is too small
+	bool addRegion(Pt2001Region r);
+	// Same for region content other than the compiled in one, see Pt2001Image
+	bool addRegion(const Pt2001RegionInfo& region);
+	// Append regions in mask of (1 << Pt2001Region), from..to inclusive
+	bool addRegions(uint8_t mask, Pt2001Region from, Pt2001Region to);
+	// Append register write of any length, split into commands of at most PT2001_MAX_TRANSFER_SIZE words.
+	// Selects common page first, registers do not exist on the code RAM pages.
+	bool addWrite(uint16_t address, const uint16_t* data, size_t size);
+
+	size_t getWordCount() const {
+		return m_used;
+	}
+
+	size_t getFrameCount() const;
+	// Words of frame `index`
+	const uint16_t* getFrame(size_t index, size_t& count) const;
+
+	// Page selected once all frames are sent
+	Pt2001Page getPage() const {
+		return m_page;
+	}
+
+	uint32_t getPageSelects() const {
+		return m_pageSelects;
+	}
+
+private:
+	bool put(uint16_t word);
+	bool selectPage(Pt2001Page page);
+	bool addRam(const Pt2001RegionInfo& region);
+	bool endFrame();
+
+	uint16_t* const m_buffer;
+	const size_t m_capacity;
+	size_t m_used = 0;
+
+	// frame i spans m_frameStart[i]..m_frameStart[i + 1]
+	size_t m_frameStart[PT2001_REGION_COUNT + 2] = {};
+	size_t m_frames = 0;
+
+	Pt2001Page m_page;
+	uint32_t m_pageSelects = 0;
+};
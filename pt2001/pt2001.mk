@@ -7,3 +7,26 @@ GEREFI_LIB_C += \
 
 GEREFI_LIB_CPP += \
 	$(GEREFI_LIB)/pt2001/src/pt2001.cpp \
+	$(GEREFI_LIB)/pt2001/src/pt2001_transfer.cpp \
+	$(GEREFI_LIB)/pt2001/src/pt2001_bus.cpp \
+	$(GEREFI_LIB)/pt2001/src/pt2001_profile.cpp \
+	$(GEREFI_LIB)/pt2001/src/pt2001_image.cpp \
+	$(GEREFI_LIB)/pt2001/src/pt2001_trace.cpp \
+
+# host only: chip simulation for tests and benchmarks
+GEREFI_LIB_HOST_CPP += \
+	$(GEREFI_LIB)/pt2001/src/pt2001_sim.cpp \
+	$(GEREFI_LIB)/pt2001/src/pt2001_psc.cpp \
+	$(GEREFI_LIB)/pt2001/src/pt2001_psc_sim.cpp \
+	$(GEREFI_LIB)/pt2001/src/pt2001_trace_decode.cpp \
+
+GEREFI_LIB_CPP_TEST += \
+	$(GEREFI_LIB)/pt2001/test/test_pt2001.cpp \
+	$(GEREFI_LIB)/pt2001/test/test_pt2001_transfer.cpp \
+	$(GEREFI_LIB)/pt2001/test/test_pt2001_diag.cpp \
+	$(GEREFI_LIB)/pt2001/test/test_pt2001_bus.cpp \
+	$(GEREFI_LIB)/pt2001/test/test_pt2001_profile.cpp \
+	$(GEREFI_LIB)/pt2001/test/test_pt2001_image.cpp \
+	$(GEREFI_LIB)/pt2001/test/test_pt2001_psc.cpp \
+	$(GEREFI_LIB)/pt2001/test/test_pt2001_trace.cpp \
+	$(GEREFI_LIB)/pt2001/test/test_pt2001_conversion.cpp \
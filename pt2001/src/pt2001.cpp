@@ -15,37 +15,25 @@
  */
 
 #include <gerefi/pt2001.h>
+#include <gerefi/pt2001_image.h>
 #include <gerefi/arrays.h>
+#include <gerefi/crc.h>
 
 #include <PT2001_LoadData.h>
 
-const int MC_CK = 6; // PLL x24 / CLK_DIV 4 = 6Mhz
-
 const int MAX_SPI_MODE_A_TRANSFER_SIZE = 31;  //max size for register config transfer
 
-enum {
-	CODE_RAM1,
-	CODE_RAM2,
-	DATA_RAM
-};
-enum {
-	REG_MAIN,
-	REG_CH1,
-	REG_CH2,
-	REG_IO,
-	REG_DIAG
-};
-
 static bool validateChipId(uint16_t id) {
 	return (id >> 8) == 0x9D;
 }
 
 void Pt2001Base::setupSpi() {
-	select();
-	// Select Channel command
-	send(0x7FE1);
-	// Common Page
-	send(0x0004);
+	spiStats.spiSetups++;
+
+	spiSelect();
+	// state of the chip is unknown, always send channel select
+	m_page = Pt2001Page::Unknown;
+	selectPage(Pt2001Page::Common);
 
 
 	// Configure SPI command
@@ -53,14 +41,40 @@ void Pt2001Base::setupSpi() {
 	// Mode A + Watchdog timer full
 	//send(0x001F);
 	send(0x009F); // + fast slew rate on miso
-	deselect();
+	spiDeselect();
+
+	m_spiConfigured = true;
+}
+
+void Pt2001Base::ensureSpi() {
+	if (!m_spiConfigured) {
+		setupSpi();
+	}
+}
+
+void Pt2001Base::selectPage(Pt2001Page page) {
+	if (m_page == page) {
+		spiStats.pageSelectsSkipped++;
+		return;
+	}
+
+	spiStats.pageSelects++;
+	// Select Channel command
+	send(0x7FE1);
+	send(static_cast<uint16_t>(page));
+	m_page = page;
+}
+
+void Pt2001Base::invalidateSpiState() {
+	m_spiConfigured = false;
+	m_page = Pt2001Page::Unknown;
 }
 
 uint16_t Pt2001Base::readId() {
-	select();
+	spiSelect();
 	send(0xBAA1);
 	uint16_t ID = recv();
-	deselect();
+	spiDeselect();
 	return ID;
 }
 
@@ -68,15 +82,14 @@ uint16_t Pt2001Base::readId() {
 uint16_t Pt2001Base::readDram(MC33816Mem addr) {
 	uint16_t addrInt = static_cast<uint16_t>(addr);
 
-	select();
-	// Select Channel command, Common Page
-	send(0x7FE1);
-	send(0x0004);
+	ensureSpi();
+	spiSelect();
+	selectPage(Pt2001Page::Common);
 	// read (MSB=1) at data ram x9 (SCV_I_Hold), and 1 word
 	send((0x8000 | addrInt << 5) + 1);
 	uint16_t readValue = recv();
 
-	deselect();
+	spiDeselect();
 	return readValue;
 }
 
@@ -84,80 +97,208 @@ uint16_t Pt2001Base::readDram(MC33816Mem addr) {
 void Pt2001Base::writeDram(MC33816Mem addr, uint16_t data) {
 	uint16_t addrInt = static_cast<uint16_t>(addr);
 
-	select();
-	// Select Channel command, Common Page
-	send(0x7FE1);
-	send(0x0004);
+	ensureSpi();
+	spiSelect();
+	selectPage(Pt2001Page::Common);
 	// write (MSB=0) at data ram x9 (SCV_I_Hold), and 1 word
 	send((addrInt << 5) + 1);
 	send(data);
 
-	deselect();
+	spiDeselect();
+
+	m_dramShadow[addrInt] = data;
+	m_dramValid[addrInt / 32] |= 1u << (addrInt % 32);
+	m_dramDirty[addrInt / 32] &= ~(1u << (addrInt % 32));
+}
+
+static_assert(sizeof(PT2001_data_RAM) / 2 == PT2001_DRAM_SIZE);
+
+static bool testBit(const uint32_t* bits, size_t idx) {
+	return bits[idx / 32] & (1u << (idx % 32));
+}
+
+void Pt2001Base::setDram(MC33816Mem addr, uint16_t data) {
+	uint16_t addrInt = static_cast<uint16_t>(addr);
+	uint32_t mask = 1u << (addrInt % 32);
+
+	if ((m_dramValid[addrInt / 32] & mask) && m_dramShadow[addrInt] == data) {
+		// chip already has it
+		return;
+	}
+
+	m_dramShadow[addrInt] = data;
+	m_dramValid[addrInt / 32] |= mask;
+	m_dramDirty[addrInt / 32] |= mask;
+}
+
+void Pt2001Base::flushDram() {
+	bool selected = false;
+	size_t addr = 0;
+
+	while (addr < PT2001_DRAM_SIZE) {
+		if (!testBit(m_dramDirty, addr)) {
+			addr++;
+			continue;
+		}
+
+		// Extend the run over following dirty words. A single clean (but known)
+		// word in between costs the same as a new command word, so swallow it too.
+		size_t start = addr;
+		size_t end = addr + 1;
+		while (end < PT2001_DRAM_SIZE && (end - start) < MAX_SPI_MODE_A_TRANSFER_SIZE) {
+			if (testBit(m_dramDirty, end)) {
+				end++;
+			} else if (end + 1 < PT2001_DRAM_SIZE && (end + 1 - start) < MAX_SPI_MODE_A_TRANSFER_SIZE &&
+					testBit(m_dramValid, end) && testBit(m_dramDirty, end + 1)) {
+				end += 2;
+			} else {
+				break;
+			}
+		}
+
+		if (!selected) {
+			ensureSpi();
+			spiSelect();
+			selectPage(Pt2001Page::Common);
+			selected = true;
+		}
+
+		// write (MSB=0) at start, and number of words to follow
+		send((start << 5) + (end - start));
+		spiSendLarge(m_dramShadow + start, end - start);
+
+		addr = end;
+	}
+
+	if (selected) {
+		spiDeselect();
+	}
+
+	for (size_t i = 0; i < efi::size(m_dramDirty); i++) {
+		m_dramDirty[i] = 0;
+	}
+}
+
+void Pt2001Base::invalidateDram() {
+	for (size_t i = 0; i < efi::size(m_dramValid); i++) {
+		m_dramValid[i] = 0;
+		m_dramDirty[i] = 0;
+	}
+}
+
+void Pt2001Base::setDramShadow(const uint16_t* data, size_t count) {
+	invalidateDram();
+
+	for (size_t i = 0; i < count && i < PT2001_DRAM_SIZE; i++) {
+		m_dramShadow[i] = data[i];
+		m_dramValid[i / 32] |= 1u << (i % 32);
+	}
+}
+
+void Pt2001Base::setDramCurrent(MC33816Mem addr, Pt2001Current current) {
+	auto dac = pt2001CurrentToDac(current, getCurrentSense());
+	if (!dac) {
+		// chip keeps the previous threshold
+		onError("PT2001 current setpoint out of DAC range");
+		return;
+	}
+	setDram(addr, dac.Value);
+}
+
+void Pt2001Base::setDramTime(MC33816Mem addr, uint16_t us) {
+	auto clocks = pt2001UsToClocks(us);
+	if (!clocks) {
+		onError("PT2001 time setpoint too long");
+		return;
+	}
+	setDram(addr, clocks.Value);
+}
+
+Pt2001InjectionProfile Pt2001Base::getConfiguredProfile() const {
+	Pt2001InjectionProfile profile;
+
+	profile.boostCurrent = getBoostCurrent();
+	profile.peakCurrent = getPeakCurrent();
+	profile.holdCurrent = getHoldCurrent();
+
+	profile.tpeakOff = getTpeakOff();
+	profile.tpeakTot = getTpeakTot();
+	profile.tbypass = getTbypass();
+	profile.tholdOff = getTholdOff();
+	profile.tholdTot = getTHoldTot();
+	profile.tboostMin = getTBoostMin();
+	profile.tboostMax = getTBoostMax();
+
+	return profile;
 }
 
-static uint16_t dacEquation(float current) {
-	/*
-		Current, given in A
-		I = (DAC_VALUE * V_DAC_LSB - V_DA_BIAS)/(G_DA_DIFF * R_SENSEx)
-		DAC_VALUE = ((I*G_DA_DIFF * R_SENSEx) + V_DA_BIAS) /  V_DAC_LSB
-		V_DAC_LSB is the DAC resolution = 9.77mv
-		V_DA_BIAS = 250mV
-		G_DA_DIFF = Gain: 5.79, 8.68, [12.53], 19.25
-		R_SENSE = 10mOhm soldered on board
-	*/
-	return ((current * 12.53f * 10) + 250.0f) / 9.77f;
+void Pt2001Base::stageProfile(const Pt2001InjectionProfile& profile) {
+	// currents to DAC codes, times in micro seconds to clock cycles
+	setDramCurrent(MC33816Mem::Iboost, profile.boostCurrent);
+	setDramCurrent(MC33816Mem::Ipeak, profile.peakCurrent);
+	setDramCurrent(MC33816Mem::Ihold, profile.holdCurrent);
+
+	setDramTime(MC33816Mem::Tpeak_off, profile.tpeakOff);
+	setDramTime(MC33816Mem::Tpeak_tot, profile.tpeakTot);
+	setDramTime(MC33816Mem::Tbypass, profile.tbypass);
+	setDramTime(MC33816Mem::Thold_off, profile.tholdOff);
+	setDramTime(MC33816Mem::Thold_tot, profile.tholdTot);
+	setDramTime(MC33816Mem::Tboost_min, profile.tboostMin);
+	setDramTime(MC33816Mem::Tboost_max, profile.tboostMax);
 }
 
 void Pt2001Base::setTimings() {
 	setBoostVoltage(getBoostVoltage());
 
-	// Convert mA to DAC values
-	writeDram(MC33816Mem::Iboost, dacEquation(getBoostCurrent()));
-	writeDram(MC33816Mem::Ipeak, dacEquation(getPeakCurrent()));
-	writeDram(MC33816Mem::Ihold, dacEquation(getHoldCurrent()));
-
-	// in micro seconds to clock cycles
-	writeDram(MC33816Mem::Tpeak_off, (MC_CK * getTpeakOff()));
-	writeDram(MC33816Mem::Tpeak_tot, (MC_CK * getTpeakTot()));
-	writeDram(MC33816Mem::Tbypass, (MC_CK * getTbypass()));
-	writeDram(MC33816Mem::Thold_off, (MC_CK * getTholdOff()));
-	writeDram(MC33816Mem::Thold_tot, (MC_CK * getTHoldTot()));
-	writeDram(MC33816Mem::Tboost_min, (MC_CK * getTBoostMin()));
-	writeDram(MC33816Mem::Tboost_max, (MC_CK * getTBoostMax()));
+	stageProfile(getConfiguredProfile());
 
 	// HPFP solenoid settings
-	writeDram(MC33816Mem::HPFP_Ipeak, dacEquation(getPumpPeakCurrent()));
-	writeDram(MC33816Mem::HPFP_Ihold, dacEquation(getPumpHoldCurrent()));
-	writeDram(MC33816Mem::HPFP_Thold_off, MC_CK * getPumpTholdOff());
-	writeDram(MC33816Mem::HPFP_Thold_tot, MC_CK * getPumpTholdTot());
+	setDramCurrent(MC33816Mem::HPFP_Ipeak, getPumpPeakCurrent());
+	setDramCurrent(MC33816Mem::HPFP_Ihold, getPumpHoldCurrent());
+	setDramTime(MC33816Mem::HPFP_Thold_off, getPumpTholdOff());
+	setDramTime(MC33816Mem::HPFP_Thold_tot, getPumpTholdTot());
+
+	// only changed values are sent, in a single chip select
+	flushDram();
+}
+
+void Pt2001Base::applyTimings() {
+	busAcquire();
+	setTimings();
+	busRelease();
+}
+
+void Pt2001Base::setInjectionProfile(const Pt2001InjectionProfile& profile) {
+	busAcquire();
+	stageProfile(profile);
+	flushDram();
+	busRelease();
 }
 
-void Pt2001Base::setBoostVoltage(float volts) {
+void Pt2001Base::setBoostVoltage(Pt2001Voltage volts) {
 	// Sanity checks, Datasheet says not too high, nor too low
-	if (volts > 72.0f) {
-		onError("DI Boost voltage setpoint too high");
-		return;
-	}
-	if (volts < 10.0f) {
-		onError("DI Boost voltage setpoint too low");
+	auto data = pt2001BoostToDac(volts);
+	if (!data) {
+		onError(data.Code == UnexpectedCode::High
+			? "DI Boost voltage setpoint too high"
+			: "DI Boost voltage setpoint too low");
 		return;
 	}
 
-	// There's a 1/32 divider on the input, then the DAC's output is 9.77mV per LSB.  (1 / 32) / 0.00977 = 3.199 counts per volt.
-	uint16_t data = (volts * 3.25f) + 1.584f;
-	writeDram(MC33816Mem::Vboost_high, data+1);
-	writeDram(MC33816Mem::Vboost_low, data-1);
+	setDram(MC33816Mem::Vboost_high, data.Value + 1);
+	setDram(MC33816Mem::Vboost_low, data.Value - 1);
 	// Remember to strobe driven!!
 }
 
 bool Pt2001Base::checkFlash() {
-	select();
+	spiSelect();
+	selectPage(Pt2001Page::Common); // only sent if not on common page yet
 
 	// ch1
 	// read (MSB=1) at location, and 1 word
 	send((0x8000 | 0x100 << 5) + 1);
 	if (!(recv() & (1<<5))) {
-		deselect();
+		spiDeselect();
 		return false;
 	}
 
@@ -166,11 +307,11 @@ bool Pt2001Base::checkFlash() {
 	send((0x8000 | 0x120 << 5) + 1);
 
 	if (!(recv() & (1<<5))) {
-		deselect();
+		spiDeselect();
 		return false;
 	}
 
-	deselect();
+	spiDeselect();
 	return true;
 }
 
@@ -178,19 +319,21 @@ void Pt2001Base::clearDriverStatus(){
 	// Note: There is a config at 0x1CE & 1 that can reset this status config register on read
 	// otherwise the reload/recheck occurs with this write
 	// resetting it is necessary to clear default reset behavoir, as well as if an issue has been resolved
-	setupSpi(); // ensure on common page?
-	select();
+	ensureSpi();
+	spiSelect();
+	selectPage(Pt2001Page::Common); // only sent if not on common page yet
 	send((0x0000 | 0x1D2 << 5) + 1); // write, location, one word
 	send(0x0000); // anything to clear
-	deselect();
+	spiDeselect();
 }
 
 uint16_t Pt2001Base::readStatus(int reg) {
-	setupSpi(); // ensure on common page?
-	select();
+	ensureSpi();
+	spiSelect();
+	selectPage(Pt2001Page::Common); // only sent if not on common page yet
 	send((0x8000 | reg << 5) + 1);
 	uint16_t driverStatus = recv();
-	deselect();
+	spiDeselect();
 	return driverStatus;
 }
 
@@ -215,162 +358,343 @@ static bool checkDrivenEnabled(uint16_t driverStatus){
 }
 
 void Pt2001Base::enableFlash() {
-	select();
+	spiSelect();
+	selectPage(Pt2001Page::Common); // code RAM download may have left another page
 	send(0x2001); //ch1
 	send(0x0018); //enable flash
 	send(0x2401); //ch2
 	send(0x0018); // enable flash
-	deselect();
+	spiDeselect();
+}
+
+const char * pt2001DiagFlagToString(Pt2001DiagFlag flag) {
+	switch (flag) {
+		case Pt2001DiagFlag::VccPUnderVoltage:
+			return "VccPUnderVoltage";
+		case Pt2001DiagFlag::V5UnderVoltage:
+			return "V5UnderVoltage";
+		case Pt2001DiagFlag::OverTemp:
+			return "OverTemp";
+		case Pt2001DiagFlag::NotDriven:
+			return "NotDriven";
+		case Pt2001DiagFlag::FlashStopped:
+			return "FlashStopped";
+		case Pt2001DiagFlag::NoComm:
+			return "NoComm";
+	}
+	return "TODO";
+}
+
+// flags that mean the chip is not doing its job any more
+static const uint8_t recoveryFlags =
+	static_cast<uint8_t>(Pt2001DiagFlag::V5UnderVoltage) |
+	static_cast<uint8_t>(Pt2001DiagFlag::NotDriven) |
+	static_cast<uint8_t>(Pt2001DiagFlag::FlashStopped) |
+	static_cast<uint8_t>(Pt2001DiagFlag::NoComm);
+
+void Pt2001Base::pollDiagnostics() {
+	auto& diag = diagnostics;
+
+	ensureSpi();
+	spiSelect();
+	// a CRC readback or RAM download may have left a code RAM page selected
+	selectPage(Pt2001Page::Common);
+	// driver status 0x1D2 through chip ID 0x1D5
+	send(0x8000 | (0x1D2 << 5) | 4);
+	diag.driverStatus = recv();
+	recv();
+	recv();
+	diag.chipId = recv();
+	// flash enable status, ch1 and ch2
+	send(0x8000 | (0x100 << 5) | 1);
+	diag.flashCh1 = recv();
+	send(0x8000 | (0x120 << 5) | 1);
+	diag.flashCh2 = recv();
+	spiDeselect();
+
+	uint8_t active = 0;
+	if (!validateChipId(diag.chipId)) {
+		// nothing else in this read can be trusted
+		active = static_cast<uint8_t>(Pt2001DiagFlag::NoComm);
+	} else {
+		if (checkUndervoltVccP(diag.driverStatus)) {
+			active |= static_cast<uint8_t>(Pt2001DiagFlag::VccPUnderVoltage);
+		}
+		if (checkUndervoltV5(diag.driverStatus)) {
+			active |= static_cast<uint8_t>(Pt2001DiagFlag::V5UnderVoltage);
+		}
+		if (diag.driverStatus & (1 << 3)) {
+			active |= static_cast<uint8_t>(Pt2001DiagFlag::OverTemp);
+		}
+		if (m_restartState == Pt2001RestartState::Running && !checkDrivenEnabled(diag.driverStatus)) {
+			active |= static_cast<uint8_t>(Pt2001DiagFlag::NotDriven);
+		}
+		if (!(diag.flashCh1 & (1 << 5)) || !(diag.flashCh2 & (1 << 5))) {
+			active |= static_cast<uint8_t>(Pt2001DiagFlag::FlashStopped);
+		}
+
+		// latched bits: clear so next poll tells if the condition is still present
+		if (diag.driverStatus & ((1 << 0) | (1 << 1) | (1 << 3))) {
+			clearDriverStatus();
+		}
+	}
+
+	efitick_t nowNt = getTimeNowNt();
+	for (size_t i = 0; i < PT2001_DIAG_FLAG_COUNT; i++) {
+		if (active & (1 << i)) {
+			diag.counts[i]++;
+			diag.lastSeenNt[i] = nowNt;
+		}
+	}
+
+	diag.active = active;
+	diag.latched |= active;
+	diag.polls++;
+	status = diag.driverStatus;
 }
 
 void Pt2001Base::periodicCallback() {
-    // todo: read status/diag via SPI
-}
-
-void Pt2001Base::downloadRam(int target) {
-	uint16_t memory_area = 0;         // memory area
-	uint16_t start_address = 0;      // start address
-	uint16_t codeWidthRegAddr = 0;   // code width register address
-	uint16_t size = 0;               // size of RAM data
-	uint16_t command = 0;            // command data
-	const uint16_t *RAM_ptr = nullptr;               // pointer to array of data to be sent to the chip
-
-	//Why Again? For Every time, just in case?
-	setupSpi();
-
-	switch(target)            // selects target
-	{
-	case CODE_RAM1:
-		memory_area = 0x1;
-		start_address = 0;
-		codeWidthRegAddr = 0x107;
-		RAM_ptr = PT2001_code_RAM1;
-		// todo: use efi::size?
-		size = sizeof(PT2001_code_RAM1) / 2;
-		break;
-
-	case CODE_RAM2:
-		memory_area = 0x2;
-		start_address = 0;
-		codeWidthRegAddr = 0x127;
-		RAM_ptr = PT2001_code_RAM2;
-		// todo: use efi::size?
-		size = sizeof(PT2001_code_RAM2) / 2;
-		break;
-
-	case DATA_RAM: // ch1 only?
-		memory_area = 0x4;
-		start_address = 0;
-		RAM_ptr = PT2001_data_RAM;
-		// todo: use efi::size?
-		size = sizeof(PT2001_data_RAM) / 2;
-		break;
-// optional, both data_rams with 0x3, writes same code to both
-	default:
-		break;
+	if (isRestarting()) {
+		if (m_restartStepTimer.hasElapsedMs(m_restartStepDelayMs)) {
+			m_restartStepDelayMs = restartStep();
+			m_restartStepTimer.reset();
+		}
+		return;
 	}
 
-	// Chip-Select high
-	select();
+	if (!m_diagTimer.hasElapsedMs(getDiagPeriodMs())) {
+		return;
+	}
+	m_diagTimer.reset();
+
+	uint32_t recoveryIntervalMs = getRecoveryIntervalMs();
+
+	if (m_restartState == Pt2001RestartState::Running) {
+		busAcquire();
+		pollDiagnostics();
+		busRelease();
+
+		uint8_t recovery = diagnostics.active & recoveryFlags;
+		if (!recovery) {
+			// chip works, start over with shortest interval next time
+			m_recoveryAttempts = 0;
+			m_recoveryPending = false;
+			return;
+		}
+
+		auto& diag = diagnostics;
+		if (diag.active & static_cast<uint8_t>(Pt2001DiagFlag::NoComm)) {
+			onError(McFault::NoComm);
+		} else if (diag.active & static_cast<uint8_t>(Pt2001DiagFlag::V5UnderVoltage)) {
+			onError(McFault::UnderVoltage5);
+		} else if (diag.active & static_cast<uint8_t>(Pt2001DiagFlag::FlashStopped)) {
+			onError(McFault::NoFlash);
+		} else {
+			onError(McFault::Driven);
+		}
+
+		m_recoveryPending = recoveryIntervalMs != 0;
+		if (!m_recoveryPending) {
+			// automatic recovery is off: report only
+			return;
+		}
+	} else if (m_restartState != Pt2001RestartState::Failed || !m_recoveryPending) {
+		// not started, shut down by the app, or failed restart the app owns
+		return;
+	}
 
-	if (target != DATA_RAM)
-	{
-		command = codeWidthRegAddr << 5;   // control width register address
-		command |= 1;                      // number of words to follow
-		send(command);           // sends code_width command
-		send(size);              // sends size (Code Width)
+	// rate limit: interval doubles with every recovery that did not help, up to 32x
+	uint8_t doublings = m_recoveryAttempts ? m_recoveryAttempts - 1 : 0;
+	uint32_t intervalMs = recoveryIntervalMs << (doublings < 5 ? doublings : 5);
+	if (!m_recoveryTimer.hasElapsedMs(intervalMs)) {
+		return;
 	}
 
-	// Select Channel command
-	send(0x7FE1);
-	// RAM1, RAM2, or Common Page (Data RAM)
-	send(memory_area);
-
-	// "Command" of starting address
-	// up to 0x03FE of code ram
-	// up to 0x0080 of data ram
-	command = start_address << 5;
-	send(command);           // sends start address command
-
-	sendLarge(RAM_ptr, size);
-	deselect();
-}
-
-void Pt2001Base::downloadRegister(int r_target) {
-	uint16_t r_start_address = 0;  // start address
-	uint16_t r_size = 0;           // size of configuration data
-	uint16_t r_command = 0;        // command data
-	uint16_t remainder_size = 0;   // remainder size
-	const uint16_t *reg_ptr = nullptr;            // pointer to array of data to be sent to the chip
-
-	switch(r_target)                     // selects target
-	{
-	case REG_CH1:                              // channel 1 configurations
-		r_start_address = 0x100;
-		reg_ptr = PT2001_ch1_config;
-		r_size = efi::size(PT2001_ch1_config);
-		break;
-
-	case REG_CH2:                              // channel 2 configurations
-		r_start_address = 0x120;
-		reg_ptr = PT2001_ch2_config;
-		r_size = efi::size(PT2001_ch2_config);
-		break;
-
-	case REG_DIAG:                              // diagnostic configurations
-		r_start_address = 0x140;
-		reg_ptr = PT2001_diag_config;
-		r_size = efi::size(PT2001_diag_config);
-		break;
-
-	case REG_IO:                              // IO configurations
-		r_start_address = 0x180;
-		reg_ptr = PT2001_io_config;
-		r_size = efi::size(PT2001_io_config);
-		break;
-
-	case REG_MAIN:                              // main configurations
-		r_start_address = 0x1C0;
-		reg_ptr = PT2001_main_config;
-		r_size = efi::size(PT2001_main_config);
-		break;
+	m_recoveryTimer.reset();
+	m_recoveryAttempts++;
+	diagnostics.recoveries++;
+
+	// chip that still talks keeps its content if it can, warm restart only downloads what is lost.
+	// Failed restart has put the chip in reset, start from scratch.
+	bool warm = m_restartState == Pt2001RestartState::Running &&
+		!(diagnostics.active & static_cast<uint8_t>(Pt2001DiagFlag::NoComm));
+	beginRestart(warm);
+	m_restartStepDelayMs = 0;
+	m_restartStepTimer.reset();
+}
 
+// Register bits that do not read back what was downloaded
+static uint16_t getCompareMask(const Pt2001RegionInfo& region, uint16_t address) {
+	if (region.address < 0x100) {
+		// RAM
+		return 0xFFFF;
+	}
+
+	switch (address) {
+	case 0x100:
+	case 0x120:
+		// flash enable, set by enableFlash
+		return ~0x0030;
+	case 0x1C8:
+		// SPI config, owned by setupSpi
+	case 0x1D2:
+		// driver status
+	case 0x1D5:
+		// chip ID
+		return 0;
 	default:
-		break;
+		return 0xFFFF;
+	}
+}
+
+static uint32_t crc32Word(uint16_t word, uint32_t crc) {
+	return crc32inc(&word, crc, sizeof(word));
+}
+
+uint32_t Pt2001Base::readRegionCrc(Pt2001Region r) {
+	const auto& region = getRegion(r);
+	uint32_t crc = 0;
+
+	spiSelect();
+	selectPage(region.page);
+
+	for (uint16_t offset = 0; offset < region.size; offset += MAX_SPI_MODE_A_TRANSFER_SIZE) {
+		uint16_t address = region.address + offset;
+		uint16_t count = region.size - offset;
+		if (count > MAX_SPI_MODE_A_TRANSFER_SIZE) {
+			count = MAX_SPI_MODE_A_TRANSFER_SIZE;
+		}
+
+		// read (MSB=1), start address, word count
+		send(0x8000 | (address << 5) | count);
+		for (uint16_t i = 0; i < count; i++) {
+			crc = crc32Word(recv() & getCompareMask(region, address + i), crc);
+		}
+	}
+
+	spiDeselect();
+	return crc;
+}
+
+bool Pt2001Base::getExpectedRegionCrc(Pt2001Region r, uint32_t& crc) const {
+	const auto& region = getRegion(r);
+	const uint16_t* data = region.data;
+
+	if (r == Pt2001Region::DataRam) {
+		// setTimings has changed Data RAM since download, shadow knows what chip should hold
+		for (size_t i = 0; i < efi::size(m_dramValid); i++) {
+			if (m_dramValid[i] != 0xFFFFFFFF || m_dramDirty[i] != 0) {
+				return false;
+			}
+		}
+		data = m_dramShadow;
 	}
 
-	//for location < size(remainder?)
-	// is location == 0? or past max xfer, send command + expected size
-	// if location = max xfer
-	//
-	// retrieve data, send it, increase pointer
-	// increase
+	crc = 0;
+	for (uint16_t i = 0; i < region.size; i++) {
+		crc = crc32Word(data[i] & getCompareMask(region, region.address + i), crc);
+	}
+	return true;
+}
+
+uint8_t Pt2001Base::verifyRegions() {
+	uint8_t mismatch = 0;
+
+	ensureSpi();
+
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		auto r = static_cast<Pt2001Region>(i);
 
-	if (r_size > MAX_SPI_MODE_A_TRANSFER_SIZE)   //if size is too large, split into two sections ... MULTIPLE sections..
-	{
-		remainder_size = r_size - MAX_SPI_MODE_A_TRANSFER_SIZE;  // creates remaining size
-		r_size = MAX_SPI_MODE_A_TRANSFER_SIZE;                   // sets first size
+		uint32_t expected;
+		if (!getExpectedRegionCrc(r, expected) || readRegionCrc(r) != expected) {
+			mismatch |= 1 << i;
+		}
 	}
 
-	r_command = r_start_address << 5;      // start address
-	r_command += r_size;                   // number of words to follow
+	return mismatch;
+}
 
-	select();						// Chip
+uint8_t Pt2001Base::verifyImage() {
+	busAcquire();
+	uint8_t mismatch = verifyRegions();
+	busRelease();
 
-	send(r_command);             // sends address and number of words to be sent
+	diagnostics.imageMismatch = mismatch;
+	return mismatch;
+}
 
-	sendLarge(reg_ptr, r_size);
+void Pt2001Base::downloadRegions(uint8_t mask, Pt2001Region from, Pt2001Region to) {
+	ensureSpi();
+
+	for (size_t i = static_cast<size_t>(from); i <= static_cast<size_t>(to); i++) {
+		if (!(mask & (1 << i))) {
+			continue;
+		}
+
+		auto r = static_cast<Pt2001Region>(i);
+		const auto& region = getRegion(r);
+		Pt2001TransferBuilder transfer(m_transferBuffer, efi::size(m_transferBuffer), m_page);
+		if (!transfer.addRegion(region)) {
+			// buffer is sized for largest compiled in region, image code RAM may be larger
+			downloadRamDirect(region);
+			continue;
+		}
+
+		// one DMA friendly transfer per chip select
+		for (size_t f = 0; f < transfer.getFrameCount(); f++) {
+			size_t count;
+			const uint16_t* frame = transfer.getFrame(f, count);
+
+			spiSelect();
+			spiSendLarge(frame, count);
+			spiDeselect();
+		}
+
+		spiStats.pageSelects += transfer.getPageSelects();
+		m_page = transfer.getPage();
+
+		if (r == Pt2001Region::DataRam) {
+			// chip now holds the default image, setTimings only needs to send the difference
+			setDramShadow(region.data, region.size);
+		}
+	}
+}
 
-	if (remainder_size > 0)                 // if remainder size is greater than 0, download the rest
-	{
-		r_start_address += r_size;          // new start address
-		r_command = r_start_address << 5;   // start address
-		r_command += remainder_size;        // number of words to follow
+void Pt2001Base::downloadRamDirect(const Pt2001RegionInfo& region) {
+	spiSelect();
 
-		send(r_command);          // sends address and number of words to be sent
-		sendLarge(reg_ptr + r_size, remainder_size);
+	if (region.codeWidthAddress) {
+		// code width is a register: common page, before switching to the RAM page
+		selectPage(Pt2001Page::Common);
+		send(pt2001WriteCommand(region.codeWidthAddress, 1));
+		send(region.size);
 	}
-	deselect();
+
+	selectPage(region.page);
+
+	// start address, zero word count: everything until chip deselect
+	send(pt2001WriteCommand(region.address, 0));
+	spiSendLarge(region.data, region.size);
+	spiDeselect();
+}
+
+void Pt2001Base::setImage(const Pt2001Image* image) {
+	m_image = (image && image->isLoaded()) ? image : nullptr;
+}
+
+const Pt2001RegionInfo& Pt2001Base::getRegion(Pt2001Region r) const {
+	return m_image ? m_image->getRegion(r) : pt2001GetRegionInfo(r);
+}
+
+void Pt2001Base::disableFlash() {
+	spiSelect();
+	selectPage(Pt2001Page::Common);
+	// write flash control words as downloaded, flash enable cleared
+	send((0x100 << 5) + 1);
+	send(getRegion(Pt2001Region::Ch1).data[0]);
+	send((0x120 << 5) + 1);
+	send(getRegion(Pt2001Region::Ch2).data[0]);
+	spiDeselect();
 }
 
 // void initMc33816() {
@@ -440,115 +764,215 @@ const char * mcFaultToString(McFault fault) {
 void Pt2001Base::shutdown() {
 	setDriveEN(false); // ensure HV is off
 	setResetB(false);  // turn off the chip
-}
 
-bool Pt2001Base::restart() {
-	bool flag0before = false;
-	bool flag0after = false;
+	// chip in reset, Data RAM content and SPI state are gone
+	invalidateDram();
+	invalidateSpiState();
 
-	// Start with everything off
-	shutdown();
-	deselect();
+	// also aborts restart in progress
+	m_restartState = Pt2001RestartState::Idle;
+}
 
-	if (getVbatt() < 8) {
-		onError("GDI not Restarting until we see VBatt");
-		return false;
+const char * pt2001RestartStateToString(Pt2001RestartState state) {
+	switch (state) {
+		case Pt2001RestartState::Idle:
+			return "Idle";
+		case Pt2001RestartState::CheckVbatt:
+			return "CheckVbatt";
+		case Pt2001RestartState::ReleaseReset:
+			return "ReleaseReset";
+		case Pt2001RestartState::DownloadRam:
+			return "DownloadRam";
+		case Pt2001RestartState::DownloadRegisters:
+			return "DownloadRegisters";
+		case Pt2001RestartState::CheckFlash:
+			return "CheckFlash";
+		case Pt2001RestartState::EnableDriven:
+			return "EnableDriven";
+		case Pt2001RestartState::CheckDriven:
+			return "CheckDriven";
+		case Pt2001RestartState::Running:
+			return "Running";
+		case Pt2001RestartState::Failed:
+			return "Failed";
 	}
+	return "TODO";
+}
 
-	// Wait for chip to reset, then release reset and wait again
-	sleepMs(1);
-	setResetB(true);
-	sleepMs(1);
+bool Pt2001Base::restart(bool warm) {
+	beginRestart(warm);
 
-	// Flag0 should be floating - pulldown means it should read low
-	flag0before = readFlag0();
+	while (isRestarting()) {
+		size_t delayMs = restartStep();
+		if (delayMs) {
+			sleepMs(delayMs);
+		}
+	}
 
-	acquireBus();
-	setupSpi();
+	return m_restartState == Pt2001RestartState::Running;
+}
 
-	clearDriverStatus(); // Initial clear necessary
-	status = readDriverStatus();
-	if (checkUndervoltV5(status)) {
-		onError(McFault::UnderVoltage5);
+void Pt2001Base::beginRestart(bool warm) {
+	if (warm) {
+		// keep the chip powered, only HV off; chip content is verified instead of trusted
+		setDriveEN(false);
+		invalidateSpiState();
+	} else {
+		// Start with everything off
 		shutdown();
-		releaseBus();
-		return false;
 	}
+	spiDeselect();
 
-	uint16_t chipId = readId();
-	if (!validateChipId(chipId)) {
-		onError(McFault::NoComm);
-		shutdown();
-		releaseBus();
-		return false;
-	}
+	m_warmRestart = warm;
+	m_downloadedRegions = 0;
+	m_flag0before = false;
+	m_restartState = Pt2001RestartState::CheckVbatt;
+}
 
-	downloadRam(CODE_RAM1);        // transfers code RAM1
-	downloadRam(CODE_RAM2);        // transfers code RAM2
-	downloadRam(DATA_RAM);         // transfers data RAM
-	downloadRegister(REG_MAIN);    // download main register configurations
+bool Pt2001Base::isRestarting() const {
+	return m_restartState != Pt2001RestartState::Idle &&
+		m_restartState != Pt2001RestartState::Running &&
+		m_restartState != Pt2001RestartState::Failed;
+}
 
-	// current configuration of REG_MAIN would toggle flag0 from LOW to HIGH
-	flag0after = readFlag0();
-	if (flag0before || !flag0after) {
-	    if (errorOnUnexpectedFlag()) {
-		    onError(McFault::flag0);
-		    shutdown();
-		    releaseBus();
-		    return false;
-        }
+size_t Pt2001Base::restartFailed(McFault p_fault) {
+	onError(p_fault);
+	shutdown();
+	busRelease();
+	m_restartState = Pt2001RestartState::Failed;
+	return 0;
+}
+
+size_t Pt2001Base::restartStep() {
+	switch (m_restartState) {
+	case Pt2001RestartState::CheckVbatt:
+		if (getVbatt() < 8) {
+			onError("GDI not Restarting until we see VBatt");
+			m_restartState = Pt2001RestartState::Failed;
+			return 0;
+		}
+
+		if (m_warmRestart) {
+			// chip was never reset
+			m_restartState = Pt2001RestartState::DownloadRam;
+			return 0;
+		}
+
+		// Wait for chip to reset, then release reset and wait again
+		m_restartState = Pt2001RestartState::ReleaseReset;
+		return 1;
+
+	case Pt2001RestartState::ReleaseReset:
+		setResetB(true);
+		m_restartState = Pt2001RestartState::DownloadRam;
+		return 1;
+
+	case Pt2001RestartState::DownloadRam: {
+		// Flag0 should be floating - pulldown means it should read low
+		m_flag0before = readFlag0();
+
+		busAcquire();
+		setupSpi();
+
+		clearDriverStatus(); // Initial clear necessary
+		status = readDriverStatus();
+		if (checkUndervoltV5(status)) {
+			return restartFailed(McFault::UnderVoltage5);
+		}
+
+		uint16_t chipId = readId();
+		if (!validateChipId(chipId)) {
+			return restartFailed(McFault::NoComm);
+		}
+
+		if (m_warmRestart) {
+			// only download what does not match
+			m_downloadedRegions = verifyRegions();
+			if (m_downloadedRegions) {
+				// microcode must not run while its memory is rewritten
+				disableFlash();
+			}
+		} else {
+			m_downloadedRegions = PT2001_ALL_REGIONS;
+		}
+
+		// code RAM1, code RAM2, data RAM, main register configurations
+		downloadRegions(m_downloadedRegions, Pt2001Region::CodeRam1, Pt2001Region::Main);
+
+		// current configuration of REG_MAIN would toggle flag0 from LOW to HIGH
+		// on warm restart flag0 is already HIGH
+		bool flag0after = readFlag0();
+		if (!m_warmRestart && (m_flag0before || !flag0after)) {
+		    if (errorOnUnexpectedFlag()) {
+			    return restartFailed(McFault::flag0);
+	        }
+		}
+
+		busRelease();
+		m_restartState = Pt2001RestartState::DownloadRegisters;
+		return 0;
 	}
 
-	downloadRegister(REG_CH1);     // download channel 1 register configurations
-	downloadRegister(REG_CH2);     // download channel 2 register configurations
-	downloadRegister(REG_IO);      // download IO register configurations
-	downloadRegister(REG_DIAG);    // download diag register configuration
+	case Pt2001RestartState::DownloadRegisters:
+		busAcquire();
+		// channel 1, channel 2, IO and diag register configurations
+		downloadRegions(m_downloadedRegions, Pt2001Region::Ch1, Pt2001Region::Diag);
 
-	setTimings();
+		setTimings();
 
-	// Finished downloading, let's run the code
-	enableFlash();
+		// Finished downloading, let's run the code
+		enableFlash();
+		busRelease();
 
-	// give it a moment to take effect
-	sleepMs(10);
+		// give it a moment to take effect
+		m_restartState = Pt2001RestartState::CheckFlash;
+		return 10;
 
-	if (!checkFlash()) {
-		onError(McFault::NoFlash);
-		shutdown();
-		releaseBus();
-		return false;
-	}
+	case Pt2001RestartState::CheckFlash:
+		busAcquire();
+		if (!checkFlash()) {
+			return restartFailed(McFault::NoFlash);
+		}
 
-    clearDriverStatus();
-    sleepMs(5);
+		clearDriverStatus();
+		busRelease();
 
-	status = readDriverStatus();
-	if (checkUndervoltVccP(status)) {
-		onError(McFault::UnderVoltage7);
-		shutdown();
-		releaseBus();
-		return false;
-	}
+		m_restartState = Pt2001RestartState::EnableDriven;
+		return 5;
 
-	// Drive High Voltage
-	setDriveEN(true); // driven = HV
-	sleepMs(10); // Give it a moment
-	status = readDriverStatus();
-	if (!checkDrivenEnabled(status)) {
-		onError(McFault::Driven);
-		shutdown();
-		releaseBus();
-		return false;
-	}
+	case Pt2001RestartState::EnableDriven:
+		busAcquire();
+		status = readDriverStatus();
+		if (checkUndervoltVccP(status)) {
+			return restartFailed(McFault::UnderVoltage7);
+		}
+		busRelease();
 
-	status = readDriverStatus();
-	if (checkUndervoltVccP(status)) {
-		onError(McFault::UnderVoltageAfter); // Likely DC-DC LS7 is dead!
-		shutdown();
-		releaseBus();
-		return false;
-	}
+		// Drive High Voltage
+		setDriveEN(true); // driven = HV
 
-    releaseBus();
-	return true;
+		// Give it a moment
+		m_restartState = Pt2001RestartState::CheckDriven;
+		return 10;
+
+	case Pt2001RestartState::CheckDriven:
+		busAcquire();
+		status = readDriverStatus();
+		if (!checkDrivenEnabled(status)) {
+			return restartFailed(McFault::Driven);
+		}
+
+		status = readDriverStatus();
+		if (checkUndervoltVccP(status)) {
+			return restartFailed(McFault::UnderVoltageAfter); // Likely DC-DC LS7 is dead!
+		}
+		busRelease();
+
+		m_restartState = Pt2001RestartState::Running;
+		return 0;
+
+	default:
+		// nothing to do: not started, finished or failed
+		return 0;
+	}
 }
@@ -0,0 +1,207 @@
+/*
+ * @file pt2001_bus.cpp
+ *
+ * Shared bus transaction queue for several PT2001, see pt2001_bus.h
+ */
+
+#include <gerefi/pt2001_bus.h>
+#include <gerefi/pt2001_transfer.h>
+#include <gerefi/gerefi_time_math.h>
+
+// Worst case SPI words per operation, used to decide if it fits the budget.
+// SPI setup after an error: 4 words
+static constexpr uint32_t setupWords = 4;
+// channel select + 3 commands + 16 timing words
+static constexpr uint32_t timingsWords = setupWords + 2 + 3 + 16;
+// see periodicCallback: channel select + burst read + clearing latched status
+static constexpr uint32_t diagWords = setupWords + 2 + 9 + 2;
+
+// readback of every region in 31 word chunks, page select for each RAM
+static uint32_t verifyWords(const Pt2001Base& chip) {
+	uint32_t words = setupWords + 3 * 2;
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		words += pt2001ChunkedWords(chip.getRegion(static_cast<Pt2001Region>(i)).size);
+	}
+	return words;
+}
+
+// warm restart download step may verify and download everything
+static uint32_t restartStepWords(const Pt2001Base& chip) {
+	uint32_t words = verifyWords(chip) + diagWords;
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		const auto& region = chip.getRegion(static_cast<Pt2001Region>(i));
+		words += region.address < 0x100
+			? pt2001RamTransferWords(region.size, region.codeWidthAddress != 0)
+			: pt2001RegisterTransferWords(region.size);
+	}
+	return words;
+}
+
+float Pt2001BusStats::getOccupancy(efitick_t nowNt) const {
+	efitick_t elapsedNt = nowNt - sinceNt;
+	if (elapsedNt <= 0) {
+		return 0;
+	}
+
+	return busyUs / NT2USF(elapsedNt);
+}
+
+bool Pt2001BusQueue::addChip(Pt2001Base& chip) {
+	if (m_chipCount >= PT2001_BUS_MAX_CHIPS) {
+		return false;
+	}
+
+	m_chips[m_chipCount] = &chip;
+	m_pending[m_chipCount] = 0;
+	m_chipCount++;
+	return true;
+}
+
+void Pt2001BusQueue::submit(size_t chip, Pt2001Request request) {
+	if (chip < m_chipCount) {
+		m_pending[chip] |= static_cast<uint8_t>(request);
+	}
+}
+
+bool Pt2001BusQueue::isPending(size_t chip, Pt2001Request request) const {
+	return chip < m_chipCount && (m_pending[chip] & static_cast<uint8_t>(request));
+}
+
+void Pt2001BusQueue::resetStats() {
+	m_stats = {};
+	m_stats.sinceNt = getTimeNowNt();
+}
+
+uint32_t Pt2001BusQueue::estimateWords(const Pt2001Base& chip, uint8_t request) const {
+	switch (static_cast<Pt2001Request>(request)) {
+	case Pt2001Request::ApplyTimings:
+		return timingsWords;
+	case Pt2001Request::PollDiagnostics:
+		return diagWords;
+	case Pt2001Request::VerifyImage:
+		return verifyWords(chip);
+	}
+
+	// periodic callback
+	return chip.isRestarting() ? restartStepWords(chip) : diagWords;
+}
+
+void Pt2001BusQueue::run(Pt2001Base& chip, uint8_t request) {
+	switch (static_cast<Pt2001Request>(request)) {
+	case Pt2001Request::ApplyTimings:
+		chip.applyTimings();
+		break;
+	case Pt2001Request::PollDiagnostics:
+		if (chip.getRestartState() == Pt2001RestartState::Running) {
+			chip.pollDiagnostics();
+		}
+		break;
+	case Pt2001Request::VerifyImage:
+		chip.verifyImage();
+		break;
+	default:
+		chip.periodicCallback();
+		break;
+	}
+
+	m_stats.operations++;
+}
+
+void Pt2001BusQueue::service(uint32_t budgetUs) {
+	if (m_chipCount == 0) {
+		return;
+	}
+
+	uint64_t budgetNs = budgetUs * 1000ull;
+	uint64_t usedNs = 0;
+	// first chip that did not get everything done starts next service
+	bool cut = false;
+	size_t cutOff = (m_next + 1) % m_chipCount;
+
+	auto fits = [&](uint32_t words) {
+		return budgetUs == 0 || usedNs + words * spiWordNs <= budgetNs;
+	};
+
+	auto skip = [&](size_t i) {
+		if (!cut) {
+			cut = true;
+			cutOff = i;
+		}
+	};
+
+	// run one operation, account for what it really sent
+	auto execute = [&](Pt2001Base& chip, uint8_t request) {
+		uint32_t before = chip.spiStats.words;
+		run(chip, request);
+		uint32_t words = chip.spiStats.words - before;
+
+		usedNs += words * spiWordNs;
+		m_stats.words += words;
+	};
+
+	acquireBus();
+	for (size_t i = 0; i < m_chipCount; i++) {
+		m_chips[i]->m_busHeldByQueue = true;
+	}
+
+	// queued operations: one per chip per round, highest priority first.
+	// Whatever does not fit the remaining budget is left for the next call,
+	// smaller operations behind it still get their chance.
+	uint8_t tooBig[PT2001_BUS_MAX_CHIPS] = {};
+	bool progress = true;
+	while (progress) {
+		progress = false;
+
+		for (size_t n = 0; n < m_chipCount; n++) {
+			size_t i = (m_next + n) % m_chipCount;
+			uint8_t pending = m_pending[i] & ~tooBig[i];
+			if (!pending) {
+				continue;
+			}
+
+			// lowest bit is highest priority
+			uint8_t request = pending & -pending;
+			if (!fits(estimateWords(*m_chips[i], request))) {
+				tooBig[i] |= request;
+				skip(i);
+				continue;
+			}
+
+			execute(*m_chips[i], request);
+			m_pending[i] &= ~request;
+			progress = true;
+		}
+	}
+
+	// periodic work: diagnostics, restart steps, recovery
+	for (size_t n = 0; n < m_chipCount; n++) {
+		size_t i = (m_next + n) % m_chipCount;
+
+		if (!fits(estimateWords(*m_chips[i], 0))) {
+			m_stats.deferred++;
+			skip(i);
+			continue;
+		}
+
+		execute(*m_chips[i], 0);
+	}
+
+	for (size_t i = 0; i < m_chipCount; i++) {
+		m_chips[i]->m_busHeldByQueue = false;
+
+		// still queued, waits for next call
+		for (uint8_t pending = m_pending[i]; pending; pending &= pending - 1) {
+			m_stats.deferred++;
+		}
+	}
+	releaseBus();
+
+	m_next = cutOff;
+
+	uint32_t usedUs = usedNs / 1000;
+	m_stats.transactions++;
+	m_stats.busyUs += usedUs;
+	if (usedUs > m_stats.maxTransactionUs) {
+		m_stats.maxTransactionUs = usedUs;
+	}
+}
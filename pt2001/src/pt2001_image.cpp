@@ -0,0 +1,155 @@
+/*
+ * @file pt2001_image.cpp
+ *
+ * Runtime image blobs, see pt2001_image.h
+ */
+
+#include <gerefi/pt2001_image.h>
+#include <gerefi/crc.h>
+
+#include <cstring>
+
+const char * pt2001ImageErrorToString(Pt2001ImageError error) {
+	switch (error) {
+	case Pt2001ImageError::None:
+		return "None";
+	case Pt2001ImageError::TooShort:
+		return "TooShort";
+	case Pt2001ImageError::Misaligned:
+		return "Misaligned";
+	case Pt2001ImageError::BadMagic:
+		return "BadMagic";
+	case Pt2001ImageError::BadVersion:
+		return "BadVersion";
+	case Pt2001ImageError::BadHeaderCrc:
+		return "BadHeaderCrc";
+	case Pt2001ImageError::BadRegionSize:
+		return "BadRegionSize";
+	case Pt2001ImageError::CodeWidthMismatch:
+		return "CodeWidthMismatch";
+	case Pt2001ImageError::Truncated:
+		return "Truncated";
+	case Pt2001ImageError::BadPayloadCrc:
+		return "BadPayloadCrc";
+	}
+	return "TODO";
+}
+
+static bool isValidSize(Pt2001Region r, uint16_t size) {
+	switch (r) {
+	case Pt2001Region::CodeRam1:
+	case Pt2001Region::CodeRam2:
+		return size > 0 && size <= PT2001_CODE_RAM_SIZE;
+	default:
+		// Data RAM is shadowed, registers are fixed blocks
+		return size == pt2001GetRegionInfo(r).size;
+	}
+}
+
+size_t pt2001ImageSize(const uint16_t (&size)[PT2001_REGION_COUNT]) {
+	size_t bytes = sizeof(Pt2001ImageHeader);
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		bytes += size[i] * sizeof(uint16_t);
+	}
+	return bytes;
+}
+
+static uint32_t headerCrc(const Pt2001ImageHeader& header) {
+	return crc32(&header, offsetof(Pt2001ImageHeader, headerCrc));
+}
+
+Pt2001ImageError Pt2001Image::load(const void* blob, size_t size) {
+	m_loaded = false;
+
+	if (size < sizeof(Pt2001ImageHeader)) {
+		return Pt2001ImageError::TooShort;
+	}
+	if (reinterpret_cast<uintptr_t>(blob) % alignof(uint16_t)) {
+		return Pt2001ImageError::Misaligned;
+	}
+
+	// header may be less aligned than its uint32 fields
+	Pt2001ImageHeader header;
+	memcpy(&header, blob, sizeof(header));
+
+	if (header.magic != PT2001_IMAGE_MAGIC) {
+		return Pt2001ImageError::BadMagic;
+	}
+	if (header.version != PT2001_IMAGE_VERSION) {
+		return Pt2001ImageError::BadVersion;
+	}
+	if (header.headerCrc != headerCrc(header)) {
+		return Pt2001ImageError::BadHeaderCrc;
+	}
+
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		if (!isValidSize(static_cast<Pt2001Region>(i), header.size[i])) {
+			return Pt2001ImageError::BadRegionSize;
+		}
+	}
+
+	size_t payloadSize = pt2001ImageSize(header.size) - sizeof(header);
+	if (size < sizeof(header) + payloadSize) {
+		return Pt2001ImageError::Truncated;
+	}
+
+	auto payload = reinterpret_cast<const uint16_t*>(static_cast<const uint8_t*>(blob) + sizeof(header));
+	if (crc32(payload, payloadSize) != header.payloadCrc) {
+		return Pt2001ImageError::BadPayloadCrc;
+	}
+
+	const uint16_t* data = payload;
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		m_regions[i] = pt2001GetRegionInfo(static_cast<Pt2001Region>(i));
+		m_regions[i].data = data;
+		m_regions[i].size = header.size[i];
+		data += header.size[i];
+	}
+
+	// channel config is downloaded after code RAM and sets code width again
+	static const Pt2001Region channels[][2] = {
+		{ Pt2001Region::CodeRam1, Pt2001Region::Ch1 },
+		{ Pt2001Region::CodeRam2, Pt2001Region::Ch2 },
+	};
+	for (const auto& channel : channels) {
+		const auto& code = getRegion(channel[0]);
+		const auto& config = getRegion(channel[1]);
+		if (config.data[code.codeWidthAddress - config.address] != code.size) {
+			return Pt2001ImageError::CodeWidthMismatch;
+		}
+	}
+
+	m_crc = header.payloadCrc;
+	m_loaded = true;
+	return Pt2001ImageError::None;
+}
+
+size_t pt2001BuildImage(void* buffer, size_t capacity, const Pt2001RegionInfo (&regions)[PT2001_REGION_COUNT]) {
+	Pt2001ImageHeader header = {};
+	header.magic = PT2001_IMAGE_MAGIC;
+	header.version = PT2001_IMAGE_VERSION;
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		header.size[i] = regions[i].size;
+	}
+
+	size_t bytes = pt2001ImageSize(header.size);
+	if (bytes > capacity) {
+		return 0;
+	}
+
+	auto out = static_cast<uint8_t*>(buffer);
+	size_t offset = sizeof(header);
+	uint32_t crc = 0;
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		size_t regionBytes = regions[i].size * sizeof(uint16_t);
+		memcpy(out + offset, regions[i].data, regionBytes);
+		crc = crc32inc(regions[i].data, crc, regionBytes);
+		offset += regionBytes;
+	}
+
+	header.payloadCrc = crc;
+	header.headerCrc = headerCrc(header);
+	memcpy(out, &header, sizeof(header));
+
+	return bytes;
+}
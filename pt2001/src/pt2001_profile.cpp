@@ -0,0 +1,75 @@
+/*
+ * @file pt2001_profile.cpp
+ *
+ * Per cylinder injection profiles, see pt2001_profile.h
+ */
+
+#include <gerefi/pt2001_profile.h>
+#include <gerefi/interpolation.h>
+
+void Pt2001ProfileTable::setBins(const float (&bins)[PT2001_PROFILE_POINTS]) {
+	for (size_t i = 0; i < PT2001_PROFILE_POINTS; i++) {
+		m_bins[i] = bins[i];
+	}
+}
+
+bool Pt2001ProfileTable::setProfile(size_t cylinder, size_t point, const Pt2001InjectionProfile& profile) {
+	if (cylinder >= PT2001_PROFILE_CYLINDERS || point >= PT2001_PROFILE_POINTS) {
+		return false;
+	}
+
+	m_profiles[cylinder][point] = profile;
+	m_set |= 1 << cylinder;
+	return true;
+}
+
+bool Pt2001ProfileTable::setProfile(size_t cylinder, const Pt2001InjectionProfile& profile) {
+	for (size_t i = 0; i < PT2001_PROFILE_POINTS; i++) {
+		if (!setProfile(cylinder, i, profile)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static uint16_t interpolateTime(uint16_t low, uint16_t high, float frac) {
+	return priv::linterp(low, high, frac) + 0.5f;
+}
+
+bool Pt2001ProfileTable::getProfile(size_t cylinder, float operatingPoint, Pt2001InjectionProfile& out) const {
+	if (cylinder >= PT2001_PROFILE_CYLINDERS || !(m_set & (1 << cylinder))) {
+		return false;
+	}
+
+	auto bin = priv::getBin(operatingPoint, m_bins);
+	const auto& low = m_profiles[cylinder][bin.Idx];
+	const auto& high = m_profiles[cylinder][bin.Idx + 1];
+	float frac = bin.Frac;
+
+	out.boostCurrent = priv::linterp(low.boostCurrent, high.boostCurrent, frac);
+	out.peakCurrent = priv::linterp(low.peakCurrent, high.peakCurrent, frac);
+	out.holdCurrent = priv::linterp(low.holdCurrent, high.holdCurrent, frac);
+
+	out.tpeakOff = interpolateTime(low.tpeakOff, high.tpeakOff, frac);
+	out.tpeakTot = interpolateTime(low.tpeakTot, high.tpeakTot, frac);
+	out.tbypass = interpolateTime(low.tbypass, high.tbypass, frac);
+	out.tholdOff = interpolateTime(low.tholdOff, high.tholdOff, frac);
+	out.tholdTot = interpolateTime(low.tholdTot, high.tholdTot, frac);
+	out.tboostMin = interpolateTime(low.tboostMin, high.tboostMin, frac);
+	out.tboostMax = interpolateTime(low.tboostMax, high.tboostMax, frac);
+
+	return true;
+}
+
+uint32_t pt2001PrepareInjection(Pt2001Base& chip, const Pt2001ProfileTable& table,
+		size_t cylinder, float operatingPoint) {
+	Pt2001InjectionProfile profile;
+	if (!table.getProfile(cylinder, operatingPoint, profile)) {
+		profile = chip.getConfiguredProfile();
+	}
+
+	uint32_t words = chip.spiStats.words;
+	chip.setInjectionProfile(profile);
+	return chip.spiStats.words - words;
+}
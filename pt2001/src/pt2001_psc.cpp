@@ -0,0 +1,521 @@
+/*
+ * @file pt2001_psc.cpp
+ *
+ * PSC microcode assembler, see pt2001_psc.h
+ */
+
+#include <gerefi/pt2001_psc.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+const float pscGains[PSC_GAIN_COUNT] = { 5.79f, 8.68f, 12.53f, 19.25f };
+
+static const char* const gainNames[PSC_GAIN_COUNT] = { "gain5.8", "gain8.7", "gain12.6", "gain19.3" };
+
+// indexed by PscCond
+static const char* const condNames[] = {
+	"start", "_start", "ocur", "_ocur",
+	"tc1", "tc2", "tc3", "tc4",
+	"cur1", "cur2", "cur3", "cur4",
+	"f0", "_f0", "vb", "_vb",
+};
+
+void pscEncode(const PscInstruction& instruction, uint16_t* words) {
+	words[0] = (static_cast<uint16_t>(instruction.op) << 10) | (instruction.a & 0x3FF);
+	words[1] = ((instruction.b & 0xF) << 12) | ((instruction.c & 0xF) << 8) |
+		((instruction.d & 0xF) << 4) | (instruction.e & 0xF);
+}
+
+bool pscDecode(const uint16_t* words, PscInstruction& instruction) {
+	uint8_t op = words[0] >> 10;
+	if (op < static_cast<uint8_t>(PscOp::Stgn) || op > static_cast<uint8_t>(PscOp::Stdcctl)) {
+		return false;
+	}
+
+	instruction.op = static_cast<PscOp>(op);
+	instruction.a = words[0] & 0x3FF;
+	instruction.b = words[1] >> 12;
+	instruction.c = (words[1] >> 8) & 0xF;
+	instruction.d = (words[1] >> 4) & 0xF;
+	instruction.e = words[1] & 0xF;
+	return true;
+}
+
+bool PscProgram::findLabel(const std::string& name, uint16_t& index) const {
+	auto it = labels.find(name);
+	if (it == labels.end()) {
+		return false;
+	}
+
+	index = it->second;
+	return true;
+}
+
+const char* PscProgram::getBlockLabel(uint16_t index) const {
+	const char* best = nullptr;
+	int bestIndex = -1;
+
+	for (const auto& label : labels) {
+		if (label.second <= index && label.second > bestIndex) {
+			best = label.first.c_str();
+			bestIndex = label.second;
+		}
+	}
+
+	return best;
+}
+
+void PscAssembler::define(const std::string& name, uint16_t value) {
+	m_symbols[name] = value;
+}
+
+bool PscAssembler::fail(int line, const std::string& message) {
+	if (m_error.empty()) {
+		m_error = "line " + std::to_string(line) + ": " + message;
+	}
+	return false;
+}
+
+static std::vector<std::string> split(const std::string& text) {
+	std::vector<std::string> tokens;
+	std::istringstream stream(text);
+	std::string token;
+	while (stream >> token) {
+		tokens.push_back(token);
+	}
+	return tokens;
+}
+
+static bool parseNumber(const std::string& token, uint16_t& value) {
+	char* end;
+	unsigned long number = strtoul(token.c_str(), &end, 0);
+	if (token.empty() || *end || number > 0xFFFF) {
+		return false;
+	}
+
+	value = number;
+	return true;
+}
+
+bool PscAssembler::addDefinitions(const std::string& text) {
+	std::istringstream stream(text);
+	std::string line;
+	int lineNumber = 0;
+
+	while (std::getline(stream, line)) {
+		lineNumber++;
+
+		auto semicolon = line.find(';');
+		auto tokens = split(line.substr(0, semicolon));
+		if (tokens.empty() || tokens[0][0] == '*') {
+			continue;
+		}
+
+		uint16_t value;
+		if (tokens.size() != 3 || tokens[0] != "#define" || !parseNumber(tokens[2], value)) {
+			return fail(lineNumber, "expected #define name value");
+		}
+
+		define(tokens[1], value);
+	}
+
+	return true;
+}
+
+bool PscAssembler::parseSymbol(int line, const std::string& token, uint16_t& value) {
+	if (parseNumber(token, value)) {
+		return true;
+	}
+
+	auto it = m_symbols.find(token);
+	if (it == m_symbols.end()) {
+		return fail(line, "unknown symbol '" + token + "'");
+	}
+
+	value = it->second;
+	return true;
+}
+
+bool PscAssembler::parseAddress(int line, const std::string& token, const PscProgram& program, uint16_t& address) {
+	if (!program.findLabel(token, address)) {
+		return fail(line, "unknown label '" + token + "'");
+	}
+	return true;
+}
+
+// Index of token in names, -1 if not there
+template<size_t N>
+static int lookup(const std::string& token, const char* const (&names)[N]) {
+	for (size_t i = 0; i < N; i++) {
+		if (token == names[i]) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// `prefix` followed by a number in min..max, e.g. row3
+static int parseIndexed(const std::string& token, const char* prefix, int min, int max) {
+	size_t length = strlen(prefix);
+	if (token.compare(0, length, prefix) != 0 || token.size() == length) {
+		return -1;
+	}
+
+	char* end;
+	long n = strtol(token.c_str() + length, &end, 10);
+	if (*end || n < min || n > max) {
+		return -1;
+	}
+	return n;
+}
+
+static int parseOutput(const std::string& token) {
+	static const char* const names[] = { "keep", "off", "on" };
+	return lookup(token, names);
+}
+
+static int parseShortcut(const std::string& token) {
+	if (token == "undef") {
+		return 0;
+	}
+
+	int n = parseIndexed(token, "hs", 1, 7);
+	if (n > 0) {
+		return pscShortcut(false, n);
+	}
+
+	n = parseIndexed(token, "ls", 1, 7);
+	if (n > 0) {
+		return pscShortcut(true, n);
+	}
+
+	return -1;
+}
+
+static int parseRowMask(const std::string& token) {
+	if (token.compare(0, 3, "row") != 0 || token.size() == 3) {
+		return -1;
+	}
+
+	int mask = 0;
+	for (size_t i = 3; i < token.size(); i++) {
+		int row = token[i] - '0';
+		if (row < 1 || row > PSC_ROWS) {
+			return -1;
+		}
+		mask |= 1 << (row - 1);
+	}
+	return mask;
+}
+
+bool PscAssembler::parseInstruction(int line, const std::vector<std::string>& tokens, const PscProgram& program, PscInstruction& out) {
+	const std::string& name = tokens[0];
+	size_t operands = tokens.size() - 1;
+	out = {};
+
+	auto expect = [&](size_t count) {
+		if (operands != count) {
+			return fail(line, name + " expects " + std::to_string(count) + " operands");
+		}
+		return true;
+	};
+
+	auto bad = [&](size_t index) {
+		return fail(line, "bad operand '" + tokens[index] + "' for " + name);
+	};
+
+	auto cond = [&](size_t index, uint8_t& value) {
+		int c = lookup(tokens[index], condNames);
+		if (c < 0) {
+			return bad(index);
+		}
+		value = c;
+		return true;
+	};
+
+	auto jumpRegister = [&](size_t index, uint8_t& value) {
+		int jr = parseIndexed(tokens[index], "jr", 1, 2);
+		if (jr < 0) {
+			return bad(index);
+		}
+		value = jr;
+		return true;
+	};
+
+	auto row = [&](size_t index, uint8_t& value) {
+		int r = parseIndexed(tokens[index], "row", 1, PSC_ROWS);
+		if (r < 0) {
+			return bad(index);
+		}
+		value = r;
+		return true;
+	};
+
+	auto output = [&](size_t index, uint8_t& value) {
+		int o = parseOutput(tokens[index]);
+		if (o < 0) {
+			return bad(index);
+		}
+		value = o;
+		return true;
+	};
+
+	if (name == "stgn") {
+		out.op = PscOp::Stgn;
+		if (!expect(2)) {
+			return false;
+		}
+		int gain = lookup(tokens[1], gainNames);
+		if (gain < 0) {
+			return bad(1);
+		}
+		static const char* const senses[] = { "sssc", "ossc" };
+		int sense = lookup(tokens[2], senses);
+		if (sense < 0) {
+			return bad(2);
+		}
+		out.b = gain;
+		out.c = sense;
+	} else if (name == "ldjr1" || name == "ldjr2") {
+		out.op = PscOp::Ldjr;
+		out.b = name[4] - '0';
+		return expect(1) && parseAddress(line, tokens[1], program, out.a);
+	} else if (name == "cwef") {
+		out.op = PscOp::Cwef;
+		return expect(3) && jumpRegister(1, out.b) && cond(2, out.c) && row(3, out.d);
+	} else if (name == "cwer") {
+		out.op = PscOp::Cwer;
+		return expect(3) && parseAddress(line, tokens[1], program, out.a) && cond(2, out.c) && row(3, out.d);
+	} else if (name == "joslr") {
+		out.op = PscOp::Joslr;
+		if (!expect(2) || !parseAddress(line, tokens[1], program, out.a)) {
+			return false;
+		}
+		int start = parseIndexed(tokens[2], "start", 1, 6);
+		if (start < 0) {
+			return bad(2);
+		}
+		out.b = start;
+	} else if (name == "jmpf") {
+		out.op = PscOp::Jmpf;
+		return expect(1) && jumpRegister(1, out.b);
+	} else if (name == "jmpr") {
+		out.op = PscOp::Jmpr;
+		return expect(1) && parseAddress(line, tokens[1], program, out.a);
+	} else if (name == "jocr") {
+		out.op = PscOp::Jocr;
+		return expect(2) && parseAddress(line, tokens[1], program, out.a) && cond(2, out.c);
+	} else if (name == "dfsct") {
+		out.op = PscOp::Dfsct;
+		if (!expect(3)) {
+			return false;
+		}
+		uint8_t* fields[] = { &out.b, &out.c, &out.d };
+		for (size_t i = 0; i < 3; i++) {
+			int shortcut = parseShortcut(tokens[i + 1]);
+			if (shortcut < 0) {
+				return bad(i + 1);
+			}
+			*fields[i] = shortcut;
+		}
+	} else if (name == "load") {
+		out.op = PscOp::Load;
+		if (!expect(3) || !parseSymbol(line, tokens[1], out.a)) {
+			return false;
+		}
+		static const char* const dacs[] = { "dac_sssc", "dac_ossc", "dac4h4n" };
+		int dac = lookup(tokens[2], dacs);
+		if (dac < 0) {
+			return bad(2);
+		}
+		static const char* const offsets[] = { "_ofs", "ofs" };
+		int offset = lookup(tokens[3], offsets);
+		if (offset < 0) {
+			return bad(3);
+		}
+		out.b = dac;
+		out.c = offset;
+	} else if (name == "ldcd") {
+		out.op = PscOp::Ldcd;
+		if (!expect(6)) {
+			return false;
+		}
+		static const char* const resets[] = { "_rst", "rst" };
+		static const char* const offsets[] = { "_ofs", "ofs" };
+		int reset = lookup(tokens[1], resets);
+		int offset = lookup(tokens[2], offsets);
+		if (reset < 0) {
+			return bad(1);
+		}
+		if (offset < 0) {
+			return bad(2);
+		}
+		int counter = parseIndexed(tokens[6], "c", 1, 4);
+		if (counter < 0) {
+			return bad(6);
+		}
+		out.b = counter;
+		out.e = reset | (offset << 1);
+		return output(3, out.c) && output(4, out.d) && parseSymbol(line, tokens[5], out.a);
+	} else if (name == "stf") {
+		out.op = PscOp::Stf;
+		if (!expect(2)) {
+			return false;
+		}
+		static const char* const levels[] = { "low", "high" };
+		int level = lookup(tokens[1], levels);
+		if (level < 0) {
+			return bad(1);
+		}
+		int bit = parseIndexed(tokens[2], "b", 0, 15);
+		if (bit < 0) {
+			return bad(2);
+		}
+		out.a = bit;
+		out.b = level;
+	} else if (name == "stos") {
+		out.op = PscOp::Stos;
+		return expect(3) && output(1, out.b) && output(2, out.c) && output(3, out.d);
+	} else if (name == "wait") {
+		out.op = PscOp::Wait;
+		if (!expect(1)) {
+			return false;
+		}
+		int mask = parseRowMask(tokens[1]);
+		if (mask <= 0) {
+			return bad(1);
+		}
+		out.a = mask;
+	} else if (name == "stdm") {
+		out.op = PscOp::Stdm;
+		if (!expect(1)) {
+			return false;
+		}
+		if (tokens[1] != "null") {
+			return bad(1);
+		}
+	} else if (name == "stdcctl") {
+		out.op = PscOp::Stdcctl;
+		if (!expect(1)) {
+			return false;
+		}
+		static const char* const modes[] = { "sync", "async" };
+		int mode = lookup(tokens[1], modes);
+		if (mode < 0) {
+			return bad(1);
+		}
+		out.b = mode;
+	} else {
+		return fail(line, "unsupported instruction '" + name + "'");
+	}
+
+	return true;
+}
+
+static bool readFile(const std::string& path, std::string& text) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	text = buffer.str();
+	return true;
+}
+
+bool PscAssembler::assemble(const std::string& source, PscProgram& program, const std::string& includeDir) {
+	struct Statement {
+		int line;
+		std::vector<std::string> tokens;
+	};
+	std::vector<Statement> statements;
+
+	m_error.clear();
+	program = {};
+
+	// first pass: labels, includes and instruction tokens
+	std::istringstream stream(source);
+	std::string text;
+	int line = 0;
+	while (std::getline(stream, text)) {
+		line++;
+
+		size_t first = text.find_first_not_of(" \t\r");
+		if (first == std::string::npos || text[first] == '*') {
+			continue;
+		}
+
+		// everything after the statement is comment
+		auto semicolon = text.find(';');
+		std::string statement = text.substr(first, semicolon == std::string::npos ? std::string::npos : semicolon - first);
+
+		if (statement.compare(0, 8, "#include") == 0) {
+			auto open = statement.find('"');
+			auto close = statement.rfind('"');
+			std::string definitions;
+			if (open == close || !readFile((includeDir.empty() ? "" : includeDir + "/") + statement.substr(open + 1, close - open - 1), definitions)) {
+				return fail(line, "can not include " + statement.substr(8));
+			}
+			if (!addDefinitions(definitions)) {
+				return false;
+			}
+			continue;
+		}
+
+		auto colon = statement.find(':');
+		if (colon != std::string::npos) {
+			std::string label = statement.substr(0, colon);
+			if (label.empty() || label.find_first_of(" \t") != std::string::npos) {
+				return fail(line, "bad label");
+			}
+			if (program.labels.count(label)) {
+				return fail(line, "duplicate label '" + label + "'");
+			}
+			program.labels[label] = statements.size();
+			statement = statement.substr(colon + 1);
+		}
+
+		auto tokens = split(statement);
+		if (tokens.empty()) {
+			continue;
+		}
+		if (semicolon == std::string::npos) {
+			return fail(line, "missing ';'");
+		}
+
+		statements.push_back({ line, tokens });
+	}
+
+	if (statements.size() > 0x3FF) {
+		return fail(line, "program too large");
+	}
+
+	// second pass: encode, all labels known now
+	program.simCode.resize(statements.size() * PSC_WORDS_PER_INSTRUCTION);
+	for (size_t i = 0; i < statements.size(); i++) {
+		PscInstruction instruction;
+		if (!parseInstruction(statements[i].line, statements[i].tokens, program, instruction)) {
+			return false;
+		}
+
+		pscEncode(instruction, &program.simCode[i * PSC_WORDS_PER_INSTRUCTION]);
+		program.lines.push_back(statements[i].line);
+	}
+
+	return true;
+}
+
+bool PscAssembler::assembleFile(const std::string& path, PscProgram& program) {
+	std::string source;
+	if (!readFile(path, source)) {
+		m_error = "can not read " + path;
+		return false;
+	}
+
+	auto slash = path.find_last_of("/\\");
+	return assemble(source, program, slash == std::string::npos ? "." : path.substr(0, slash));
+}
@@ -0,0 +1,317 @@
+/*
+ * @file pt2001_psc_sim.cpp
+ *
+ * Cycle level PSC microcode simulation, see pt2001_psc_sim.h
+ */
+
+#include <gerefi/pt2001_psc_sim.h>
+
+#include <cstring>
+
+PscSim::PscSim(const PscProgram& program)
+	: m_program(program)
+{
+	for (auto& core : m_cores) {
+		core.startMask = 0x3F;
+		core.gain = 2;
+	}
+}
+
+bool PscSim::startCore(size_t index, const char* label) {
+	uint16_t pc;
+	if (index >= PSC_CORES || !m_program.findLabel(label, pc)) {
+		return false;
+	}
+
+	auto& core = m_cores[index];
+	uint8_t startMask = core.startMask;
+	core = {};
+	core.startMask = startMask;
+	core.gain = 2;
+	core.pc = pc;
+	core.running = true;
+	return true;
+}
+
+void PscSim::setStartMask(size_t core, uint8_t mask) {
+	m_cores[core].startMask = mask;
+}
+
+void PscSim::setStart(size_t start, bool active) {
+	if (start < 1 || start > 6) {
+		return;
+	}
+
+	if (active) {
+		m_starts |= 1 << (start - 1);
+	} else {
+		m_starts &= ~(1 << (start - 1));
+	}
+}
+
+float PscSim::getThreshold(size_t core) const {
+	// same DAC as pt2001CurrentToDac: 9.77mV per LSB, 250mV bias
+	const auto& c = m_cores[core];
+	return (c.dac * 0.00977f - 0.25f) / (pscGains[c.gain] * config.senseResistance);
+}
+
+const PscTraceEvent* PscSim::findEvent(size_t core, const char* label, uint32_t fromTick) const {
+	for (const auto& event : m_trace) {
+		if (event.core == core && event.tick >= fromTick && event.label && strcmp(event.label, label) == 0) {
+			return &event;
+		}
+	}
+	return nullptr;
+}
+
+void PscSim::stop(Core& core, const char* error) {
+	core.running = false;
+	if (!m_error) {
+		m_error = error;
+	}
+}
+
+bool PscSim::condition(const Core& core, uint8_t cond) const {
+	uint8_t starts = m_starts & core.startMask;
+
+	switch (static_cast<PscCond>(cond)) {
+	case PscCond::Start:
+		return starts != 0;
+	case PscCond::NotStart:
+		return starts == 0;
+	case PscCond::Ocur:
+	case PscCond::Cur1:
+	case PscCond::Cur2:
+	case PscCond::Cur3:
+	case PscCond::Cur4:
+		// one sense block per microcore
+		return core.current >= getThreshold(&core - m_cores);
+	case PscCond::NotOcur:
+		return core.current < getThreshold(&core - m_cores);
+	case PscCond::Tc1:
+	case PscCond::Tc2:
+	case PscCond::Tc3:
+	case PscCond::Tc4: {
+		const auto& counter = core.counters[cond - static_cast<uint8_t>(PscCond::Tc1)];
+		return counter.loaded && counter.count >= counter.end;
+	}
+	case PscCond::F0:
+		return flags & 1;
+	case PscCond::NotF0:
+		return !(flags & 1);
+	case PscCond::Vb:
+	case PscCond::NotVb: {
+		// inverse of setBoostVoltage in pt2001.cpp
+		float threshold = (core.dac4h - 1.584f) / 3.25f;
+		return (config.vboost > threshold) == (static_cast<PscCond>(cond) == PscCond::Vb);
+	}
+	}
+
+	return false;
+}
+
+bool PscSim::jump(Core& core, uint16_t target) {
+	if (target >= m_program.getInstructionCount()) {
+		stop(core, "jump out of code");
+		return false;
+	}
+
+	core.pc = target;
+	return true;
+}
+
+void PscSim::setOutput(Core& core, size_t shortcut, uint8_t output) {
+	switch (static_cast<PscOutput>(output)) {
+	case PscOutput::Keep:
+		break;
+	case PscOutput::Off:
+		core.outputs[shortcut] = false;
+		break;
+	case PscOutput::On:
+		core.outputs[shortcut] = true;
+		break;
+	}
+}
+
+void PscSim::getSwitches(const Core& core, bool& bat, bool& boost, bool& lowSide) const {
+	// first high side of dfsct is battery, second one boost
+	bat = boost = lowSide = false;
+	size_t highSides = 0;
+
+	for (size_t i = 0; i < 3; i++) {
+		uint8_t shortcut = core.shortcuts[i];
+		if (!shortcut) {
+			continue;
+		}
+
+		if (pscIsLowSide(shortcut)) {
+			lowSide = lowSide || core.outputs[i];
+		} else if (highSides++ == 0) {
+			bat = core.outputs[i];
+		} else {
+			boost = core.outputs[i];
+		}
+	}
+}
+
+bool PscSim::execute(Core& core, const PscInstruction& instruction) {
+	const auto& in = instruction;
+
+	switch (in.op) {
+	case PscOp::Stgn:
+		core.gain = in.b;
+		break;
+	case PscOp::Ldjr:
+		core.jr[in.b - 1] = in.a;
+		break;
+	case PscOp::Cwef:
+		core.rows[in.d - 1] = { true, true, in.c, in.b };
+		break;
+	case PscOp::Cwer:
+		core.rows[in.d - 1] = { true, false, in.c, in.a };
+		break;
+	case PscOp::Joslr: {
+		uint8_t start = 1 << (in.b - 1);
+		if ((m_starts & core.startMask) == start) {
+			return jump(core, in.a);
+		}
+		break;
+	}
+	case PscOp::Jmpf:
+		return jump(core, core.jr[in.b - 1]);
+	case PscOp::Jmpr:
+		return jump(core, in.a);
+	case PscOp::Jocr:
+		if (condition(core, in.c)) {
+			return jump(core, in.a);
+		}
+		break;
+	case PscOp::Dfsct:
+		core.shortcuts[0] = in.b;
+		core.shortcuts[1] = in.c;
+		core.shortcuts[2] = in.d;
+		break;
+	case PscOp::Load:
+		if (in.a >= PSC_DRAM_SIZE) {
+			stop(core, "Data RAM address out of range");
+			return false;
+		}
+		if (in.b == 2) {
+			core.dac4h = dram[in.a];
+		} else {
+			core.dac = dram[in.a];
+		}
+		break;
+	case PscOp::Ldcd: {
+		if (in.a >= PSC_DRAM_SIZE) {
+			stop(core, "Data RAM address out of range");
+			return false;
+		}
+		auto& counter = core.counters[in.b - 1];
+		counter.loaded = true;
+		counter.end = dram[in.a];
+		if (in.e & 1) {
+			counter.count = 0;
+		}
+		setOutput(core, 0, in.c);
+		setOutput(core, 1, in.d);
+		break;
+	}
+	case PscOp::Stf:
+		if (in.b) {
+			flags |= 1 << in.a;
+		} else {
+			flags &= ~(1 << in.a);
+		}
+		break;
+	case PscOp::Stos:
+		setOutput(core, 0, in.b);
+		setOutput(core, 1, in.c);
+		setOutput(core, 2, in.d);
+		break;
+	case PscOp::Wait:
+		for (size_t row = 0; row < PSC_ROWS; row++) {
+			const auto& r = core.rows[row];
+			if ((in.a & (1 << row)) && r.set && condition(core, r.cond)) {
+				return jump(core, r.viaRegister ? core.jr[r.target - 1] : r.target);
+			}
+		}
+		// keep waiting
+		return true;
+	case PscOp::Stdm:
+	case PscOp::Stdcctl:
+		// DC-DC converter is not modelled
+		break;
+	}
+
+	core.pc++;
+	if (core.pc >= m_program.getInstructionCount()) {
+		stop(core, "ran past end of code");
+		return false;
+	}
+	return true;
+}
+
+void PscSim::updateLoad(Core& core) {
+	bool bat, boost, lowSide;
+	getSwitches(core, bat, boost, lowSide);
+
+	float volts;
+	if (lowSide && boost) {
+		volts = config.vboost;
+	} else if (lowSide && bat) {
+		volts = config.vbatt;
+	} else if (lowSide) {
+		// slow decay through the high side recirculation diode
+		volts = -config.diodeDrop;
+	} else {
+		// fast decay into the boost capacitor
+		volts = -(config.vboost + config.diodeDrop);
+	}
+
+	float dt = 1e-6f / ticksPerUs;
+	core.current += (volts - config.resistance * core.current) / config.inductance * dt;
+	if (core.current < 0) {
+		core.current = 0;
+	}
+}
+
+void PscSim::step(size_t index) {
+	auto& core = m_cores[index];
+	uint16_t pc = core.pc;
+
+	PscInstruction instruction;
+	if (!pscDecode(&m_program.simCode[pc * PSC_WORDS_PER_INSTRUCTION], instruction)) {
+		stop(core, "bad instruction");
+		return;
+	}
+	execute(core, instruction);
+
+	for (auto& counter : core.counters) {
+		if (counter.loaded && counter.count < counter.end) {
+			counter.count++;
+		}
+	}
+
+	updateLoad(core);
+
+	bool bat, boost, lowSide;
+	getSwitches(core, bat, boost, lowSide);
+	if (bat != core.lastBat || boost != core.lastBoost || lowSide != core.lastLowSide) {
+		m_trace.push_back({ m_tick, static_cast<uint8_t>(index), m_program.getBlockLabel(pc), bat, boost, lowSide, core.current });
+		core.lastBat = bat;
+		core.lastBoost = boost;
+		core.lastLowSide = lowSide;
+	}
+}
+
+void PscSim::run(uint32_t ticks) {
+	for (uint32_t i = 0; i < ticks; i++) {
+		for (size_t c = 0; c < PSC_CORES; c++) {
+			if (m_cores[c].running) {
+				step(c);
+			}
+		}
+		m_tick++;
+	}
+}
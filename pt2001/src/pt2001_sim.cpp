@@ -0,0 +1,234 @@
+/*
+ * @file pt2001_sim.cpp
+ *
+ * Host simulation of the PT2001, see pt2001_sim.h
+ */
+
+#include <gerefi/pt2001_sim.h>
+#include <gerefi/arrays.h>
+
+#include <cstring>
+
+// address field of Mode A command
+#define ADDR_MASK		0x3FF
+#define REG_BASE		0x100
+#define REG_FLASH_CH1	0x100
+#define REG_FLASH_CH2	0x120
+#define REG_STATUS		0x1D2
+#define REG_CHIP_ID		0x1D5
+
+#define FLASH_ENABLE		(1 << 4)
+#define FLASH_ENABLED		(1 << 5)
+#define STATUS_UV_VCCP		(1 << 0)
+#define STATUS_UV_V5		(1 << 1)
+#define STATUS_OVER_TEMP	(1 << 3)
+#define STATUS_DRIVEN		(1 << 4)
+
+void Pt2001Sim::setFault(Pt2001SimFault simFault, bool active) {
+	if (active) {
+		m_faults |= static_cast<uint8_t>(simFault);
+	} else {
+		m_faults &= ~static_cast<uint8_t>(simFault);
+	}
+}
+
+bool Pt2001Sim::hasFault(Pt2001SimFault simFault) const {
+	return m_faults & static_cast<uint8_t>(simFault);
+}
+
+void Pt2001Sim::acquireBus() {
+	if (busDepth++ == 0) {
+		m_busAcquiredNs = m_timeNs;
+	}
+}
+
+void Pt2001Sim::releaseBus() {
+	if (--busDepth == 0) {
+		uint64_t held = m_timeNs - m_busAcquiredNs;
+		if (held > maxBusHoldNs) {
+			maxBusHoldNs = held;
+		}
+	}
+}
+
+void Pt2001Sim::select() {
+	m_selected = true;
+	m_expect = Expect::Command;
+	simSelects++;
+	m_timeNs += spiSelectNs;
+}
+
+void Pt2001Sim::deselect() {
+	m_selected = false;
+	m_expect = Expect::Command;
+}
+
+uint16_t Pt2001Sim::sendRecv(uint16_t tx) {
+	simWords++;
+	m_timeNs += spiWordNs;
+
+	if (!m_selected || !m_resetB) {
+		// chip not listening
+		return 0;
+	}
+
+	uint16_t reply = 0;
+
+	switch (m_expect) {
+	case Expect::Page:
+		m_page = tx;
+		m_expect = Expect::Command;
+		break;
+	case Expect::Data:
+		if (m_read) {
+			reply = readWord(m_addr);
+		} else {
+			writeWord(m_addr, tx);
+		}
+		m_addr = (m_addr + 1) & ADDR_MASK;
+		// zero word count streams until deselect
+		if (m_remaining && --m_remaining == 0) {
+			m_expect = Expect::Command;
+		}
+		break;
+	case Expect::Command:
+		if (tx == 0x7FE1) {
+			// channel select, page follows
+			m_expect = Expect::Page;
+			break;
+		}
+
+		m_read = tx & 0x8000;
+		m_addr = (tx >> 5) & ADDR_MASK;
+		m_remaining = tx & 0x1F;
+		m_expect = Expect::Data;
+		break;
+	}
+
+	return hasFault(Pt2001SimFault::NoComm) ? 0 : reply;
+}
+
+void Pt2001Sim::sendLarge(const uint16_t* data, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		sendRecv(data[i]);
+	}
+}
+
+void Pt2001Sim::setResetB(bool state) {
+	if (!state) {
+		// everything is lost in reset
+		memset(codeRam1, 0, sizeof(codeRam1));
+		memset(codeRam2, 0, sizeof(codeRam2));
+		memset(dataRam, 0, sizeof(dataRam));
+		memset(regs, 0, sizeof(regs));
+		m_statusLatched = 0;
+		m_page = 0;
+	}
+
+	m_resetB = state;
+}
+
+void Pt2001Sim::setDriveEN(bool state) {
+	m_driveEn = state;
+}
+
+bool Pt2001Sim::readFlag0() const {
+	// flag0 follows main config being loaded, 0x1C0 bit 0
+	return m_resetB && (regs[0x1C0 - REG_BASE] & 1);
+}
+
+void Pt2001Sim::onError(const char* why) {
+	lastError = why;
+}
+
+void Pt2001Sim::sleepMs(size_t ms) {
+	m_timeNs += ms * 1000000ull;
+}
+
+uint16_t Pt2001Sim::getStatusConditions() const {
+	uint16_t conditions = 0;
+
+	if (hasFault(Pt2001SimFault::UnderVoltageVccP)) {
+		conditions |= STATUS_UV_VCCP;
+	}
+	if (hasFault(Pt2001SimFault::UnderVoltageV5)) {
+		conditions |= STATUS_UV_V5;
+	}
+	if (hasFault(Pt2001SimFault::OverTemp)) {
+		conditions |= STATUS_OVER_TEMP;
+	}
+
+	return conditions;
+}
+
+bool Pt2001Sim::isRegister(uint16_t addr) const {
+	return m_page == static_cast<uint16_t>(Pt2001Page::Common)
+		&& addr >= REG_BASE && static_cast<size_t>(addr - REG_BASE) < efi::size(regs);
+}
+
+uint16_t* Pt2001Sim::locate(uint16_t addr) {
+	switch (static_cast<Pt2001Page>(m_page)) {
+	case Pt2001Page::CodeRam1:
+		return addr < efi::size(codeRam1) ? &codeRam1[addr] : nullptr;
+	case Pt2001Page::CodeRam2:
+		return addr < efi::size(codeRam2) ? &codeRam2[addr] : nullptr;
+	case Pt2001Page::Common:
+		if (addr < REG_BASE) {
+			return addr < efi::size(dataRam) ? &dataRam[addr] : nullptr;
+		}
+		return isRegister(addr) ? &regs[addr - REG_BASE] : nullptr;
+	default:
+		return nullptr;
+	}
+}
+
+uint16_t Pt2001Sim::readWord(uint16_t addr) {
+	if (isRegister(addr)) {
+		switch (addr) {
+		case REG_CHIP_ID:
+			return chipId;
+		case REG_STATUS: {
+			uint16_t driverStatus = m_statusLatched | getStatusConditions();
+			bool flashing = (regs[REG_FLASH_CH1 - REG_BASE] & FLASH_ENABLE) && !hasFault(Pt2001SimFault::BadFlash);
+			if (m_driveEn && flashing && !hasFault(Pt2001SimFault::NoDriven)) {
+				driverStatus |= STATUS_DRIVEN;
+			}
+			return driverStatus;
+		}
+		case REG_FLASH_CH1:
+		case REG_FLASH_CH2: {
+			uint16_t value = regs[addr - REG_BASE] & ~FLASH_ENABLED;
+			if ((value & FLASH_ENABLE) && !hasFault(Pt2001SimFault::BadFlash)) {
+				value |= FLASH_ENABLED;
+			}
+			return value;
+		}
+		default:
+			break;
+		}
+	}
+
+	uint16_t* word = locate(addr);
+	return word ? *word : 0;
+}
+
+void Pt2001Sim::writeWord(uint16_t addr, uint16_t data) {
+	if (isRegister(addr)) {
+		switch (addr) {
+		case REG_CHIP_ID:
+			// read only
+			return;
+		case REG_STATUS:
+			// any write clears latched bits, conditions still present latch again
+			m_statusLatched = getStatusConditions();
+			return;
+		default:
+			break;
+		}
+	}
+
+	uint16_t* word = locate(addr);
+	if (word) {
+		*word = data;
+	}
+}
@@ -0,0 +1,102 @@
+/*
+ * @file pt2001_trace.cpp
+ *
+ * SPI transaction trace, see pt2001_trace.h
+ */
+
+#include <gerefi/pt2001_trace.h>
+
+void Pt2001Trace::finish() {
+	if (!m_open) {
+		return;
+	}
+
+	m_current.durationNt = m_lastNt - m_current.startNt;
+
+	if (m_count == PT2001_TRACE_SIZE) {
+		m_dropped++;
+	} else {
+		m_count++;
+	}
+	m_entries[m_next] = m_current;
+	m_next = (m_next + 1) % PT2001_TRACE_SIZE;
+
+	m_open = false;
+}
+
+void Pt2001Trace::onSelect() {
+	m_expect = Expect::Command;
+	m_remaining = 0;
+}
+
+void Pt2001Trace::onDeselect(efitick_t nowNt) {
+	(void)nowNt;
+	// zero count commands stream until here
+	finish();
+	m_expect = Expect::Command;
+	m_frame++;
+}
+
+void Pt2001Trace::onWord(uint16_t tx, efitick_t nowNt) {
+	switch (m_expect) {
+	case Expect::Command:
+		finish();
+
+		m_current = {};
+		m_current.startNt = nowNt;
+		m_current.command = tx;
+		m_current.page = m_page;
+		m_current.frame = m_frame;
+		m_open = true;
+
+		if (tx == PT2001_TRACE_CHANNEL_SELECT) {
+			m_expect = Expect::Page;
+		} else {
+			m_remaining = tx & 0x1F;
+			m_expect = Expect::Data;
+		}
+		break;
+	case Expect::Page:
+		m_page = tx;
+		m_current.page = tx;
+		m_current.words++;
+		m_expect = Expect::Command;
+		break;
+	case Expect::Data:
+		m_current.words++;
+		// zero word count streams until deselect
+		if (m_remaining && --m_remaining == 0) {
+			m_expect = Expect::Command;
+		}
+		break;
+	}
+}
+
+void Pt2001Trace::onWordDone(efitick_t nowNt) {
+	m_lastNt = nowNt;
+}
+
+void Pt2001Trace::onLarge(const uint16_t* data, size_t count, efitick_t startNt, efitick_t endNt) {
+	// spread bus time evenly, commands inside of the block keep their share
+	for (size_t i = 0; i < count; i++) {
+		onWord(data[i], startNt + (endNt - startNt) * i / count);
+		onWordDone(startNt + (endNt - startNt) * (i + 1) / count);
+	}
+}
+
+size_t Pt2001Trace::getCount() const {
+	return m_count;
+}
+
+const Pt2001TraceEntry& Pt2001Trace::get(size_t index) const {
+	size_t oldest = (m_next + PT2001_TRACE_SIZE - m_count) % PT2001_TRACE_SIZE;
+	return m_entries[(oldest + index) % PT2001_TRACE_SIZE];
+}
+
+void Pt2001Trace::clear() {
+	m_next = 0;
+	m_count = 0;
+	m_dropped = 0;
+	m_open = false;
+	m_expect = Expect::Command;
+}
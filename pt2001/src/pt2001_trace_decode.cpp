@@ -0,0 +1,129 @@
+/*
+ * @file pt2001_trace_decode.cpp
+ *
+ * Host side decoder of Pt2001Trace, see pt2001_trace_decode.h
+ */
+
+#include <gerefi/pt2001_trace_decode.h>
+#include <gerefi/pt2001_transfer.h>
+#include <gerefi/gerefi_time_math.h>
+
+#include <cstdio>
+
+static const char* const regionNames[PT2001_REGION_COUNT] = {
+	"code RAM1",
+	"code RAM2",
+	"Data RAM",
+	"main config",
+	"ch1 config",
+	"ch2 config",
+	"io config",
+	"diag config",
+};
+
+static const char* pageName(uint8_t page) {
+	switch (static_cast<Pt2001Page>(page)) {
+	case Pt2001Page::CodeRam1:
+		return "code RAM1";
+	case Pt2001Page::CodeRam2:
+		return "code RAM2";
+	case Pt2001Page::Common:
+		return "common";
+	default:
+		return "unknown page";
+	}
+}
+
+const char* pt2001TraceAddressName(uint8_t page, uint16_t address) {
+	if (page != static_cast<uint8_t>(Pt2001Page::Common)) {
+		return pageName(page);
+	}
+
+	// registers the driver touches on their own
+	switch (address) {
+	case 0x100:
+		return "ch1 flash enable";
+	case 0x107:
+		return "ch1 code width";
+	case 0x120:
+		return "ch2 flash enable";
+	case 0x127:
+		return "ch2 code width";
+	case 0x1C8:
+		return "SPI config";
+	case 0x1D2:
+		return "driver status";
+	case 0x1D5:
+		return "chip ID";
+	}
+
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		const auto& region = pt2001GetRegionInfo(static_cast<Pt2001Region>(i));
+		if (region.page == Pt2001Page::Common
+			&& address >= region.address && address < region.address + region.size) {
+			return regionNames[i];
+		}
+	}
+
+	return "?";
+}
+
+std::string pt2001TraceFormat(const Pt2001TraceEntry& entry) {
+	char line[96];
+
+	if (entry.command == PT2001_TRACE_CHANNEL_SELECT) {
+		snprintf(line, sizeof(line), "frame %-3u W page %-5u %-20s %.1fus",
+			entry.frame, entry.page, pageName(entry.page), NT2USF(entry.durationNt));
+		return line;
+	}
+
+	bool read = entry.command & 0x8000;
+	uint16_t address = (entry.command >> 5) & 0x3FF;
+	snprintf(line, sizeof(line), "frame %-3u %c 0x%03X x%-3u %-20s %.1fus",
+		entry.frame, read ? 'R' : 'W', address, entry.words,
+		pt2001TraceAddressName(entry.page, address), NT2USF(entry.durationNt));
+	return line;
+}
+
+Pt2001TraceSummary pt2001TraceSummarize(const Pt2001Trace& trace) {
+	Pt2001TraceSummary summary = {};
+
+	for (size_t i = 0; i < trace.getCount(); i++) {
+		const auto& entry = trace.get(i);
+
+		if (entry.command == PT2001_TRACE_CHANNEL_SELECT) {
+			summary.pageSelects++;
+		} else {
+			if (entry.command & 0x8000) {
+				summary.reads++;
+			} else {
+				summary.writes++;
+			}
+		}
+		summary.dataWords += entry.words;
+		summary.busNt += entry.durationNt;
+	}
+
+	return summary;
+}
+
+std::string pt2001TraceDecode(const Pt2001Trace& trace) {
+	std::string text;
+
+	if (trace.getDropped()) {
+		text += "... " + std::to_string(trace.getDropped()) + " older entries dropped\n";
+	}
+
+	for (size_t i = 0; i < trace.getCount(); i++) {
+		text += pt2001TraceFormat(trace.get(i));
+		text += '\n';
+	}
+
+	auto summary = pt2001TraceSummarize(trace);
+	char line[128];
+	snprintf(line, sizeof(line), "%u reads, %u writes, %u page selects, %u data words, %.1fus on bus\n",
+		summary.reads, summary.writes, summary.pageSelects, summary.dataWords, NT2USF(summary.busNt));
+	text += line;
+
+	return text;
+}
@@ -0,0 +1,152 @@
+/*
+ * @file pt2001_transfer.cpp
+ *
+ * Download word stream builder, see pt2001_transfer.h
+ */
+
+#include <gerefi/pt2001_transfer.h>
+
+// indexed by Pt2001Region
+static const Pt2001RegionInfo regionInfo[] = {
+	{ Pt2001Page::CodeRam1, 0x000, 0x107, PT2001_code_RAM1, efi::size(PT2001_code_RAM1) },
+	{ Pt2001Page::CodeRam2, 0x000, 0x127, PT2001_code_RAM2, efi::size(PT2001_code_RAM2) },
+	{ Pt2001Page::Common, 0x000, 0, PT2001_data_RAM, efi::size(PT2001_data_RAM) },
+	{ Pt2001Page::Common, 0x1C0, 0, PT2001_main_config, efi::size(PT2001_main_config) },
+	{ Pt2001Page::Common, 0x100, 0, PT2001_ch1_config, efi::size(PT2001_ch1_config) },
+	{ Pt2001Page::Common, 0x120, 0, PT2001_ch2_config, efi::size(PT2001_ch2_config) },
+	{ Pt2001Page::Common, 0x180, 0, PT2001_io_config, efi::size(PT2001_io_config) },
+	{ Pt2001Page::Common, 0x140, 0, PT2001_diag_config, efi::size(PT2001_diag_config) },
+};
+
+static_assert(efi::size(regionInfo) == PT2001_REGION_COUNT);
+static_assert(PT2001_REGION_TRANSFER_WORDS <= PT2001_TRANSFER_BUFFER_SIZE);
+
+const Pt2001RegionInfo& pt2001GetRegionInfo(Pt2001Region r) {
+	return regionInfo[static_cast<size_t>(r)];
+}
+
+Pt2001TransferBuilder::Pt2001TransferBuilder(uint16_t* buffer, size_t capacity, Pt2001Page page)
+	: m_buffer(buffer)
+	, m_capacity(capacity)
+	, m_page(page)
+{
+}
+
+bool Pt2001TransferBuilder::put(uint16_t word) {
+	if (m_used >= m_capacity) {
+		return false;
+	}
+
+	m_buffer[m_used++] = word;
+	return true;
+}
+
+bool Pt2001TransferBuilder::endFrame() {
+	if (m_used != m_frameStart[m_frames]) {
+		if (m_frames + 2 >= efi::size(m_frameStart)) {
+			return false;
+		}
+		m_frames++;
+		m_frameStart[m_frames] = m_used;
+	}
+	return true;
+}
+
+size_t Pt2001TransferBuilder::getFrameCount() const {
+	// last frame may still be open
+	return m_frames + (m_used != m_frameStart[m_frames] ? 1 : 0);
+}
+
+const uint16_t* Pt2001TransferBuilder::getFrame(size_t index, size_t& count) const {
+	size_t end = index < m_frames ? m_frameStart[index + 1] : m_used;
+
+	count = end - m_frameStart[index];
+	return m_buffer + m_frameStart[index];
+}
+
+bool Pt2001TransferBuilder::selectPage(Pt2001Page page) {
+	if (page == m_page) {
+		return true;
+	}
+
+	// Select Channel command: RAM1, RAM2, or Common Page (Data RAM and registers)
+	if (!put(0x7FE1) || !put(static_cast<uint16_t>(page))) {
+		return false;
+	}
+	m_page = page;
+	m_pageSelects++;
+	return true;
+}
+
+bool Pt2001TransferBuilder::addWrite(uint16_t address, const uint16_t* data, size_t size) {
+	// registers exist on common page only
+	if (!selectPage(Pt2001Page::Common)) {
+		return false;
+	}
+
+	for (size_t offset = 0; offset < size; offset += PT2001_MAX_TRANSFER_SIZE) {
+		size_t count = size - offset;
+		if (count > PT2001_MAX_TRANSFER_SIZE) {
+			count = PT2001_MAX_TRANSFER_SIZE;
+		}
+
+		if (!put(pt2001WriteCommand(address + offset, count))) {
+			return false;
+		}
+		for (size_t i = 0; i < count; i++) {
+			if (!put(data[offset + i])) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool Pt2001TransferBuilder::addRam(const Pt2001RegionInfo& region) {
+	if (region.codeWidthAddress) {
+		// sends size (Code Width), a register: before switching to the RAM page
+		if (!selectPage(Pt2001Page::Common)
+				|| !put(pt2001WriteCommand(region.codeWidthAddress, 1)) || !put(region.size)) {
+			return false;
+		}
+	}
+
+	if (!selectPage(region.page)) {
+		return false;
+	}
+
+	// start address, zero word count: everything until chip deselect
+	if (!put(pt2001WriteCommand(region.address, 0))) {
+		return false;
+	}
+	for (size_t i = 0; i < region.size; i++) {
+		if (!put(region.data[i])) {
+			return false;
+		}
+	}
+
+	return endFrame();
+}
+
+bool Pt2001TransferBuilder::addRegion(Pt2001Region r) {
+	return addRegion(pt2001GetRegionInfo(r));
+}
+
+bool Pt2001TransferBuilder::addRegion(const Pt2001RegionInfo& region) {
+	if (region.address < 0x100) {
+		return addRam(region);
+	}
+
+	return addWrite(region.address, region.data, region.size);
+}
+
+bool Pt2001TransferBuilder::addRegions(uint8_t mask, Pt2001Region from, Pt2001Region to) {
+	for (size_t i = static_cast<size_t>(from); i <= static_cast<size_t>(to); i++) {
+		if ((mask & (1 << i)) && !addRegion(static_cast<Pt2001Region>(i))) {
+			return false;
+		}
+	}
+
+	return true;
+}
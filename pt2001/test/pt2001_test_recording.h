@@ -0,0 +1,59 @@
+// PT2001 simulation that records SPI traffic, for unit tests
+
+#pragma once
+
+#include <vector>
+
+#include <gerefi/pt2001_sim.h>
+
+// Records SPI traffic, one vector of words per chip select.
+// Follows channel select the way the chip does and counts register writes
+// (write commands to 0x100 and up) sent while a code RAM page is selected.
+class RecordingPt2001 : public Pt2001Sim {
+public:
+	std::vector<std::vector<uint16_t>> frames;
+	size_t words = 0;
+	size_t registerWritesOffCommonPage = 0;
+
+protected:
+	void select() override {
+		frames.emplace_back();
+		m_pageFollows = false;
+		m_dataWords = 0;
+		Pt2001Sim::select();
+	}
+
+	uint16_t sendRecv(uint16_t tx) override {
+		frames.back().push_back(tx);
+		words++;
+		follow(tx);
+		return Pt2001Sim::sendRecv(tx);
+	}
+
+private:
+	// data of zero word count command: everything until deselect
+	static const size_t streaming = SIZE_MAX;
+
+	void follow(uint16_t tx) {
+		if (m_pageFollows) {
+			m_selectedPage = static_cast<Pt2001Page>(tx);
+			m_pageFollows = false;
+		} else if (m_dataWords == streaming) {
+		} else if (m_dataWords) {
+			m_dataWords--;
+		} else if (tx == 0x7FE1) {
+			m_pageFollows = true;
+		} else {
+			bool write = !(tx & 0x8000);
+			uint16_t address = (tx >> 5) & 0x3FF;
+			if (write && address >= 0x100 && m_selectedPage != Pt2001Page::Common) {
+				registerWritesOffCommonPage++;
+			}
+			m_dataWords = (tx & 0x1F) ? (tx & 0x1F) : streaming;
+		}
+	}
+
+	Pt2001Page m_selectedPage = Pt2001Page::Unknown;
+	bool m_pageFollows = false;
+	size_t m_dataWords = 0;
+};
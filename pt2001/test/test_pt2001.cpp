@@ -0,0 +1,304 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/pt2001_transfer.h>
+
+#include <vector>
+
+#include "pt2001_test_recording.h"
+
+TEST(Pt2001, shadowedTimingsBurst) {
+	RecordingPt2001 chip;
+
+	// nothing known about the chip content: SPI setup, then everything is written in one select
+	chip.applyTimings();
+	ASSERT_EQ(2u, chip.frames.size());
+	EXPECT_EQ(1u, chip.spiStats.spiSetups);
+	auto& frame = chip.frames[1];
+	// setup left chip on common page, 3 runs: 0x00..0x09, 0x40..0x41, 0x45..0x48
+	ASSERT_EQ((1 + 10) + (1 + 2) + (1 + 4), frame.size());
+	EXPECT_EQ((0x00 << 5) + 10, frame[0]);
+	EXPECT_EQ((0x40 << 5) + 2, frame[11]);
+	EXPECT_EQ((0x45 << 5) + 4, frame[14]);
+
+	// same config again costs nothing
+	chip.frames.clear();
+	chip.words = 0;
+	chip.applyTimings();
+	EXPECT_EQ(0u, chip.frames.size());
+	EXPECT_EQ(0u, chip.words);
+
+	// single changed value
+	chip.config.peakCurrent = 11;
+	chip.applyTimings();
+	ASSERT_EQ(1u, chip.frames.size());
+	ASSERT_EQ(2u, chip.frames[0].size());
+	EXPECT_EQ((0x01 << 5) + 1, chip.frames[0][0]);
+
+	// chip reset loses shadow and SPI config
+	chip.frames.clear();
+	chip.shutdown();
+	chip.applyTimings();
+	ASSERT_EQ(2u, chip.frames.size());
+	EXPECT_EQ(2u, chip.spiStats.spiSetups);
+	EXPECT_EQ((1u + 10) + (1 + 2) + (1 + 4), chip.frames[1].size());
+}
+
+TEST(Pt2001, restartSpiTraffic) {
+	RecordingPt2001 chip;
+
+	ASSERT_TRUE(chip.restart());
+	EXPECT_EQ(McFault::None, chip.fault);
+
+	// SPI configured once; code width registers are on common page, so each code RAM
+	// costs a switch there and one back to common
+	EXPECT_EQ(1u, chip.spiStats.spiSetups);
+	EXPECT_EQ(5u, chip.spiStats.pageSelects);
+	EXPECT_GT(chip.spiStats.pageSelectsSkipped, 0u);
+	EXPECT_EQ(chip.words, chip.spiStats.words);
+	EXPECT_EQ(chip.frames.size(), chip.spiStats.selects);
+	EXPECT_EQ(0u, chip.registerWritesOffCommonPage);
+
+	// status polling needs no setup and no page select
+	chip.words = 0;
+	for (int i = 0; i < 10; i++) {
+		chip.readStatus(0x1D2);
+	}
+	EXPECT_EQ(10u * 2, chip.words);
+
+	// error invalidates cached state
+	chip.onError(McFault::NoComm);
+	chip.words = 0;
+	chip.readStatus(0x1D2);
+	EXPECT_EQ(2u, chip.spiStats.spiSetups);
+	EXPECT_EQ(4u + 2, chip.words);
+}
+
+TEST(Pt2001, nonBlockingRestart) {
+	RecordingPt2001 chip;
+
+	chip.beginRestart();
+	EXPECT_EQ(Pt2001RestartState::CheckVbatt, chip.getRestartState());
+
+	size_t totalDelay = 0;
+	int steps = 0;
+	while (chip.isRestarting()) {
+		totalDelay += chip.restartStep();
+		steps++;
+		// bus is never held between steps
+		EXPECT_EQ(0, chip.busDepth);
+	}
+
+	EXPECT_EQ(Pt2001RestartState::Running, chip.getRestartState());
+	EXPECT_EQ(McFault::None, chip.fault);
+	EXPECT_EQ(7, steps);
+	EXPECT_EQ(27u, totalDelay);
+	// only SPI traffic took time, restartStep never sleeps
+	EXPECT_EQ(chip.simWords * chip.spiWordNs + chip.simSelects * chip.spiSelectNs, chip.getTimeNs());
+}
+
+TEST(Pt2001, nonBlockingRestartFault) {
+	RecordingPt2001 blocking;
+	blocking.chipId = 0x1234;
+	EXPECT_FALSE(blocking.restart());
+	EXPECT_EQ(McFault::NoComm, blocking.fault);
+	EXPECT_EQ(0, blocking.busDepth);
+
+	RecordingPt2001 chip;
+	chip.chipId = 0x1234;
+	chip.beginRestart();
+	while (chip.isRestarting()) {
+		chip.restartStep();
+	}
+
+	EXPECT_EQ(Pt2001RestartState::Failed, chip.getRestartState());
+	EXPECT_EQ(McFault::NoComm, chip.fault);
+	EXPECT_EQ(0, chip.busDepth);
+
+	// shutdown aborts restart in progress
+	chip.beginRestart();
+	chip.restartStep();
+	chip.shutdown();
+	EXPECT_FALSE(chip.isRestarting());
+	EXPECT_EQ(Pt2001RestartState::Idle, chip.getRestartState());
+}
+
+TEST(Pt2001, warmRestartVerifiesImage) {
+	RecordingPt2001 chip;
+
+	ASSERT_TRUE(chip.restart());
+	EXPECT_EQ(PT2001_ALL_REGIONS, chip.getDownloadedRegions());
+	EXPECT_EQ(0, chip.verifyImage());
+
+	// chip kept its content: nothing downloaded
+	chip.words = 0;
+	ASSERT_TRUE(chip.restart(true));
+	EXPECT_EQ(0, chip.getDownloadedRegions());
+	size_t warmWords = chip.words;
+
+	// corrupted code RAM2 word and IO register are detected and only those are downloaded again
+	chip.codeRam2[5] ^= 0x0100;
+	chip.regs[0x85] ^= 0x0001;
+	uint8_t corrupted = (1 << (int)Pt2001Region::CodeRam2) | (1 << (int)Pt2001Region::Io);
+	EXPECT_EQ(corrupted, chip.verifyImage());
+
+	ASSERT_TRUE(chip.restart(true));
+	EXPECT_EQ(corrupted, chip.getDownloadedRegions());
+	EXPECT_EQ(0, chip.verifyImage());
+
+	// timing change is part of expected Data RAM content
+	chip.config.peakCurrent = 12;
+	chip.applyTimings();
+	EXPECT_EQ(0, chip.verifyImage());
+	chip.dataRam[0x30] ^= 1;
+	EXPECT_EQ(1 << (int)Pt2001Region::DataRam, chip.verifyImage());
+
+	// cold restart after warm one
+	chip.words = 0;
+	ASSERT_TRUE(chip.restart());
+	EXPECT_GT(chip.words, warmWords);
+	EXPECT_EQ(0, chip.verifyImage());
+}
+
+TEST(Pt2001, warmRestartOfCodeRamOnly) {
+	RecordingPt2001 chip;
+	ASSERT_TRUE(chip.restart());
+
+	// download leaves code RAM 1 page selected, nothing else to write before flash enable
+	chip.codeRam1[3] ^= 1;
+	ASSERT_TRUE(chip.restart(true));
+	EXPECT_EQ(1 << (int)Pt2001Region::CodeRam1, chip.getDownloadedRegions());
+	EXPECT_EQ(0u, chip.registerWritesOffCommonPage);
+	EXPECT_EQ(0, chip.verifyImage());
+}
+
+static McFault restartWithFault(Pt2001SimFault fault) {
+	Pt2001Sim chip;
+	chip.setFault(fault, true);
+
+	EXPECT_FALSE(chip.restart());
+	// failed restart leaves chip off and bus free
+	EXPECT_TRUE(chip.isInReset());
+	EXPECT_FALSE(chip.isDriveEnabled());
+	EXPECT_EQ(0, chip.busDepth);
+
+	return chip.fault;
+}
+
+TEST(Pt2001Sim, restartFaults) {
+	EXPECT_EQ(McFault::UnderVoltage5, restartWithFault(Pt2001SimFault::UnderVoltageV5));
+	EXPECT_EQ(McFault::NoComm, restartWithFault(Pt2001SimFault::NoComm));
+	EXPECT_EQ(McFault::NoFlash, restartWithFault(Pt2001SimFault::BadFlash));
+	EXPECT_EQ(McFault::UnderVoltage7, restartWithFault(Pt2001SimFault::UnderVoltageVccP));
+	EXPECT_EQ(McFault::Driven, restartWithFault(Pt2001SimFault::NoDriven));
+
+	Pt2001Sim lowBattery;
+	lowBattery.config.vbatt = 6;
+	EXPECT_FALSE(lowBattery.restart());
+	EXPECT_NE(nullptr, lowBattery.lastError);
+}
+
+TEST(Pt2001Sim, restartLatency) {
+	Pt2001Sim blocking;
+	ASSERT_TRUE(blocking.restart());
+	EXPECT_EQ(McFault::None, blocking.fault);
+	EXPECT_TRUE(blocking.isDriveEnabled());
+
+	// 27ms of sleeps plus SPI traffic
+	uint64_t spiNs = blocking.simWords * blocking.spiWordNs + blocking.simSelects * blocking.spiSelectNs;
+	EXPECT_EQ(27000000u + spiNs, blocking.getTimeNs());
+	// bus is released while sleeping, longest hold is the download step
+	EXPECT_LT(blocking.maxBusHoldNs, 5000000u);
+
+	// same when driven step by step
+	Pt2001Sim stepped;
+	stepped.beginRestart();
+	while (stepped.isRestarting()) {
+		stepped.sleepMs(stepped.restartStep());
+	}
+	ASSERT_EQ(Pt2001RestartState::Running, stepped.getRestartState());
+	EXPECT_LT(stepped.maxBusHoldNs, 5000000u);
+	EXPECT_EQ(blocking.simWords, stepped.simWords);
+
+	EXPECT_EQ(0, stepped.verifyImage());
+}
+
+// Raw SPI access to the simulated chip, one chip select per call
+class RawPt2001 : public Pt2001Sim {
+public:
+	RawPt2001() {
+		setResetB(true);
+	}
+
+	void write(Pt2001Page page, uint16_t address, const uint16_t* data, size_t count) {
+		select();
+		sendRecv(0x7FE1);
+		sendRecv(static_cast<uint16_t>(page));
+		// zero word count: streams until deselect
+		sendRecv(pt2001WriteCommand(address, 0));
+		for (size_t i = 0; i < count; i++) {
+			sendRecv(data[i]);
+		}
+		deselect();
+	}
+
+	uint16_t read(Pt2001Page page, uint16_t address) {
+		select();
+		sendRecv(0x7FE1);
+		sendRecv(static_cast<uint16_t>(page));
+		sendRecv(pt2001ReadCommand(address, 1));
+		uint16_t value = sendRecv(0);
+		deselect();
+		return value;
+	}
+};
+
+TEST(Pt2001Sim, registersOnCommonPageOnly) {
+	RawPt2001 chip;
+
+	// code width address on a code RAM page is code RAM
+	uint16_t value = 0x55;
+	chip.write(Pt2001Page::CodeRam1, 0x107, &value, 1);
+	EXPECT_EQ(0x55, chip.codeRam1[0x107]);
+	EXPECT_EQ(0, chip.regs[0x07]);
+	EXPECT_EQ(0, chip.read(Pt2001Page::CodeRam1, 0x1D5));
+	EXPECT_EQ(chip.chipId, chip.read(Pt2001Page::Common, 0x1D5));
+
+	value = 0x66;
+	chip.write(Pt2001Page::Common, 0x107, &value, 1);
+	EXPECT_EQ(0x66, chip.regs[0x07]);
+	EXPECT_EQ(0x55, chip.codeRam1[0x107]);
+
+	// nothing above registers on common page
+	uint16_t data[4] = { 1, 2, 3, 4 };
+	chip.write(Pt2001Page::Common, 0x1FE, data, 4);
+	EXPECT_EQ(1, chip.regs[0xFE]);
+	EXPECT_EQ(2, chip.regs[0xFF]);
+	EXPECT_EQ(0, chip.read(Pt2001Page::Common, 0x200));
+}
+
+TEST(Pt2001Sim, largeCodeImage) {
+	RawPt2001 chip;
+
+	// more than the whole code RAM: address wraps around at 10 bits
+	std::vector<uint16_t> code(1100);
+	for (size_t i = 0; i < code.size(); i++) {
+		code[i] = i;
+	}
+	chip.write(Pt2001Page::CodeRam2, 0x000, code.data(), code.size());
+
+	EXPECT_EQ(1024, chip.codeRam2[0]);
+	EXPECT_EQ(100, chip.codeRam2[100]);
+	EXPECT_EQ(1023, chip.codeRam2[1023]);
+	EXPECT_EQ(700, chip.read(Pt2001Page::CodeRam2, 700));
+
+	// registers, Data RAM and the other code RAM are untouched
+	for (auto word : chip.regs) {
+		EXPECT_EQ(0, word);
+	}
+	for (auto word : chip.dataRam) {
+		EXPECT_EQ(0, word);
+	}
+	for (auto word : chip.codeRam1) {
+		EXPECT_EQ(0, word);
+	}
+}
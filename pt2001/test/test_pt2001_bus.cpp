@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/pt2001_bus.h>
+#include <gerefi/pt2001_sim.h>
+#include <gerefi/gerefi_time_math.h>
+
+class TestBusQueue : public Pt2001BusQueue {
+public:
+	int acquires = 0;
+	int depth = 0;
+
+protected:
+	void acquireBus() override {
+		acquires++;
+		depth++;
+	}
+
+	void releaseBus() override {
+		depth--;
+	}
+};
+
+struct TwoChips {
+	Pt2001Sim chips[2];
+	TestBusQueue queue;
+
+	TwoChips() {
+		setTimeNowUs(0);
+		for (auto& chip : chips) {
+			EXPECT_TRUE(chip.restart());
+			EXPECT_TRUE(queue.addChip(chip));
+		}
+		queue.resetStats();
+	}
+};
+
+TEST(Pt2001Bus, batchesChips) {
+	TwoChips t;
+
+	t.chips[0].config.peakCurrent = 11;
+	t.chips[1].config.peakCurrent = 12;
+	t.queue.submit(0, Pt2001Request::ApplyTimings);
+	t.queue.submit(1, Pt2001Request::ApplyTimings);
+	// merged with the first one
+	t.queue.submit(1, Pt2001Request::ApplyTimings);
+
+	t.queue.service();
+
+	// single bus acquisition for timings and diagnostics of both chips
+	EXPECT_EQ(1, t.queue.acquires);
+	EXPECT_EQ(0, t.queue.depth);
+	for (auto& chip : t.chips) {
+		EXPECT_EQ(0, chip.busDepth);
+		EXPECT_EQ(1u, chip.diagnostics.polls);
+	}
+	EXPECT_NE(t.chips[0].dataRam[1], t.chips[1].dataRam[1]);
+	EXPECT_FALSE(t.queue.isPending(1, Pt2001Request::ApplyTimings));
+
+	const auto& stats = t.queue.getStats();
+	EXPECT_EQ(1u, stats.transactions);
+	EXPECT_EQ(4u, stats.operations);
+	EXPECT_EQ(0u, stats.deferred);
+	EXPECT_EQ(t.chips[0].spiStats.words + t.chips[1].spiStats.words - 2 * 506u, stats.words);
+}
+
+TEST(Pt2001Bus, respectsBudget) {
+	TwoChips t;
+
+	t.queue.submit(0, Pt2001Request::VerifyImage);
+	t.queue.submit(1, Pt2001Request::VerifyImage);
+
+	// 200us window: readback does not fit, diagnostics do
+	t.queue.service(200);
+	EXPECT_TRUE(t.queue.isPending(0, Pt2001Request::VerifyImage));
+	EXPECT_TRUE(t.queue.isPending(1, Pt2001Request::VerifyImage));
+	EXPECT_EQ(1u, t.chips[0].diagnostics.polls);
+	EXPECT_EQ(1u, t.chips[1].diagnostics.polls);
+	EXPECT_LE(t.queue.getStats().maxTransactionUs, 200u);
+	EXPECT_EQ(2u, t.queue.getStats().deferred);
+
+	// large window later
+	t.chips[1].codeRam1[3] ^= 1;
+	t.queue.service();
+	EXPECT_FALSE(t.queue.isPending(0, Pt2001Request::VerifyImage));
+	EXPECT_EQ(0, t.chips[0].diagnostics.imageMismatch);
+	EXPECT_EQ(1 << (int)Pt2001Region::CodeRam1, t.chips[1].diagnostics.imageMismatch);
+	EXPECT_GT(t.queue.getStats().maxTransactionUs, 2000u);
+}
+
+TEST(Pt2001Bus, occupancy) {
+	TwoChips t;
+
+	for (int ms = 0; ms < 1000; ms++) {
+		t.queue.service();
+		advanceTimeUs(1000);
+	}
+
+	const auto& stats = t.queue.getStats();
+	EXPECT_EQ(1000u, stats.transactions);
+	// both chips polled every ~100ms, 9 words each
+	EXPECT_EQ(2u * 10, t.chips[0].diagnostics.polls + t.chips[1].diagnostics.polls);
+	EXPECT_EQ(2u * 10 * 9, stats.words);
+	EXPECT_EQ(stats.words * 4u, stats.busyUs);
+	EXPECT_NEAR(stats.busyUs / 1e6, stats.getOccupancy(getTimeNowNt()), 1e-6);
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/pt2001_sim.h>
+
+// float equation the integer conversion replaces, board defaults
+static uint16_t floatDac(float current, float gain = 12.53f, float senseMohm = 10) {
+	return ((current * gain * senseMohm) + 250.0f) / 9.77f;
+}
+
+TEST(Pt2001Conversion, currentMatchesFloatEquation) {
+	for (uint16_t ma = 0; ma <= 17000; ma += 50) {
+		Pt2001Current current = ma / 1000.0f;
+		auto dac = pt2001CurrentToDac(current);
+		ASSERT_TRUE(dac.Valid) << ma;
+		EXPECT_NEAR(floatDac(ma / 1000.0f), dac.Value, 1) << ma;
+	}
+
+	EXPECT_EQ(floatDac(10), pt2001CurrentToDac(10).Value);
+	EXPECT_EQ(floatDac(3), pt2001CurrentToDac(3).Value);
+}
+
+TEST(Pt2001Conversion, senseOptions) {
+	Pt2001CurrentSense sense;
+	sense.resistor = Pt2001SenseResistor::R5mOhm;
+	sense.gain = Pt2001SenseGain::G19_25;
+	EXPECT_EQ(floatDac(20, 19.25f, 5), pt2001CurrentToDac(20, sense).Value);
+
+	sense.resistor = Pt2001SenseResistor::R20mOhm;
+	sense.gain = Pt2001SenseGain::G5_79;
+	EXPECT_EQ(floatDac(8, 5.79f, 20), pt2001CurrentToDac(8, sense).Value);
+}
+
+TEST(Pt2001Conversion, ranges) {
+	// 8 bit DAC tops out just below 18A with the default sense
+	EXPECT_TRUE(pt2001CurrentToDac(17.8f).Valid);
+	auto dac = pt2001CurrentToDac(18);
+	EXPECT_FALSE(dac.Valid);
+	EXPECT_EQ(UnexpectedCode::High, dac.Code);
+
+	EXPECT_EQ(60000, pt2001UsToClocks(10000).Value);
+	EXPECT_FALSE(pt2001UsToClocks(11000).Valid);
+
+	EXPECT_EQ(212, pt2001BoostToDac(65).Value);
+	EXPECT_EQ(UnexpectedCode::High, pt2001BoostToDac(72.5f).Code);
+	EXPECT_EQ(UnexpectedCode::Low, pt2001BoostToDac(9.9f).Code);
+}
+
+TEST(Pt2001Conversion, outOfRangeKeepsChipValue) {
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+	uint16_t peak = chip.dataRam[static_cast<size_t>(MC33816Mem::Ipeak)];
+	uint16_t hold = chip.dataRam[static_cast<size_t>(MC33816Mem::Ihold)];
+
+	chip.config.peakCurrent = 25;
+	chip.config.holdCurrent = 4;
+	chip.applyTimings();
+
+	EXPECT_STREQ("PT2001 current setpoint out of DAC range", chip.lastError);
+	EXPECT_EQ(peak, chip.dataRam[static_cast<size_t>(MC33816Mem::Ipeak)]);
+	// other settings still applied
+	EXPECT_NE(hold, chip.dataRam[static_cast<size_t>(MC33816Mem::Ihold)]);
+	EXPECT_EQ(pt2001CurrentToDac(4).Value, chip.dataRam[static_cast<size_t>(MC33816Mem::Ihold)]);
+}
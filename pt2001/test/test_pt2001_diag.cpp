@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/pt2001_sim.h>
+#include <gerefi/gerefi_time_math.h>
+
+static void runFor(Pt2001Sim& chip, int ms) {
+	for (int i = 0; i < ms; i++) {
+		chip.periodicCallback();
+		advanceTimeUs(1000);
+	}
+}
+
+TEST(Pt2001Diag, pollBudget) {
+	setTimeNowUs(0);
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+
+	uint32_t words = chip.simWords;
+	uint32_t selects = chip.simSelects;
+	chip.periodicCallback();
+	EXPECT_EQ(1u, chip.diagnostics.polls);
+	EXPECT_EQ(0, chip.diagnostics.active);
+	// one chip select, 3 commands + 6 data words
+	EXPECT_EQ(9u, chip.simWords - words);
+	EXPECT_EQ(1u, chip.simSelects - selects);
+
+	// next poll only after the period
+	chip.periodicCallback();
+	EXPECT_EQ(1u, chip.diagnostics.polls);
+	runFor(chip, 1000);
+	EXPECT_EQ(10u, chip.diagnostics.polls);
+	EXPECT_EQ(9u * chip.diagnostics.polls, chip.simWords - words);
+	EXPECT_EQ(0, chip.busDepth);
+}
+
+TEST(Pt2001Diag, overTempIsReported) {
+	setTimeNowUs(0);
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+
+	advanceTimeUs(5000);
+	chip.setFault(Pt2001SimFault::OverTemp, true);
+	chip.periodicCallback();
+	EXPECT_TRUE(chip.diagnostics.isActive(Pt2001DiagFlag::OverTemp));
+	EXPECT_EQ(1u, chip.diagnostics.counts[2]);
+	EXPECT_EQ(5000 * US_TO_NT_MULTIPLIER, chip.diagnostics.lastSeenNt[2]);
+
+	// reported only, no restart
+	EXPECT_EQ(0u, chip.diagnostics.recoveries);
+	EXPECT_EQ(Pt2001RestartState::Running, chip.getRestartState());
+
+	// latched flag stays after condition is gone, chip latched it once more on the first clear
+	chip.setFault(Pt2001SimFault::OverTemp, false);
+	runFor(chip, 220);
+	EXPECT_EQ(0, chip.diagnostics.active);
+	EXPECT_EQ(static_cast<uint8_t>(Pt2001DiagFlag::OverTemp), chip.diagnostics.latched);
+}
+
+TEST(Pt2001Diag, rateLimitedRecovery) {
+	setTimeNowUs(0);
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+
+	// microcode stops and can not be started again
+	chip.setFault(Pt2001SimFault::BadFlash, true);
+	runFor(chip, 100);
+	EXPECT_TRUE(chip.diagnostics.isActive(Pt2001DiagFlag::FlashStopped));
+	EXPECT_EQ(McFault::NoFlash, chip.fault);
+	EXPECT_EQ(1u, chip.diagnostics.recoveries);
+	EXPECT_EQ(Pt2001RestartState::Failed, chip.getRestartState());
+
+	// retries after 1s, then 2s, 4s, checked at diagnostics period
+	runFor(chip, 1100);
+	EXPECT_EQ(2u, chip.diagnostics.recoveries);
+	runFor(chip, 1500);
+	EXPECT_EQ(2u, chip.diagnostics.recoveries);
+	runFor(chip, 600);
+	EXPECT_EQ(3u, chip.diagnostics.recoveries);
+	runFor(chip, 3500);
+	EXPECT_EQ(3u, chip.diagnostics.recoveries);
+
+	// fault goes away, next attempt gets the chip running
+	chip.setFault(Pt2001SimFault::BadFlash, false);
+	runFor(chip, 700);
+	EXPECT_EQ(4u, chip.diagnostics.recoveries);
+	EXPECT_EQ(Pt2001RestartState::Running, chip.getRestartState());
+	EXPECT_TRUE(chip.isDriveEnabled());
+
+	// chip was left in reset by failed attempts
+	EXPECT_EQ(PT2001_ALL_REGIONS, chip.getDownloadedRegions());
+
+	runFor(chip, 200);
+	EXPECT_EQ(0, chip.diagnostics.active);
+	EXPECT_EQ(0, chip.busDepth);
+}
+
+struct NoRecoveryPt2001 : public Pt2001Sim {
+	uint32_t getRecoveryIntervalMs() const override {
+		return 0;
+	}
+};
+
+TEST(Pt2001Diag, recoveryDisabled) {
+	setTimeNowUs(0);
+	NoRecoveryPt2001 chip;
+	ASSERT_TRUE(chip.restart());
+	uint8_t downloaded = chip.getDownloadedRegions();
+
+	chip.setFault(Pt2001SimFault::BadFlash, true);
+	runFor(chip, 3000);
+
+	// reported on every poll, never restarted
+	EXPECT_TRUE(chip.diagnostics.isActive(Pt2001DiagFlag::FlashStopped));
+	EXPECT_EQ(McFault::NoFlash, chip.fault);
+	EXPECT_EQ(0u, chip.diagnostics.recoveries);
+	EXPECT_EQ(Pt2001RestartState::Running, chip.getRestartState());
+	EXPECT_EQ(downloaded, chip.getDownloadedRegions());
+	EXPECT_EQ(0, chip.busDepth);
+}
+
+TEST(Pt2001Diag, warmRecovery) {
+	setTimeNowUs(0);
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+
+	// SPI glitch stopped the microcode and corrupted a register
+	chip.regs[0x00] &= ~(1 << 4);
+	chip.regs[0x85] ^= 1;
+	runFor(chip, 100);
+
+	EXPECT_EQ(1u, chip.diagnostics.recoveries);
+	EXPECT_EQ(Pt2001RestartState::Running, chip.getRestartState());
+	EXPECT_EQ(1 << (int)Pt2001Region::Io, chip.getDownloadedRegions());
+	EXPECT_EQ(0, chip.verifyImage());
+}
+
+TEST(Pt2001Diag, shutdownStopsRecovery) {
+	setTimeNowUs(0);
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+
+	chip.shutdown();
+	runFor(chip, 5000);
+	EXPECT_EQ(0u, chip.diagnostics.polls);
+	EXPECT_EQ(0u, chip.diagnostics.recoveries);
+	EXPECT_TRUE(chip.isInReset());
+}
+
+TEST(Pt2001Diag, pollAfterCodeRamDownload) {
+	setTimeNowUs(0);
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+
+	// warm restart stopped right after code RAM 1 download, its page is still selected
+	chip.codeRam1[3] ^= 1;
+	chip.beginRestart(true);
+	while (chip.getRestartState() != Pt2001RestartState::DownloadRegisters) {
+		chip.restartStep();
+	}
+
+	chip.pollDiagnostics();
+	EXPECT_EQ(chip.chipId, chip.diagnostics.chipId);
+	EXPECT_FALSE(chip.diagnostics.isActive(Pt2001DiagFlag::NoComm));
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/pt2001_image.h>
+
+#include <cstring>
+
+#include "pt2001_test_recording.h"
+
+struct TestImage {
+	alignas(4) uint8_t blob[8192];
+	size_t size;
+
+	uint16_t codeRam1[1024];
+	uint16_t codeRam2[efi::size(PT2001_code_RAM2)];
+	uint16_t largeCodeRam2[150];
+	uint16_t ch1Config[efi::size(PT2001_ch1_config)];
+	uint16_t ch2Config[efi::size(PT2001_ch2_config)];
+	Pt2001RegionInfo regions[PT2001_REGION_COUNT];
+
+	TestImage() {
+		for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+			regions[i] = pt2001GetRegionInfo(static_cast<Pt2001Region>(i));
+		}
+
+		memcpy(codeRam2, PT2001_code_RAM2, sizeof(codeRam2));
+		regions[static_cast<size_t>(Pt2001Region::CodeRam2)].data = codeRam2;
+
+		build();
+	}
+
+	// code RAM 1 as large as the chip has, more than the transfer buffer
+	void useLargeCodeRam1() {
+		for (size_t i = 0; i < efi::size(codeRam1); i++) {
+			codeRam1[i] = 0x1000 + i;
+		}
+		auto& region = regions[static_cast<size_t>(Pt2001Region::CodeRam1)];
+		region.data = codeRam1;
+		region.size = efi::size(codeRam1);
+
+		// code width, 0x107
+		memcpy(ch1Config, PT2001_ch1_config, sizeof(ch1Config));
+		ch1Config[7] = region.size;
+		regions[static_cast<size_t>(Pt2001Region::Ch1)].data = ch1Config;
+	}
+
+	// same for code RAM 2, downloaded right after code RAM 1
+	void useLargeCodeRam2() {
+		for (size_t i = 0; i < efi::size(largeCodeRam2); i++) {
+			largeCodeRam2[i] = 0x2000 + i;
+		}
+		auto& region = regions[static_cast<size_t>(Pt2001Region::CodeRam2)];
+		region.data = largeCodeRam2;
+		region.size = efi::size(largeCodeRam2);
+
+		// code width, 0x127
+		memcpy(ch2Config, PT2001_ch2_config, sizeof(ch2Config));
+		ch2Config[7] = region.size;
+		regions[static_cast<size_t>(Pt2001Region::Ch2)].data = ch2Config;
+	}
+
+	void build() {
+		size = pt2001BuildImage(blob, sizeof(blob), regions);
+		ASSERT_NE(0u, size);
+	}
+};
+
+TEST(Pt2001Image, loadsCompiledIn) {
+	TestImage t;
+	Pt2001Image image;
+	ASSERT_EQ(Pt2001ImageError::None, image.load(t.blob, t.size));
+	EXPECT_TRUE(image.isLoaded());
+
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		auto r = static_cast<Pt2001Region>(i);
+		const auto& expected = pt2001GetRegionInfo(r);
+		const auto& region = image.getRegion(r);
+
+		EXPECT_EQ(expected.address, region.address);
+		EXPECT_EQ(expected.size, region.size);
+		EXPECT_EQ(0, memcmp(expected.data, region.data, expected.size * 2));
+		// used in place
+		EXPECT_GE((const uint8_t*)region.data, t.blob);
+		EXPECT_LT((const uint8_t*)region.data, t.blob + t.size);
+	}
+}
+
+TEST(Pt2001Image, rejectsBadBlob) {
+	TestImage t;
+	Pt2001Image image;
+
+	EXPECT_EQ(Pt2001ImageError::TooShort, image.load(t.blob, 10));
+	EXPECT_EQ(Pt2001ImageError::Truncated, image.load(t.blob, t.size - 1));
+
+	uint8_t copy[sizeof(t.blob) + 1];
+	memcpy(copy + 1, t.blob, t.size);
+	EXPECT_EQ(Pt2001ImageError::Misaligned, image.load(copy + (reinterpret_cast<uintptr_t>(copy) % 2 ? 0 : 1), t.size));
+
+	t.blob[t.size - 1] ^= 0x40;
+	EXPECT_EQ(Pt2001ImageError::BadPayloadCrc, image.load(t.blob, t.size));
+	t.blob[t.size - 1] ^= 0x40;
+
+	t.blob[offsetof(Pt2001ImageHeader, size)] ^= 1;
+	EXPECT_EQ(Pt2001ImageError::BadHeaderCrc, image.load(t.blob, t.size));
+	t.blob[offsetof(Pt2001ImageHeader, size)] ^= 1;
+
+	t.blob[0] = 0;
+	EXPECT_EQ(Pt2001ImageError::BadMagic, image.load(t.blob, t.size));
+	EXPECT_FALSE(image.isLoaded());
+
+	// code RAM size has to match code width register
+	t.regions[static_cast<size_t>(Pt2001Region::CodeRam2)].size--;
+	t.build();
+	EXPECT_EQ(Pt2001ImageError::CodeWidthMismatch, image.load(t.blob, t.size));
+
+	// Data RAM must fill the chip
+	t.regions[static_cast<size_t>(Pt2001Region::DataRam)].size = 100;
+	t.build();
+	EXPECT_EQ(Pt2001ImageError::BadRegionSize, image.load(t.blob, t.size));
+}
+
+TEST(Pt2001Image, downloadsImage) {
+	TestImage t;
+	t.useLargeCodeRam1();
+	t.useLargeCodeRam2();
+	t.build();
+
+	Pt2001Image image;
+	ASSERT_EQ(Pt2001ImageError::None, image.load(t.blob, t.size));
+
+	RecordingPt2001 chip;
+	chip.setImage(&image);
+	ASSERT_TRUE(chip.restart());
+
+	EXPECT_EQ(0, memcmp(t.codeRam1, chip.codeRam1, sizeof(t.codeRam1)));
+	EXPECT_EQ(0, memcmp(t.largeCodeRam2, chip.codeRam2, sizeof(t.largeCodeRam2)));
+	EXPECT_EQ(efi::size(t.codeRam1), chip.regs[0x107 - 0x100]);
+	EXPECT_EQ(efi::size(t.largeCodeRam2), chip.regs[0x127 - 0x100]);
+	// code width of code RAM 2 goes to common page, not the code RAM 1 page left by the download before
+	EXPECT_EQ(0u, chip.registerWritesOffCommonPage);
+	EXPECT_EQ(0, chip.verifyImage());
+
+	// back to compiled in: code and its code width differ
+	chip.setImage(nullptr);
+	EXPECT_EQ((1 << (int)Pt2001Region::CodeRam1) | (1 << (int)Pt2001Region::Ch1)
+		| (1 << (int)Pt2001Region::CodeRam2) | (1 << (int)Pt2001Region::Ch2), chip.verifyImage());
+}
+
+TEST(Pt2001Image, warmRestartDownloadsDifference) {
+	TestImage t;
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+
+	t.codeRam2[5] ^= 0x0100;
+	t.build();
+	Pt2001Image image;
+	ASSERT_EQ(Pt2001ImageError::None, image.load(t.blob, t.size));
+
+	chip.setImage(&image);
+	ASSERT_TRUE(chip.restart(true));
+	EXPECT_EQ(1 << (int)Pt2001Region::CodeRam2, chip.getDownloadedRegions());
+	EXPECT_EQ(t.codeRam2[5], chip.codeRam2[5]);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/pt2001_profile.h>
+#include <gerefi/pt2001_sim.h>
+
+static Pt2001InjectionProfile makeProfile(float peakCurrent, uint16_t tpeakTot) {
+	Pt2001InjectionProfile profile = {};
+	profile.boostCurrent = 13;
+	profile.peakCurrent = peakCurrent;
+	profile.holdCurrent = 3;
+	profile.tpeakOff = 10;
+	profile.tpeakTot = tpeakTot;
+	profile.tbypass = 10;
+	profile.tholdOff = 60;
+	profile.tholdTot = 10000;
+	profile.tboostMin = 100;
+	profile.tboostMax = 400;
+	return profile;
+}
+
+TEST(Pt2001Profile, interpolatesOperatingPoint) {
+	Pt2001ProfileTable table;
+	table.setBins({ 50, 100, 150, 200 });
+	table.setProfile(2, 0, makeProfile(8, 600));
+	table.setProfile(2, 1, makeProfile(10, 700));
+	table.setProfile(2, 2, makeProfile(12, 800));
+	table.setProfile(2, 3, makeProfile(14, 900));
+
+	Pt2001InjectionProfile profile;
+	EXPECT_FALSE(table.getProfile(1, 100, profile));
+	EXPECT_FALSE(table.getProfile(PT2001_PROFILE_CYLINDERS, 100, profile));
+
+	ASSERT_TRUE(table.getProfile(2, 125, profile));
+	EXPECT_FLOAT_EQ(11, profile.peakCurrent);
+	EXPECT_EQ(750, profile.tpeakTot);
+	EXPECT_EQ(60, profile.tholdOff);
+
+	// clamped
+	ASSERT_TRUE(table.getProfile(2, 0, profile));
+	EXPECT_FLOAT_EQ(8, profile.peakCurrent);
+	ASSERT_TRUE(table.getProfile(2, 1000, profile));
+	EXPECT_EQ(900, profile.tpeakTot);
+}
+
+TEST(Pt2001Profile, switchesWithMinimalWrites) {
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+	uint16_t ipeakDefault = chip.dataRam[(int)MC33816Mem::Ipeak];
+
+	Pt2001ProfileTable table;
+	table.setBins({ 50, 100, 150, 200 });
+	// cylinder 0 differs from configuration in peak current only
+	table.setProfile(0, makeProfile(12, 700));
+	// cylinder 1 in peak current and peak time
+	table.setProfile(1, makeProfile(11, 750));
+
+	// configured profile is already there
+	EXPECT_EQ(0u, pt2001PrepareInjection(chip, table, 3, 100));
+
+	uint32_t selects = chip.simSelects;
+	// command + Ipeak
+	EXPECT_EQ(2u, pt2001PrepareInjection(chip, table, 0, 100));
+	EXPECT_NE(ipeakDefault, chip.dataRam[(int)MC33816Mem::Ipeak]);
+	EXPECT_EQ(1u, chip.simSelects - selects);
+
+	// Ipeak (1) and Tpeak_tot (4): two commands in one chip select
+	selects = chip.simSelects;
+	EXPECT_EQ(4u, pt2001PrepareInjection(chip, table, 1, 100));
+	EXPECT_EQ(1u, chip.simSelects - selects);
+	EXPECT_EQ(0u, pt2001PrepareInjection(chip, table, 1, 100));
+	// 6MHz microcore clock
+	EXPECT_EQ(6 * 750, chip.dataRam[(int)MC33816Mem::Tpeak_tot]);
+
+	// back to configured profile
+	pt2001PrepareInjection(chip, table, 5, 100);
+	EXPECT_EQ(ipeakDefault, chip.dataRam[(int)MC33816Mem::Ipeak]);
+	EXPECT_EQ(0, chip.busDepth);
+}
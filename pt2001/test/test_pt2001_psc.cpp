@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/pt2001_psc_sim.h>
+#include <gerefi/pt2001_memory_map.h>
+#include <gerefi/pt2001_conversion.h>
+#include <gerefi/arrays.h>
+
+#include <string>
+
+#include <PT2001_LoadData.h>
+
+// microcode as shipped, next to this file in project/gerefi
+static std::string projectFile(const char* name) {
+	std::string path = __FILE__;
+	return path.substr(0, path.find_last_of('/') + 1) + "../project/gerefi/" + name;
+}
+
+struct Ch1Sim {
+	PscProgram program;
+	PscSim* sim = nullptr;
+
+	Ch1Sim() {
+		PscAssembler assembler;
+		// dram1.def comes in through its #include
+		EXPECT_TRUE(assembler.assembleFile(projectFile("MicrocodeCh1/ch1.psc"), program)) << assembler.getError();
+
+		sim = new PscSim(program);
+
+		// same as setTimings with Pt2001Sim defaults, times in 6MHz clocks
+		sim->dram[PT2001_D1_Iboost] = pt2001CurrentToDac(13).Value;
+		sim->dram[PT2001_D1_Ipeak] = pt2001CurrentToDac(10).Value;
+		sim->dram[PT2001_D1_Ihold] = pt2001CurrentToDac(3).Value;
+		sim->dram[PT2001_D1_Tpeak_off] = 6 * 10;
+		sim->dram[PT2001_D1_Tpeak_tot] = 6 * 700;
+		sim->dram[PT2001_D1_Tbypass] = 6 * 10;
+		sim->dram[PT2001_D1_Thold_off] = 6 * 60;
+		sim->dram[PT2001_D1_Thold_tot] = 6 * 10000;
+		sim->dram[PT2001_D1_Tboost_min] = 6 * 100;
+		sim->dram[PT2001_D1_Tboost_max] = 6 * 400;
+
+		EXPECT_TRUE(sim->startCore(0, "init0"));
+		sim->flags = 1 << 10;
+	}
+
+	~Ch1Sim() {
+		delete sim;
+	}
+
+	// start pulse of given length after 10us idle
+	void inject(uint32_t us) {
+		sim->runUs(10);
+		sim->setStart(1, true);
+		sim->runUs(us);
+		sim->setStart(1, false);
+		sim->runUs(100);
+	}
+};
+
+TEST(Pt2001Psc, assembles) {
+	Ch1Sim t;
+	const auto& program = t.program;
+
+	// both microcores, as many instructions as Developer Studio put into code RAM
+	EXPECT_EQ(114u, program.getInstructionCount());
+	EXPECT_EQ(efi::size(PT2001_code_RAM1), program.getInstructionCount());
+	EXPECT_EQ(2u * 114, program.simCode.size());
+
+	uint16_t index;
+	ASSERT_TRUE(program.findLabel("boost0", index));
+	EXPECT_EQ(14, index);
+	EXPECT_STREQ("boost0", program.getBlockLabel(index + 3));
+
+	PscInstruction instruction;
+	ASSERT_TRUE(pscDecode(&program.simCode[index * PSC_WORDS_PER_INSTRUCTION], instruction));
+	// load Iboost dac_sssc _ofs
+	EXPECT_EQ(PscOp::Load, instruction.op);
+	EXPECT_EQ(PT2001_D1_Iboost, instruction.a);
+	EXPECT_EQ(0, instruction.b);
+
+	uint16_t words[2];
+	pscEncode(instruction, words);
+	EXPECT_EQ(program.simCode[index * 2], words[0]);
+	EXPECT_EQ(program.simCode[index * 2 + 1], words[1]);
+
+	// uCore1 follows the same pattern
+	ASSERT_TRUE(program.findLabel("init1", index));
+	EXPECT_EQ(57, index);
+}
+
+TEST(Pt2001Psc, assemblesChannel2) {
+	PscAssembler assembler;
+	PscProgram program;
+	ASSERT_TRUE(assembler.assembleFile(projectFile("MicrocodeCh2/ch2.psc"), program)) << assembler.getError();
+	EXPECT_EQ(43u, program.getInstructionCount());
+	EXPECT_EQ(efi::size(PT2001_code_RAM2), program.getInstructionCount());
+
+	// dram2.def holds addresses within the channel's half of Data RAM
+	PscInstruction instruction;
+	uint16_t index;
+	ASSERT_TRUE(program.findLabel("hold1", index));
+	ASSERT_TRUE(pscDecode(&program.simCode[(index + 1) * PSC_WORDS_PER_INSTRUCTION], instruction));
+	EXPECT_EQ(PscOp::Load, instruction.op);
+	EXPECT_EQ(PT2001_D2_PCV_Ihold - PSC_DRAM_SIZE, instruction.a);
+
+	// uCore1 drives the HPFP valve with Data RAM of channel 2
+	PscSim sim(program);
+	for (size_t i = 0; i < PSC_DRAM_SIZE; i++) {
+		sim.dram[i] = PT2001_data_RAM[PSC_DRAM_SIZE + i];
+	}
+	ASSERT_TRUE(sim.startCore(0, "init1"));
+	sim.runUs(10);
+	sim.setStart(6, true);
+	sim.runUs(1000);
+	sim.setStart(6, false);
+	sim.runUs(100);
+	ASSERT_EQ(nullptr, sim.getError());
+
+	auto peak = sim.findEvent(0, "peak1");
+	ASSERT_NE(nullptr, peak);
+	EXPECT_TRUE(peak->bat);
+	EXPECT_TRUE(peak->lowSide);
+	ASSERT_NE(nullptr, sim.findEvent(0, "hold_off1", peak->tick));
+
+	auto end = sim.findEvent(0, "eoact1", peak->tick);
+	ASSERT_NE(nullptr, end);
+	EXPECT_NEAR(10 + 1000, end->tick / PscSim::ticksPerUs, 2);
+	EXPECT_FALSE(end->lowSide);
+}
+
+TEST(Pt2001Psc, reportsErrors) {
+	PscAssembler assembler;
+	PscProgram program;
+
+	EXPECT_FALSE(assembler.assemble("start: jmpr nowhere;\n", program));
+	EXPECT_EQ("line 1: unknown label 'nowhere'", assembler.getError());
+
+	EXPECT_FALSE(assembler.assemble("* comment\n  slab 1 2;\n", program));
+	EXPECT_EQ("line 2: unsupported instruction 'slab'", assembler.getError());
+
+	EXPECT_FALSE(assembler.assemble("x: load Nothing dac_sssc _ofs;\n", program));
+	EXPECT_EQ("line 1: unknown symbol 'Nothing'", assembler.getError());
+
+	EXPECT_FALSE(assembler.assemble("x: wait row17;\n", program));
+	EXPECT_EQ("line 1: bad operand 'row17' for wait", assembler.getError());
+}
+
+TEST(Pt2001Psc, injectionProfile) {
+	Ch1Sim t;
+	auto& sim = *t.sim;
+	t.inject(3000);
+	ASSERT_EQ(nullptr, sim.getError());
+
+	auto boost = sim.findEvent(0, "boost0");
+	ASSERT_NE(nullptr, boost);
+	EXPECT_TRUE(boost->boost);
+	EXPECT_TRUE(boost->lowSide);
+
+	// boost until Iboost: 65V into 1.5mH/1.5R takes ~357us to reach 13A
+	auto peak = sim.findEvent(0, "peak_off0", boost->tick);
+	ASSERT_NE(nullptr, peak);
+	uint32_t boostUs = (peak->tick - boost->tick) / PscSim::ticksPerUs;
+	EXPECT_NEAR(357, boostUs, 5);
+	EXPECT_NEAR(13, peak->current, 0.2);
+
+	// peak phase lasts Tpeak_tot
+	auto bypass = sim.findEvent(0, "bypass0", peak->tick);
+	ASSERT_NE(nullptr, bypass);
+	EXPECT_NEAR(700, (bypass->tick - peak->tick) / PscSim::ticksPerUs, 2);
+
+	// short bypass leaves ~9A, slow decay to Ihold takes ~1ms
+	auto hold = sim.findEvent(0, "hold_off0", bypass->tick);
+	ASSERT_NE(nullptr, hold);
+	EXPECT_NEAR(9.1, hold->current, 0.2);
+
+	auto end = sim.findEvent(0, "eoinj0", hold->tick);
+	ASSERT_NE(nullptr, end);
+	EXPECT_NEAR(10 + 3000, end->tick / PscSim::ticksPerUs, 2);
+	EXPECT_FALSE(end->lowSide);
+
+	// then chops around Ihold until start goes low
+	const PscTraceEvent* lastChop = nullptr;
+	for (const auto& event : sim.getTrace()) {
+		if (event.tick < end->tick && strcmp(event.label, "hold_off0") == 0) {
+			lastChop = &event;
+		}
+	}
+	ASSERT_NE(nullptr, lastChop);
+	EXPECT_NEAR(3, lastChop->current, 0.1);
+
+	// error flag is active low
+	EXPECT_NE(0, sim.flags & (1 << 10));
+}
+
+TEST(Pt2001Psc, profileChangeShowsInTiming) {
+	Ch1Sim t;
+	auto& sim = *t.sim;
+	sim.dram[PT2001_D1_Tpeak_tot] = 6 * 400;
+	t.inject(2000);
+
+	auto peak = sim.findEvent(0, "peak_off0");
+	auto bypass = sim.findEvent(0, "bypass0");
+	ASSERT_NE(nullptr, peak);
+	ASSERT_NE(nullptr, bypass);
+	EXPECT_NEAR(400, (bypass->tick - peak->tick) / PscSim::ticksPerUs, 2);
+}
+
+TEST(Pt2001Psc, boostTimeout) {
+	Ch1Sim t;
+	auto& sim = *t.sim;
+	// weak boost never reaches Iboost within Tboost_max
+	sim.config.vboost = 20;
+	t.inject(1000);
+
+	auto error = sim.findEvent(0, "boost0_err");
+	ASSERT_NE(nullptr, error);
+	EXPECT_NEAR(10 + 400, error->tick / PscSim::ticksPerUs, 2);
+	EXPECT_EQ(0, sim.flags & (1 << 10));
+	EXPECT_EQ(nullptr, sim.findEvent(0, "peak_off0"));
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/pt2001_sim.h>
+#include <gerefi/pt2001_trace_decode.h>
+
+TEST(Pt2001Trace, decodesTransactions) {
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+	chip.trace.clear();
+
+	chip.readStatus(0x1D5);
+
+	ASSERT_EQ(1u, chip.trace.getCount());
+	const auto& entry = chip.trace.get(0);
+	EXPECT_EQ(0x8000 | 0x1D5 << 5 | 1, entry.command);
+	EXPECT_EQ(1, entry.words);
+	EXPECT_EQ(static_cast<uint8_t>(Pt2001Page::Common), entry.page);
+	// command and reply on simulated 4MHz SPI
+	EXPECT_EQ(800u, entry.durationNt);
+
+	EXPECT_STREQ("chip ID", pt2001TraceAddressName(entry.page, 0x1D5));
+	EXPECT_NE(std::string::npos, pt2001TraceFormat(entry).find("R 0x1D5 x1   chip ID"));
+	EXPECT_NE(std::string::npos, pt2001TraceFormat(entry).find("8.0us"));
+
+	// timing burst: one Data RAM write, words sent by sendLarge are traced as well
+	chip.trace.clear();
+	chip.config.peakCurrent = 12;
+	chip.config.tpeakTot = 50;
+	chip.applyTimings();
+
+	auto summary = pt2001TraceSummarize(chip.trace);
+	EXPECT_EQ(0u, summary.reads);
+	EXPECT_GE(summary.writes, 1u);
+	EXPECT_EQ(chip.trace.get(chip.trace.getCount() - 1).page, static_cast<uint8_t>(Pt2001Page::Common));
+	EXPECT_STREQ("Data RAM", pt2001TraceAddressName(chip.trace.get(0).page, (chip.trace.get(0).command >> 5) & 0x3FF));
+
+	std::string text = pt2001TraceDecode(chip.trace);
+	EXPECT_NE(std::string::npos, text.find("0 reads"));
+}
+
+TEST(Pt2001Trace, verifyTraffic) {
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+	chip.trace.clear();
+
+	uint32_t words = chip.spiStats.words;
+	EXPECT_EQ(0, chip.verifyImage());
+	words = chip.spiStats.words - words;
+
+	// every region read back on its page
+	auto summary = pt2001TraceSummarize(chip.trace);
+	EXPECT_EQ(0u, chip.trace.getDropped());
+	EXPECT_EQ(0u, summary.writes);
+	EXPECT_GE(summary.pageSelects, 3u);
+	EXPECT_EQ(words, summary.reads + summary.pageSelects + summary.dataWords);
+	EXPECT_EQ(USF2NT(words * chip.spiWordNs / 1000.0f), summary.busNt);
+
+	bool sawCodeRam2 = false;
+	for (size_t i = 0; i < chip.trace.getCount(); i++) {
+		sawCodeRam2 |= chip.trace.get(i).page == static_cast<uint8_t>(Pt2001Page::CodeRam2);
+	}
+	EXPECT_TRUE(sawCodeRam2);
+}
+
+TEST(Pt2001Trace, ringDropsOldest) {
+	Pt2001Sim chip;
+	ASSERT_TRUE(chip.restart());
+	chip.trace.clear();
+
+	for (int i = 0; i < PT2001_TRACE_SIZE + 5; i++) {
+		chip.readStatus(0x1D2);
+	}
+	chip.readStatus(0x1D5);
+
+	EXPECT_EQ(static_cast<size_t>(PT2001_TRACE_SIZE), chip.trace.getCount());
+	EXPECT_EQ(6u, chip.trace.getDropped());
+	EXPECT_EQ(0x8000 | 0x1D5 << 5 | 1, chip.trace.get(PT2001_TRACE_SIZE - 1).command);
+	EXPECT_EQ(0x8000 | 0x1D2 << 5 | 1, chip.trace.get(0).command);
+
+	// frames keep counting across the wrap
+	EXPECT_EQ(static_cast<uint8_t>(chip.trace.get(0).frame + PT2001_TRACE_SIZE - 1),
+		chip.trace.get(PT2001_TRACE_SIZE - 1).frame);
+}
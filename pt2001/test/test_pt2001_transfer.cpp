@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/pt2001_transfer.h>
+
+TEST(Pt2001Transfer, fullImage) {
+	uint16_t buffer[PT2001_TRANSFER_WORDS];
+	Pt2001TransferBuilder transfer(buffer, efi::size(buffer));
+
+	ASSERT_TRUE(transfer.addRegions(PT2001_ALL_REGIONS, Pt2001Region::CodeRam1, Pt2001Region::Diag));
+	EXPECT_EQ(PT2001_TRANSFER_WORDS, transfer.getWordCount());
+	EXPECT_EQ(Pt2001Page::Common, transfer.getPage());
+	// common for code width, RAM1, common, RAM2, common for data RAM and registers
+	EXPECT_EQ(5u, transfer.getPageSelects());
+
+	// three streamed RAM frames, registers share the last one
+	ASSERT_EQ(4u, transfer.getFrameCount());
+
+	size_t count;
+	const uint16_t* frame = transfer.getFrame(0, count);
+	EXPECT_EQ(pt2001RamTransferWords(efi::size(PT2001_code_RAM1), true), count);
+	EXPECT_EQ(0x7FE1, frame[0]);
+	EXPECT_EQ(0x0004, frame[1]);
+	EXPECT_EQ(pt2001WriteCommand(0x107, 1), frame[2]);
+	EXPECT_EQ(efi::size(PT2001_code_RAM1), frame[3]);
+	EXPECT_EQ(0x7FE1, frame[4]);
+	EXPECT_EQ(0x0001, frame[5]);
+	EXPECT_EQ(0x0000, frame[6]);
+	EXPECT_EQ(PT2001_code_RAM1[0], frame[7]);
+
+	// code RAM 2 width is written on common page too
+	frame = transfer.getFrame(1, count);
+	EXPECT_EQ(0x7FE1, frame[0]);
+	EXPECT_EQ(0x0004, frame[1]);
+	EXPECT_EQ(pt2001WriteCommand(0x127, 1), frame[2]);
+	EXPECT_EQ(0x7FE1, frame[4]);
+	EXPECT_EQ(0x0002, frame[5]);
+
+	frame = transfer.getFrame(3, count);
+	// main, ch1, ch2 fit one command each, io and diag need two
+	EXPECT_EQ(efi::size(PT2001_main_config) + efi::size(PT2001_ch1_config) + efi::size(PT2001_ch2_config) +
+		efi::size(PT2001_io_config) + efi::size(PT2001_diag_config) + 7, count);
+	EXPECT_EQ(pt2001WriteCommand(0x1C0, 29), frame[0]);
+}
+
+TEST(Pt2001Transfer, skipsPageSelect) {
+	uint16_t buffer[PT2001_TRANSFER_BUFFER_SIZE];
+	Pt2001TransferBuilder transfer(buffer, efi::size(buffer), Pt2001Page::Common);
+
+	ASSERT_TRUE(transfer.addRegion(Pt2001Region::DataRam));
+	EXPECT_EQ(0u, transfer.getPageSelects());
+	EXPECT_EQ(1u + PT2001_DRAM_SIZE, transfer.getWordCount());
+}
+
+TEST(Pt2001Transfer, registersAfterCodeRamOnCommonPage) {
+	uint16_t buffer[PT2001_TRANSFER_WORDS];
+	Pt2001TransferBuilder transfer(buffer, efi::size(buffer), Pt2001Page::Common);
+
+	uint8_t mask = (1 << (int)Pt2001Region::CodeRam1) | (1 << (int)Pt2001Region::Ch1);
+	ASSERT_TRUE(transfer.addRegions(mask, Pt2001Region::CodeRam1, Pt2001Region::Diag));
+	EXPECT_EQ(2u, transfer.getPageSelects());
+	EXPECT_EQ(Pt2001Page::Common, transfer.getPage());
+
+	ASSERT_EQ(2u, transfer.getFrameCount());
+	size_t count;
+	const uint16_t* frame = transfer.getFrame(1, count);
+	EXPECT_EQ(pt2001RegisterTransferWords(efi::size(PT2001_ch1_config)), count);
+	EXPECT_EQ(0x7FE1, frame[0]);
+	EXPECT_EQ(0x0004, frame[1]);
+	EXPECT_EQ(pt2001WriteCommand(0x100, efi::size(PT2001_ch1_config)), frame[2]);
+}
+
+TEST(Pt2001Transfer, chunksAnyLength) {
+	uint16_t data[70];
+	for (size_t i = 0; i < efi::size(data); i++) {
+		data[i] = i;
+	}
+
+	uint16_t buffer[80];
+	Pt2001TransferBuilder transfer(buffer, efi::size(buffer), Pt2001Page::Common);
+	ASSERT_TRUE(transfer.addWrite(0x140, data, efi::size(data)));
+
+	ASSERT_EQ(pt2001ChunkedWords(70), transfer.getWordCount());
+	EXPECT_EQ(73u, transfer.getWordCount());
+	EXPECT_EQ(pt2001WriteCommand(0x140, 31), buffer[0]);
+	EXPECT_EQ(0, buffer[1]);
+	EXPECT_EQ(pt2001WriteCommand(0x140 + 31, 31), buffer[32]);
+	EXPECT_EQ(31, buffer[33]);
+	EXPECT_EQ(pt2001WriteCommand(0x140 + 62, 8), buffer[64]);
+	EXPECT_EQ(69, buffer[72]);
+
+	// does not fit
+	Pt2001TransferBuilder small(buffer, 72, Pt2001Page::Common);
+	EXPECT_FALSE(small.addWrite(0x140, data, efi::size(data)));
+}
@@ -0,0 +1,90 @@
+/*
+ * psc_run.cpp
+ *
+ * Assemble PSC microcode and simulate one actuation, printing every output change.
+ *
+ * usage: psc_run [-2] [-e entry_label] [-s start] [-t pulse_us] [-v vboost] file.psc
+ *
+ * Data RAM comes from PT2001_LoadData.h, -2 selects the channel 2 half.
+ */
+
+#include <gerefi/pt2001_psc_sim.h>
+#include <PT2001_LoadData.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void usage() {
+	fprintf(stderr, "usage: psc_run [-2] [-e entry_label] [-s start] [-t pulse_us] [-v vboost] file.psc\n");
+}
+
+int main(int argc, char** argv) {
+	bool channel2 = false;
+	const char* entry = "init0";
+	int start = 1;
+	uint32_t pulseUs = 2000;
+	float vboost = 65;
+	const char* input = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-2") == 0) {
+			channel2 = true;
+		} else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+			entry = argv[++i];
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			start = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			pulseUs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+			vboost = atof(argv[++i]);
+		} else if (argv[i][0] != '-' && !input) {
+			input = argv[i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (!input) {
+		usage();
+		return 1;
+	}
+
+	PscAssembler assembler;
+	PscProgram program;
+	if (!assembler.assembleFile(input, program)) {
+		fprintf(stderr, "%s: %s\n", input, assembler.getError().c_str());
+		return 1;
+	}
+	printf("%s: %zu instructions\n", input, program.getInstructionCount());
+
+	PscSim sim(program);
+	sim.config.vboost = vboost;
+	for (size_t i = 0; i < PSC_DRAM_SIZE; i++) {
+		sim.dram[i] = PT2001_data_RAM[(channel2 ? PSC_DRAM_SIZE : 0) + i];
+	}
+
+	if (!sim.startCore(0, entry)) {
+		fprintf(stderr, "%s: no label %s\n", input, entry);
+		return 1;
+	}
+
+	sim.runUs(10);
+	sim.setStart(start, true);
+	sim.runUs(pulseUs);
+	sim.setStart(start, false);
+	sim.runUs(200);
+
+	printf("%10s  %-16s %3s %5s %2s %8s\n", "time us", "block", "bat", "boost", "ls", "current");
+	for (const auto& event : sim.getTrace()) {
+		printf("%10.2f  %-16s %3d %5d %2d %8.3f\n", event.tick / float(PscSim::ticksPerUs),
+			event.label ? event.label : "?", event.bat, event.boost, event.lowSide, event.current);
+	}
+
+	if (sim.getError()) {
+		fprintf(stderr, "%s: %s\n", input, sim.getError());
+		return 1;
+	}
+	return 0;
+}
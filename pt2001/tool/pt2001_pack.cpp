@@ -0,0 +1,254 @@
+/*
+ * pt2001_pack.cpp
+ *
+ * Pack PT2001 images for Pt2001Image, check packed images.
+ *
+ * usage: pt2001_pack pack [-r registers_dir] [-1 code_ram1] [-2 code_ram2] -o output
+ *        pt2001_pack check image
+ *
+ * Input files hold one 16 bit word per line, binary digits as in project/gerefi/Registers
+ * or 0x prefixed hex. Regions without input file come from PT2001_LoadData.h.
+ * Code width in channel config is set to the code RAM size.
+ */
+
+#include <gerefi/pt2001_image.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static void usage() {
+	fprintf(stderr, "usage: pt2001_pack pack [-r registers_dir] [-1 code_ram1] [-2 code_ram2] -o output\n");
+	fprintf(stderr, "       pt2001_pack check image\n");
+}
+
+static bool readWords(const std::string& path, std::vector<uint16_t>& words) {
+	FILE* f = fopen(path.c_str(), "r");
+	if (!f) {
+		fprintf(stderr, "pt2001_pack: can not read %s\n", path.c_str());
+		return false;
+	}
+
+	char line[128];
+	int lineNumber = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), f)) {
+		lineNumber++;
+
+		char* text = line;
+		while (*text == ' ' || *text == '\t') {
+			text++;
+		}
+		if (*text == '\r' || *text == '\n' || *text == '\0') {
+			continue;
+		}
+
+		bool hex = text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+		char* end;
+		unsigned long value = strtoul(text, &end, hex ? 16 : 2);
+		if (end == text || value > 0xFFFF) {
+			fprintf(stderr, "pt2001_pack: %s:%d: not a 16 bit word\n", path.c_str(), lineNumber);
+			ok = false;
+		}
+		words.push_back(value);
+	}
+
+	fclose(f);
+	return ok;
+}
+
+static int pack(int argc, char** argv) {
+	const char* registers = nullptr;
+	const char* codeRam[2] = {};
+	const char* output = nullptr;
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			registers = argv[++i];
+		} else if (strcmp(argv[i], "-1") == 0 && i + 1 < argc) {
+			codeRam[0] = argv[++i];
+		} else if (strcmp(argv[i], "-2") == 0 && i + 1 < argc) {
+			codeRam[1] = argv[++i];
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (!output) {
+		usage();
+		return 1;
+	}
+
+	Pt2001RegionInfo regions[PT2001_REGION_COUNT];
+	std::vector<uint16_t> words[PT2001_REGION_COUNT];
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		regions[i] = pt2001GetRegionInfo(static_cast<Pt2001Region>(i));
+		words[i].assign(regions[i].data, regions[i].data + regions[i].size);
+	}
+
+	if (registers) {
+		// as exported by the project, Data RAM comes in two halves
+		static const struct {
+			Pt2001Region region;
+			const char* files[2];
+		} files[] = {
+			{ Pt2001Region::DataRam, { "dram1.bin", "dram2.bin" } },
+			{ Pt2001Region::Main, { "main_config_reg.bin" } },
+			{ Pt2001Region::Ch1, { "ch1_config_reg.bin" } },
+			{ Pt2001Region::Ch2, { "ch2_config_reg.bin" } },
+			{ Pt2001Region::Io, { "io_config_reg.bin" } },
+			{ Pt2001Region::Diag, { "diag_config_reg.bin" } },
+		};
+
+		for (const auto& file : files) {
+			auto& region = words[static_cast<size_t>(file.region)];
+			region.clear();
+			for (const char* name : file.files) {
+				if (name && !readWords(std::string(registers) + "/" + name, region)) {
+					return 1;
+				}
+			}
+		}
+	}
+
+	for (size_t c = 0; c < 2; c++) {
+		auto code = c == 0 ? Pt2001Region::CodeRam1 : Pt2001Region::CodeRam2;
+		auto config = c == 0 ? Pt2001Region::Ch1 : Pt2001Region::Ch2;
+
+		auto& codeWords = words[static_cast<size_t>(code)];
+		if (codeRam[c]) {
+			codeWords.clear();
+			if (!readWords(codeRam[c], codeWords)) {
+				return 1;
+			}
+		}
+
+		const auto& info = pt2001GetRegionInfo(code);
+		const auto& configInfo = pt2001GetRegionInfo(config);
+		auto& configWords = words[static_cast<size_t>(config)];
+		size_t widthIndex = info.codeWidthAddress - configInfo.address;
+		if (widthIndex < configWords.size()) {
+			configWords[widthIndex] = codeWords.size();
+		}
+	}
+
+	uint16_t sizes[PT2001_REGION_COUNT];
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		regions[i].data = words[i].data();
+		regions[i].size = words[i].size();
+		sizes[i] = words[i].size();
+	}
+
+	std::vector<uint8_t> blob(pt2001ImageSize(sizes));
+	size_t size = pt2001BuildImage(blob.data(), blob.size(), regions);
+
+	// refuse to write anything the loader would not take
+	Pt2001Image image;
+	auto error = image.load(blob.data(), size);
+	if (error != Pt2001ImageError::None) {
+		fprintf(stderr, "pt2001_pack: invalid image: %s\n", pt2001ImageErrorToString(error));
+		return 1;
+	}
+
+	FILE* f = fopen(output, "wb");
+	if (!f || fwrite(blob.data(), 1, size, f) != size) {
+		fprintf(stderr, "pt2001_pack: can not write %s\n", output);
+		if (f) {
+			fclose(f);
+		}
+		return 1;
+	}
+	fclose(f);
+
+	printf("%s: %zu bytes, crc 0x%08x\n", output, size, image.getCrc());
+	return 0;
+}
+
+static const char* regionNames[PT2001_REGION_COUNT] = {
+	"code RAM 1", "code RAM 2", "Data RAM", "main", "ch1", "ch2", "io", "diag",
+};
+
+static int check(const char* path, const void* blob, size_t size) {
+	Pt2001Image image;
+	auto error = image.load(blob, size);
+	if (error != Pt2001ImageError::None) {
+		fprintf(stderr, "%s: %s\n", path, pt2001ImageErrorToString(error));
+		return 1;
+	}
+
+	printf("%s: crc 0x%08x\n", path, image.getCrc());
+	for (size_t i = 0; i < PT2001_REGION_COUNT; i++) {
+		const auto& region = image.getRegion(static_cast<Pt2001Region>(i));
+		printf("  %-10s 0x%03x %4u words\n", regionNames[i], region.address, region.size);
+	}
+	return 0;
+}
+
+// Maps image the way a bench rig would use it, read into memory where mmap is not available
+static int check(const char* path) {
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+		fprintf(stderr, "pt2001_pack: can not read %s\n", path);
+		if (fd >= 0) {
+			close(fd);
+		}
+		return 1;
+	}
+
+	void* blob = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (blob == MAP_FAILED) {
+		fprintf(stderr, "pt2001_pack: can not map %s\n", path);
+		return 1;
+	}
+
+	int result = check(path, blob, st.st_size);
+	munmap(blob, st.st_size);
+	return result;
+#else
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "pt2001_pack: can not read %s\n", path);
+		return 1;
+	}
+
+	// uint16_t storage keeps the words aligned
+	std::vector<uint16_t> blob;
+	uint16_t chunk[1024];
+	size_t bytes = 0;
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+		blob.insert(blob.end(), chunk, chunk + (n + 1) / 2);
+		bytes += n;
+	}
+	fclose(f);
+
+	return check(path, blob.data(), bytes);
+#endif
+}
+
+int main(int argc, char** argv) {
+	if (argc >= 2 && strcmp(argv[1], "pack") == 0) {
+		return pack(argc, argv);
+	}
+	if (argc == 3 && strcmp(argv[1], "check") == 0) {
+		return check(argv[2]);
+	}
+
+	usage();
+	return 1;
+}
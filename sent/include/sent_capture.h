@@ -0,0 +1,173 @@
+/*
+ * sent_capture.h
+ *
+ * Host side decoding of recorded SENT captures (logic analyzer, test rigs).
+ * Not intended for firmware: uses files, mmap and threads.
+ *
+ * Capture file, all values little endian:
+ *   header:        "SENTCAP1", uint32 timer frequency [Hz], uint32 channel count
+ *   channel table: channel count * { uint64 offset [bytes from file start], uint64 pulse count }
+ *   pulse data:    uint32 per pulse, falling edge to falling edge interval in timer clocks,
+ *                  bit 31 set if capture hardware overflowed before this pulse
+ * A file without header is a single channel of raw uint32 intervals.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#define SENT_CAPTURE_MAGIC				"SENTCAP1"
+#define SENT_CAPTURE_MAX_CHANNELS		32
+#define SENT_CAPTURE_FLAG_HW_OVERFLOW	(UINT32_C(1) << 31)
+
+struct SentCaptureHeader {
+	char magic[8];
+	uint32_t tickHz;
+	uint32_t channelCount;
+};
+
+struct SentCaptureChannelEntry {
+	uint64_t offset;
+	uint64_t count;
+};
+
+static_assert(sizeof(SentCaptureHeader) == 16);
+static_assert(sizeof(SentCaptureChannelEntry) == 16);
+
+// Read-only view of a capture file, mmap'ed where available
+class SentCapture {
+public:
+	SentCapture() = default;
+	~SentCapture();
+
+	SentCapture(const SentCapture&) = delete;
+	SentCapture& operator=(const SentCapture&) = delete;
+
+	// returns false if file can not be read or is malformed
+	bool open(const char* path);
+	void close();
+
+	size_t getChannelCount() const {
+		return m_channelCount;
+	}
+
+	// zero for raw captures without header
+	uint32_t getTickHz() const {
+		return m_tickHz;
+	}
+
+	const uint32_t* getPulses(size_t channel) const {
+		return m_pulses[channel];
+	}
+
+	size_t getPulseCount(size_t channel) const {
+		return m_counts[channel];
+	}
+
+	uint64_t getTotalPulseCount() const;
+
+private:
+	bool parse();
+
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_mapped = false;
+
+	uint32_t m_tickHz = 0;
+	size_t m_channelCount = 0;
+	const uint32_t* m_pulses[SENT_CAPTURE_MAX_CHANNELS];
+	size_t m_counts[SENT_CAPTURE_MAX_CHANNELS];
+};
+
+// Write capture file with given channels, returns false on IO error
+bool sentWriteCapture(FILE* out, uint32_t tickHz, const uint32_t* const* pulses, const size_t* counts, size_t channelCount);
+
+enum class SentCaptureEventType : uint8_t {
+	// fast channel frame with valid CRC: id = status nibble, value0 = sig0, value1 = sig1
+	Frame = 0,
+	// slow channel message completed: id = message id, value0 = data
+	SlowChannel = 1,
+	// decoder rejected pulse, id = SentCaptureError
+	Error = 2,
+};
+
+enum class SentCaptureError : uint8_t {
+	ShortInterval = 0,
+	LongInterval = 1,
+	Sync = 2,
+	Crc = 3,
+	// decoder lost calibration and restarted
+	Restart = 4,
+	HwOverflow = 5,
+	Unknown = 6,
+};
+
+// One record of binary output
+struct SentCaptureEvent {
+	// timer clocks since start of capture, at the end of pulse that produced this event
+	uint64_t clocks;
+	// index of pulse that produced this event
+	uint64_t pulse;
+	uint8_t channel;
+	SentCaptureEventType type;
+	uint8_t id;
+	uint8_t reserved;
+	uint16_t value0;
+	uint16_t value1;
+};
+
+static_assert(sizeof(SentCaptureEvent) == 24);
+
+struct SentCaptureSink {
+	virtual ~SentCaptureSink() = default;
+
+	virtual void onEvent(const SentCaptureEvent& event) = 0;
+	// called once after last event of the channel
+	virtual void flush() { }
+};
+
+// Buffered writers
+class SentCaptureCsvWriter : public SentCaptureSink {
+public:
+	explicit SentCaptureCsvWriter(FILE* out);
+	~SentCaptureCsvWriter();
+
+	void onEvent(const SentCaptureEvent& event) override;
+	void flush() override;
+
+	static void writeHeader(FILE* out);
+
+private:
+	FILE* const m_out;
+	size_t m_used = 0;
+	char m_buffer[64 * 1024];
+};
+
+class SentCaptureBinaryWriter : public SentCaptureSink {
+public:
+	explicit SentCaptureBinaryWriter(FILE* out);
+	~SentCaptureBinaryWriter();
+
+	void onEvent(const SentCaptureEvent& event) override;
+	void flush() override;
+
+private:
+	FILE* const m_out;
+	size_t m_used = 0;
+	SentCaptureEvent m_buffer[4096];
+};
+
+struct SentCaptureChannelResult {
+	uint64_t frames;
+	uint64_t slowMessages;
+	uint64_t errors;
+};
+
+// Decode one channel of pulses with a fresh sent_channel
+SentCaptureChannelResult sentDecodePulses(const uint32_t* pulses, size_t count, uint8_t channel, SentCaptureSink& sink);
+
+// Decode all channels of the capture, channels run in parallel on up to `threads` threads.
+// sinks[i] receives events of channel i, results[i] (optional) gets per-channel totals.
+void sentDecodeCapture(const SentCapture& capture, SentCaptureSink* const* sinks, SentCaptureChannelResult* results, size_t threads);
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 /* Maximum slow shannel mailboxes */
@@ -17,6 +18,27 @@
 /* collect statistic */
 #define SENT_STATISTIC_COUNTERS	1
 
+/* Rolling window statistic: window is made of buckets, each bucket
+ * is closed after this number of events (frames + errors) */
+#ifndef SENT_STAT_WINDOW_BUCKETS
+#define SENT_STAT_WINDOW_BUCKETS		8
+#endif
+#ifndef SENT_STAT_WINDOW_BUCKET_EVENTS
+#define SENT_STAT_WINDOW_BUCKET_EVENTS	64
+#endif
+
+/* Sync pulse jitter histogram
+ * Bin width is 1/SENT_JITTER_HIST_SCALE of previous sync pulse length,
+ * so with default values histogram covers +/-3.125% (J2716 allows
+ * +/-1.5625% between successive calibration pulses).
+ * First and last bins also collect everything out of range. */
+#ifndef SENT_JITTER_HIST_BINS
+#define SENT_JITTER_HIST_BINS		16
+#endif
+#ifndef SENT_JITTER_HIST_SCALE
+#define SENT_JITTER_HIST_SCALE		256
+#endif
+
 typedef enum
 {
 	SENT_STATE_CALIB = 0,
@@ -57,6 +79,125 @@ struct sent_channel_stat {
 	}
 };
 
+/* Error rate over last (SENT_STAT_WINDOW_BUCKETS - 1) .. SENT_STAT_WINDOW_BUCKETS
+ * buckets of events. Not cleared on decoder restart. Constant time update. */
+struct sent_channel_window_stat {
+	struct {
+		uint16_t frames;
+		uint16_t errors;
+	} bucket[SENT_STAT_WINDOW_BUCKETS];
+
+	/* bucket being filled */
+	uint8_t current;
+	uint16_t currentEvents;
+
+	/* sums over all buckets */
+	uint32_t frames;
+	uint32_t errors;
+
+	void addFrame() {
+		bucket[current].frames++;
+		frames++;
+		next();
+	}
+
+	void addError() {
+		bucket[current].errors++;
+		errors++;
+		next();
+	}
+
+	/* errors / (frames + errors) in parts per million, integer math only */
+	uint32_t getErrorRatePpm() const {
+		uint32_t total = frames + errors;
+
+		if (total == 0) {
+			return 0;
+		}
+		/* window is small enough: errors * 1000000 does not overflow */
+		return (errors * UINT32_C(1000000)) / total;
+	}
+
+	void reset() {
+		*this = {};
+	}
+
+private:
+	void next() {
+		if (++currentEvents < SENT_STAT_WINDOW_BUCKET_EVENTS) {
+			return;
+		}
+		currentEvents = 0;
+		current = (current + 1) % SENT_STAT_WINDOW_BUCKETS;
+		/* drop oldest bucket */
+		frames -= bucket[current].frames;
+		errors -= bucket[current].errors;
+		bucket[current].frames = 0;
+		bucket[current].errors = 0;
+	}
+};
+
+static_assert((uint64_t)SENT_STAT_WINDOW_BUCKETS * SENT_STAT_WINDOW_BUCKET_EVENTS * 1000000 <= UINT32_MAX,
+	"SENT statistic window too large for integer error rate");
+static_assert(SENT_STAT_WINDOW_BUCKET_EVENTS <= UINT16_MAX);
+
+/* Histogram of sync pulse length relative to previous sync pulse.
+ * Cheap enough to run from decoder ISR: one division by value
+ * precalculated on previous sync pulse, no floats. */
+struct sent_channel_jitter_hist {
+	uint32_t bins[SENT_JITTER_HIST_BINS];
+
+	/* previous sync length, zero if unknown */
+	uint32_t prevSyncClocks;
+	/* timer clocks per histogram bin */
+	uint32_t clocksPerBin;
+
+	void add(uint32_t syncClocks) {
+		if (clocksPerBin) {
+			int32_t delta = (int32_t)(syncClocks - prevSyncClocks);
+			/* round towards minus infinity, so the centre bin is as wide as the others */
+			int32_t bin = delta >= 0
+				? delta / (int32_t)clocksPerBin
+				: -(int32_t)((0u - (uint32_t)delta + clocksPerBin - 1) / clocksPerBin);
+
+			bin += SENT_JITTER_HIST_BINS / 2;
+			if (bin < 0) {
+				bin = 0;
+			} else if (bin >= SENT_JITTER_HIST_BINS) {
+				bin = SENT_JITTER_HIST_BINS - 1;
+			}
+			bins[bin]++;
+		}
+		resync(syncClocks);
+	}
+
+	/* remember sync length without collecting it, used after loss of sync */
+	void resync(uint32_t syncClocks) {
+		prevSyncClocks = syncClocks;
+		/* zero if timer is too slow to resolve one bin */
+		clocksPerBin = syncClocks / SENT_JITTER_HIST_SCALE;
+	}
+
+	uint32_t getCount() const {
+		uint32_t count = 0;
+
+		for (size_t i = 0; i < SENT_JITTER_HIST_BINS; i++) {
+			count += bins[i];
+		}
+		return count;
+	}
+
+	/* deviation from previous sync of given bin in 1/SENT_JITTER_HIST_SCALE units,
+	 * bin holds deviations from this value up to the next one */
+	static int32_t getBinDeviation(size_t bin) {
+		return (int32_t)bin - SENT_JITTER_HIST_BINS / 2;
+	}
+
+	void reset() {
+		*this = {};
+	}
+};
+
 #define SENT_FLAG_HW_OVERFLOW	(1 << 0)
 
 class sent_channel {
@@ -76,6 +217,11 @@ private:
 	/* fast channel last received valid message */
 	uint32_t rxLast;
 
+	/* slow channel message stored with last frame */
+	bool scUpdated = false;
+	uint8_t scUpdatedId;
+	uint16_t scUpdatedData;
+
 	/* slow channel shift registers */
 	uint32_t scShift2;	/* shift register for bit 2 from status nibble */
 	uint32_t scShift3;	/* shift register for bit 3 from status nibble */
@@ -112,6 +258,10 @@ public:
 	/* Statistic counters */
 #if SENT_STATISTIC_COUNTERS
 	sent_channel_stat statistic;
+	/* Rolling error rate, survives restart() */
+	sent_channel_window_stat windowStatistic;
+	/* Sync pulse to sync pulse jitter, survives restart() */
+	sent_channel_jitter_hist syncJitter;
 #endif // SENT_STATISTIC_COUNTERS
 
 	/* Decoder */
@@ -128,6 +278,9 @@ public:
 	/* Get slow channel value for given ID 8*/
 	int GetSlowChannelValue(uint8_t id);
 
+	/* Get slow channel message completed since previous call, -1 if none */
+	int GetSlowChannelUpdate(uint8_t *pId, uint16_t *pData);
+
 	/* Current tick time in CPU/timer clocks */
 	float getTickTime();
 
@@ -3,3 +3,11 @@ GEREFI_LIB_INC += \
 
 GEREFI_LIB_CPP += \
 	$(GEREFI_LIB)/sent/src/sent_decoder.cpp
+
+# host only: recorded capture decoding, see sent/tool
+GEREFI_LIB_HOST_CPP += \
+	$(GEREFI_LIB)/sent/src/sent_capture.cpp \
+
+GEREFI_LIB_CPP_TEST += \
+	$(GEREFI_LIB)/sent/test/test_sent_decoder.cpp \
+	$(GEREFI_LIB)/sent/test/test_sent_capture.cpp \
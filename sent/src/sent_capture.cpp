@@ -0,0 +1,409 @@
+/*
+ * sent_capture.cpp
+ *
+ * Host side decoding of recorded SENT captures, see sent_capture.h
+ */
+
+#include "sent_capture.h"
+#include "sent_decoder.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*==========================================================================*/
+/* Capture file																*/
+/*==========================================================================*/
+
+SentCapture::~SentCapture() {
+	close();
+}
+
+bool SentCapture::open(const char* path) {
+	close();
+
+#ifndef _WIN32
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	/* we are going to read it once front to back */
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	m_data = reinterpret_cast<const uint8_t*>(map);
+	m_size = st.st_size;
+	m_mapped = true;
+#else
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t* buffer = size > 0 ? new uint8_t[size] : nullptr;
+	if (!buffer || fread(buffer, 1, size, f) != (size_t)size) {
+		delete[] buffer;
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+
+	m_data = buffer;
+	m_size = size;
+	m_mapped = false;
+#endif
+
+	if (!parse()) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void SentCapture::close() {
+	if (m_data) {
+#ifndef _WIN32
+		if (m_mapped) {
+			munmap(const_cast<uint8_t*>(m_data), m_size);
+		}
+#else
+		delete[] m_data;
+#endif
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapped = false;
+	m_tickHz = 0;
+	m_channelCount = 0;
+}
+
+bool SentCapture::parse() {
+	SentCaptureHeader header;
+
+	if (m_size < sizeof(header) || memcmp(m_data, SENT_CAPTURE_MAGIC, sizeof(header.magic)) != 0) {
+		/* raw capture: single channel */
+		m_channelCount = 1;
+		m_pulses[0] = reinterpret_cast<const uint32_t*>(m_data);
+		m_counts[0] = m_size / sizeof(uint32_t);
+		return true;
+	}
+
+	memcpy(&header, m_data, sizeof(header));
+	if (header.channelCount == 0 || header.channelCount > SENT_CAPTURE_MAX_CHANNELS) {
+		return false;
+	}
+	if (m_size < sizeof(header) + header.channelCount * sizeof(SentCaptureChannelEntry)) {
+		return false;
+	}
+
+	for (size_t i = 0; i < header.channelCount; i++) {
+		SentCaptureChannelEntry entry;
+		memcpy(&entry, m_data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+		if ((entry.offset % sizeof(uint32_t)) != 0 ||
+			entry.offset > m_size ||
+			entry.count > (m_size - entry.offset) / sizeof(uint32_t)) {
+			return false;
+		}
+
+		m_pulses[i] = reinterpret_cast<const uint32_t*>(m_data + entry.offset);
+		m_counts[i] = entry.count;
+	}
+
+	m_tickHz = header.tickHz;
+	m_channelCount = header.channelCount;
+	return true;
+}
+
+uint64_t SentCapture::getTotalPulseCount() const {
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < m_channelCount; i++) {
+		total += m_counts[i];
+	}
+	return total;
+}
+
+bool sentWriteCapture(FILE* out, uint32_t tickHz, const uint32_t* const* pulses, const size_t* counts, size_t channelCount) {
+	if (channelCount == 0 || channelCount > SENT_CAPTURE_MAX_CHANNELS) {
+		return false;
+	}
+
+	SentCaptureHeader header;
+	memcpy(header.magic, SENT_CAPTURE_MAGIC, sizeof(header.magic));
+	header.tickHz = tickHz;
+	header.channelCount = channelCount;
+	if (fwrite(&header, sizeof(header), 1, out) != 1) {
+		return false;
+	}
+
+	uint64_t offset = sizeof(header) + channelCount * sizeof(SentCaptureChannelEntry);
+	for (size_t i = 0; i < channelCount; i++) {
+		SentCaptureChannelEntry entry = { offset, counts[i] };
+		if (fwrite(&entry, sizeof(entry), 1, out) != 1) {
+			return false;
+		}
+		offset += counts[i] * sizeof(uint32_t);
+	}
+
+	for (size_t i = 0; i < channelCount; i++) {
+		if (fwrite(pulses[i], sizeof(uint32_t), counts[i], out) != counts[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*==========================================================================*/
+/* Writers																	*/
+/*==========================================================================*/
+
+static const char* const eventTypeNames[] = { "frame", "slow", "error" };
+
+static char* putUint(char* p, uint64_t value) {
+	char tmp[20];
+	size_t n = 0;
+
+	do {
+		tmp[n++] = '0' + (value % 10);
+		value /= 10;
+	} while (value);
+
+	while (n) {
+		*p++ = tmp[--n];
+	}
+	return p;
+}
+
+static char* putString(char* p, const char* str) {
+	while (*str) {
+		*p++ = *str++;
+	}
+	return p;
+}
+
+SentCaptureCsvWriter::SentCaptureCsvWriter(FILE* out) : m_out(out) {
+}
+
+SentCaptureCsvWriter::~SentCaptureCsvWriter() {
+	flush();
+}
+
+void SentCaptureCsvWriter::writeHeader(FILE* out) {
+	fputs("channel,pulse,clocks,type,id,value0,value1\n", out);
+}
+
+void SentCaptureCsvWriter::onEvent(const SentCaptureEvent& event) {
+	/* longest line: 3 + 20 + 20 + 5 + 3 + 5 + 5 + separators */
+	if (m_used > sizeof(m_buffer) - 80) {
+		flush();
+	}
+
+	char* p = m_buffer + m_used;
+	p = putUint(p, event.channel);
+	*p++ = ',';
+	p = putUint(p, event.pulse);
+	*p++ = ',';
+	p = putUint(p, event.clocks);
+	*p++ = ',';
+	p = putString(p, eventTypeNames[(size_t)event.type]);
+	*p++ = ',';
+	p = putUint(p, event.id);
+	*p++ = ',';
+	p = putUint(p, event.value0);
+	*p++ = ',';
+	p = putUint(p, event.value1);
+	*p++ = '\n';
+
+	m_used = p - m_buffer;
+}
+
+void SentCaptureCsvWriter::flush() {
+	if (m_used) {
+		fwrite(m_buffer, 1, m_used, m_out);
+		m_used = 0;
+	}
+}
+
+SentCaptureBinaryWriter::SentCaptureBinaryWriter(FILE* out) : m_out(out) {
+}
+
+SentCaptureBinaryWriter::~SentCaptureBinaryWriter() {
+	flush();
+}
+
+void SentCaptureBinaryWriter::onEvent(const SentCaptureEvent& event) {
+	m_buffer[m_used++] = event;
+
+	if (m_used == sizeof(m_buffer) / sizeof(m_buffer[0])) {
+		flush();
+	}
+}
+
+void SentCaptureBinaryWriter::flush() {
+	if (m_used) {
+		fwrite(m_buffer, sizeof(m_buffer[0]), m_used, m_out);
+		m_used = 0;
+	}
+}
+
+/*==========================================================================*/
+/* Decoder																	*/
+/*==========================================================================*/
+
+/* Find out which error counter moved, counters are only compared when decoder
+ * reported error so hot path stays untouched */
+static SentCaptureError classifyError(const sent_channel_stat& now, sent_channel_stat& known) {
+	SentCaptureError error = SentCaptureError::Unknown;
+
+	/* sync error also bumps short/long interval counter, so check it first */
+	if (now.SyncErr != known.SyncErr) {
+		error = SentCaptureError::Sync;
+	} else if (now.CrcErrCnt != known.CrcErrCnt) {
+		error = SentCaptureError::Crc;
+	} else if (now.ShortIntervalErr != known.ShortIntervalErr) {
+		error = SentCaptureError::ShortInterval;
+	} else if (now.LongIntervalErr != known.LongIntervalErr) {
+		error = SentCaptureError::LongInterval;
+	}
+
+	known = now;
+	return error;
+}
+
+SentCaptureChannelResult sentDecodePulses(const uint32_t* pulses, size_t count, uint8_t channel, SentCaptureSink& sink) {
+	SentCaptureChannelResult result = {};
+	/* sent_channel is big-ish and has no constructor for everything, keep it zeroed */
+	sent_channel ch{};
+	sent_channel_stat known = {};
+	uint64_t clocks = 0;
+
+	SentCaptureEvent event = {};
+	event.channel = channel;
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t raw = pulses[i];
+		uint32_t interval = raw & ~SENT_CAPTURE_FLAG_HW_OVERFLOW;
+		uint8_t flags = (raw & SENT_CAPTURE_FLAG_HW_OVERFLOW) ? SENT_FLAG_HW_OVERFLOW : 0;
+
+		clocks += interval;
+
+		int ret = ch.Decoder(interval, flags);
+
+		if (__builtin_expect(ret == 0 && flags == 0 && ch.statistic.RestartCnt == known.RestartCnt, 1)) {
+			continue;
+		}
+
+		event.clocks = clocks;
+		event.pulse = i;
+
+		if (flags) {
+			event.type = SentCaptureEventType::Error;
+			event.id = (uint8_t)SentCaptureError::HwOverflow;
+			event.value0 = event.value1 = 0;
+			sink.onEvent(event);
+			result.errors++;
+		}
+
+		if (ch.statistic.RestartCnt != known.RestartCnt) {
+			/* restart() clears error counters */
+			known = ch.statistic;
+
+			event.type = SentCaptureEventType::Error;
+			event.id = (uint8_t)SentCaptureError::Restart;
+			event.value0 = event.value1 = 0;
+			sink.onEvent(event);
+			result.errors++;
+		}
+
+		if (ret > 0) {
+			uint8_t stat;
+			uint16_t sig0, sig1;
+
+			ch.GetSignals(&stat, &sig0, &sig1);
+			event.type = SentCaptureEventType::Frame;
+			event.id = stat;
+			event.value0 = sig0;
+			event.value1 = sig1;
+			sink.onEvent(event);
+			result.frames++;
+
+			uint8_t id;
+			uint16_t data;
+			if (ch.GetSlowChannelUpdate(&id, &data) == 0) {
+				event.type = SentCaptureEventType::SlowChannel;
+				event.id = id;
+				event.value0 = data;
+				event.value1 = 0;
+				sink.onEvent(event);
+				result.slowMessages++;
+			}
+		} else if (ret < 0) {
+			event.type = SentCaptureEventType::Error;
+			event.id = (uint8_t)classifyError(ch.statistic, known);
+			event.value0 = event.value1 = 0;
+			sink.onEvent(event);
+			result.errors++;
+		}
+	}
+
+	sink.flush();
+
+	return result;
+}
+
+void sentDecodeCapture(const SentCapture& capture, SentCaptureSink* const* sinks, SentCaptureChannelResult* results, size_t threads) {
+	size_t channels = capture.getChannelCount();
+	std::atomic<size_t> nextChannel{0};
+
+	auto worker = [&]() {
+		size_t ch;
+		while ((ch = nextChannel++) < channels) {
+			SentCaptureChannelResult result = sentDecodePulses(capture.getPulses(ch), capture.getPulseCount(ch), ch, *sinks[ch]);
+			if (results) {
+				results[ch] = result;
+			}
+		}
+	};
+
+	if (threads > channels) {
+		threads = channels;
+	}
+
+	if (threads <= 1) {
+		worker();
+		return;
+	}
+
+	std::vector<std::thread> pool;
+	for (size_t i = 0; i < threads; i++) {
+		pool.emplace_back(worker);
+	}
+	for (auto& t : pool) {
+		t.join();
+	}
+}
@@ -84,6 +84,8 @@ void sent_channel::restart() {
 		statistic.sc16 = 0;
 		statistic.scCrcErr = 0;
 		statistic.RestartCnt++;
+		/* rolling statistic is kept, just forget previous sync */
+		syncJitter.resync(0);
 	#endif
 }
 
@@ -146,6 +148,10 @@ int sent_channel::FastChannelDecoder(uint32_t clocks) {
 	/* special case for out-of-sync state */
 	if (state == SENT_STATE_INIT) {
 		if (isSyncPulse(clocks)) {
+			#if SENT_STATISTIC_COUNTERS
+				/* do not compare with sync seen before loss of sync */
+				syncJitter.resync(clocks);
+			#endif // SENT_STATISTIC_COUNTERS
 			/* adjust unit time */
 			calcTickPerUnit(clocks);
 			/* we get here from calibration phase. calibration phase end with CRC nibble
@@ -189,6 +195,9 @@ int sent_channel::FastChannelDecoder(uint32_t clocks) {
 		case SENT_STATE_SYNC:
 			if (isSyncPulse(clocks))
 			{
+				#if SENT_STATISTIC_COUNTERS
+					syncJitter.add(clocks);
+				#endif // SENT_STATISTIC_COUNTERS
 				/* measured tick interval will be used until next sync pulse */
 				calcTickPerUnit(clocks);
 				rxReg = 0;
@@ -230,6 +239,8 @@ int sent_channel::FastChannelDecoder(uint32_t clocks) {
 			if ((pausePulseReceived == false) && isSyncPulse(clocks)) {
 				#if SENT_STATISTIC_COUNTERS
 					statistic.PauseCnt++;
+					/* previous pulse was pause, not sync */
+					syncJitter.resync(clocks);
 				#endif // SENT_STATISTIC_COUNTERS
 				/* measured tick interval will be used until next sync pulse */
 				calcTickPerUnit(clocks);
@@ -305,6 +316,15 @@ int sent_channel::Decoder(uint32_t clocks, uint8_t flags) {
 	(void)flags;
 
 	ret = FastChannelDecoder(clocks);
+
+	#if SENT_STATISTIC_COUNTERS
+		if (ret > 0) {
+			windowStatistic.addFrame();
+		} else if (ret < 0) {
+			windowStatistic.addError();
+		}
+	#endif // SENT_STATISTIC_COUNTERS
+
 	if (ret > 0) {
 		/* valid packet received, can process slow channels */
 		SlowChannelDecoder();
@@ -364,6 +384,10 @@ int sent_channel::StoreSlowChannelValue(uint8_t id, uint16_t data)
 {
 	size_t i;
 
+	scUpdated = true;
+	scUpdatedId = id;
+	scUpdatedData = data;
+
 	/* Update already allocated messagebox? */
 	for (i = 0; i < SENT_SLOW_CHANNELS_MAX; i++) {
 		if ((scMsg[i].valid) && (scMsg[i].id == id)) {
@@ -401,6 +425,23 @@ int sent_channel::GetSlowChannelValue(uint8_t id)
 	return -1;
 }
 
+int sent_channel::GetSlowChannelUpdate(uint8_t *pId, uint16_t *pData)
+{
+	if (!scUpdated) {
+		return -1;
+	}
+	scUpdated = false;
+
+	if (pId) {
+		*pId = scUpdatedId;
+	}
+	if (pData) {
+		*pData = scUpdatedData;
+	}
+
+	return 0;
+}
+
 int sent_channel::SlowChannelDecoder()
 {
 	/* bit 2 and bit 3 from status nibble are used to transfer short messages */
@@ -0,0 +1,35 @@
+// SENT pulse train generator for unit tests
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/* timer clocks per SENT tick */
+static const uint32_t sentTestTickClocks = 30;
+
+static inline uint8_t sentTestCrc4(const uint8_t *nibbles) {
+	const uint8_t CrcLookup[16] = {0, 13, 7, 10, 14, 3, 9, 4, 1, 12, 6, 11, 15, 2, 8, 5};
+	uint8_t crc = 0x05;
+
+	for (size_t i = 0; i < 7; i++) {
+		crc = CrcLookup[crc ^ nibbles[i]];
+	}
+	return crc;
+}
+
+/* sync, status, 6 data nibbles, CRC */
+static inline void sentTestAddFrame(std::vector<uint32_t>& pulses, uint16_t sig0, uint32_t syncClocks = 56 * sentTestTickClocks, uint8_t status = 0) {
+	uint8_t nibbles[8] = {
+		status,
+		(uint8_t)((sig0 >> 8) & 0xf), (uint8_t)((sig0 >> 4) & 0xf), (uint8_t)(sig0 & 0xf),
+		1, 2, 3,
+		0
+	};
+	nibbles[7] = sentTestCrc4(nibbles);
+
+	pulses.push_back(syncClocks);
+	for (size_t i = 0; i < 8; i++) {
+		pulses.push_back((12 + nibbles[i]) * sentTestTickClocks);
+	}
+}
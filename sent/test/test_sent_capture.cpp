@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "sent_capture.h"
+#include "sent_test_frames.h"
+#include "test_temp_path.h"
+
+struct RecordingSink : public SentCaptureSink {
+	std::vector<SentCaptureEvent> events;
+	int flushCount = 0;
+
+	void onEvent(const SentCaptureEvent& event) override {
+		events.push_back(event);
+	}
+
+	void flush() override {
+		flushCount++;
+	}
+
+	size_t count(SentCaptureEventType type) const {
+		size_t n = 0;
+		for (auto& e : events) {
+			n += e.type == type;
+		}
+		return n;
+	}
+};
+
+/* short serial message: status bit 3 marks start, bit 2 carries 16 bits MSB first */
+static void addShortSerialMessage(std::vector<uint32_t>& pulses, uint8_t id, uint8_t data) {
+	uint16_t message = (id << 12) | (data << 4);
+
+	for (int i = 0; i < 16; i++) {
+		uint8_t b3 = (i == 0) ? 1 : 0;
+		uint8_t b2 = (message >> (15 - i)) & 1;
+		sentTestAddFrame(pulses, 0x100 + i, 56 * sentTestTickClocks, (b3 << 3) | (b2 << 2));
+	}
+}
+
+TEST(Sent_Capture, decodeFile) {
+	std::vector<uint32_t> ch0, ch1;
+
+	for (int i = 0; i < 10; i++) {
+		sentTestAddFrame(ch0, 0x123);
+	}
+	addShortSerialMessage(ch0, 5, 0xA7);
+
+	for (int i = 0; i < 20; i++) {
+		sentTestAddFrame(ch1, 0x456);
+	}
+	/* broken nibble */
+	size_t broken = ch1.size() - 4;
+	ch1[broken] = 2 * sentTestTickClocks;
+	/* hw overflow flag */
+	ch1.push_back(56 * sentTestTickClocks | SENT_CAPTURE_FLAG_HW_OVERFLOW);
+
+	std::string file = tempPath("sent_capture_test");
+	const char* path = file.c_str();
+	FILE* f = fopen(path, "wb");
+	ASSERT_NE(nullptr, f);
+	const uint32_t* pulses[] = { ch0.data(), ch1.data() };
+	size_t counts[] = { ch0.size(), ch1.size() };
+	ASSERT_TRUE(sentWriteCapture(f, 1000000, pulses, counts, 2));
+	fclose(f);
+
+	SentCapture capture;
+	ASSERT_TRUE(capture.open(path));
+	ASSERT_EQ(2u, capture.getChannelCount());
+	EXPECT_EQ(1000000u, capture.getTickHz());
+	EXPECT_EQ(ch0.size(), capture.getPulseCount(0));
+	EXPECT_EQ(ch1.size(), capture.getPulseCount(1));
+	EXPECT_EQ(ch0.size() + ch1.size(), capture.getTotalPulseCount());
+
+	RecordingSink sink0, sink1;
+	SentCaptureSink* sinks[] = { &sink0, &sink1 };
+	SentCaptureChannelResult results[2];
+	sentDecodeCapture(capture, sinks, results, 2);
+
+	EXPECT_EQ(1, sink0.flushCount);
+	EXPECT_EQ(1, sink1.flushCount);
+
+	/* channel 0: all frames after calibration, one slow channel message */
+	EXPECT_EQ(results[0].frames, sink0.count(SentCaptureEventType::Frame));
+	EXPECT_GT(results[0].frames, 20u);
+	EXPECT_EQ(0u, results[0].errors);
+	ASSERT_EQ(1u, sink0.count(SentCaptureEventType::SlowChannel));
+	for (auto& e : sink0.events) {
+		EXPECT_EQ(0, e.channel);
+		if (e.type == SentCaptureEventType::SlowChannel) {
+			EXPECT_EQ(5, e.id);
+			EXPECT_EQ(0xA7, e.value0);
+		}
+	}
+	EXPECT_EQ(0x123, sink0.events[0].value0);
+	EXPECT_EQ(0x321, sink0.events[0].value1);
+
+	/* channel 1: short interval error, then hw overflow */
+	ASSERT_EQ(2u, sink1.count(SentCaptureEventType::Error));
+	auto& err = sink1.events[sink1.events.size() - 2];
+	EXPECT_EQ((uint8_t)SentCaptureError::ShortInterval, err.id);
+	EXPECT_EQ(broken, err.pulse);
+	auto& overflow = sink1.events.back();
+	EXPECT_EQ((uint8_t)SentCaptureError::HwOverflow, overflow.id);
+	EXPECT_EQ(ch1.size() - 1, overflow.pulse);
+
+	/* timestamp is sum of intervals up to the event */
+	uint64_t clocks = 0;
+	for (size_t i = 0; i <= sink1.events[0].pulse; i++) {
+		clocks += ch1[i];
+	}
+	EXPECT_EQ(clocks, sink1.events[0].clocks);
+
+	capture.close();
+	remove(path);
+}
+
+TEST(Sent_Capture, rawFile) {
+	std::vector<uint32_t> ch0;
+	for (int i = 0; i < 10; i++) {
+		sentTestAddFrame(ch0, 0x123);
+	}
+
+	std::string file = tempPath("sent_capture_raw_test");
+	const char* path = file.c_str();
+	FILE* f = fopen(path, "wb");
+	ASSERT_NE(nullptr, f);
+	fwrite(ch0.data(), sizeof(uint32_t), ch0.size(), f);
+	fclose(f);
+
+	SentCapture capture;
+	ASSERT_TRUE(capture.open(path));
+	EXPECT_EQ(1u, capture.getChannelCount());
+	EXPECT_EQ(0u, capture.getTickHz());
+
+	RecordingSink sink;
+	auto result = sentDecodePulses(capture.getPulses(0), capture.getPulseCount(0), 0, sink);
+	EXPECT_GT(result.frames, 0u);
+
+	capture.close();
+	remove(path);
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "sent_decoder.h"
+#include "sent_test_frames.h"
+
+static int feed(sent_channel& ch, const std::vector<uint32_t>& pulses) {
+	int frames = 0;
+
+	for (auto clocks : pulses) {
+		if (ch.Decoder(clocks) > 0) {
+			frames++;
+		}
+	}
+	return frames;
+}
+
+TEST(Sent_Decoder, decodesFrames) {
+	sent_channel ch{};
+	std::vector<uint32_t> pulses;
+
+	for (int i = 0; i < 20; i++) {
+		sentTestAddFrame(pulses, 0x123);
+	}
+
+	EXPECT_GT(feed(ch, pulses), 10);
+
+	uint16_t sig0, sig1;
+	ASSERT_EQ(0, ch.GetSignals(nullptr, &sig0, &sig1));
+	EXPECT_EQ(0x123, sig0);
+	EXPECT_EQ(0x321, sig1);
+}
+
+TEST(Sent_Decoder, windowStatistic) {
+	sent_channel ch{};
+	std::vector<uint32_t> pulses;
+
+	for (int i = 0; i < 100; i++) {
+		sentTestAddFrame(pulses, 0x200 + i);
+	}
+	int frames = feed(ch, pulses);
+
+	EXPECT_EQ((uint32_t)frames, ch.windowStatistic.frames);
+	EXPECT_EQ(0u, ch.windowStatistic.errors);
+	EXPECT_EQ(0u, ch.windowStatistic.getErrorRatePpm());
+
+	/* too short pulse in the middle of the frame */
+	pulses.clear();
+	sentTestAddFrame(pulses, 0x100);
+	pulses[3] = 2 * sentTestTickClocks;
+	feed(ch, pulses);
+
+	EXPECT_EQ(1u, ch.windowStatistic.errors);
+	EXPECT_EQ(1u, ch.statistic.ShortIntervalErr);
+	EXPECT_GT(ch.windowStatistic.getErrorRatePpm(), 0u);
+
+	/* error leaves window after enough good frames */
+	pulses.clear();
+	for (int i = 0; i < SENT_STAT_WINDOW_BUCKETS * SENT_STAT_WINDOW_BUCKET_EVENTS; i++) {
+		sentTestAddFrame(pulses, 0x300);
+	}
+	feed(ch, pulses);
+
+	EXPECT_EQ(0u, ch.windowStatistic.errors);
+	EXPECT_LE(ch.windowStatistic.frames, (uint32_t)(SENT_STAT_WINDOW_BUCKETS * SENT_STAT_WINDOW_BUCKET_EVENTS));
+	EXPECT_GE(ch.windowStatistic.frames, (uint32_t)((SENT_STAT_WINDOW_BUCKETS - 1) * SENT_STAT_WINDOW_BUCKET_EVENTS));
+}
+
+TEST(Sent_Decoder, syncJitter) {
+	sent_channel ch{};
+	std::vector<uint32_t> pulses;
+
+	for (int i = 0; i < 10; i++) {
+		sentTestAddFrame(pulses, 0x123);
+	}
+	feed(ch, pulses);
+
+	uint32_t stable = ch.syncJitter.bins[SENT_JITTER_HIST_BINS / 2];
+	EXPECT_GT(stable, 0u);
+	EXPECT_EQ(stable, ch.syncJitter.getCount());
+
+	/* alternate sync length by +/-1% */
+	pulses.clear();
+	uint32_t sync = 56 * sentTestTickClocks;
+	for (int i = 0; i < 10; i++) {
+		sentTestAddFrame(pulses, 0x123, (i & 1) ? sync : sync + sync / 100);
+	}
+	feed(ch, pulses);
+
+	/* +1% is 2.56 bins, -1% of longer pulse is -2.53 bins */
+	EXPECT_EQ(5u, ch.syncJitter.bins[SENT_JITTER_HIST_BINS / 2 + 2]);
+	EXPECT_EQ(5u, ch.syncJitter.bins[SENT_JITTER_HIST_BINS / 2 - 3]);
+	EXPECT_EQ(2, sent_channel_jitter_hist::getBinDeviation(SENT_JITTER_HIST_BINS / 2 + 2));
+}
+
+TEST(Sent_Decoder, syncJitterSmallDeviation) {
+	sent_channel_jitter_hist hist{};
+	const int center = SENT_JITTER_HIST_BINS / 2;
+
+	/* 100 clocks per bin */
+	hist.resync(25600);
+	hist.add(25600 - 1);
+	EXPECT_EQ(1u, hist.bins[center - 1]);
+
+	hist.resync(25600);
+	hist.add(25600 + 1);
+	EXPECT_EQ(1u, hist.bins[center]);
+
+	hist.resync(25600);
+	hist.add(25600 - 100);
+	EXPECT_EQ(2u, hist.bins[center - 1]);
+
+	hist.resync(25600);
+	hist.add(25600 - 101);
+	EXPECT_EQ(1u, hist.bins[center - 2]);
+
+	hist.resync(25600);
+	hist.add(25600);
+	EXPECT_EQ(2u, hist.bins[center]);
+	EXPECT_EQ(5u, hist.getCount());
+}
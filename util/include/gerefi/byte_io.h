@@ -0,0 +1,72 @@
+/**
+ * @file byte_io.h
+ *
+ * Byte order independent serialization: little endian integers and LEB128 varints.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+inline void putLe16(uint8_t* p, uint16_t value) {
+	p[0] = value;
+	p[1] = value >> 8;
+}
+
+inline void putLe32(uint8_t* p, uint32_t value) {
+	putLe16(p, value);
+	putLe16(p + 2, value >> 16);
+}
+
+inline void putLe64(uint8_t* p, uint64_t value) {
+	putLe32(p, value);
+	putLe32(p + 4, value >> 32);
+}
+
+inline uint16_t getLe16(const uint8_t* p) {
+	return p[0] | p[1] << 8;
+}
+
+inline uint32_t getLe32(const uint8_t* p) {
+	return getLe16(p) | static_cast<uint32_t>(getLe16(p + 2)) << 16;
+}
+
+inline uint64_t getLe64(const uint8_t* p) {
+	return getLe32(p) | static_cast<uint64_t>(getLe32(p + 4)) << 32;
+}
+
+// Largest encoded varint
+#define VARINT_MAX_SIZE 10
+
+// Returns pointer past the varint
+inline uint8_t* putVarint(uint8_t* p, uint64_t value) {
+	while (value >= 0x80) {
+		*p++ = value | 0x80;
+		value >>= 7;
+	}
+	*p++ = value;
+	return p;
+}
+
+// Returns pointer past the varint, nullptr if it runs past end or is too long
+inline const uint8_t* getVarint(const uint8_t* p, const uint8_t* end, uint64_t& value) {
+	value = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7) {
+		uint8_t b = *p++;
+		value |= static_cast<uint64_t>(b & 0x7F) << shift;
+		if (!(b & 0x80)) {
+			return p;
+		}
+	}
+	return nullptr;
+}
+
+// Signed values close to zero in few bytes
+inline uint64_t zigzagEncode(int64_t value) {
+	return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value) {
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
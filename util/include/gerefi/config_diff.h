@@ -0,0 +1,58 @@
+/**
+ * @file config_diff.h
+ *
+ * Changed byte ranges between two config images, and patches made of them:
+ * burn or send only what changed instead of the whole struct.
+ *
+ *   ConfigRange ranges[16];
+ *   size_t count = configDiff(&old, &current, sizeof(current), ranges, 16);
+ *   size_t size = configWritePatch(&current, ranges, count, buffer, sizeof(buffer));
+ *   ... other end:
+ *   configApplyPatch(&config, sizeof(config), buffer, size);
+ *
+ * Identical stretches are skipped 8 bytes at a time, 32 with AVX2 on hosts
+ * (see cpu_features.h).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+struct ConfigRange {
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct ConfigDiffOptions {
+	// unchanged bytes between two changes up to this many are included in one range,
+	// cheaper than another patch record header
+	uint32_t mergeGap = 8;
+	// range offsets and sizes are multiples of this, e.g. flash program unit; power of 2
+	uint32_t alignment = 1;
+};
+
+// Writes ranges that differ in offset order, returns their count.
+// If more than maxRanges are needed the last one grows to cover all remaining changes.
+size_t configDiff(const void* oldImage, const void* newImage, size_t size,
+		ConfigRange* ranges, size_t maxRanges, const ConfigDiffOptions& options = {});
+
+// Patch: records of little endian uint32 offset, uint32 size, then size bytes of data
+#define CONFIG_PATCH_HEADER_SIZE 8
+
+size_t configPatchSize(const ConfigRange* ranges, size_t count);
+
+// Patch with data of ranges from image, returns bytes written, 0 if it does not fit
+size_t configWritePatch(const void* image, const ConfigRange* ranges, size_t count,
+		uint8_t* patch, size_t patchSize);
+
+// Receives every record of a patch, e.g. to program flash; false aborts
+using ConfigPatchWriter = bool (*)(void* context, uint32_t offset, const uint8_t* data, uint32_t size);
+
+// Checks the whole patch against imageSize first, nothing is written if it is malformed.
+// false if malformed or writer failed.
+bool configApplyPatch(const uint8_t* patch, size_t patchSize, size_t imageSize,
+		ConfigPatchWriter writer, void* context);
+
+// Apply to a copy of the image in RAM
+bool configApplyPatch(void* image, size_t imageSize, const uint8_t* patch, size_t patchSize);
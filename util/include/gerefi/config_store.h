@@ -0,0 +1,133 @@
+/**
+ * @file config_store.h
+ *
+ * Log structured config storage on NOR flash.
+ *
+ * The flash area is a ring of sectors. Each sector starts with a header and a
+ * snapshot of the whole image, saves append records holding only the changed
+ * ranges (see config_diff.h). Every record ends with a crc32, so a write torn by
+ * power loss is simply not part of the log. When the active sector fills up,
+ * compaction writes a snapshot to the next sector of the ring: the old sector
+ * stays intact until then, and erases are spread over all sectors.
+ *
+ * Boot reads the sector headers and scans only the newest valid sector.
+ *
+ *   ConfigStore store(flash, &shadowCopy, sizeof(config));
+ *   if (!store.load(&config)) { ...defaults... }
+ *   ...
+ *   store.save(&config);
+ *   // low priority thread
+ *   if (store.needsCompaction()) store.compact();
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Largest flash program unit supported, e.g. STM32H7 flash word
+#define CONFIG_STORE_MAX_PROGRAM_UNIT 32
+// Changed ranges per record, more changes than that are merged into the last range
+#define CONFIG_STORE_MAX_RANGES 32
+
+// Flash area reserved for config, the consuming app implements it on top of its flash driver.
+// Addresses are relative to the start of the area.
+class ConfigFlash {
+public:
+	virtual bool read(uint32_t address, void* data, size_t size) = 0;
+	// NOR semantics: programming can only clear bits.
+	// address and size are multiples of getProgramUnit(), bytes are programmed in address order
+	virtual bool program(uint32_t address, const void* data, size_t size) = 0;
+	// Sets every byte of the sector to 0xFF
+	virtual bool erase(size_t sector) = 0;
+
+	virtual size_t getSectorSize() const = 0;
+	virtual size_t getSectorCount() const = 0;
+	virtual size_t getProgramUnit() const {
+		return 1;
+	}
+};
+
+struct ConfigStoreStats {
+	// records appended by save(), compactions not included
+	uint32_t records;
+	uint32_t compactions;
+	uint32_t erases;
+	// records at the end of the active sector that failed their crc during load()
+	uint32_t badRecords;
+
+	// image bytes changed by saves vs bytes programmed to flash, including headers and snapshots
+	uint64_t bytesChanged;
+	uint64_t bytesProgrammed;
+
+	float getWriteAmplification() const {
+		return bytesChanged ? static_cast<float>(bytesProgrammed) / bytesChanged : 0;
+	}
+};
+
+class ConfigStore {
+public:
+	// shadow: RAM copy of what is stored, imageSize bytes, used to find what changed.
+	// Every sector must hold at least two snapshots of the image.
+	ConfigStore(ConfigFlash& flash, void* shadow, size_t imageSize);
+
+	// Latest valid image to image, false if flash holds none: image is untouched,
+	// the first save() formats the area.
+	bool load(void* image);
+
+	// Append what changed since last load/save. Compacts first if the active sector
+	// has no room, which means an erase. false on flash error, stored image is unchanged.
+	bool save(const void* image);
+
+	// Active sector is running out of room, or has garbage after a torn write
+	bool needsCompaction() const;
+	// Snapshot to the next sector of the ring
+	bool compact();
+
+	const ConfigStoreStats& getStats() const {
+		return m_stats;
+	}
+
+	void resetStats() {
+		m_stats = {};
+	}
+
+	// -1 if nothing was loaded or saved yet
+	int getActiveSector() const {
+		return m_active;
+	}
+
+	uint32_t getGeneration() const {
+		return m_generation;
+	}
+
+	// Room left in active sector
+	size_t getFreeBytes() const;
+
+private:
+	bool isGeometryValid() const;
+	size_t alignUp(size_t size) const;
+	// flash bytes taken by a record with payload bytes
+	size_t recordSize(size_t payload) const;
+
+	bool readSector(size_t sector, uint32_t& generation);
+	bool scanSector(size_t sector);
+	bool checkRecord(uint32_t address, uint32_t end, uint8_t& type, uint32_t& length);
+	bool applyRecord(uint32_t address, uint8_t type, uint32_t length);
+
+	// Snapshot of image to the next sector
+	bool compactFrom(const void* image);
+
+	ConfigFlash& m_flash;
+	uint8_t* const m_shadow;
+	const size_t m_size;
+
+	int m_active = -1;
+	uint32_t m_generation = 0;
+	// next record goes here, absolute address
+	uint32_t m_writeAddress = 0;
+	// active sector has garbage after the last record
+	bool m_dirty = false;
+
+	ConfigStoreStats m_stats = {};
+};
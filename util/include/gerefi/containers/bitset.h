@@ -0,0 +1,115 @@
+/**
+ * @file	bitset.h
+ * @brief	Fixed size bit set with find-first-set iteration
+ *
+ * for (size_t fault : activeFaults) { ... }
+ * visits set bits only, a word of zeros costs one compare.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+template<size_t N>
+class bitset {
+public:
+	static_assert(N > 0);
+
+	static constexpr size_t words = (N + 31) / 32;
+
+	constexpr bitset() = default;
+
+	static constexpr size_t size() { return N; }
+
+	constexpr void set(size_t index, bool value = true) {
+		if (value) {
+			m_words[index / 32] |= 1u << (index % 32);
+		} else {
+			reset(index);
+		}
+	}
+
+	constexpr void reset(size_t index) {
+		m_words[index / 32] &= ~(1u << (index % 32));
+	}
+
+	constexpr void reset() {
+		for (auto& word : m_words) {
+			word = 0;
+		}
+	}
+
+	constexpr bool test(size_t index) const {
+		return m_words[index / 32] & (1u << (index % 32));
+	}
+
+	constexpr size_t count() const {
+		size_t bits = 0;
+		for (auto word : m_words) {
+			bits += __builtin_popcount(word);
+		}
+		return bits;
+	}
+
+	constexpr bool any() const {
+		for (auto word : m_words) {
+			if (word) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	constexpr bool none() const { return !any(); }
+
+	// First set bit at or after index, N if none
+	constexpr size_t findNext(size_t index) const {
+		if (index >= N) {
+			return N;
+		}
+
+		size_t w = index / 32;
+		// bits below index cleared
+		uint32_t word = m_words[w] & (~0u << (index % 32));
+		while (true) {
+			if (word) {
+				size_t found = w * 32 + __builtin_ctz(word);
+				return found < N ? found : N;
+			}
+			if (++w == words) {
+				return N;
+			}
+			word = m_words[w];
+		}
+	}
+
+	constexpr size_t findFirst() const {
+		return findNext(0);
+	}
+
+	class iterator {
+	public:
+		constexpr iterator(const bitset& owner, size_t index) : m_owner(owner), m_index(index) { }
+
+		constexpr size_t operator*() const { return m_index; }
+
+		constexpr iterator& operator++() {
+			m_index = m_owner.findNext(m_index + 1);
+			return *this;
+		}
+
+		constexpr bool operator!=(const iterator& other) const { return m_index != other.m_index; }
+
+	private:
+		const bitset& m_owner;
+		size_t m_index;
+	};
+
+	// iterates indices of set bits
+	constexpr iterator begin() const { return iterator(*this, findFirst()); }
+	constexpr iterator end() const { return iterator(*this, N); }
+
+private:
+	uint32_t m_words[words] = {};
+};
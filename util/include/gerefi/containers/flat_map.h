@@ -0,0 +1,111 @@
+/**
+ * @file	flat_map.h
+ * @brief	Sorted map with fixed capacity and inline storage, no heap
+ *
+ * Keys are kept sorted in their own array and found with branchless binary search:
+ * log2(N) compares with no unpredictable branches. Insert and erase move the tail.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+template<typename K, typename V, size_t N>
+class flat_map {
+public:
+	static_assert(N > 0);
+
+	constexpr flat_map() = default;
+
+	constexpr size_t size() const { return m_size; }
+	static constexpr size_t capacity() { return N; }
+	constexpr bool empty() const { return m_size == 0; }
+	constexpr bool full() const { return m_size == N; }
+
+	// Entries in key order
+	constexpr const K& keyAt(size_t index) const { return m_keys[index]; }
+	constexpr V& valueAt(size_t index) { return m_values[index]; }
+	constexpr const V& valueAt(size_t index) const { return m_values[index]; }
+
+	// Index of first key not less than key, size() if none
+	constexpr size_t lower_bound(const K& key) const {
+		if (m_size == 0) {
+			return 0;
+		}
+
+		size_t base = 0;
+		size_t n = m_size;
+		while (n > 1) {
+			size_t half = n / 2;
+			base = (m_keys[base + half] < key) ? base + half : base;
+			n -= half;
+		}
+		return base + (m_keys[base] < key);
+	}
+
+	// nullptr if key is not there
+	constexpr V* find(const K& key) {
+		size_t index = lower_bound(key);
+		return index < m_size && !(key < m_keys[index]) ? &m_values[index] : nullptr;
+	}
+
+	constexpr const V* find(const K& key) const {
+		return const_cast<flat_map*>(this)->find(key);
+	}
+
+	constexpr bool contains(const K& key) const {
+		return find(key) != nullptr;
+	}
+
+	// false if key is new and map is full
+	constexpr bool insert_or_assign(const K& key, const V& value) {
+		size_t index = lower_bound(key);
+		if (index < m_size && !(key < m_keys[index])) {
+			m_values[index] = value;
+			return true;
+		}
+
+		if (full()) {
+			return false;
+		}
+
+		for (size_t i = m_size; i > index; i--) {
+			m_keys[i] = m_keys[i - 1];
+			m_values[i] = m_values[i - 1];
+		}
+		m_keys[index] = key;
+		m_values[index] = value;
+		m_size++;
+		return true;
+	}
+
+	// false if key was not there
+	constexpr bool erase(const K& key) {
+		size_t index = lower_bound(key);
+		if (index == m_size || key < m_keys[index]) {
+			return false;
+		}
+
+		for (size_t i = index; i + 1 < m_size; i++) {
+			m_keys[i] = m_keys[i + 1];
+			m_values[i] = m_values[i + 1];
+		}
+		m_size--;
+		m_keys[m_size] = K{};
+		m_values[m_size] = V{};
+		return true;
+	}
+
+	constexpr void clear() {
+		while (m_size) {
+			m_size--;
+			m_keys[m_size] = K{};
+			m_values[m_size] = V{};
+		}
+	}
+
+private:
+	K m_keys[N] = {};
+	V m_values[N] = {};
+	size_t m_size = 0;
+};
@@ -0,0 +1,121 @@
+/**
+ * @file	object_pool.h
+ * @brief	Fixed size pool of T with a lock-free free list
+ *
+ * allocate() and free() are O(1) and safe from any thread or ISR: a free list
+ * head update is a single compare-and-swap, so an interrupted update is simply
+ * retried (on Cortex-M exception entry clears the exclusive monitor).
+ * The head carries a tag incremented on every change, so a head that was popped
+ * and pushed back in between (ABA) does not match anymore.
+ *
+ * Objects are constructed in allocate() and destroyed in free().
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+template<typename T, size_t N>
+class object_pool {
+public:
+	static_assert(N > 0 && N < 0xFFFF, "index has to fit 16 bits with one value left for empty");
+
+	object_pool() {
+		for (size_t i = 0; i < N; i++) {
+			m_next[i].store(i + 1 < N ? i + 1 : empty, std::memory_order_relaxed);
+		}
+		m_head.store(0, std::memory_order_relaxed);
+	}
+
+	object_pool(const object_pool&) = delete;
+	object_pool& operator=(const object_pool&) = delete;
+
+	// nullptr if all objects are in use
+	template<typename... Args>
+	T* allocate(Args&&... args) {
+		uint32_t head = m_head.load(std::memory_order_acquire);
+		uint16_t index;
+
+		while (true) {
+			index = head & 0xFFFF;
+			if (index == empty) {
+				m_failed.fetch_add(1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			// stale if someone else took index meanwhile, CAS then fails on the tag
+			uint16_t next = m_next[index].load(std::memory_order_relaxed);
+			if (m_head.compare_exchange_weak(head, retag(head, next),
+					std::memory_order_acquire, std::memory_order_acquire)) {
+				break;
+			}
+		}
+
+		uint32_t used = m_used.fetch_add(1, std::memory_order_relaxed) + 1;
+		uint32_t high = m_highWater.load(std::memory_order_relaxed);
+		while (used > high && !m_highWater.compare_exchange_weak(high, used, std::memory_order_relaxed)) {
+		}
+
+		return new (&m_slots[index]) T(std::forward<Args>(args)...);
+	}
+
+	// object must come from allocate() of this pool, nullptr is ignored
+	void free(T* object) {
+		if (!object) {
+			return;
+		}
+
+		object->~T();
+		uint16_t index = reinterpret_cast<Slot*>(object) - m_slots;
+
+		uint32_t head = m_head.load(std::memory_order_relaxed);
+		do {
+			m_next[index].store(head & 0xFFFF, std::memory_order_relaxed);
+		} while (!m_head.compare_exchange_weak(head, retag(head, index),
+				std::memory_order_release, std::memory_order_relaxed));
+
+		m_used.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	bool owns(const T* object) const {
+		auto slot = reinterpret_cast<const Slot*>(object);
+		return slot >= m_slots && slot < m_slots + N;
+	}
+
+	static constexpr size_t capacity() { return N; }
+
+	size_t used() const { return m_used.load(std::memory_order_relaxed); }
+	// most objects in use at the same time since construction / resetStats
+	size_t highWater() const { return m_highWater.load(std::memory_order_relaxed); }
+	// allocate() calls that found the pool empty
+	uint32_t failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+	void resetStats() {
+		m_highWater.store(used(), std::memory_order_relaxed);
+		m_failed.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	static constexpr uint16_t empty = 0xFFFF;
+
+	// head: tag << 16 | index of first free slot
+	static uint32_t retag(uint32_t head, uint16_t index) {
+		return (((head >> 16) + 1) << 16) | index;
+	}
+
+	struct Slot {
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	Slot m_slots[N];
+	std::atomic<uint16_t> m_next[N];
+	std::atomic<uint32_t> m_head;
+
+	std::atomic<uint32_t> m_used{0};
+	std::atomic<uint32_t> m_highWater{0};
+	std::atomic<uint32_t> m_failed{0};
+};
@@ -0,0 +1,100 @@
+/**
+ * @file	static_vector.h
+ * @brief	Vector with fixed capacity and inline storage, no heap
+ *
+ * Full vector is not an error: push_back/insert return false and leave it unchanged.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+template<typename T, size_t N>
+class static_vector {
+public:
+	static_assert(N > 0);
+
+	using value_type = T;
+	using iterator = T*;
+	using const_iterator = const T*;
+
+	constexpr static_vector() = default;
+
+	constexpr size_t size() const { return m_size; }
+	static constexpr size_t capacity() { return N; }
+	constexpr bool empty() const { return m_size == 0; }
+	constexpr bool full() const { return m_size == N; }
+
+	constexpr T* data() { return m_data; }
+	constexpr const T* data() const { return m_data; }
+
+	constexpr iterator begin() { return m_data; }
+	constexpr iterator end() { return m_data + m_size; }
+	constexpr const_iterator begin() const { return m_data; }
+	constexpr const_iterator end() const { return m_data + m_size; }
+
+	constexpr T& operator[](size_t index) { return m_data[index]; }
+	constexpr const T& operator[](size_t index) const { return m_data[index]; }
+
+	constexpr T& front() { return m_data[0]; }
+	constexpr const T& front() const { return m_data[0]; }
+	constexpr T& back() { return m_data[m_size - 1]; }
+	constexpr const T& back() const { return m_data[m_size - 1]; }
+
+	constexpr bool push_back(const T& value) {
+		if (full()) {
+			return false;
+		}
+		m_data[m_size++] = value;
+		return true;
+	}
+
+	constexpr void pop_back() {
+		if (m_size) {
+			m_size--;
+			m_data[m_size] = T{};
+		}
+	}
+
+	// Insert before position, later elements move up
+	constexpr bool insert(const_iterator position, const T& value) {
+		if (full()) {
+			return false;
+		}
+
+		size_t index = position - m_data;
+		for (size_t i = m_size; i > index; i--) {
+			m_data[i] = m_data[i - 1];
+		}
+		m_data[index] = value;
+		m_size++;
+		return true;
+	}
+
+	// Keeps order, returns iterator to the element that took its place
+	constexpr iterator erase(const_iterator position) {
+		size_t index = position - m_data;
+		for (size_t i = index; i + 1 < m_size; i++) {
+			m_data[i] = m_data[i + 1];
+		}
+		pop_back();
+		return m_data + index;
+	}
+
+	// O(1): last element takes its place
+	constexpr void erase_unordered(const_iterator position) {
+		size_t index = position - m_data;
+		m_data[index] = m_data[m_size - 1];
+		pop_back();
+	}
+
+	constexpr void clear() {
+		while (m_size) {
+			pop_back();
+		}
+	}
+
+private:
+	T m_data[N] = {};
+	size_t m_size = 0;
+};
@@ -0,0 +1,143 @@
+/**
+ * @file cpu_features.h
+ *
+ * Runtime CPU feature dispatch for kernels with SIMD variants (host builds):
+ * features are detected once, each kernel binds the best variant the CPU has to a
+ * function pointer at startup.
+ *
+ * static constexpr CpuVariant<MyFn> myVariants[] = {
+ *     { "avx2", cpuFeatureMask(CpuFeature::Avx2), myAvx2 },
+ *     { "scalar", 0, myScalar },
+ * };
+ * static constinit CpuKernel myKernel("my", myVariants);
+ * static CpuKernelRegistration myRegistration(myKernel);
+ * ... myKernel.get()(args);
+ *
+ * The kernel is constant initialized to its plain C++ variant, so static constructors
+ * of other files can call it; the registration moves it to the best variant.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Hosts with optional instruction sets pick variants at runtime. Everything else
+// (firmware) has the plain C++ variants only and should call them directly.
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#define EFI_CPU_DISPATCH 1
+#else
+#define EFI_CPU_DISPATCH 0
+#endif
+
+// Most kernels registered at the same time
+#define CPU_MAX_KERNELS 16
+
+enum class CpuFeature : uint8_t
+{
+	Sse41 = 0,
+	Sse42,
+	Pclmul,
+	Avx2,
+	Avx512f,
+	Neon,
+	ArmCrc32,
+};
+
+#define CPU_FEATURE_COUNT 7
+
+constexpr uint32_t cpuFeatureMask(CpuFeature feature) {
+	return 1u << static_cast<uint8_t>(feature);
+}
+
+// Mask of CpuFeature detected on first call, nothing while forced scalar
+uint32_t cpuGetFeatures();
+bool cpuHasFeature(CpuFeature feature);
+const char* cpuFeatureName(CpuFeature feature);
+
+// Bind plain C++ variants of every kernel, e.g. for tests comparing variants.
+// GEREFI_CPU_SCALAR=1 in the environment does the same from startup.
+// Other threads may call kernels meanwhile, each call runs the old or the new variant.
+void cpuForceScalar(bool force);
+bool cpuIsForcedScalar();
+
+class CpuKernelBase {
+public:
+	const char* getName() const {
+		return m_name;
+	}
+
+	// Name of variant in use
+	const char* getVariant() const {
+		return m_variant.load(std::memory_order_relaxed);
+	}
+
+protected:
+	constexpr CpuKernelBase(const char* name, const char* variant)
+		: m_name(name)
+		, m_variant(variant)
+	{
+	}
+
+	// pick variant for cpuGetFeatures()
+	virtual void bind() = 0;
+	friend void cpuForceScalar(bool force);
+	friend class CpuKernelRegistration;
+
+	const char* const m_name;
+	std::atomic<const char*> m_variant;
+};
+
+// Binds kernel to the best variant during static initialization and lists it for cpuGetKernel()
+class CpuKernelRegistration {
+public:
+	explicit CpuKernelRegistration(CpuKernelBase& kernel);
+};
+
+// Registered kernels, for reporting which variant each one uses
+size_t cpuGetKernelCount();
+const CpuKernelBase& cpuGetKernel(size_t index);
+
+template <typename TFunction>
+struct CpuVariant {
+	const char* name;
+	// cpuFeatureMask() of everything the variant needs
+	uint32_t features;
+	TFunction function;
+};
+
+// Variants best first, the last one has to be plain C++ with no features
+template <typename TFunction, size_t TCount>
+class CpuKernel : public CpuKernelBase {
+public:
+	constexpr CpuKernel(const char* name, const CpuVariant<TFunction> (&variants)[TCount])
+		: CpuKernelBase(name, variants[TCount - 1].name)
+		, m_variants(variants)
+		, m_function(variants[TCount - 1].function)
+	{
+		static_assert(TCount >= 1);
+	}
+
+	TFunction get() const {
+		return m_function.load(std::memory_order_relaxed);
+	}
+
+protected:
+	void bind() override {
+		uint32_t features = cpuGetFeatures();
+
+		for (size_t i = 0; i < TCount; i++) {
+			const auto& variant = m_variants[i];
+			if ((variant.features & features) == variant.features || i == TCount - 1) {
+				m_function.store(variant.function, std::memory_order_relaxed);
+				m_variant.store(variant.name, std::memory_order_relaxed);
+				return;
+			}
+		}
+	}
+
+private:
+	const CpuVariant<TFunction>* const m_variants;
+	std::atomic<TFunction> m_function;
+};
@@ -0,0 +1,75 @@
+/**
+ * @file flash_emulator.h
+ *
+ * NOR flash for host tests, tools and benchmarks, optionally backed by a file so
+ * contents survive like real flash across runs.
+ *
+ * Programming only clears bits; setting a bit without an erase fails like on the MCU.
+ * injectPowerLoss() cuts power in the middle of a program or erase: the last byte
+ * is left half programmed, an erase stops part way through the sector.
+ */
+
+#pragma once
+
+#include <gerefi/config_store.h>
+
+#include <cstdio>
+#include <vector>
+
+class FlashEmulator : public ConfigFlash {
+public:
+	// path: backing file, reused if it has the right size; nullptr for RAM only
+	FlashEmulator(const char* path, size_t sectorSize, size_t sectorCount, size_t programUnit = 1);
+	~FlashEmulator();
+
+	bool read(uint32_t address, void* data, size_t size) override;
+	bool program(uint32_t address, const void* data, size_t size) override;
+	bool erase(size_t sector) override;
+
+	size_t getSectorSize() const override {
+		return m_sectorSize;
+	}
+
+	size_t getSectorCount() const override {
+		return m_sectorCount;
+	}
+
+	size_t getProgramUnit() const override {
+		return m_programUnit;
+	}
+
+	// Power fails once this many more bytes are programmed or erased.
+	// Every operation fails after that until powerCycle().
+	void injectPowerLoss(uint32_t bytes);
+	void powerCycle();
+
+	bool isPowerLost() const {
+		return m_powerLost;
+	}
+
+	uint32_t getEraseCount(size_t sector) const {
+		return m_eraseCounts[sector];
+	}
+
+	// Raw contents, e.g. to flip bits
+	uint8_t* getData() {
+		return m_data.data();
+	}
+
+private:
+	// false when power runs out with this byte
+	bool consumePower();
+	void persist(uint32_t address, size_t size);
+
+	const size_t m_sectorSize;
+	const size_t m_sectorCount;
+	const size_t m_programUnit;
+
+	std::vector<uint8_t> m_data;
+	std::vector<uint32_t> m_eraseCounts;
+	FILE* m_file = nullptr;
+
+	bool m_powerLossArmed = false;
+	uint32_t m_powerLeft = 0;
+	bool m_powerLost = false;
+};
@@ -0,0 +1,109 @@
+/**
+ * @file log_codec.h
+ *
+ * Compact encoding of fixed size log records, e.g. output channels copied with copyRange().
+ * Cheap enough to run inline with the sampling task; log_decoder.h reads it back on the host.
+ *
+ * Records are grouped in blocks that decode on their own: the first record of a block
+ * is encoded against zeros, every other one against the record before it.
+ *
+ * block: header (LOG_BLOCK_HEADER_SIZE, little endian), payload
+ *   header: magic, flags, record count, record size, payload size, raw size,
+ *           first and last timestamp, crc32 of header before it and payload
+ *   payload: records, LZ compressed if LOG_FLAG_LZ, raw size before that
+ *
+ * record: zigzag varint timestamp delta (first record: against first timestamp),
+ *         varint count of changed 8 byte groups,
+ *         changed groups as varint index gaps if that is shorter than a bitmap, bitmap otherwise,
+ *         for each changed group a mask of changed bytes, then those bytes
+ *         XORed with (or minus, LOG_FLAG_DELTA) the previous record
+ *
+ * LZ: sequences of token (literal count << 4 | match length - 4), varint extensions
+ *     when a nibble is 15, literals, 16 bit match offset; the last sequence has no match.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define LOG_BLOCK_MAGIC 0x474F4C47
+#define LOG_BLOCK_HEADER_SIZE 40
+
+// Changed bytes are stored as difference instead of XOR, better for counters and slow ramps
+#define LOG_FLAG_DELTA (1 << 0)
+// Block payload is LZ compressed
+#define LOG_FLAG_LZ (1 << 1)
+
+// Largest record and block the encoder takes
+#define LOG_MAX_RECORD_SIZE 4096
+#define LOG_MAX_BLOCK_SIZE 65536
+
+#define LOG_LZ_MIN_MATCH 4
+#define LOG_LZ_HASH_BITS 10
+
+// Largest encoded size of one record
+constexpr size_t logMaxRecordSize(size_t recordSize) {
+	size_t groups = (recordSize + 7) / 8;
+	// timestamp, group count, group bitmap or up to two byte index gaps, masks and bytes
+	return 10 + 5 + 2 * ((groups + 7) / 8) + groups + recordSize;
+}
+
+// Receives each finished block, header included; false stops encoding
+using LogBlockWriter = bool (*)(void* context, const uint8_t* data, size_t size);
+
+struct LogEncoderStats {
+	uint32_t records;
+	uint32_t blocks;
+	// bytes given to add() vs bytes of blocks written
+	uint64_t rawBytes;
+	uint64_t encodedBytes;
+
+	float getRatio() const {
+		return rawBytes ? static_cast<float>(encodedBytes) / rawBytes : 0;
+	}
+};
+
+class LogEncoder {
+public:
+	// previous: recordSize bytes.
+	// block: working buffer, blocks are at most this big; must hold header and one record.
+	// The encoder does nothing if sizes are out of range.
+	// lzBuffer: blockSize bytes to compress blocks, nullptr to store them as they are.
+	LogEncoder(size_t recordSize, uint8_t* previous, uint8_t* block, size_t blockSize,
+			uint8_t* lzBuffer, LogBlockWriter writer, void* context, uint8_t flags = 0);
+
+	// Encode one record, writes the block when it is full. false if the writer failed.
+	bool add(uint64_t timestamp, const uint8_t* record);
+	// Write the partial block, e.g. before closing the log
+	bool flush();
+
+	const LogEncoderStats& getStats() const {
+		return m_stats;
+	}
+
+private:
+	size_t encodeRecord(uint64_t timestamp, const uint8_t* record, uint8_t* out);
+	size_t compress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize);
+
+	const size_t m_recordSize;
+	uint8_t* const m_previous;
+	uint8_t* const m_block;
+	const size_t m_blockSize;
+	uint8_t* const m_lzBuffer;
+	const LogBlockWriter m_writer;
+	void* const m_context;
+	const uint8_t m_flags;
+	const bool m_valid;
+
+	// encoded records in m_block after the header
+	size_t m_used = 0;
+	uint16_t m_count = 0;
+	uint64_t m_firstTimestamp = 0;
+	uint64_t m_lastTimestamp = 0;
+
+	// LZ match finder, positions in block payload
+	uint16_t m_hash[1 << LOG_LZ_HASH_BITS];
+
+	LogEncoderStats m_stats = {};
+};
@@ -0,0 +1,40 @@
+/**
+ * @file log_decoder.h
+ *
+ * Host side reader of blocks written by LogEncoder, see log_codec.h
+ */
+
+#pragma once
+
+#include <gerefi/log_codec.h>
+
+#include <vector>
+
+struct LogBlockInfo {
+	uint8_t flags;
+	uint16_t recordCount;
+	uint32_t recordSize;
+	// stored payload, and before LZ
+	uint32_t payloadSize;
+	uint32_t rawSize;
+	uint64_t firstTimestamp;
+	uint64_t lastTimestamp;
+
+	// header and payload
+	size_t getSize() const {
+		return LOG_BLOCK_HEADER_SIZE + payloadSize;
+	}
+};
+
+// Header of block at data, false if there is none. Does not check the crc.
+bool logReadBlockHeader(const uint8_t* data, size_t size, LogBlockInfo& info);
+
+// Header is valid and block fits size and passes its crc
+bool logCheckBlock(const uint8_t* data, size_t size);
+
+// Decode every record of block: record i at records[i * recordSize], time timestamps[i].
+// Vectors are resized, their capacity is reused. false if block is corrupt.
+bool logDecodeBlock(const uint8_t* data, size_t size, std::vector<uint8_t>& records, std::vector<uint64_t>& timestamps);
+
+// false if input is malformed or does not produce exactly outSize bytes
+bool logLzDecompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize);
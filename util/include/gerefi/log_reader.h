@@ -0,0 +1,139 @@
+/**
+ * @file log_reader.h
+ *
+ * Host side reader of logs made of LogEncoder blocks (log_codec.h).
+ *
+ * open() maps the file and walks only the block headers to build a sparse index:
+ * one entry per block with its time span and first record number. Blocks are
+ * decoded on worker threads straight into columns, one array per channel.
+ *
+ *   LogReader reader;
+ *   reader.open("log.bin");
+ *   size_t first = reader.findBlock(startTime);
+ *   LogColumns columns;
+ *   reader.readColumns(first, reader.getBlockCount() - first, channels, 3, columns);
+ */
+
+#pragma once
+
+#include <gerefi/log_decoder.h>
+#include <gerefi/timeline_merge.h>
+
+#include <cstdint>
+#include <vector>
+
+struct LogIndexEntry {
+	uint64_t offset;
+	uint64_t firstTimestamp;
+	uint64_t lastTimestamp;
+	// number of first record in the whole log
+	uint64_t firstRecord;
+	uint32_t recordCount;
+};
+
+enum class LogChannelType : uint8_t
+{
+	U8,
+	I8,
+	U16,
+	I16,
+	U32,
+	I32,
+	F32,
+};
+
+// Field of the record to extract, value is raw * scale
+struct LogChannel {
+	uint32_t offset;
+	LogChannelType type;
+	float scale;
+};
+
+struct LogColumns {
+	std::vector<uint64_t> timestamps;
+	// one column per channel, same length as timestamps
+	std::vector<std::vector<float>> values;
+};
+
+class LogReader {
+public:
+	LogReader() = default;
+	LogReader(const LogReader&) = delete;
+	LogReader& operator=(const LogReader&) = delete;
+	~LogReader();
+
+	// Map file and index it, false if it can not be read or holds no blocks
+	bool open(const char* path);
+	// Index a log already in memory, data must outlive the reader
+	bool open(const uint8_t* data, size_t size);
+	void close();
+
+	size_t getBlockCount() const {
+		return m_index.size();
+	}
+
+	const LogIndexEntry& getBlock(size_t block) const {
+		return m_index[block];
+	}
+
+	uint64_t getRecordCount() const;
+
+	uint32_t getRecordSize() const {
+		return m_recordSize;
+	}
+
+	// Bytes skipped while indexing: damaged headers, blocks of another record size
+	uint64_t getSkippedBytes() const {
+		return m_skippedBytes;
+	}
+
+	// First block that ends at or after timestamp, getBlockCount() if none. O(log n).
+	size_t findBlock(uint64_t timestamp) const;
+
+	// Number of first record at or after timestamp, getRecordCount() if none.
+	// Decodes one block.
+	uint64_t seek(uint64_t timestamp) const;
+
+	// Decode blocks into columns, using threads workers, 0 for one per CPU.
+	// Blocks that fail their crc are left out. Returns number of such blocks.
+	size_t readColumns(size_t firstBlock, size_t blockCount, const LogChannel* channels, size_t channelCount,
+			LogColumns& columns, size_t threads = 0) const;
+
+	// Decode one block, false if it is corrupt
+	bool readBlock(size_t block, std::vector<uint8_t>& records, std::vector<uint64_t>& timestamps) const;
+
+private:
+	bool buildIndex();
+
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+
+	// mapped file, or copy of it where mmap is not available
+	void* m_mapping = nullptr;
+	std::vector<uint8_t> m_copy;
+
+	std::vector<LogIndexEntry> m_index;
+	uint32_t m_recordSize = 0;
+	uint64_t m_skippedBytes = 0;
+};
+
+// Records of a log one by one as a TimelineMerge source, decoding one block at a time.
+// Corrupt blocks are skipped. Event data is the record, timestamp as logged.
+class LogReaderSource : public TimelineSource {
+public:
+	explicit LogReaderSource(const LogReader& reader, size_t firstBlock = 0)
+		: m_reader(reader)
+		, m_block(firstBlock)
+	{
+	}
+
+	bool next(TimelineSourceEvent& event) override;
+
+private:
+	const LogReader& m_reader;
+	size_t m_block;
+	size_t m_record = 0;
+
+	std::vector<uint8_t> m_records;
+	std::vector<uint64_t> m_timestamps;
+};
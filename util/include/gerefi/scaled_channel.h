@@ -62,6 +62,11 @@ public:
 		m_value++;
 	}
 
+	// Stored integer, for conversions that must not go through float
+	constexpr T getRaw() const {
+		return m_value;
+	}
+
 	constexpr const char* getFirstByteAddr() const {
 		return &m_firstByte;
 	}
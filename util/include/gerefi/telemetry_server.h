@@ -0,0 +1,193 @@
+/**
+ * @file telemetry_server.h
+ *
+ * Live output channels of the firmware running as a Linux simulator, for dashboards.
+ *
+ * Datagrams over a Unix socket or UDP. Clients ask for one range of the FragmentList
+ * or subscribe to periodic snapshots of it. Replies are gathered straight from the
+ * live structs with iovecs, no copy, and sent in batches with sendmmsg.
+ * Ranges longer than one datagram are split, every part carries its offset.
+ * A subscriber whose client is gone, or whose messages keep failing, is dropped.
+ *
+ *   TelemetryServer server(fragments);
+ *   server.listenUnix("/tmp/gerefi_telemetry");
+ *   while (simulating) {
+ *       ...
+ *       server.poll();
+ *   }
+ *
+ * All fields are in host byte order: clients run on the same machine.
+ */
+
+#pragma once
+
+#include <gerefi/fragments.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+
+#include <sys/socket.h>
+
+#define TELEMETRY_MAGIC 0x4D4C4554
+#define TELEMETRY_MAX_SUBSCRIBERS 16u
+// messages per sendmmsg/recvmmsg
+#define TELEMETRY_BATCH 32u
+// iovecs per message: header and fragments
+#define TELEMETRY_MAX_IOV 16
+// payload bytes per message, keeps UDP on loopback without fragmentation issues
+#define TELEMETRY_MAX_PAYLOAD 8192
+// failed messages in a row (receive buffer full) before a subscriber is dropped
+#define TELEMETRY_MAX_SEND_ERRORS 100u
+
+enum class TelemetryOp : uint8_t
+{
+	// one range: offset, size
+	Read = 1,
+	// snapshots of range every periodUs, replaces earlier subscription of the client to same offset
+	Subscribe,
+	// stop all subscriptions of the client
+	Unsubscribe,
+	// server to client: size bytes of range at offset follow
+	Data,
+};
+
+// Data: last message of a range or snapshot
+#define TELEMETRY_FLAG_LAST 1
+
+struct TelemetryHeader {
+	uint32_t magic;
+	uint8_t op;
+	uint8_t flags;
+	uint16_t reserved;
+	// Read: chosen by client and echoed; Data of a subscription: snapshot counter
+	uint32_t sequence;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t periodUs;
+	// Data: time the snapshot was sent, see telemetryNowUs()
+	uint64_t timeUs;
+};
+
+static_assert(sizeof(TelemetryHeader) == 32);
+
+// CLOCK_MONOTONIC in microseconds, server and clients on one machine agree on it
+uint64_t telemetryNowUs();
+
+struct TelemetryServerStats {
+	uint32_t requests;
+	uint32_t badRequests;
+	uint32_t snapshots;
+	// datagrams and sendmmsg calls
+	uint32_t messages;
+	uint32_t batches;
+	// dropped: socket buffer full or client gone
+	uint32_t sendErrors;
+	// subscribers dropped because of send errors
+	uint32_t expired;
+};
+
+class TelemetryServer {
+public:
+	explicit TelemetryServer(FragmentList fragments);
+	~TelemetryServer();
+
+	TelemetryServer(const TelemetryServer&) = delete;
+	TelemetryServer& operator=(const TelemetryServer&) = delete;
+
+	// Datagram socket at path, an old socket file there is removed
+	bool listenUnix(const char* path);
+	// port 0 picks a free one, see getPort()
+	bool listenUdp(uint16_t port, const char* address = "127.0.0.1");
+	void close();
+
+	// For poll()/epoll of the simulator loop
+	int getFd() const {
+		return m_fd;
+	}
+
+	uint16_t getPort() const;
+
+	// Answer requests and send snapshots that are due. Never blocks.
+	void poll(uint64_t nowUs = telemetryNowUs());
+
+	size_t getSubscriberCount() const;
+
+	const TelemetryServerStats& getStats() const {
+		return m_stats;
+	}
+
+private:
+	struct Subscriber {
+		bool active;
+		sockaddr_storage address;
+		socklen_t addressLength;
+		uint32_t offset;
+		uint32_t size;
+		uint32_t periodUs;
+		uint64_t nextUs;
+		uint32_t sequence;
+		// failed messages in a row
+		uint32_t sendErrors;
+	};
+
+	struct Outgoing {
+		TelemetryHeader header;
+		sockaddr_storage address;
+		iovec iov[TELEMETRY_MAX_IOV];
+		// index in m_subscribers, -1 for a Read reply
+		int subscriber;
+	};
+
+	void receive(uint64_t nowUs);
+	void handle(const TelemetryHeader& request, const sockaddr_storage& address, socklen_t addressLength, uint64_t nowUs);
+	// Messages with range gathered from fragments
+	void queueRange(const sockaddr_storage& address, socklen_t addressLength, uint32_t sequence,
+			uint32_t offset, uint32_t size, uint64_t nowUs, int subscriber = -1);
+	void flush();
+	void sendFailed(const Outgoing& out, int error);
+
+	const FragmentList m_fragments;
+	const size_t m_totalSize;
+
+	int m_fd = -1;
+	char m_unixPath[108] = {};
+
+	Subscriber m_subscribers[TELEMETRY_MAX_SUBSCRIBERS] = {};
+
+	Outgoing m_out[TELEMETRY_BATCH];
+	mmsghdr m_messages[TELEMETRY_BATCH];
+	size_t m_queued = 0;
+
+	TelemetryServerStats m_stats = {};
+};
+
+// Dashboard side, also used by tests and the load generator
+class TelemetryClient {
+public:
+	~TelemetryClient();
+
+	bool connectUnix(const char* path);
+	bool connectUdp(const char* address, uint16_t port);
+	void close();
+
+	int getFd() const {
+		return m_fd;
+	}
+
+	bool read(uint32_t sequence, uint32_t offset, uint32_t size);
+	bool subscribe(uint32_t offset, uint32_t size, uint32_t periodUs);
+	bool unsubscribe();
+
+	// Next Data message, waits up to timeoutMs (0: do not wait).
+	// Up to payloadSize bytes of its payload are copied to payload.
+	bool receive(TelemetryHeader& header, uint8_t* payload, size_t payloadSize, int timeoutMs);
+
+private:
+	bool request(TelemetryOp op, uint32_t sequence, uint32_t offset, uint32_t size, uint32_t periodUs);
+
+	int m_fd = -1;
+};
+
+#endif // __linux__
@@ -0,0 +1,134 @@
+/**
+ * @file timeline_merge.h
+ *
+ * Merge of separately logged, time ordered event streams (SENT frames, CAN traffic,
+ * PT2001 diagnostics, output channel samples) into one timeline.
+ *
+ * Streams are pulled one event at a time through a binary heap of their heads:
+ * memory does not depend on log size, O(log n) per event for n streams.
+ * 32 bit tick stamps are unwrapped per stream: the first stamp is taken as is, every
+ * later one as the signed 32 bit step from the one before, so consecutive events of
+ * a stream must be less than 2^31 ticks apart.
+ *
+ *   TimelineMerge merge;
+ *   merge.addSource(sent, TimelineClock::Wrapped32);
+ *   merge.addSource(outputs, TimelineClock::Ticks64);
+ *   TimelineEvent event;
+ *   while (merge.next(event)) { ... }
+ */
+
+#pragma once
+
+#include <gerefi/gerefi_time_types.h>
+
+#include <cstddef>
+
+#define TIMELINE_MAX_STREAMS 16
+
+enum class TimelineClock : uint8_t
+{
+	// timestamps are efitick_t
+	Ticks64,
+	// low 32 bits of timer, wrapping around
+	Wrapped32,
+};
+
+// Event as the source has it
+struct TimelineSourceEvent {
+	uint64_t timestamp;
+	// stays valid until next call of the source's next()
+	const void* data;
+	size_t size;
+};
+
+// Time ordered input, e.g. one log file
+class TimelineSource {
+public:
+	// false when there are no more events
+	virtual bool next(TimelineSourceEvent& event) = 0;
+};
+
+// Event of the unified timeline
+struct TimelineEvent {
+	efitick_t time;
+	// index of source in order of addSource()
+	uint8_t stream;
+	// valid until next call of TimelineMerge::next()
+	const void* data;
+	size_t size;
+};
+
+struct TimelineStats {
+	uint64_t events;
+	// events older than the one before them in their own stream, emitted as they come
+	uint64_t outOfOrder;
+};
+
+class TimelineMerge {
+public:
+	// Add all sources before the first next(). offset: added to the source's time to
+	// line up clocks of different recorders. false if there is no room.
+	bool addSource(TimelineSource& source, TimelineClock clock, efitick_t offset = 0);
+
+	// Next event in time order, ties in order of streams. false when all sources are done.
+	bool next(TimelineEvent& event);
+
+	const TimelineStats& getStats() const {
+		return m_stats;
+	}
+
+private:
+	struct Stream {
+		TimelineSource* source;
+		TimelineClock clock;
+		efitick_t offset;
+		// Wrapped32: unwrapped stamp of the last event, before offset
+		efitick_t unwrapped;
+		bool seeded;
+
+		TimelineSourceEvent head;
+		efitick_t time;
+	};
+
+	// Read next event of stream into its head, false if it is done
+	bool advance(size_t stream);
+	bool isBefore(uint8_t a, uint8_t b) const;
+	void siftDown(size_t i);
+	void siftUp(size_t i);
+
+	Stream m_streams[TIMELINE_MAX_STREAMS];
+	size_t m_streamCount = 0;
+
+	// streams with a head, earliest first
+	uint8_t m_heap[TIMELINE_MAX_STREAMS];
+	size_t m_heapSize = 0;
+
+	bool m_started = false;
+	// stream whose head was handed out last, advanced on next call
+	int m_emitted = -1;
+
+	TimelineStats m_stats = {};
+};
+
+// Source over an array of events, e.g. in tests
+class TimelineArraySource : public TimelineSource {
+public:
+	TimelineArraySource(const TimelineSourceEvent* events, size_t count)
+		: m_events(events)
+		, m_count(count)
+	{
+	}
+
+	bool next(TimelineSourceEvent& event) override {
+		if (m_position >= m_count) {
+			return false;
+		}
+		event = m_events[m_position++];
+		return true;
+	}
+
+private:
+	const TimelineSourceEvent* const m_events;
+	const size_t m_count;
+	size_t m_position = 0;
+};
@@ -0,0 +1,197 @@
+/**
+ * @file config_diff.cpp
+ *
+ * Config image diff and patch, see config_diff.h
+ */
+
+#include <gerefi/config_diff.h>
+#include <gerefi/cpu_features.h>
+#include <gerefi/byte_io.h>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CONFIG_DIFF_AVX2 1
+#endif
+
+// Offset of first byte that differs, size if none
+static size_t firstMismatchScalar(const uint8_t* a, const uint8_t* b, size_t size) {
+	size_t i = 0;
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	for (; i + 8 <= size; i += 8) {
+		uint64_t x, y;
+		memcpy(&x, a + i, sizeof(x));
+		memcpy(&y, b + i, sizeof(y));
+		if (x != y) {
+			// lowest differing byte comes first in memory
+			return i + __builtin_ctzll(x ^ y) / 8;
+		}
+	}
+#endif
+
+	for (; i < size; i++) {
+		if (a[i] != b[i]) {
+			return i;
+		}
+	}
+	return size;
+}
+
+#if CONFIG_DIFF_AVX2
+__attribute__((target("avx2")))
+static size_t firstMismatchAvx2(const uint8_t* a, const uint8_t* b, size_t size) {
+	size_t i = 0;
+
+	for (; i + 32 <= size; i += 32) {
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+		uint32_t equal = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+		if (equal != 0xFFFFFFFF) {
+			return i + __builtin_ctz(~equal);
+		}
+	}
+
+	return i + firstMismatchScalar(a + i, b + i, size - i);
+}
+#endif
+
+#if EFI_CPU_DISPATCH
+using FirstMismatchFunction = size_t (*)(const uint8_t* a, const uint8_t* b, size_t size);
+
+static constexpr CpuVariant<FirstMismatchFunction> firstMismatchVariants[] = {
+#if CONFIG_DIFF_AVX2
+	{ "avx2", cpuFeatureMask(CpuFeature::Avx2), firstMismatchAvx2 },
+#endif
+	{ "scalar", 0, firstMismatchScalar },
+};
+
+static constinit CpuKernel firstMismatchKernel("config_diff", firstMismatchVariants);
+static CpuKernelRegistration firstMismatchRegistration(firstMismatchKernel);
+#endif
+
+static size_t firstMismatch(const uint8_t* a, const uint8_t* b, size_t size) {
+#if EFI_CPU_DISPATCH
+	return firstMismatchKernel.get()(a, b, size);
+#else
+	return firstMismatchScalar(a, b, size);
+#endif
+}
+
+size_t configDiff(const void* oldImage, const void* newImage, size_t size,
+		ConfigRange* ranges, size_t maxRanges, const ConfigDiffOptions& options) {
+	auto a = reinterpret_cast<const uint8_t*>(oldImage);
+	auto b = reinterpret_cast<const uint8_t*>(newImage);
+	size_t align = options.alignment ? options.alignment : 1;
+	size_t count = 0;
+
+	if (maxRanges == 0) {
+		return 0;
+	}
+
+	size_t pos = 0;
+	while (pos < size) {
+		size_t start = pos + firstMismatch(a + pos, b + pos, size - pos);
+		if (start == size) {
+			break;
+		}
+
+		// end of changes: first run of more than mergeGap equal bytes
+		size_t end = start + 1;
+		size_t equalRun = 0;
+		for (size_t i = end; i < size && equalRun <= options.mergeGap; i++) {
+			if (a[i] == b[i]) {
+				equalRun++;
+			} else {
+				equalRun = 0;
+				end = i + 1;
+			}
+		}
+
+		size_t alignedStart = start & ~(align - 1);
+		size_t alignedEnd = (end + align - 1) & ~(align - 1);
+		if (alignedEnd > size) {
+			alignedEnd = size;
+		}
+
+		bool touchesLast = count && alignedStart <= ranges[count - 1].offset + ranges[count - 1].size + options.mergeGap;
+		if (touchesLast || count == maxRanges) {
+			// merge with previous range, or out of ranges: last one covers everything that is left
+			ranges[count - 1].size = alignedEnd - ranges[count - 1].offset;
+		} else {
+			ranges[count++] = { static_cast<uint32_t>(alignedStart), static_cast<uint32_t>(alignedEnd - alignedStart) };
+		}
+
+		pos = alignedEnd > end ? alignedEnd : end;
+	}
+
+	return count;
+}
+
+size_t configPatchSize(const ConfigRange* ranges, size_t count) {
+	size_t size = 0;
+	for (size_t i = 0; i < count; i++) {
+		size += CONFIG_PATCH_HEADER_SIZE + ranges[i].size;
+	}
+	return size;
+}
+
+size_t configWritePatch(const void* image, const ConfigRange* ranges, size_t count,
+		uint8_t* patch, size_t patchSize) {
+	size_t size = configPatchSize(ranges, count);
+	if (size > patchSize) {
+		return 0;
+	}
+
+	auto data = reinterpret_cast<const uint8_t*>(image);
+	for (size_t i = 0; i < count; i++) {
+		putLe32(patch, ranges[i].offset);
+		putLe32(patch + 4, ranges[i].size);
+		memcpy(patch + CONFIG_PATCH_HEADER_SIZE, data + ranges[i].offset, ranges[i].size);
+		patch += CONFIG_PATCH_HEADER_SIZE + ranges[i].size;
+	}
+
+	return size;
+}
+
+bool configApplyPatch(const uint8_t* patch, size_t patchSize, size_t imageSize,
+		ConfigPatchWriter writer, void* context) {
+	// validate everything before touching the target
+	for (size_t pos = 0; pos < patchSize;) {
+		if (patchSize - pos < CONFIG_PATCH_HEADER_SIZE) {
+			return false;
+		}
+
+		uint32_t offset = getLe32(patch + pos);
+		uint32_t size = getLe32(patch + pos + 4);
+		pos += CONFIG_PATCH_HEADER_SIZE;
+
+		if (size > patchSize - pos || offset > imageSize || size > imageSize - offset) {
+			return false;
+		}
+		pos += size;
+	}
+
+	for (size_t pos = 0; pos < patchSize;) {
+		uint32_t offset = getLe32(patch + pos);
+		uint32_t size = getLe32(patch + pos + 4);
+		pos += CONFIG_PATCH_HEADER_SIZE;
+
+		if (!writer(context, offset, patch + pos, size)) {
+			return false;
+		}
+		pos += size;
+	}
+
+	return true;
+}
+
+static bool writeToImage(void* context, uint32_t offset, const uint8_t* data, uint32_t size) {
+	memcpy(reinterpret_cast<uint8_t*>(context) + offset, data, size);
+	return true;
+}
+
+bool configApplyPatch(void* image, size_t imageSize, const uint8_t* patch, size_t patchSize) {
+	return configApplyPatch(patch, patchSize, imageSize, writeToImage, image);
+}
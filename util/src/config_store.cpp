@@ -0,0 +1,452 @@
+/**
+ * @file config_store.cpp
+ *
+ * Log structured config storage, see config_store.h
+ *
+ * sector: header, then records up to the first erased record header
+ *   header: magic, generation, image size, crc32 of these three
+ *   record: magic, type, length, payload, crc32 of everything before it,
+ *           padded with 0xFF to the program unit
+ *
+ * The first record of a sector is a snapshot. Patch payload is the config_diff.h
+ * patch format. Structs are stored in the byte order of the MCU.
+ */
+
+#include <gerefi/config_store.h>
+#include <gerefi/config_diff.h>
+#include <gerefi/byte_io.h>
+#include <gerefi/crc.h>
+
+#include <cstddef>
+#include <cstring>
+
+#define SECTOR_MAGIC 0x53464347
+#define RECORD_MAGIC 0xC5A7
+
+struct SectorHeader {
+	uint32_t magic;
+	uint32_t generation;
+	uint32_t imageSize;
+	uint32_t crc;
+};
+
+enum class RecordType : uint8_t {
+	Snapshot = 1,
+	Patch = 2,
+};
+
+struct RecordHeader {
+	uint16_t magic;
+	uint8_t type;
+	uint8_t reserved;
+	uint32_t length;
+};
+
+#define RECORD_CRC_SIZE 4
+
+// Streams bytes to flash in whole program units, keeps crc of everything written
+struct ConfigFlashWriter {
+	ConfigFlashWriter(ConfigFlash& flash, uint32_t address, size_t unit)
+		: m_flash(flash)
+		, m_address(address)
+		, m_unit(unit)
+	{
+	}
+
+	void write(const void* data, size_t size) {
+		m_crc = crc32inc(data, m_crc, size);
+		writeRaw(reinterpret_cast<const uint8_t*>(data), size);
+	}
+
+	void writeCrc() {
+		uint32_t crc = m_crc;
+		writeRaw(reinterpret_cast<const uint8_t*>(&crc), sizeof(crc));
+	}
+
+	// Pads last program unit, false if any program failed
+	bool finish() {
+		if (m_fill) {
+			memset(m_buffer + m_fill, 0xFF, m_unit - m_fill);
+			flush(m_buffer, m_unit);
+		}
+		return m_ok;
+	}
+
+	uint32_t getAddress() const {
+		return m_address;
+	}
+
+	size_t getProgrammed() const {
+		return m_programmed;
+	}
+
+private:
+	void writeRaw(const uint8_t* data, size_t size) {
+		// top up staging buffer first
+		if (m_fill) {
+			size_t n = m_unit - m_fill < size ? m_unit - m_fill : size;
+			memcpy(m_buffer + m_fill, data, n);
+			m_fill += n;
+			data += n;
+			size -= n;
+			if (m_fill < m_unit) {
+				return;
+			}
+			flush(m_buffer, m_unit);
+			m_fill = 0;
+		}
+
+		// whole units straight from the source
+		size_t direct = size - size % m_unit;
+		if (direct) {
+			flush(data, direct);
+		}
+
+		memcpy(m_buffer, data + direct, size - direct);
+		m_fill = size - direct;
+	}
+
+	void flush(const uint8_t* data, size_t size) {
+		if (m_ok && !m_flash.program(m_address, data, size)) {
+			m_ok = false;
+		}
+		m_address += size;
+		m_programmed += size;
+	}
+
+	ConfigFlash& m_flash;
+	uint32_t m_address;
+	const size_t m_unit;
+
+	uint8_t m_buffer[CONFIG_STORE_MAX_PROGRAM_UNIT];
+	size_t m_fill = 0;
+	uint32_t m_crc = 0;
+	size_t m_programmed = 0;
+	bool m_ok = true;
+};
+
+static bool isErased(const void* data, size_t size) {
+	auto p = reinterpret_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++) {
+		if (p[i] != 0xFF) {
+			return false;
+		}
+	}
+	return true;
+}
+
+ConfigStore::ConfigStore(ConfigFlash& flash, void* shadow, size_t imageSize)
+	: m_flash(flash)
+	, m_shadow(reinterpret_cast<uint8_t*>(shadow))
+	, m_size(imageSize)
+{
+}
+
+size_t ConfigStore::alignUp(size_t size) const {
+	size_t unit = m_flash.getProgramUnit();
+	return (size + unit - 1) / unit * unit;
+}
+
+size_t ConfigStore::recordSize(size_t payload) const {
+	return alignUp(sizeof(RecordHeader) + payload + RECORD_CRC_SIZE);
+}
+
+bool ConfigStore::isGeometryValid() const {
+	size_t unit = m_flash.getProgramUnit();
+	if (unit == 0 || unit > CONFIG_STORE_MAX_PROGRAM_UNIT || m_flash.getSectorCount() < 2) {
+		return false;
+	}
+
+	return alignUp(sizeof(SectorHeader)) + 2 * recordSize(m_size) <= m_flash.getSectorSize();
+}
+
+size_t ConfigStore::getFreeBytes() const {
+	if (m_active < 0) {
+		return 0;
+	}
+	return (m_active + 1) * m_flash.getSectorSize() - m_writeAddress;
+}
+
+bool ConfigStore::needsCompaction() const {
+	return m_active >= 0 && (m_dirty || getFreeBytes() < recordSize(m_size));
+}
+
+bool ConfigStore::readSector(size_t sector, uint32_t& generation) {
+	SectorHeader header;
+	if (!m_flash.read(sector * m_flash.getSectorSize(), &header, sizeof(header))) {
+		return false;
+	}
+
+	if (header.magic != SECTOR_MAGIC || header.crc != crc32(&header, offsetof(SectorHeader, crc))) {
+		return false;
+	}
+
+	generation = header.generation;
+	return header.imageSize == m_size;
+}
+
+// Record at address fits before end and its crc matches
+bool ConfigStore::checkRecord(uint32_t address, uint32_t end, uint8_t& type, uint32_t& length) {
+	RecordHeader header;
+	if (end - address < sizeof(header) + RECORD_CRC_SIZE || !m_flash.read(address, &header, sizeof(header))) {
+		return false;
+	}
+
+	if (header.magic != RECORD_MAGIC) {
+		return false;
+	}
+
+	if (header.type == static_cast<uint8_t>(RecordType::Snapshot)) {
+		if (header.length != m_size) {
+			return false;
+		}
+	} else if (header.type != static_cast<uint8_t>(RecordType::Patch)) {
+		return false;
+	}
+
+	if (header.length > end - address - sizeof(header) - RECORD_CRC_SIZE) {
+		return false;
+	}
+
+	uint32_t crc = crc32inc(&header, 0, sizeof(header));
+	uint8_t chunk[256];
+	uint32_t pos = address + sizeof(header);
+	for (uint32_t left = header.length; left;) {
+		uint32_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+		if (!m_flash.read(pos, chunk, n)) {
+			return false;
+		}
+		crc = crc32inc(chunk, crc, n);
+		pos += n;
+		left -= n;
+	}
+
+	uint32_t stored;
+	if (!m_flash.read(pos, &stored, sizeof(stored)) || stored != crc) {
+		return false;
+	}
+
+	type = header.type;
+	length = header.length;
+	return true;
+}
+
+// Record passed checkRecord(), copy its data into shadow
+bool ConfigStore::applyRecord(uint32_t address, uint8_t type, uint32_t length) {
+	uint32_t pos = address + sizeof(RecordHeader);
+
+	if (type == static_cast<uint8_t>(RecordType::Snapshot)) {
+		return m_flash.read(pos, m_shadow, m_size);
+	}
+
+	uint32_t end = pos + length;
+	while (pos < end) {
+		uint8_t header[CONFIG_PATCH_HEADER_SIZE];
+		if (end - pos < sizeof(header) || !m_flash.read(pos, header, sizeof(header))) {
+			return false;
+		}
+		pos += sizeof(header);
+
+		uint32_t offset = getLe32(header);
+		uint32_t size = getLe32(header + 4);
+		if (size > end - pos || offset > m_size || size > m_size - offset) {
+			return false;
+		}
+
+		if (!m_flash.read(pos, m_shadow + offset, size)) {
+			return false;
+		}
+		pos += size;
+	}
+
+	return true;
+}
+
+bool ConfigStore::scanSector(size_t sector) {
+	uint32_t address = sector * m_flash.getSectorSize() + alignUp(sizeof(SectorHeader));
+	uint32_t end = (sector + 1) * m_flash.getSectorSize();
+
+	uint8_t type;
+	uint32_t length;
+	if (!checkRecord(address, end, type, length) || type != static_cast<uint8_t>(RecordType::Snapshot)
+			|| !applyRecord(address, type, length)) {
+		return false;
+	}
+	address += recordSize(length);
+
+	while (checkRecord(address, end, type, length)) {
+		if (!applyRecord(address, type, length)) {
+			break;
+		}
+		address += recordSize(length);
+	}
+
+	m_writeAddress = address;
+
+	// anything but erased flash at the write position is a torn or corrupt record,
+	// appending after it would need an erase
+	RecordHeader next;
+	m_dirty = false;
+	if (end - address >= sizeof(next)) {
+		m_dirty = !m_flash.read(address, &next, sizeof(next)) || !isErased(&next, sizeof(next));
+	}
+	if (m_dirty) {
+		m_stats.badRecords++;
+	}
+
+	return true;
+}
+
+bool ConfigStore::load(void* image) {
+	m_active = -1;
+	m_generation = 0;
+	if (!isGeometryValid()) {
+		return false;
+	}
+
+	// newest sector first, one with a torn snapshot falls back to the one before
+	uint32_t tried = UINT32_MAX;
+	for (size_t attempt = 0; attempt < m_flash.getSectorCount(); attempt++) {
+		int best = -1;
+		uint32_t bestGeneration = 0;
+		for (size_t i = 0; i < m_flash.getSectorCount(); i++) {
+			uint32_t generation;
+			if (!readSector(i, generation)) {
+				continue;
+			}
+
+			// next compaction must be newer than anything on flash
+			if (generation > m_generation) {
+				m_generation = generation;
+			}
+
+			if (generation < tried && (best < 0 || generation > bestGeneration)) {
+				best = i;
+				bestGeneration = generation;
+			}
+		}
+
+		if (best < 0) {
+			break;
+		}
+
+		if (scanSector(best)) {
+			m_active = best;
+			memcpy(image, m_shadow, m_size);
+			return true;
+		}
+		tried = bestGeneration;
+	}
+
+	return false;
+}
+
+bool ConfigStore::compactFrom(const void* image) {
+	size_t sector = m_active < 0 ? 0 : (m_active + 1) % m_flash.getSectorCount();
+	uint32_t generation = m_generation + 1;
+
+	m_stats.erases++;
+	if (!m_flash.erase(sector)) {
+		return false;
+	}
+
+	SectorHeader header = { SECTOR_MAGIC, generation, static_cast<uint32_t>(m_size), 0 };
+	header.crc = crc32(&header, offsetof(SectorHeader, crc));
+
+	uint32_t start = sector * m_flash.getSectorSize();
+	ConfigFlashWriter headerWriter(m_flash, start, m_flash.getProgramUnit());
+	headerWriter.write(&header, sizeof(header));
+	bool ok = headerWriter.finish();
+
+	RecordHeader record = { RECORD_MAGIC, static_cast<uint8_t>(RecordType::Snapshot), 0xFF, static_cast<uint32_t>(m_size) };
+	ConfigFlashWriter writer(m_flash, headerWriter.getAddress(), m_flash.getProgramUnit());
+	writer.write(&record, sizeof(record));
+	writer.write(image, m_size);
+	writer.writeCrc();
+	ok = writer.finish() && ok;
+
+	m_stats.bytesProgrammed += headerWriter.getProgrammed() + writer.getProgrammed();
+	// new generation is on flash even if incomplete, do not reuse it
+	m_generation = generation;
+	if (!ok) {
+		return false;
+	}
+
+	m_stats.compactions++;
+	m_active = sector;
+	m_writeAddress = writer.getAddress();
+	m_dirty = false;
+	if (image != m_shadow) {
+		memcpy(m_shadow, image, m_size);
+	}
+	return true;
+}
+
+bool ConfigStore::compact() {
+	if (m_active < 0) {
+		// nothing stored yet
+		return false;
+	}
+	return compactFrom(m_shadow);
+}
+
+bool ConfigStore::save(const void* image) {
+	if (!isGeometryValid()) {
+		return false;
+	}
+
+	if (m_active < 0) {
+		m_stats.bytesChanged += m_size;
+		return compactFrom(image);
+	}
+
+	ConfigRange ranges[CONFIG_STORE_MAX_RANGES];
+	size_t count = configDiff(m_shadow, image, m_size, ranges, CONFIG_STORE_MAX_RANGES);
+	if (count == 0) {
+		return true;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		m_stats.bytesChanged += ranges[i].size;
+	}
+
+	size_t patchSize = configPatchSize(ranges, count);
+	bool snapshot = patchSize >= m_size;
+	size_t payload = snapshot ? m_size : patchSize;
+
+	if (m_dirty || recordSize(payload) > getFreeBytes()) {
+		return compactFrom(image);
+	}
+
+	RecordType type = snapshot ? RecordType::Snapshot : RecordType::Patch;
+	RecordHeader header = { RECORD_MAGIC, static_cast<uint8_t>(type), 0xFF, static_cast<uint32_t>(payload) };
+	ConfigFlashWriter writer(m_flash, m_writeAddress, m_flash.getProgramUnit());
+	writer.write(&header, sizeof(header));
+
+	auto data = reinterpret_cast<const uint8_t*>(image);
+	if (snapshot) {
+		writer.write(data, m_size);
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			uint8_t rangeHeader[CONFIG_PATCH_HEADER_SIZE];
+			putLe32(rangeHeader, ranges[i].offset);
+			putLe32(rangeHeader + 4, ranges[i].size);
+			writer.write(rangeHeader, sizeof(rangeHeader));
+			writer.write(data + ranges[i].offset, ranges[i].size);
+		}
+	}
+	writer.writeCrc();
+	bool ok = writer.finish();
+
+	m_stats.bytesProgrammed += writer.getProgrammed();
+	// whatever happened, flash up to here is used now
+	m_writeAddress = writer.getAddress();
+	if (!ok) {
+		m_dirty = true;
+		return false;
+	}
+
+	m_stats.records++;
+	memcpy(m_shadow, image, m_size);
+	return true;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file cpu_features.cpp
+ *
+ * Runtime CPU feature dispatch, see cpu_features.h
+ */
+
+#include <gerefi/cpu_features.h>
+
+#if EFI_CPU_DISPATCH
+#include <cstdlib>
+#include <cstring>
+#endif
+
+static const char* const featureNames[CPU_FEATURE_COUNT] = {
+	"sse4.1",
+	"sse4.2",
+	"pclmul",
+	"avx2",
+	"avx512f",
+	"neon",
+	"crc32",
+};
+
+static uint32_t detectFeatures() {
+	uint32_t features = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+	// may run from static constructors, before the compiler runtime did it
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse4.1")) {
+		features |= cpuFeatureMask(CpuFeature::Sse41);
+	}
+	if (__builtin_cpu_supports("sse4.2")) {
+		features |= cpuFeatureMask(CpuFeature::Sse42);
+	}
+	if (__builtin_cpu_supports("pclmul")) {
+		features |= cpuFeatureMask(CpuFeature::Pclmul);
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		features |= cpuFeatureMask(CpuFeature::Avx2);
+	}
+	if (__builtin_cpu_supports("avx512f")) {
+		features |= cpuFeatureMask(CpuFeature::Avx512f);
+	}
+#elif defined(__aarch64__)
+	// part of the 64 bit ARM baseline
+	features |= cpuFeatureMask(CpuFeature::Neon);
+#if defined(__ARM_FEATURE_CRC32)
+	// only claimed when the compiler targets it, see crc.cpp
+	features |= cpuFeatureMask(CpuFeature::ArmCrc32);
+#endif
+#endif
+
+	return features;
+}
+
+static bool forcedScalar() {
+#if EFI_CPU_DISPATCH
+	const char* value = getenv("GEREFI_CPU_SCALAR");
+	return value && strcmp(value, "1") == 0;
+#else
+	return false;
+#endif
+}
+
+// function statics: kernels register from static constructors of other files
+static uint32_t& detected() {
+	static uint32_t features = detectFeatures();
+	return features;
+}
+
+static std::atomic<bool>& scalarOnly() {
+	static std::atomic<bool> force(forcedScalar());
+	return force;
+}
+
+static CpuKernelBase* kernels[CPU_MAX_KERNELS];
+static size_t kernelCount = 0;
+
+uint32_t cpuGetFeatures() {
+	return scalarOnly() ? 0 : detected();
+}
+
+bool cpuHasFeature(CpuFeature feature) {
+	return cpuGetFeatures() & cpuFeatureMask(feature);
+}
+
+const char* cpuFeatureName(CpuFeature feature) {
+	size_t index = static_cast<size_t>(feature);
+	return index < CPU_FEATURE_COUNT ? featureNames[index] : "?";
+}
+
+void cpuForceScalar(bool force) {
+	scalarOnly() = force;
+
+	for (size_t i = 0; i < kernelCount; i++) {
+		kernels[i]->bind();
+	}
+}
+
+bool cpuIsForcedScalar() {
+	return scalarOnly();
+}
+
+CpuKernelRegistration::CpuKernelRegistration(CpuKernelBase& kernel) {
+	if (kernelCount < CPU_MAX_KERNELS) {
+		kernels[kernelCount++] = &kernel;
+	}
+	kernel.bind();
+}
+
+size_t cpuGetKernelCount() {
+	return kernelCount;
+}
+
+const CpuKernelBase& cpuGetKernel(size_t index) {
+	return *kernels[index];
+}
@@ -5,6 +5,18 @@
  */
 
 #include <gerefi/crc.h>
+#include <gerefi/cpu_features.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32_PCLMUL 1
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#include <cstring>
+#define CRC32_ARM 1
+#endif
 
 static const uint32_t crc32_tab[] = { 0x00000000, 0x77073096, 0xee0e612c, 0x990951ba,
 		0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4,
@@ -58,7 +70,7 @@ uint32_t crc32(const void *buf, uint32_t size) {
 	return crc32inc(buf, 0, size);
 }
 
-uint32_t crc32inc(const void *buf, uint32_t crc, uint32_t size) {
+static uint32_t crc32incScalar(const void *buf, uint32_t crc, uint32_t size) {
 	auto p = reinterpret_cast<const uint8_t*>(buf);
 	crc = crc ^ 0xFFFFFFFF;
 
@@ -69,6 +81,150 @@ uint32_t crc32inc(const void *buf, uint32_t crc, uint32_t size) {
 	return crc ^ 0xFFFFFFFF;
 }
 
+#if CRC32_PCLMUL
+// fold 128 bits of state onto the next 16 bytes
+__attribute__((target("pclmul,sse4.1")))
+static inline __m128i crc32Fold16(__m128i x, __m128i next, __m128i k) {
+	__m128i low = _mm_clmulepi64_si128(x, k, 0x00);
+	__m128i high = _mm_clmulepi64_si128(x, k, 0x11);
+	return _mm_xor_si128(_mm_xor_si128(high, next), low);
+}
+
+/**
+ * Carry-less multiplication folding of 64 byte blocks, "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction" (Intel), constants for the
+ * reflected CRC32 polynomial as in zlib/chromium.
+ * size: multiple of 16, at least 64. Takes and returns the inverted crc state.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32Fold(const uint8_t *p, uint32_t size, uint32_t state) {
+	alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+	alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+	alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+	alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+	__m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x00));
+	__m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x10));
+	__m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x20));
+	__m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(state));
+
+	__m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+	p += 64;
+	size -= 64;
+
+	// four blocks in parallel
+	while (size >= 64) {
+		__m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+		__m128i x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+		__m128i x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+		__m128i x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x30)));
+
+		p += 64;
+		size -= 64;
+	}
+
+	// fold into 128 bits
+	k = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+	x1 = crc32Fold16(x1, x2, k);
+	x1 = crc32Fold16(x1, x3, k);
+	x1 = crc32Fold16(x1, x4, k);
+
+	// remaining 16 byte blocks
+	while (size >= 16) {
+		x1 = crc32Fold16(x1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), k);
+		p += 16;
+		size -= 16;
+	}
+
+	// 128 to 64 bits
+	__m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+	k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	k = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), k, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return _mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32incPclmul(const void *buf, uint32_t crc, uint32_t size) {
+	if (size < 64) {
+		return crc32incScalar(buf, crc, size);
+	}
+
+	auto p = reinterpret_cast<const uint8_t*>(buf);
+	uint32_t folded = size & ~15u;
+	crc = ~crc32Fold(p, folded, ~crc);
+
+	return crc32incScalar(p + folded, crc, size - folded);
+}
+#endif // CRC32_PCLMUL
+
+#if CRC32_ARM
+static uint32_t crc32incArm(const void *buf, uint32_t crc, uint32_t size) {
+	auto p = reinterpret_cast<const uint8_t*>(buf);
+	crc = ~crc;
+
+	while (size >= 8) {
+		uint64_t word;
+		memcpy(&word, p, sizeof(word));
+		crc = __crc32d(crc, word);
+		p += 8;
+		size -= 8;
+	}
+
+	while (size--) {
+		crc = __crc32b(crc, *p++);
+	}
+
+	return ~crc;
+}
+#endif // CRC32_ARM
+
+#if EFI_CPU_DISPATCH
+using Crc32Function = uint32_t (*)(const void *buf, uint32_t crc, uint32_t size);
+
+static constexpr CpuVariant<Crc32Function> crc32Variants[] = {
+#if CRC32_PCLMUL
+	{ "pclmul", cpuFeatureMask(CpuFeature::Pclmul) | cpuFeatureMask(CpuFeature::Sse41), crc32incPclmul },
+#endif
+#if CRC32_ARM
+	{ "armv8 crc32", cpuFeatureMask(CpuFeature::ArmCrc32), crc32incArm },
+#endif
+	{ "scalar", 0, crc32incScalar },
+};
+
+static constinit CpuKernel crc32Kernel("crc32", crc32Variants);
+static CpuKernelRegistration crc32Registration(crc32Kernel);
+#endif
+
+uint32_t crc32inc(const void *buf, uint32_t crc, uint32_t size) {
+#if EFI_CPU_DISPATCH
+	return crc32Kernel.get()(buf, crc, size);
+#else
+	return crc32incScalar(buf, crc, size);
+#endif
+}
+
 /**
  * http://www.sunshine2k.de/coding/javascript/crc/crc_js.html
  * https://stackoverflow.com/questions/38639423/understanding-results-of-crc8-sae-j1850-normal-vs-zero
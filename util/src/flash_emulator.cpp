@@ -0,0 +1,133 @@
+/**
+ * @file flash_emulator.cpp
+ *
+ * NOR flash emulator, see flash_emulator.h
+ */
+
+#include <gerefi/flash_emulator.h>
+
+#include <cstring>
+
+FlashEmulator::FlashEmulator(const char* path, size_t sectorSize, size_t sectorCount, size_t programUnit)
+	: m_sectorSize(sectorSize)
+	, m_sectorCount(sectorCount)
+	, m_programUnit(programUnit)
+	, m_data(sectorSize * sectorCount, 0xFF)
+	, m_eraseCounts(sectorCount, 0)
+{
+	if (!path) {
+		return;
+	}
+
+	// existing contents if the geometry matches, erased flash otherwise
+	m_file = fopen(path, "r+b");
+	if (m_file) {
+		bool matches = fseek(m_file, 0, SEEK_END) == 0 && static_cast<size_t>(ftell(m_file)) == m_data.size();
+		if (matches && fseek(m_file, 0, SEEK_SET) == 0 && fread(m_data.data(), 1, m_data.size(), m_file) == m_data.size()) {
+			return;
+		}
+		fclose(m_file);
+		memset(m_data.data(), 0xFF, m_data.size());
+	}
+
+	m_file = fopen(path, "w+b");
+	persist(0, m_data.size());
+}
+
+FlashEmulator::~FlashEmulator() {
+	if (m_file) {
+		fclose(m_file);
+	}
+}
+
+bool FlashEmulator::read(uint32_t address, void* data, size_t size) {
+	if (m_powerLost || address > m_data.size() || size > m_data.size() - address) {
+		return false;
+	}
+
+	memcpy(data, m_data.data() + address, size);
+	return true;
+}
+
+bool FlashEmulator::consumePower() {
+	if (!m_powerLossArmed) {
+		return true;
+	}
+
+	if (m_powerLeft == 0) {
+		m_powerLost = true;
+		return false;
+	}
+
+	m_powerLeft--;
+	return true;
+}
+
+bool FlashEmulator::program(uint32_t address, const void* data, size_t size) {
+	if (m_powerLost || address % m_programUnit || size % m_programUnit
+			|| address > m_data.size() || size > m_data.size() - address) {
+		return false;
+	}
+
+	auto source = reinterpret_cast<const uint8_t*>(data);
+	uint8_t* target = m_data.data() + address;
+
+	// bits can only go from 1 to 0
+	for (size_t i = 0; i < size; i++) {
+		if (source[i] & ~target[i]) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		if (!consumePower()) {
+			// torn byte: only some of its bits made it
+			target[i] &= source[i] | 0xF0;
+			persist(address, i + 1);
+			return false;
+		}
+		target[i] = source[i];
+	}
+
+	persist(address, size);
+	return true;
+}
+
+bool FlashEmulator::erase(size_t sector) {
+	if (m_powerLost || sector >= m_sectorCount) {
+		return false;
+	}
+
+	m_eraseCounts[sector]++;
+	uint32_t address = sector * m_sectorSize;
+	for (size_t i = 0; i < m_sectorSize; i++) {
+		if (!consumePower()) {
+			persist(address, i);
+			return false;
+		}
+		m_data[address + i] = 0xFF;
+	}
+
+	persist(address, m_sectorSize);
+	return true;
+}
+
+void FlashEmulator::injectPowerLoss(uint32_t bytes) {
+	m_powerLossArmed = true;
+	m_powerLeft = bytes;
+}
+
+void FlashEmulator::powerCycle() {
+	m_powerLossArmed = false;
+	m_powerLost = false;
+}
+
+void FlashEmulator::persist(uint32_t address, size_t size) {
+	if (!m_file || size == 0) {
+		return;
+	}
+
+	fseek(m_file, address, SEEK_SET);
+	fwrite(m_data.data() + address, 1, size, m_file);
+	fflush(m_file);
+}
@@ -0,0 +1,239 @@
+/**
+ * @file log_codec.cpp
+ *
+ * Log record encoder, see log_codec.h
+ *
+ * Runs on Cortex-M4: unchanged data is skipped with 32 bit compares, work beyond
+ * that is proportional to what changed.
+ */
+
+#include <gerefi/log_codec.h>
+#include <gerefi/byte_io.h>
+#include <gerefi/crc.h>
+
+#include <cstring>
+
+LogEncoder::LogEncoder(size_t recordSize, uint8_t* previous, uint8_t* block, size_t blockSize,
+		uint8_t* lzBuffer, LogBlockWriter writer, void* context, uint8_t flags)
+	: m_recordSize(recordSize)
+	, m_previous(previous)
+	, m_block(block)
+	, m_blockSize(blockSize)
+	, m_lzBuffer(lzBuffer)
+	, m_writer(writer)
+	, m_context(context)
+	, m_flags(flags & LOG_FLAG_DELTA)
+	, m_valid(recordSize > 0 && recordSize <= LOG_MAX_RECORD_SIZE && blockSize <= LOG_MAX_BLOCK_SIZE
+		&& LOG_BLOCK_HEADER_SIZE + logMaxRecordSize(recordSize) <= blockSize)
+{
+}
+
+// Bitmap of 8 byte groups that differ, returns their count
+static size_t findChangedGroups(const uint8_t* record, const uint8_t* previous, size_t size, uint8_t* bits) {
+	size_t groups = (size + 7) / 8;
+	memset(bits, 0, (groups + 7) / 8);
+
+	size_t count = 0;
+	size_t full = size / 8;
+	for (size_t g = 0; g < full; g++) {
+		uint32_t a[2], b[2];
+		memcpy(a, record + g * 8, sizeof(a));
+		memcpy(b, previous + g * 8, sizeof(b));
+		if ((a[0] ^ b[0]) | (a[1] ^ b[1])) {
+			bits[g / 8] |= 1 << (g % 8);
+			count++;
+		}
+	}
+
+	if (full < groups && memcmp(record + full * 8, previous + full * 8, size - full * 8)) {
+		bits[full / 8] |= 1 << (full % 8);
+		count++;
+	}
+
+	return count;
+}
+
+size_t LogEncoder::encodeRecord(uint64_t timestamp, const uint8_t* record, uint8_t* out) {
+	uint8_t* p = out;
+	uint64_t base = m_count == 0 ? m_firstTimestamp : m_lastTimestamp;
+	p = putVarint(p, zigzagEncode(static_cast<int64_t>(timestamp - base)));
+
+	uint8_t bits[(LOG_MAX_RECORD_SIZE / 8 + 7) / 8];
+	size_t bitmapSize = ((m_recordSize + 7) / 8 + 7) / 8;
+	size_t count = findChangedGroups(record, m_previous, m_recordSize, bits);
+	p = putVarint(p, count);
+	if (count == 0) {
+		return p - out;
+	}
+
+	// few changes: index gaps are shorter than the bitmap
+	bool indexed = count < bitmapSize;
+	if (!indexed) {
+		memcpy(p, bits, bitmapSize);
+		p += bitmapSize;
+	}
+
+	size_t next = 0;
+	uint8_t* data = p;
+	if (indexed) {
+		// gaps first, group data after them
+		for (size_t i = 0; i < bitmapSize; i++) {
+			for (uint32_t b = bits[i]; b; b &= b - 1) {
+				size_t g = i * 8 + __builtin_ctz(b);
+				data = putVarint(data, g - next);
+				next = g + 1;
+			}
+		}
+	}
+
+	bool delta = m_flags & LOG_FLAG_DELTA;
+	for (size_t i = 0; i < bitmapSize; i++) {
+		for (uint32_t b = bits[i]; b; b &= b - 1) {
+			size_t start = (i * 8 + __builtin_ctz(b)) * 8;
+			size_t n = m_recordSize - start < 8 ? m_recordSize - start : 8;
+
+			uint8_t* mask = data++;
+			*mask = 0;
+			for (size_t j = 0; j < n; j++) {
+				uint8_t current = record[start + j];
+				uint8_t& previous = m_previous[start + j];
+				if (current != previous) {
+					*mask |= 1 << j;
+					*data++ = delta ? current - previous : current ^ previous;
+					previous = current;
+				}
+			}
+		}
+	}
+
+	return data - out;
+}
+
+bool LogEncoder::add(uint64_t timestamp, const uint8_t* record) {
+	if (!m_valid) {
+		return false;
+	}
+
+	if (m_count == 0) {
+		// block decodes on its own
+		memset(m_previous, 0, m_recordSize);
+		m_firstTimestamp = timestamp;
+	}
+
+	m_used += encodeRecord(timestamp, record, m_block + LOG_BLOCK_HEADER_SIZE + m_used);
+	m_lastTimestamp = timestamp;
+	m_count++;
+	m_stats.records++;
+	m_stats.rawBytes += m_recordSize;
+
+	// write as soon as the next record may not fit
+	if (LOG_BLOCK_HEADER_SIZE + m_used + logMaxRecordSize(m_recordSize) > m_blockSize || m_count == UINT16_MAX) {
+		return flush();
+	}
+	return true;
+}
+
+static uint8_t* putLzLength(uint8_t* p, size_t length) {
+	return length >= 15 ? putVarint(p, length - 15) : p;
+}
+
+// LZ77 with a single entry hash table, greedy matching. 0 if it does not fit outSize.
+size_t LogEncoder::compress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize) {
+	memset(m_hash, 0, sizeof(m_hash));
+
+	uint8_t* p = out;
+	uint8_t* end = out + outSize;
+	size_t anchor = 0;
+	size_t i = 0;
+
+	auto emit = [&](size_t literals, size_t offset, size_t match) {
+		// token, two extensions, offset
+		if (static_cast<size_t>(end - p) < 1 + 2 * 5 + literals + 2) {
+			return false;
+		}
+
+		size_t matchCode = match ? match - LOG_LZ_MIN_MATCH : 0;
+		*p++ = (literals < 15 ? literals : 15) << 4 | (matchCode < 15 ? matchCode : 15);
+		p = putLzLength(p, literals);
+		memcpy(p, data + anchor, literals);
+		p += literals;
+
+		if (match) {
+			putLe16(p, offset);
+			p += 2;
+			p = putLzLength(p, matchCode);
+		}
+		return true;
+	};
+
+	while (i + LOG_LZ_MIN_MATCH <= size) {
+		uint32_t value;
+		memcpy(&value, data + i, sizeof(value));
+		uint32_t hash = (value * 2654435761u) >> (32 - LOG_LZ_HASH_BITS);
+		size_t candidate = m_hash[hash];
+		m_hash[hash] = i;
+
+		uint32_t found;
+		memcpy(&found, data + candidate, sizeof(found));
+		if (candidate < i && found == value) {
+			size_t match = LOG_LZ_MIN_MATCH;
+			while (i + match < size && data[candidate + match] == data[i + match]) {
+				match++;
+			}
+
+			if (!emit(i - anchor, i - candidate, match)) {
+				return 0;
+			}
+			i += match;
+			anchor = i;
+		} else {
+			// step faster through data that does not compress
+			i += 1 + ((i - anchor) >> 5);
+		}
+	}
+
+	if (!emit(size - anchor, 0, 0)) {
+		return 0;
+	}
+	return p - out;
+}
+
+bool LogEncoder::flush() {
+	if (!m_valid || m_count == 0) {
+		return true;
+	}
+
+	uint8_t* block = m_block;
+	uint8_t flags = m_flags;
+	size_t payloadSize = m_used;
+
+	if (m_lzBuffer) {
+		size_t compressed = compress(m_block + LOG_BLOCK_HEADER_SIZE, m_used,
+			m_lzBuffer + LOG_BLOCK_HEADER_SIZE, m_blockSize - LOG_BLOCK_HEADER_SIZE);
+		if (compressed && compressed < m_used) {
+			block = m_lzBuffer;
+			flags |= LOG_FLAG_LZ;
+			payloadSize = compressed;
+		}
+	}
+
+	putLe32(block, LOG_BLOCK_MAGIC);
+	block[4] = flags;
+	block[5] = 0;
+	putLe16(block + 6, m_count);
+	putLe32(block + 8, m_recordSize);
+	putLe32(block + 12, payloadSize);
+	putLe32(block + 16, m_used);
+	putLe64(block + 20, m_firstTimestamp);
+	putLe64(block + 28, m_lastTimestamp);
+	uint32_t crc = crc32inc(block, 0, 36);
+	putLe32(block + 36, crc32inc(block + LOG_BLOCK_HEADER_SIZE, crc, payloadSize));
+
+	size_t size = LOG_BLOCK_HEADER_SIZE + payloadSize;
+	m_used = 0;
+	m_count = 0;
+	m_stats.blocks++;
+	m_stats.encodedBytes += size;
+
+	return m_writer(m_context, block, size);
+}
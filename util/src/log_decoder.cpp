@@ -0,0 +1,214 @@
+/**
+ * @file log_decoder.cpp
+ *
+ * Log block decoder, see log_decoder.h
+ */
+
+#include <gerefi/log_decoder.h>
+#include <gerefi/byte_io.h>
+#include <gerefi/crc.h>
+
+#include <cstring>
+
+bool logReadBlockHeader(const uint8_t* data, size_t size, LogBlockInfo& info) {
+	if (size < LOG_BLOCK_HEADER_SIZE || getLe32(data) != LOG_BLOCK_MAGIC) {
+		return false;
+	}
+
+	info.flags = data[4];
+	info.recordCount = getLe16(data + 6);
+	info.recordSize = getLe32(data + 8);
+	info.payloadSize = getLe32(data + 12);
+	info.rawSize = getLe32(data + 16);
+	info.firstTimestamp = getLe64(data + 20);
+	info.lastTimestamp = getLe64(data + 28);
+
+	return info.recordCount > 0 && info.recordSize > 0 && info.recordSize <= LOG_MAX_RECORD_SIZE
+		&& info.payloadSize <= LOG_MAX_BLOCK_SIZE && info.rawSize <= LOG_MAX_BLOCK_SIZE;
+}
+
+static const uint8_t* getLzLength(const uint8_t* p, const uint8_t* end, size_t& length) {
+	if (length < 15) {
+		return p;
+	}
+
+	uint64_t extra;
+	p = getVarint(p, end, extra);
+	if (p && extra > LOG_MAX_BLOCK_SIZE) {
+		return nullptr;
+	}
+	length += extra;
+	return p;
+}
+
+bool logLzDecompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+	const uint8_t* end = in + inSize;
+	size_t pos = 0;
+
+	while (in < end) {
+		uint8_t token = *in++;
+
+		size_t literals = token >> 4;
+		in = getLzLength(in, end, literals);
+		if (!in || literals > static_cast<size_t>(end - in) || literals > outSize - pos) {
+			return false;
+		}
+		memcpy(out + pos, in, literals);
+		in += literals;
+		pos += literals;
+
+		// last sequence has no match
+		if (in == end) {
+			break;
+		}
+
+		if (end - in < 2) {
+			return false;
+		}
+		size_t offset = getLe16(in);
+		in += 2;
+
+		size_t match = token & 0xF;
+		in = getLzLength(in, end, match);
+		match += LOG_LZ_MIN_MATCH;
+		if (!in || offset == 0 || offset > pos || match > outSize - pos) {
+			return false;
+		}
+
+		// may overlap: byte by byte
+		for (size_t i = 0; i < match; i++, pos++) {
+			out[pos] = out[pos - offset];
+		}
+	}
+
+	return pos == outSize;
+}
+
+// One record against previous, in place. Returns pointer past it, nullptr if malformed.
+static const uint8_t* decodeRecord(const uint8_t* p, const uint8_t* end, uint8_t* record,
+		size_t recordSize, bool delta, uint64_t& timestamp) {
+	uint64_t value;
+	if (!(p = getVarint(p, end, value))) {
+		return nullptr;
+	}
+	timestamp += zigzagDecode(value);
+
+	uint64_t count;
+	if (!(p = getVarint(p, end, count))) {
+		return nullptr;
+	}
+
+	size_t groups = (recordSize + 7) / 8;
+	size_t bitmapSize = (groups + 7) / 8;
+	if (count > groups) {
+		return nullptr;
+	}
+
+	auto applyGroup = [&](size_t g) {
+		if (p >= end) {
+			return false;
+		}
+		uint8_t mask = *p++;
+		size_t start = g * 8;
+		for (size_t j = 0; mask; j++, mask >>= 1) {
+			if (!(mask & 1)) {
+				continue;
+			}
+			if (p >= end || start + j >= recordSize) {
+				return false;
+			}
+			record[start + j] = delta ? record[start + j] + *p++ : record[start + j] ^ *p++;
+		}
+		return true;
+	};
+
+	if (count < bitmapSize) {
+		// index gaps, then group data in the same order
+		size_t indices[LOG_MAX_RECORD_SIZE / 8];
+		size_t next = 0;
+		for (size_t i = 0; i < count; i++) {
+			uint64_t gap;
+			if (!(p = getVarint(p, end, gap)) || gap >= groups - next) {
+				return nullptr;
+			}
+			indices[i] = next + gap;
+			next = indices[i] + 1;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			if (!applyGroup(indices[i])) {
+				return nullptr;
+			}
+		}
+	} else if (count) {
+		if (static_cast<size_t>(end - p) < bitmapSize) {
+			return nullptr;
+		}
+		const uint8_t* bits = p;
+		p += bitmapSize;
+
+		for (size_t i = 0; i < bitmapSize; i++) {
+			for (uint32_t b = bits[i]; b; b &= b - 1) {
+				if (!applyGroup(i * 8 + __builtin_ctz(b))) {
+					return nullptr;
+				}
+			}
+		}
+	}
+
+	return p;
+}
+
+bool logCheckBlock(const uint8_t* data, size_t size) {
+	LogBlockInfo info;
+	if (!logReadBlockHeader(data, size, info) || info.payloadSize > size - LOG_BLOCK_HEADER_SIZE) {
+		return false;
+	}
+
+	uint32_t crc = crc32inc(data, 0, 36);
+	return crc32inc(data + LOG_BLOCK_HEADER_SIZE, crc, info.payloadSize) == getLe32(data + 36);
+}
+
+bool logDecodeBlock(const uint8_t* data, size_t size, std::vector<uint8_t>& records, std::vector<uint64_t>& timestamps) {
+	LogBlockInfo info;
+	if (!logCheckBlock(data, size)) {
+		return false;
+	}
+	logReadBlockHeader(data, size, info);
+
+	const uint8_t* payload = data + LOG_BLOCK_HEADER_SIZE;
+	std::vector<uint8_t> raw;
+	if (info.flags & LOG_FLAG_LZ) {
+		raw.resize(info.rawSize);
+		if (!logLzDecompress(payload, info.payloadSize, raw.data(), raw.size())) {
+			return false;
+		}
+		payload = raw.data();
+	} else if (info.rawSize != info.payloadSize) {
+		return false;
+	}
+
+	records.resize(info.recordCount * info.recordSize);
+	timestamps.resize(info.recordCount);
+
+	const uint8_t* p = payload;
+	const uint8_t* end = payload + info.rawSize;
+	uint8_t* record = records.data();
+	memset(record, 0, info.recordSize);
+	uint64_t timestamp = info.firstTimestamp;
+
+	for (size_t i = 0; i < info.recordCount; i++) {
+		if (i > 0) {
+			memcpy(record + info.recordSize, record, info.recordSize);
+			record += info.recordSize;
+		}
+
+		p = decodeRecord(p, end, record, info.recordSize, info.flags & LOG_FLAG_DELTA, timestamp);
+		if (!p) {
+			return false;
+		}
+		timestamps[i] = timestamp;
+	}
+
+	return p == end;
+}
@@ -0,0 +1,332 @@
+/**
+ * @file log_reader.cpp
+ *
+ * Indexed, multithreaded log reader, see log_reader.h
+ */
+
+#include <gerefi/log_reader.h>
+#include <gerefi/byte_io.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LOG_READER_MMAP 1
+#endif
+
+LogReader::~LogReader() {
+	close();
+}
+
+void LogReader::close() {
+#if LOG_READER_MMAP
+	if (m_mapping) {
+		munmap(m_mapping, m_size);
+	}
+#endif
+	m_mapping = nullptr;
+	m_copy.clear();
+	m_copy.shrink_to_fit();
+	m_data = nullptr;
+	m_size = 0;
+	m_index.clear();
+	m_recordSize = 0;
+	m_skippedBytes = 0;
+}
+
+bool LogReader::open(const char* path) {
+	close();
+
+#if LOG_READER_MMAP
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+
+	m_mapping = mapping;
+	m_data = reinterpret_cast<const uint8_t*>(mapping);
+	m_size = st.st_size;
+#else
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		return false;
+	}
+
+	uint8_t buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+		m_copy.insert(m_copy.end(), buffer, buffer + n);
+	}
+	fclose(f);
+
+	m_data = m_copy.data();
+	m_size = m_copy.size();
+#endif
+
+	return buildIndex();
+}
+
+bool LogReader::open(const uint8_t* data, size_t size) {
+	close();
+	m_data = data;
+	m_size = size;
+	return buildIndex();
+}
+
+// Header at pos that is followed by another block or the end of the log.
+// Otherwise either header is damaged or the next one, only the crc can tell.
+static bool isBlockAt(const uint8_t* data, size_t size, size_t pos, LogBlockInfo& info) {
+	if (!logReadBlockHeader(data + pos, size - pos, info) || info.getSize() > size - pos) {
+		return false;
+	}
+
+	size_t next = pos + info.getSize();
+	if (next == size || (size - next >= 4 && getLe32(data + next) == LOG_BLOCK_MAGIC)) {
+		return true;
+	}
+	return logCheckBlock(data + pos, size - pos);
+}
+
+bool LogReader::buildIndex() {
+	uint64_t record = 0;
+	size_t pos = 0;
+
+	while (pos < m_size) {
+		LogBlockInfo info;
+		if (isBlockAt(m_data, m_size, pos, info)) {
+			if (m_recordSize == 0) {
+				m_recordSize = info.recordSize;
+			}
+
+			if (info.recordSize == m_recordSize) {
+				m_index.push_back({ pos, info.firstTimestamp, info.lastTimestamp, record, info.recordCount });
+				record += info.recordCount;
+			} else {
+				m_skippedBytes += info.getSize();
+			}
+			pos += info.getSize();
+			continue;
+		}
+
+		// damaged: resync at next magic
+		size_t next = pos + 1;
+		while (next + 4 <= m_size && getLe32(m_data + next) != LOG_BLOCK_MAGIC) {
+			next++;
+		}
+		if (next + 4 > m_size) {
+			next = m_size;
+		}
+		m_skippedBytes += next - pos;
+		pos = next;
+	}
+
+	return !m_index.empty();
+}
+
+uint64_t LogReader::getRecordCount() const {
+	if (m_index.empty()) {
+		return 0;
+	}
+	return m_index.back().firstRecord + m_index.back().recordCount;
+}
+
+size_t LogReader::findBlock(uint64_t timestamp) const {
+	// blocks are in time order
+	auto it = std::partition_point(m_index.begin(), m_index.end(), [&](const LogIndexEntry& e) {
+		return e.lastTimestamp < timestamp;
+	});
+	return it - m_index.begin();
+}
+
+bool LogReader::readBlock(size_t block, std::vector<uint8_t>& records, std::vector<uint64_t>& timestamps) const {
+	const auto& entry = m_index[block];
+	return logDecodeBlock(m_data + entry.offset, m_size - entry.offset, records, timestamps)
+		&& timestamps.size() == entry.recordCount;
+}
+
+uint64_t LogReader::seek(uint64_t timestamp) const {
+	size_t block = findBlock(timestamp);
+	if (block == m_index.size()) {
+		return getRecordCount();
+	}
+
+	std::vector<uint8_t> records;
+	std::vector<uint64_t> timestamps;
+	const auto& entry = m_index[block];
+	if (!readBlock(block, records, timestamps)) {
+		// can not look inside: start of block is close enough
+		return entry.firstRecord;
+	}
+
+	size_t i = 0;
+	while (i < timestamps.size() && timestamps[i] < timestamp) {
+		i++;
+	}
+	return entry.firstRecord + i;
+}
+
+template <typename T>
+static void extract(const uint8_t* records, size_t count, size_t recordSize, size_t offset, float scale, float* out) {
+	for (size_t i = 0; i < count; i++) {
+		T value;
+		memcpy(&value, records + i * recordSize + offset, sizeof(value));
+		out[i] = value * scale;
+	}
+}
+
+static size_t channelSize(LogChannelType type) {
+	switch (type) {
+	case LogChannelType::U8:
+	case LogChannelType::I8:
+		return 1;
+	case LogChannelType::U16:
+	case LogChannelType::I16:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+static void extractChannel(const LogChannel& channel, const uint8_t* records, size_t count, size_t recordSize, float* out) {
+	if (channel.offset + channelSize(channel.type) > recordSize) {
+		std::fill(out, out + count, 0);
+		return;
+	}
+
+	switch (channel.type) {
+	case LogChannelType::U8:
+		return extract<uint8_t>(records, count, recordSize, channel.offset, channel.scale, out);
+	case LogChannelType::I8:
+		return extract<int8_t>(records, count, recordSize, channel.offset, channel.scale, out);
+	case LogChannelType::U16:
+		return extract<uint16_t>(records, count, recordSize, channel.offset, channel.scale, out);
+	case LogChannelType::I16:
+		return extract<int16_t>(records, count, recordSize, channel.offset, channel.scale, out);
+	case LogChannelType::U32:
+		return extract<uint32_t>(records, count, recordSize, channel.offset, channel.scale, out);
+	case LogChannelType::I32:
+		return extract<int32_t>(records, count, recordSize, channel.offset, channel.scale, out);
+	case LogChannelType::F32:
+		return extract<float>(records, count, recordSize, channel.offset, channel.scale, out);
+	}
+}
+
+size_t LogReader::readColumns(size_t firstBlock, size_t blockCount, const LogChannel* channels, size_t channelCount,
+		LogColumns& columns, size_t threads) const {
+	firstBlock = std::min(firstBlock, m_index.size());
+	blockCount = std::min(blockCount, m_index.size() - firstBlock);
+
+	uint64_t base = blockCount ? m_index[firstBlock].firstRecord : 0;
+	uint64_t total = blockCount ? m_index[firstBlock + blockCount - 1].firstRecord
+		+ m_index[firstBlock + blockCount - 1].recordCount - base : 0;
+
+	// every block has its rows reserved, workers never touch the same element
+	columns.timestamps.resize(total);
+	columns.values.resize(channelCount);
+	for (auto& column : columns.values) {
+		column.resize(total);
+	}
+
+	std::vector<uint8_t> ok(blockCount);
+	std::atomic<size_t> next(0);
+
+	auto worker = [&]() {
+		std::vector<uint8_t> records;
+		std::vector<uint64_t> timestamps;
+
+		for (size_t i = next++; i < blockCount; i = next++) {
+			size_t block = firstBlock + i;
+			if (!readBlock(block, records, timestamps)) {
+				continue;
+			}
+
+			size_t row = m_index[block].firstRecord - base;
+			std::copy(timestamps.begin(), timestamps.end(), columns.timestamps.begin() + row);
+			for (size_t c = 0; c < channelCount; c++) {
+				extractChannel(channels[c], records.data(), timestamps.size(), m_recordSize, columns.values[c].data() + row);
+			}
+			ok[i] = 1;
+		}
+	};
+
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = std::min(threads, std::max<size_t>(blockCount, 1));
+
+	std::vector<std::thread> pool;
+	for (size_t i = 1; i < threads; i++) {
+		pool.emplace_back(worker);
+	}
+	worker();
+	for (auto& t : pool) {
+		t.join();
+	}
+
+	// drop rows of corrupt blocks
+	size_t failed = std::count(ok.begin(), ok.end(), 0);
+	if (failed) {
+		size_t out = 0;
+		for (size_t i = 0; i < blockCount; i++) {
+			const auto& entry = m_index[firstBlock + i];
+			if (!ok[i]) {
+				continue;
+			}
+
+			size_t row = entry.firstRecord - base;
+			if (row != out) {
+				std::copy_n(columns.timestamps.begin() + row, entry.recordCount, columns.timestamps.begin() + out);
+				for (auto& column : columns.values) {
+					std::copy_n(column.begin() + row, entry.recordCount, column.begin() + out);
+				}
+			}
+			out += entry.recordCount;
+		}
+
+		columns.timestamps.resize(out);
+		for (auto& column : columns.values) {
+			column.resize(out);
+		}
+	}
+
+	return failed;
+}
+
+bool LogReaderSource::next(TimelineSourceEvent& event) {
+	while (m_record >= m_timestamps.size()) {
+		if (m_block >= m_reader.getBlockCount()) {
+			return false;
+		}
+
+		m_record = 0;
+		if (!m_reader.readBlock(m_block++, m_records, m_timestamps)) {
+			m_timestamps.clear();
+		}
+	}
+
+	size_t recordSize = m_reader.getRecordSize();
+	event.timestamp = m_timestamps[m_record];
+	event.data = m_records.data() + m_record * recordSize;
+	event.size = recordSize;
+	m_record++;
+	return true;
+}
@@ -0,0 +1,470 @@
+/**
+ * @file telemetry_server.cpp
+ *
+ * Live telemetry over datagram sockets, see telemetry_server.h
+ */
+
+#include <gerefi/telemetry_server.h>
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// recvmmsg rounds per poll(), a flood of requests does not stall the simulator
+#define TELEMETRY_RECEIVE_ROUNDS 4
+
+// stands in for fragments without a buffer
+static const uint8_t zeros[TELEMETRY_MAX_PAYLOAD] = {};
+
+uint64_t telemetryNowUs() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+static size_t totalSize(FragmentList fragments) {
+	size_t size = 0;
+	for (size_t i = 0; i < fragments.count; i++) {
+		size += fragments.fragments[i].size;
+	}
+	return size;
+}
+
+static bool isSameAddress(const sockaddr_storage& a, socklen_t aLength, const sockaddr_storage& b, socklen_t bLength) {
+	return aLength == bLength && memcmp(&a, &b, aLength) == 0;
+}
+
+TelemetryServer::TelemetryServer(FragmentList fragments)
+	: m_fragments(fragments)
+	, m_totalSize(totalSize(fragments))
+{
+	memset(m_out, 0, sizeof(m_out));
+	memset(m_messages, 0, sizeof(m_messages));
+	for (size_t i = 0; i < TELEMETRY_BATCH; i++) {
+		m_messages[i].msg_hdr.msg_name = &m_out[i].address;
+		m_messages[i].msg_hdr.msg_iov = m_out[i].iov;
+	}
+}
+
+TelemetryServer::~TelemetryServer() {
+	close();
+}
+
+void TelemetryServer::close() {
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+	if (m_unixPath[0]) {
+		unlink(m_unixPath);
+		m_unixPath[0] = 0;
+	}
+	for (auto& subscriber : m_subscribers) {
+		subscriber.active = false;
+	}
+	m_queued = 0;
+}
+
+bool TelemetryServer::listenUnix(const char* path) {
+	close();
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return false;
+	}
+	strcpy(address.sun_path, path);
+
+	m_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_fd < 0) {
+		return false;
+	}
+
+	unlink(path);
+	if (bind(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+		close();
+		return false;
+	}
+
+	strcpy(m_unixPath, path);
+	return true;
+}
+
+bool TelemetryServer::listenUdp(uint16_t port, const char* address) {
+	close();
+
+	sockaddr_in in = {};
+	in.sin_family = AF_INET;
+	in.sin_port = htons(port);
+	if (inet_pton(AF_INET, address, &in.sin_addr) != 1) {
+		return false;
+	}
+
+	m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_fd < 0) {
+		return false;
+	}
+
+	if (bind(m_fd, reinterpret_cast<sockaddr*>(&in), sizeof(in)) != 0) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+uint16_t TelemetryServer::getPort() const {
+	sockaddr_in in = {};
+	socklen_t length = sizeof(in);
+	if (m_fd < 0 || getsockname(m_fd, reinterpret_cast<sockaddr*>(&in), &length) != 0 || in.sin_family != AF_INET) {
+		return 0;
+	}
+	return ntohs(in.sin_port);
+}
+
+size_t TelemetryServer::getSubscriberCount() const {
+	return std::count_if(m_subscribers, m_subscribers + TELEMETRY_MAX_SUBSCRIBERS, [](const Subscriber& s) {
+		return s.active;
+	});
+}
+
+void TelemetryServer::poll(uint64_t nowUs) {
+	if (m_fd < 0) {
+		return;
+	}
+
+	receive(nowUs);
+
+	for (size_t i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+		auto& subscriber = m_subscribers[i];
+		if (!subscriber.active || nowUs < subscriber.nextUs) {
+			continue;
+		}
+
+		queueRange(subscriber.address, subscriber.addressLength, subscriber.sequence++,
+				subscriber.offset, subscriber.size, nowUs, i);
+		m_stats.snapshots++;
+
+		subscriber.nextUs += subscriber.periodUs;
+		if (subscriber.nextUs <= nowUs) {
+			// fell behind: skip missed snapshots rather than send a burst of them
+			subscriber.nextUs = nowUs + subscriber.periodUs;
+		}
+	}
+
+	// Live structs are read when messages go out: here, or in queueRange() once a batch is
+	// full. The simulator does not step during poll(), so all replies show the same moment.
+	flush();
+}
+
+void TelemetryServer::receive(uint64_t nowUs) {
+	TelemetryHeader requests[TELEMETRY_BATCH];
+	sockaddr_storage addresses[TELEMETRY_BATCH];
+	iovec iov[TELEMETRY_BATCH];
+	mmsghdr in[TELEMETRY_BATCH];
+
+	for (size_t round = 0; round < TELEMETRY_RECEIVE_ROUNDS; round++) {
+		memset(in, 0, sizeof(in));
+		for (size_t i = 0; i < TELEMETRY_BATCH; i++) {
+			iov[i] = { &requests[i], sizeof(requests[i]) };
+			in[i].msg_hdr.msg_name = &addresses[i];
+			in[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+			in[i].msg_hdr.msg_iov = &iov[i];
+			in[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int count = recvmmsg(m_fd, in, TELEMETRY_BATCH, MSG_DONTWAIT, nullptr);
+		if (count <= 0) {
+			return;
+		}
+
+		for (int i = 0; i < count; i++) {
+			const auto& message = in[i];
+			// a Unix socket client that did not bind has no address to answer to
+			if (message.msg_len != sizeof(TelemetryHeader) || (message.msg_hdr.msg_flags & MSG_TRUNC)
+					|| message.msg_hdr.msg_namelen <= sizeof(sa_family_t)
+					|| requests[i].magic != TELEMETRY_MAGIC) {
+				m_stats.badRequests++;
+				continue;
+			}
+			handle(requests[i], addresses[i], message.msg_hdr.msg_namelen, nowUs);
+		}
+
+		if (static_cast<size_t>(count) < TELEMETRY_BATCH) {
+			return;
+		}
+	}
+}
+
+void TelemetryServer::handle(const TelemetryHeader& request, const sockaddr_storage& address, socklen_t addressLength, uint64_t nowUs) {
+	m_stats.requests++;
+
+	auto op = static_cast<TelemetryOp>(request.op);
+	bool validRange = request.size > 0 && request.offset <= m_totalSize && request.size <= m_totalSize - request.offset;
+
+	switch (op) {
+	case TelemetryOp::Read:
+		if (!validRange) {
+			break;
+		}
+		queueRange(address, addressLength, request.sequence, request.offset, request.size, nowUs);
+		return;
+	case TelemetryOp::Subscribe: {
+		if (!validRange || request.periodUs == 0) {
+			break;
+		}
+
+		Subscriber* slot = nullptr;
+		for (auto& subscriber : m_subscribers) {
+			if (subscriber.active && subscriber.offset == request.offset
+					&& isSameAddress(subscriber.address, subscriber.addressLength, address, addressLength)) {
+				slot = &subscriber;
+				break;
+			}
+			if (!subscriber.active && !slot) {
+				slot = &subscriber;
+			}
+		}
+		if (!slot) {
+			// full
+			break;
+		}
+
+		if (!slot->active) {
+			slot->active = true;
+			slot->address = address;
+			slot->addressLength = addressLength;
+			slot->sequence = 0;
+			slot->sendErrors = 0;
+		}
+		slot->offset = request.offset;
+		slot->size = request.size;
+		slot->periodUs = request.periodUs;
+		// first snapshot right away
+		slot->nextUs = nowUs;
+		return;
+	}
+	case TelemetryOp::Unsubscribe:
+		for (auto& subscriber : m_subscribers) {
+			if (subscriber.active && isSameAddress(subscriber.address, subscriber.addressLength, address, addressLength)) {
+				subscriber.active = false;
+			}
+		}
+		return;
+	default:
+		break;
+	}
+
+	m_stats.badRequests++;
+}
+
+void TelemetryServer::queueRange(const sockaddr_storage& address, socklen_t addressLength, uint32_t sequence,
+		uint32_t offset, uint32_t size, uint64_t nowUs, int subscriber) {
+	uint32_t position = offset;
+	uint32_t end = offset + size;
+
+	while (position < end) {
+		if (m_queued == TELEMETRY_BATCH) {
+			flush();
+		}
+
+		auto& out = m_out[m_queued];
+		uint32_t start = position;
+		size_t iovCount = 1;
+
+		// one iovec per fragment touched, pointing into the live struct
+		while (position < end && iovCount < TELEMETRY_MAX_IOV && position - start < TELEMETRY_MAX_PAYLOAD) {
+			size_t room = std::min<size_t>(TELEMETRY_MAX_PAYLOAD - (position - start), end - position);
+			uint8_t* ptr;
+			size_t length = getRangePtr(&ptr, m_fragments, position, room);
+			out.iov[iovCount].iov_base = ptr ? ptr : const_cast<uint8_t*>(zeros);
+			out.iov[iovCount].iov_len = length;
+			iovCount++;
+			position += length;
+		}
+
+		out.header = {};
+		out.header.magic = TELEMETRY_MAGIC;
+		out.header.op = static_cast<uint8_t>(TelemetryOp::Data);
+		out.header.flags = position == end ? TELEMETRY_FLAG_LAST : 0;
+		out.header.sequence = sequence;
+		out.header.offset = start;
+		out.header.size = position - start;
+		out.header.timeUs = nowUs;
+		out.iov[0] = { &out.header, sizeof(out.header) };
+		memcpy(&out.address, &address, addressLength);
+		out.subscriber = subscriber;
+
+		auto& message = m_messages[m_queued].msg_hdr;
+		message.msg_namelen = addressLength;
+		message.msg_iovlen = iovCount;
+		m_queued++;
+	}
+}
+
+void TelemetryServer::flush() {
+	size_t sent = 0;
+	while (sent < m_queued) {
+		int count = sendmmsg(m_fd, m_messages + sent, m_queued - sent, MSG_DONTWAIT);
+		m_stats.batches++;
+
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			// first message can not go out (receive buffer full, client gone): drop it, go on with the rest
+			sendFailed(m_out[sent], errno);
+			sent++;
+			continue;
+		}
+
+		for (int i = 0; i < count; i++) {
+			int subscriber = m_out[sent + i].subscriber;
+			if (subscriber >= 0) {
+				m_subscribers[subscriber].sendErrors = 0;
+			}
+		}
+		m_stats.messages += count;
+		sent += count;
+	}
+	m_queued = 0;
+}
+
+void TelemetryServer::sendFailed(const Outgoing& out, int error) {
+	m_stats.sendErrors++;
+	if (out.subscriber < 0) {
+		return;
+	}
+
+	auto& subscriber = m_subscribers[out.subscriber];
+	subscriber.sendErrors++;
+	// nobody bound to the address any more, or a client that stopped reading
+	bool gone = error == ECONNREFUSED || error == ENOENT;
+	if (subscriber.active && (gone || subscriber.sendErrors >= TELEMETRY_MAX_SEND_ERRORS)) {
+		subscriber.active = false;
+		m_stats.expired++;
+	}
+}
+
+TelemetryClient::~TelemetryClient() {
+	close();
+}
+
+void TelemetryClient::close() {
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+bool TelemetryClient::connectUnix(const char* path) {
+	close();
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return false;
+	}
+	strcpy(address.sun_path, path);
+
+	m_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (m_fd < 0) {
+		return false;
+	}
+
+	// autobind to an abstract address so the server has somewhere to answer
+	sockaddr_un local = {};
+	local.sun_family = AF_UNIX;
+	if (bind(m_fd, reinterpret_cast<sockaddr*>(&local), sizeof(sa_family_t)) != 0
+			|| connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool TelemetryClient::connectUdp(const char* address, uint16_t port) {
+	close();
+
+	sockaddr_in in = {};
+	in.sin_family = AF_INET;
+	in.sin_port = htons(port);
+	if (inet_pton(AF_INET, address, &in.sin_addr) != 1) {
+		return false;
+	}
+
+	m_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (m_fd < 0) {
+		return false;
+	}
+
+	if (connect(m_fd, reinterpret_cast<sockaddr*>(&in), sizeof(in)) != 0) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool TelemetryClient::request(TelemetryOp op, uint32_t sequence, uint32_t offset, uint32_t size, uint32_t periodUs) {
+	TelemetryHeader header = {};
+	header.magic = TELEMETRY_MAGIC;
+	header.op = static_cast<uint8_t>(op);
+	header.sequence = sequence;
+	header.offset = offset;
+	header.size = size;
+	header.periodUs = periodUs;
+	return m_fd >= 0 && send(m_fd, &header, sizeof(header), 0) == sizeof(header);
+}
+
+bool TelemetryClient::read(uint32_t sequence, uint32_t offset, uint32_t size) {
+	return request(TelemetryOp::Read, sequence, offset, size, 0);
+}
+
+bool TelemetryClient::subscribe(uint32_t offset, uint32_t size, uint32_t periodUs) {
+	return request(TelemetryOp::Subscribe, 0, offset, size, periodUs);
+}
+
+bool TelemetryClient::unsubscribe() {
+	return request(TelemetryOp::Unsubscribe, 0, 0, 0, 0);
+}
+
+bool TelemetryClient::receive(TelemetryHeader& header, uint8_t* payload, size_t payloadSize, int timeoutMs) {
+	if (m_fd < 0) {
+		return false;
+	}
+
+	if (timeoutMs > 0) {
+		pollfd pfd = { m_fd, POLLIN, 0 };
+		if (::poll(&pfd, 1, timeoutMs) <= 0) {
+			return false;
+		}
+	}
+
+	while (true) {
+		iovec iov[2] = { { &header, sizeof(header) }, { payload, payloadSize } };
+		msghdr message = {};
+		message.msg_iov = iov;
+		message.msg_iovlen = 2;
+
+		ssize_t length = recvmsg(m_fd, &message, MSG_DONTWAIT);
+		if (length < 0) {
+			return false;
+		}
+
+		// anything else on this socket is not ours
+		if (static_cast<size_t>(length) >= sizeof(header) && header.magic == TELEMETRY_MAGIC
+				&& header.op == static_cast<uint8_t>(TelemetryOp::Data)) {
+			return true;
+		}
+	}
+}
+
+#endif // __linux__
@@ -0,0 +1,128 @@
+/**
+ * @file timeline_merge.cpp
+ *
+ * k-way merge of event streams, see timeline_merge.h
+ */
+
+#include <gerefi/timeline_merge.h>
+
+bool TimelineMerge::addSource(TimelineSource& source, TimelineClock clock, efitick_t offset) {
+	if (m_started || m_streamCount >= TIMELINE_MAX_STREAMS) {
+		return false;
+	}
+
+	auto& stream = m_streams[m_streamCount++];
+	stream.source = &source;
+	stream.clock = clock;
+	stream.offset = offset;
+	stream.seeded = false;
+	// nothing is out of order against the first event
+	stream.time = INT64_MIN;
+	return true;
+}
+
+bool TimelineMerge::advance(size_t index) {
+	auto& stream = m_streams[index];
+	if (!stream.source->next(stream.head)) {
+		return false;
+	}
+
+	efitick_t time;
+	if (stream.clock == TimelineClock::Wrapped32) {
+		uint32_t stamp = static_cast<uint32_t>(stream.head.timestamp);
+		if (stream.seeded) {
+			stream.unwrapped += static_cast<int32_t>(stamp - static_cast<uint32_t>(stream.unwrapped));
+		} else {
+			// whatever the timer showed when the log started, in [0, 2^32)
+			stream.unwrapped = stamp;
+			stream.seeded = true;
+		}
+		time = stream.unwrapped;
+	} else {
+		time = static_cast<efitick_t>(stream.head.timestamp);
+	}
+	time += stream.offset;
+
+	if (time < stream.time) {
+		m_stats.outOfOrder++;
+	}
+	stream.time = time;
+	return true;
+}
+
+bool TimelineMerge::isBefore(uint8_t a, uint8_t b) const {
+	efitick_t ta = m_streams[a].time;
+	efitick_t tb = m_streams[b].time;
+	return ta < tb || (ta == tb && a < b);
+}
+
+void TimelineMerge::siftDown(size_t i) {
+	while (true) {
+		size_t smallest = i;
+		size_t left = 2 * i + 1;
+		size_t right = left + 1;
+		if (left < m_heapSize && isBefore(m_heap[left], m_heap[smallest])) {
+			smallest = left;
+		}
+		if (right < m_heapSize && isBefore(m_heap[right], m_heap[smallest])) {
+			smallest = right;
+		}
+		if (smallest == i) {
+			return;
+		}
+
+		uint8_t t = m_heap[i];
+		m_heap[i] = m_heap[smallest];
+		m_heap[smallest] = t;
+		i = smallest;
+	}
+}
+
+void TimelineMerge::siftUp(size_t i) {
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+		if (!isBefore(m_heap[i], m_heap[parent])) {
+			return;
+		}
+
+		uint8_t t = m_heap[i];
+		m_heap[i] = m_heap[parent];
+		m_heap[parent] = t;
+		i = parent;
+	}
+}
+
+bool TimelineMerge::next(TimelineEvent& event) {
+	if (!m_started) {
+		m_started = true;
+		for (size_t i = 0; i < m_streamCount; i++) {
+			if (advance(i)) {
+				m_heap[m_heapSize++] = i;
+				siftUp(m_heapSize - 1);
+			}
+		}
+	} else if (m_emitted >= 0) {
+		// the head handed out last time was kept valid until now: replace it at the top
+		if (advance(m_emitted)) {
+			siftDown(0);
+		} else {
+			m_heap[0] = m_heap[--m_heapSize];
+			siftDown(0);
+		}
+	}
+
+	if (m_heapSize == 0) {
+		m_emitted = -1;
+		return false;
+	}
+
+	// earliest head stays on top until next call
+	m_emitted = m_heap[0];
+	const auto& stream = m_streams[m_emitted];
+	event.time = stream.time;
+	event.stream = m_emitted;
+	event.data = stream.head.data;
+	event.size = stream.head.size;
+	m_stats.events++;
+	return true;
+}
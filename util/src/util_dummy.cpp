@@ -2,3 +2,7 @@
 
 #include <gerefi/arrays.h>
 #include <gerefi/interpolation.h>
+#include "static_vector.h"
+#include "flat_map.h"
+#include "bitset.h"
+#include "object_pool.h"
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "bitset.h"
+
+static constexpr size_t sumOfSet() {
+	bitset<100> bits;
+	bits.set(3);
+	bits.set(64);
+	bits.set(99);
+	size_t sum = 0;
+	for (size_t i : bits) {
+		sum += i;
+	}
+	return sum;
+}
+
+static_assert(sumOfSet() == 3 + 64 + 99);
+
+TEST(Util_Bitset, setTest) {
+	bitset<70> bits;
+	EXPECT_TRUE(bits.none());
+	EXPECT_EQ(70u, bits.findFirst());
+
+	bits.set(0);
+	bits.set(31);
+	bits.set(32);
+	bits.set(69);
+	EXPECT_TRUE(bits.test(31));
+	EXPECT_FALSE(bits.test(30));
+	EXPECT_EQ(4u, bits.count());
+
+	bits.set(31, false);
+	bits.reset(0);
+	EXPECT_EQ(2u, bits.count());
+	EXPECT_EQ(32u, bits.findFirst());
+
+	bits.reset();
+	EXPECT_FALSE(bits.any());
+}
+
+TEST(Util_Bitset, iteration) {
+	bitset<130> bits;
+	const size_t set[] = { 1, 2, 31, 33, 95, 96, 128, 129 };
+	for (auto i : set) {
+		bits.set(i);
+	}
+
+	size_t n = 0;
+	for (size_t i : bits) {
+		ASSERT_LT(n, sizeof(set) / sizeof(set[0]));
+		EXPECT_EQ(set[n], i);
+		n++;
+	}
+	EXPECT_EQ(8u, n);
+
+	EXPECT_EQ(31u, bits.findNext(3));
+	EXPECT_EQ(128u, bits.findNext(97));
+	EXPECT_EQ(130u, bits.findNext(130));
+}
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/config_diff.h>
+#include <gerefi/cpu_features.h>
+
+#include <cstring>
+#include <vector>
+
+struct TestConfig {
+	uint8_t data[1000];
+};
+
+static TestConfig makeConfig() {
+	TestConfig config;
+	for (size_t i = 0; i < sizeof(config.data); i++) {
+		config.data[i] = i * 7;
+	}
+	return config;
+}
+
+TEST(Util_ConfigDiff, ranges) {
+	TestConfig a = makeConfig();
+	TestConfig b = a;
+	ConfigRange ranges[8];
+
+	EXPECT_EQ(0u, configDiff(&a, &b, sizeof(a), ranges, 8));
+
+	b.data[5]++;
+	b.data[9]++;	// within merge gap of 5
+	b.data[100]++;
+	b.data[101]++;
+	b.data[999]++;
+
+	ASSERT_EQ(3u, configDiff(&a, &b, sizeof(a), ranges, 8));
+	EXPECT_EQ(5u, ranges[0].offset);
+	EXPECT_EQ(5u, ranges[0].size);
+	EXPECT_EQ(100u, ranges[1].offset);
+	EXPECT_EQ(2u, ranges[1].size);
+	EXPECT_EQ(999u, ranges[2].offset);
+	EXPECT_EQ(1u, ranges[2].size);
+
+	// no merging: every change on its own
+	ConfigDiffOptions exact;
+	exact.mergeGap = 0;
+	EXPECT_EQ(4u, configDiff(&a, &b, sizeof(a), ranges, 8, exact));
+
+	// out of ranges: last one covers the rest
+	ASSERT_EQ(2u, configDiff(&a, &b, sizeof(a), ranges, 2));
+	EXPECT_EQ(100u, ranges[1].offset);
+	EXPECT_EQ(900u, ranges[1].size);
+}
+
+TEST(Util_ConfigDiff, alignment) {
+	TestConfig a = makeConfig();
+	TestConfig b = a;
+	b.data[5]++;
+	b.data[70]++;
+	b.data[998]++;
+
+	ConfigDiffOptions flash;
+	flash.alignment = 32;
+	ConfigRange ranges[8];
+	ASSERT_EQ(3u, configDiff(&a, &b, sizeof(a), ranges, 8, flash));
+	EXPECT_EQ(0u, ranges[0].offset);
+	EXPECT_EQ(32u, ranges[0].size);
+	EXPECT_EQ(64u, ranges[1].offset);
+	EXPECT_EQ(32u, ranges[1].size);
+	// clipped at the end of the image
+	EXPECT_EQ(992u, ranges[2].offset);
+	EXPECT_EQ(8u, ranges[2].size);
+}
+
+TEST(Util_ConfigDiff, patchRoundTrip) {
+	TestConfig a = makeConfig();
+	TestConfig b = a;
+	uint32_t seed = 3;
+	for (int i = 0; i < 40; i++) {
+		seed = seed * 1103515245 + 12345;
+		b.data[(seed >> 8) % sizeof(b.data)] ^= 0x5A;
+	}
+
+	ConfigRange ranges[64];
+	size_t count = configDiff(&a, &b, sizeof(a), ranges, 64);
+	ASSERT_GT(count, 0u);
+
+	uint8_t patch[2000];
+	size_t size = configWritePatch(&b, ranges, count, patch, sizeof(patch));
+	ASSERT_EQ(configPatchSize(ranges, count), size);
+	EXPECT_LT(size, sizeof(b));
+	EXPECT_EQ(0u, configWritePatch(&b, ranges, count, patch, size - 1));
+
+	TestConfig c = a;
+	ASSERT_TRUE(configApplyPatch(&c, sizeof(c), patch, size));
+	EXPECT_EQ(0, memcmp(&b, &c, sizeof(c)));
+
+	// truncated or out of bounds patches change nothing
+	TestConfig d = a;
+	EXPECT_FALSE(configApplyPatch(&d, sizeof(d), patch, size - 1));
+	EXPECT_FALSE(configApplyPatch(&d, sizeof(d) - 500, patch, size));
+	EXPECT_EQ(0, memcmp(&a, &d, sizeof(d)));
+}
+
+TEST(Util_ConfigDiff, variantsAgree) {
+#if EFI_CPU_DISPATCH
+	// registered, and not left on the plain C++ variant where there is something better
+	const CpuKernelBase* kernel = nullptr;
+	for (size_t i = 0; i < cpuGetKernelCount(); i++) {
+		if (strcmp(cpuGetKernel(i).getName(), "config_diff") == 0) {
+			kernel = &cpuGetKernel(i);
+		}
+	}
+	ASSERT_NE(nullptr, kernel);
+#if defined(__x86_64__) || defined(__i386__)
+	if (cpuHasFeature(CpuFeature::Avx2)) {
+		EXPECT_STRNE("scalar", kernel->getVariant());
+	}
+#endif
+#endif
+
+	std::vector<uint8_t> a(4096), b;
+	for (size_t i = 0; i < a.size(); i++) {
+		a[i] = i * 13;
+	}
+
+	for (size_t change = 0; change < 200; change += 3) {
+		b = a;
+		b[change * 17 % a.size()]++;
+		b[(change * 31 + 5) % a.size()]++;
+
+		ConfigRange expected[4], actual[4];
+		cpuForceScalar(true);
+		size_t expectedCount = configDiff(a.data(), b.data(), a.size(), expected, 4);
+		cpuForceScalar(false);
+		size_t actualCount = configDiff(a.data(), b.data(), a.size(), actual, 4);
+
+		ASSERT_EQ(expectedCount, actualCount);
+		for (size_t i = 0; i < actualCount; i++) {
+			EXPECT_EQ(expected[i].offset, actual[i].offset);
+			EXPECT_EQ(expected[i].size, actual[i].size);
+		}
+	}
+}
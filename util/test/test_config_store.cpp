@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/config_store.h>
+#include <gerefi/flash_emulator.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "test_temp_path.h"
+
+struct StoreConfig {
+	uint8_t data[500];
+};
+
+#define SECTOR_SIZE 2048
+#define SECTOR_COUNT 3
+
+static StoreConfig makeConfig(uint8_t seed) {
+	StoreConfig config;
+	for (size_t i = 0; i < sizeof(config.data); i++) {
+		config.data[i] = i * 7 + seed;
+	}
+	return config;
+}
+
+TEST(Util_ConfigStore, saveAndLoad) {
+	FlashEmulator flash(nullptr, SECTOR_SIZE, SECTOR_COUNT);
+	StoreConfig shadow, config = makeConfig(0);
+
+	{
+		ConfigStore store(flash, &shadow, sizeof(config));
+		EXPECT_FALSE(store.load(&config));
+		EXPECT_EQ(-1, store.getActiveSector());
+
+		ASSERT_TRUE(store.save(&config));
+		config.data[10] = 1;
+		config.data[300] = 2;
+		ASSERT_TRUE(store.save(&config));
+		// unchanged: nothing written
+		size_t free = store.getFreeBytes();
+		ASSERT_TRUE(store.save(&config));
+		EXPECT_EQ(free, store.getFreeBytes());
+		EXPECT_EQ(1u, store.getStats().records);
+	}
+
+	// reboot
+	StoreConfig loaded = {};
+	ConfigStore store(flash, &shadow, sizeof(config));
+	ASSERT_TRUE(store.load(&loaded));
+	EXPECT_EQ(0, memcmp(&config, &loaded, sizeof(config)));
+	EXPECT_FALSE(store.needsCompaction());
+
+	// size changed, e.g. new firmware: not ours
+	StoreConfig other;
+	ConfigStore wrongSize(flash, &other, sizeof(config) - 4);
+	EXPECT_FALSE(wrongSize.load(&other));
+}
+
+TEST(Util_ConfigStore, compactionRotatesSectors) {
+	FlashEmulator flash(nullptr, SECTOR_SIZE, SECTOR_COUNT, 8);
+	StoreConfig shadow, config = makeConfig(0);
+	ConfigStore store(flash, &shadow, sizeof(config));
+	ASSERT_TRUE(store.save(&config));
+
+	for (int i = 0; i < 300; i++) {
+		config.data[(i * 37) % sizeof(config.data)]++;
+		ASSERT_TRUE(store.save(&config));
+		if (store.needsCompaction()) {
+			ASSERT_TRUE(store.compact());
+		}
+	}
+
+	EXPECT_GT(store.getStats().compactions, 6u);
+	// wear is spread evenly
+	for (size_t i = 1; i < SECTOR_COUNT; i++) {
+		EXPECT_NEAR(flash.getEraseCount(0), flash.getEraseCount(i), 1);
+	}
+	// small changes cost a fraction of rewriting the image
+	EXPECT_LT(store.getStats().getWriteAmplification(), 40);
+
+	StoreConfig loaded;
+	ConfigStore reboot(flash, &shadow, sizeof(config));
+	ASSERT_TRUE(reboot.load(&loaded));
+	EXPECT_EQ(0, memcmp(&config, &loaded, sizeof(config)));
+	EXPECT_EQ(store.getActiveSector(), reboot.getActiveSector());
+	EXPECT_EQ(store.getGeneration(), reboot.getGeneration());
+}
+
+TEST(Util_ConfigStore, powerLoss) {
+	StoreConfig before = makeConfig(0);
+	StoreConfig after = before;
+	after.data[3] = 0;
+	after.data[250] = 0;
+
+	// cut power at every byte of a save, and of a compaction
+	for (int compaction = 0; compaction < 2; compaction++) {
+		for (uint32_t cut = 0;; cut++) {
+			FlashEmulator flash(nullptr, SECTOR_SIZE, SECTOR_COUNT, 4);
+			StoreConfig shadow;
+			ConfigStore store(flash, &shadow, sizeof(before));
+			ASSERT_TRUE(store.save(&before));
+
+			flash.injectPowerLoss(cut);
+			bool saved = compaction ? store.compact() : store.save(&after);
+			flash.powerCycle();
+
+			StoreConfig loaded;
+			ConfigStore reboot(flash, &shadow, sizeof(before));
+			ASSERT_TRUE(reboot.load(&loaded)) << cut;
+			bool isBefore = memcmp(&before, &loaded, sizeof(loaded)) == 0;
+			bool isAfter = !compaction && memcmp(&after, &loaded, sizeof(loaded)) == 0;
+			ASSERT_TRUE(isBefore || isAfter) << cut;
+			if (saved) {
+				EXPECT_FALSE(isBefore && !compaction);
+				break;
+			}
+
+			// keeps working after a torn write
+			StoreConfig next = makeConfig(9);
+			ASSERT_TRUE(reboot.save(&next)) << cut;
+			ConfigStore again(flash, &shadow, sizeof(before));
+			ASSERT_TRUE(again.load(&loaded));
+			ASSERT_EQ(0, memcmp(&next, &loaded, sizeof(loaded))) << cut;
+		}
+	}
+}
+
+TEST(Util_ConfigStore, corruptRecord) {
+	FlashEmulator flash(nullptr, SECTOR_SIZE, SECTOR_COUNT);
+	StoreConfig shadow, config = makeConfig(0);
+	ConfigStore store(flash, &shadow, sizeof(config));
+	ASSERT_TRUE(store.save(&config));
+	StoreConfig first = config;
+
+	config.data[100] = 0;
+	ASSERT_TRUE(store.save(&config));
+
+	// flip a bit in the data of the patch record, after the snapshot
+	size_t record = store.getActiveSector() * SECTOR_SIZE + SECTOR_SIZE - store.getFreeBytes() - 6;
+	flash.getData()[record] ^= 1;
+
+	StoreConfig loaded;
+	ConfigStore reboot(flash, &shadow, sizeof(config));
+	ASSERT_TRUE(reboot.load(&loaded));
+	EXPECT_EQ(0, memcmp(&first, &loaded, sizeof(loaded)));
+	EXPECT_EQ(1u, reboot.getStats().badRecords);
+	EXPECT_TRUE(reboot.needsCompaction());
+
+	// next save goes to a clean sector
+	ASSERT_TRUE(reboot.save(&config));
+	EXPECT_NE(store.getActiveSector(), reboot.getActiveSector());
+}
+
+TEST(Util_ConfigStore, fileBacked) {
+	std::string file = tempPath("config_store_test");
+	const char* path = file.c_str();
+	remove(path);
+
+	StoreConfig shadow, config = makeConfig(5);
+	{
+		FlashEmulator flash(path, SECTOR_SIZE, SECTOR_COUNT);
+		ConfigStore store(flash, &shadow, sizeof(config));
+		ASSERT_TRUE(store.save(&config));
+	}
+
+	StoreConfig loaded;
+	{
+		FlashEmulator flash(path, SECTOR_SIZE, SECTOR_COUNT);
+		ConfigStore store(flash, &shadow, sizeof(config));
+		ASSERT_TRUE(store.load(&loaded));
+		EXPECT_EQ(0, memcmp(&config, &loaded, sizeof(loaded)));
+	}
+
+	// different geometry starts erased
+	{
+		FlashEmulator flash(path, SECTOR_SIZE, SECTOR_COUNT + 1);
+		ConfigStore store(flash, &shadow, sizeof(config));
+		EXPECT_FALSE(store.load(&loaded));
+	}
+
+	remove(path);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/cpu_features.h>
+#include <gerefi/crc.h>
+
+#include <cstring>
+
+static const CpuKernelBase* findKernel(const char* name) {
+	for (size_t i = 0; i < cpuGetKernelCount(); i++) {
+		if (strcmp(cpuGetKernel(i).getName(), name) == 0) {
+			return &cpuGetKernel(i);
+		}
+	}
+	return nullptr;
+}
+
+// static constructor of another file, may run before crc.cpp's registration
+static const uint32_t staticInitCrc = crc32("123456789", 9);
+
+TEST(Util_CpuFeatures, kernelUsableFromStaticInit) {
+	EXPECT_EQ(0xCBF43926u, staticInitCrc);
+}
+
+TEST(Util_CpuFeatures, forceScalar) {
+	bool wasForced = cpuIsForcedScalar();
+
+	cpuForceScalar(true);
+	EXPECT_EQ(0u, cpuGetFeatures());
+	for (size_t i = 0; i < cpuGetKernelCount(); i++) {
+		EXPECT_STREQ("scalar", cpuGetKernel(i).getVariant()) << cpuGetKernel(i).getName();
+	}
+
+	cpuForceScalar(wasForced);
+}
+
+TEST(Util_CpuFeatures, reportsKernels) {
+#if EFI_CPU_DISPATCH
+	auto crc = findKernel("crc32");
+	ASSERT_NE(nullptr, crc);
+	ASSERT_NE(nullptr, crc->getVariant());
+	printf("crc32 variant: %s\n", crc->getVariant());
+#endif
+
+	EXPECT_STREQ("pclmul", cpuFeatureName(CpuFeature::Pclmul));
+}
+
+TEST(Util_CpuFeatures, crc32VariantsAgree) {
+	uint8_t data[1100];
+	uint32_t seed = 1;
+	for (auto& b : data) {
+		seed = seed * 1103515245 + 12345;
+		b = seed >> 16;
+	}
+
+	// fold block boundaries, tails and misaligned starts
+	for (uint32_t size = 0; size < 300; size += 7) {
+		for (uint32_t offset = 0; offset < 4; offset++) {
+			cpuForceScalar(true);
+			uint32_t expected = crc32inc(data + offset, 0x12345678, size);
+			cpuForceScalar(false);
+			ASSERT_EQ(expected, crc32inc(data + offset, 0x12345678, size)) << size << " " << offset;
+		}
+	}
+
+	cpuForceScalar(true);
+	uint32_t expected = crc32(data, sizeof(data));
+	cpuForceScalar(false);
+	EXPECT_EQ(expected, crc32(data, sizeof(data)));
+
+	// 'A' * 64, enough for the folding variant
+	char a[64];
+	memset(a, 'A', sizeof(a));
+	uint32_t chained = crc32inc(a + 1, crc32(a, 1), 63);
+	EXPECT_EQ(crc32(a, 64), chained);
+}
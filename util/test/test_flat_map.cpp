@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "flat_map.h"
+
+static constexpr int lookup(int key) {
+	flat_map<int, int, 4> map;
+	map.insert_or_assign(30, 3);
+	map.insert_or_assign(10, 1);
+	map.insert_or_assign(20, 2);
+	auto value = map.find(key);
+	return value ? *value : -1;
+}
+
+static_assert(lookup(20) == 2);
+static_assert(lookup(25) == -1);
+
+TEST(Util_FlatMap, sortedInsert) {
+	flat_map<uint8_t, uint16_t, 4> map;
+	EXPECT_TRUE(map.insert_or_assign(7, 70));
+	EXPECT_TRUE(map.insert_or_assign(2, 20));
+	EXPECT_TRUE(map.insert_or_assign(5, 50));
+	EXPECT_TRUE(map.insert_or_assign(9, 90));
+	EXPECT_TRUE(map.full());
+
+	// new key does not fit, existing one is updated
+	EXPECT_FALSE(map.insert_or_assign(1, 10));
+	EXPECT_TRUE(map.insert_or_assign(5, 55));
+
+	const uint8_t keys[] = { 2, 5, 7, 9 };
+	for (size_t i = 0; i < map.size(); i++) {
+		EXPECT_EQ(keys[i], map.keyAt(i));
+	}
+	EXPECT_EQ(55, *map.find(5));
+	EXPECT_EQ(nullptr, map.find(6));
+	EXPECT_FALSE(map.contains(0));
+	EXPECT_TRUE(map.contains(9));
+}
+
+TEST(Util_FlatMap, lowerBound) {
+	flat_map<int, int, 16> map;
+	EXPECT_EQ(0u, map.lower_bound(5));
+
+	for (int i = 0; i < 13; i++) {
+		map.insert_or_assign(i * 10, i);
+	}
+
+	for (int key = -5; key < 140; key++) {
+		size_t expected = 0;
+		while (expected < map.size() && map.keyAt(expected) < key) {
+			expected++;
+		}
+		ASSERT_EQ(expected, map.lower_bound(key)) << key;
+	}
+}
+
+TEST(Util_FlatMap, erase) {
+	flat_map<int, int, 8> map;
+	for (int i = 0; i < 5; i++) {
+		map.insert_or_assign(i, i * i);
+	}
+
+	EXPECT_TRUE(map.erase(2));
+	EXPECT_FALSE(map.erase(2));
+	EXPECT_EQ(4u, map.size());
+	EXPECT_EQ(9, *map.find(3));
+	EXPECT_EQ(16, *map.find(4));
+
+	map.clear();
+	EXPECT_TRUE(map.empty());
+}
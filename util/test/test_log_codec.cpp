@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/log_codec.h>
+#include <gerefi/log_decoder.h>
+
+#include <cstring>
+
+#define RECORD_SIZE 301u
+
+// output channels like: slow ramps, noisy sensors, counters, mostly constant
+static void makeRecords(std::vector<uint8_t>& records, size_t count) {
+	records.assign(count * RECORD_SIZE, 0);
+	uint32_t seed = 1;
+	for (size_t i = 0; i < count; i++) {
+		uint8_t* r = records.data() + i * RECORD_SIZE;
+		for (size_t j = 0; j < RECORD_SIZE; j++) {
+			r[j] = j;
+		}
+
+		uint32_t counter = i;
+		memcpy(r + 4, &counter, sizeof(counter));
+		r[20] = i / 8;
+		seed = seed * 1103515245 + 12345;
+		r[40] = seed >> 24;
+		r[300] = i % 3;
+	}
+}
+
+struct Sink {
+	std::vector<std::vector<uint8_t>> blocks;
+
+	static bool write(void* context, const uint8_t* data, size_t size) {
+		reinterpret_cast<Sink*>(context)->blocks.emplace_back(data, data + size);
+		return true;
+	}
+
+	size_t getSize() const {
+		size_t size = 0;
+		for (const auto& b : blocks) {
+			size += b.size();
+		}
+		return size;
+	}
+};
+
+static void roundTrip(uint8_t flags, bool lz) {
+	std::vector<uint8_t> input;
+	makeRecords(input, 1000);
+
+	Sink sink;
+	uint8_t previous[RECORD_SIZE];
+	uint8_t block[4096];
+	uint8_t lzBuffer[sizeof(block)];
+	LogEncoder encoder(RECORD_SIZE, previous, block, sizeof(block), lz ? lzBuffer : nullptr, Sink::write, &sink, flags);
+
+	for (size_t i = 0; i < 1000; i++) {
+		// going back in time is allowed
+		uint64_t timestamp = 1000000000000ull + i * 1000 - (i == 500 ? 1500 : 0);
+		ASSERT_TRUE(encoder.add(timestamp, input.data() + i * RECORD_SIZE));
+	}
+	ASSERT_TRUE(encoder.flush());
+
+	EXPECT_GT(sink.blocks.size(), 1u);
+	EXPECT_EQ(sink.getSize(), encoder.getStats().encodedBytes);
+	EXPECT_LT(encoder.getStats().getRatio(), 0.1f);
+
+	// every block decodes on its own
+	size_t index = 0;
+	std::vector<uint8_t> records;
+	std::vector<uint64_t> timestamps;
+	for (const auto& b : sink.blocks) {
+		LogBlockInfo info;
+		ASSERT_TRUE(logReadBlockHeader(b.data(), b.size(), info));
+		EXPECT_EQ(b.size(), info.getSize());
+		EXPECT_EQ(RECORD_SIZE, info.recordSize);
+		EXPECT_EQ(lz, (info.flags & LOG_FLAG_LZ) != 0);
+
+		ASSERT_TRUE(logDecodeBlock(b.data(), b.size(), records, timestamps));
+		ASSERT_EQ(info.recordCount, timestamps.size());
+		EXPECT_EQ(info.firstTimestamp, timestamps.front());
+		EXPECT_EQ(info.lastTimestamp, timestamps.back());
+
+		for (size_t i = 0; i < info.recordCount; i++, index++) {
+			ASSERT_EQ(0, memcmp(input.data() + index * RECORD_SIZE, records.data() + i * RECORD_SIZE, RECORD_SIZE)) << index;
+			EXPECT_EQ(1000000000000ull + index * 1000 - (index == 500 ? 1500 : 0), timestamps[i]);
+		}
+	}
+	EXPECT_EQ(1000u, index);
+}
+
+TEST(Util_LogCodec, roundTripXor) {
+	roundTrip(0, false);
+}
+
+TEST(Util_LogCodec, roundTripDelta) {
+	roundTrip(LOG_FLAG_DELTA, false);
+}
+
+TEST(Util_LogCodec, roundTripLz) {
+	roundTrip(LOG_FLAG_DELTA, true);
+}
+
+TEST(Util_LogCodec, denseChanges) {
+	// everything changes: bitmap form, LZ does not help and is skipped
+	Sink sink;
+	uint8_t previous[RECORD_SIZE], block[2048], lzBuffer[2048];
+	LogEncoder encoder(RECORD_SIZE, previous, block, sizeof(block), lzBuffer, Sink::write, &sink);
+
+	std::vector<uint8_t> input(20 * RECORD_SIZE);
+	uint32_t seed = 7;
+	for (auto& b : input) {
+		seed = seed * 1103515245 + 12345;
+		b = seed >> 24;
+	}
+	for (size_t i = 0; i < 20; i++) {
+		ASSERT_TRUE(encoder.add(i, input.data() + i * RECORD_SIZE));
+	}
+	ASSERT_TRUE(encoder.flush());
+
+	std::vector<uint8_t> records, all;
+	std::vector<uint64_t> timestamps;
+	for (const auto& b : sink.blocks) {
+		ASSERT_TRUE(logDecodeBlock(b.data(), b.size(), records, timestamps));
+		all.insert(all.end(), records.begin(), records.end());
+	}
+	EXPECT_EQ(input, all);
+}
+
+TEST(Util_LogCodec, corruptBlock) {
+	std::vector<uint8_t> input;
+	makeRecords(input, 50);
+
+	Sink sink;
+	uint8_t previous[RECORD_SIZE], block[8192], lzBuffer[8192];
+	LogEncoder encoder(RECORD_SIZE, previous, block, sizeof(block), lzBuffer, Sink::write, &sink);
+	for (size_t i = 0; i < 50; i++) {
+		encoder.add(i, input.data() + i * RECORD_SIZE);
+	}
+	encoder.flush();
+	ASSERT_EQ(1u, sink.blocks.size());
+
+	std::vector<uint8_t> records;
+	std::vector<uint64_t> timestamps;
+	auto b = sink.blocks[0];
+	ASSERT_TRUE(logDecodeBlock(b.data(), b.size(), records, timestamps));
+	EXPECT_FALSE(logDecodeBlock(b.data(), b.size() - 1, records, timestamps));
+
+	for (size_t i = 0; i < b.size(); i += 7) {
+		auto corrupt = b;
+		corrupt[i] ^= 0x10;
+		EXPECT_FALSE(logDecodeBlock(corrupt.data(), corrupt.size(), records, timestamps)) << i;
+	}
+
+	// sizes out of range: encoder refuses
+	uint8_t small[64];
+	LogEncoder tooSmall(RECORD_SIZE, previous, small, sizeof(small), nullptr, Sink::write, &sink);
+	EXPECT_FALSE(tooSmall.add(0, input.data()));
+}
@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/log_reader.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "test_temp_path.h"
+
+struct ReaderRecord {
+	uint16_t rpm;
+	int16_t clt;
+	float afr;
+	uint8_t flags;
+	uint8_t pad[23];
+};
+
+static bool appendBlock(void* context, const uint8_t* data, size_t size) {
+	auto& log = *reinterpret_cast<std::vector<uint8_t>*>(context);
+	log.insert(log.end(), data, data + size);
+	return true;
+}
+
+// record i at time 1000 * i
+static std::vector<uint8_t> makeLog(size_t count) {
+	std::vector<uint8_t> log;
+	ReaderRecord previous;
+	uint8_t block[1024];
+	LogEncoder encoder(sizeof(ReaderRecord), reinterpret_cast<uint8_t*>(&previous), block, sizeof(block),
+		nullptr, appendBlock, &log);
+
+	for (size_t i = 0; i < count; i++) {
+		ReaderRecord r = {};
+		r.rpm = 800 + i;
+		r.clt = i % 100 - 40;
+		r.afr = 14.7f + (i % 10) * 0.1f;
+		r.flags = i & 1;
+		encoder.add(1000 * i, reinterpret_cast<uint8_t*>(&r));
+	}
+	encoder.flush();
+	return log;
+}
+
+static const LogChannel channels[] = {
+	{ offsetof(ReaderRecord, rpm), LogChannelType::U16, 1 },
+	{ offsetof(ReaderRecord, clt), LogChannelType::I16, 0.5f },
+	{ offsetof(ReaderRecord, afr), LogChannelType::F32, 1 },
+};
+
+TEST(Util_LogReader, indexAndSeek) {
+	auto log = makeLog(5000);
+	LogReader reader;
+	ASSERT_TRUE(reader.open(log.data(), log.size()));
+
+	EXPECT_GT(reader.getBlockCount(), 10u);
+	EXPECT_EQ(5000u, reader.getRecordCount());
+	EXPECT_EQ(sizeof(ReaderRecord), reader.getRecordSize());
+	EXPECT_EQ(0u, reader.getSkippedBytes());
+
+	EXPECT_EQ(0u, reader.findBlock(0));
+	EXPECT_EQ(reader.getBlockCount(), reader.findBlock(5000 * 1000));
+	EXPECT_EQ(0u, reader.seek(0));
+	EXPECT_EQ(1234u, reader.seek(1234 * 1000));
+	EXPECT_EQ(1235u, reader.seek(1234 * 1000 + 1));
+	EXPECT_EQ(5000u, reader.seek(10000000));
+
+	size_t block = reader.findBlock(2500 * 1000);
+	EXPECT_LE(reader.getBlock(block).firstTimestamp, 2500u * 1000);
+	EXPECT_GE(reader.getBlock(block).lastTimestamp, 2500u * 1000);
+}
+
+TEST(Util_LogReader, columns) {
+	auto log = makeLog(5000);
+	LogReader reader;
+	ASSERT_TRUE(reader.open(log.data(), log.size()));
+
+	LogColumns single, parallel;
+	EXPECT_EQ(0u, reader.readColumns(0, reader.getBlockCount(), channels, 3, single, 1));
+	EXPECT_EQ(0u, reader.readColumns(0, reader.getBlockCount(), channels, 3, parallel, 4));
+	EXPECT_EQ(single.timestamps, parallel.timestamps);
+	EXPECT_EQ(single.values, parallel.values);
+
+	ASSERT_EQ(5000u, parallel.timestamps.size());
+	for (size_t i = 0; i < 5000; i += 7) {
+		EXPECT_EQ(1000 * i, parallel.timestamps[i]);
+		EXPECT_EQ(800 + i, parallel.values[0][i]);
+		EXPECT_EQ((static_cast<int>(i % 100) - 40) * 0.5f, parallel.values[1][i]);
+		EXPECT_FLOAT_EQ(14.7f + (i % 10) * 0.1f, parallel.values[2][i]);
+	}
+
+	// from the middle
+	size_t first = reader.findBlock(3000 * 1000);
+	LogColumns tail;
+	reader.readColumns(first, reader.getBlockCount() - first, channels, 1, tail);
+	EXPECT_EQ(reader.getRecordCount() - reader.getBlock(first).firstRecord, tail.timestamps.size());
+	EXPECT_EQ(reader.getBlock(first).firstTimestamp, tail.timestamps.front());
+}
+
+TEST(Util_LogReader, damage) {
+	auto log = makeLog(2000);
+	LogReader reader;
+	ASSERT_TRUE(reader.open(log.data(), log.size()));
+	size_t blocks = reader.getBlockCount();
+	auto second = reader.getBlock(1);
+	auto fourth = reader.getBlock(3);
+
+	// payload bit flip: indexed, fails crc when read
+	log[second.offset + LOG_BLOCK_HEADER_SIZE + 3] ^= 0x40;
+	// header destroyed: skipped while indexing
+	log[fourth.offset] = 0;
+	// torn last block
+	log.resize(log.size() - 5);
+
+	ASSERT_TRUE(reader.open(log.data(), log.size()));
+	EXPECT_EQ(blocks - 2, reader.getBlockCount());
+	EXPECT_GT(reader.getSkippedBytes(), 0u);
+
+	LogColumns columns;
+	EXPECT_EQ(1u, reader.readColumns(0, reader.getBlockCount(), channels, 3, columns));
+	EXPECT_EQ(reader.getRecordCount() - second.recordCount, columns.timestamps.size());
+	// still in time order, rows of the bad block left out
+	EXPECT_TRUE(std::is_sorted(columns.timestamps.begin(), columns.timestamps.end()));
+	EXPECT_EQ(second.firstTimestamp - 1000, columns.timestamps[second.firstRecord - 1]);
+	EXPECT_EQ(second.lastTimestamp + 1000, columns.timestamps[second.firstRecord]);
+}
+
+TEST(Util_LogReader, file) {
+	auto log = makeLog(300);
+	std::string file = tempPath("log_reader_test");
+	const char* path = file.c_str();
+	FILE* f = fopen(path, "wb");
+	ASSERT_TRUE(f);
+	fwrite(log.data(), 1, log.size(), f);
+	fclose(f);
+
+	LogReader reader;
+	ASSERT_TRUE(reader.open(path));
+	EXPECT_EQ(300u, reader.getRecordCount());
+	LogColumns columns;
+	EXPECT_EQ(0u, reader.readColumns(0, reader.getBlockCount(), channels, 1, columns));
+	EXPECT_EQ(1099, columns.values[0].back());
+
+	reader.close();
+	remove(path);
+	EXPECT_FALSE(reader.open(path));
+}
+
+TEST(Util_LogReader, timelineSource) {
+	auto log = makeLog(3000);
+	LogReader reader;
+	ASSERT_TRUE(reader.open(log.data(), log.size()));
+
+	// same log twice, second recorder half a sample late
+	LogReaderSource first(reader), second(reader);
+	TimelineMerge merge;
+	merge.addSource(first, TimelineClock::Ticks64);
+	merge.addSource(second, TimelineClock::Ticks64, 500);
+
+	TimelineEvent event;
+	size_t count = 0;
+	while (merge.next(event)) {
+		size_t record = count / 2;
+		ASSERT_EQ(count % 2, event.stream);
+		ASSERT_EQ(static_cast<efitick_t>(record * 1000 + event.stream * 500), event.time);
+		ASSERT_EQ(sizeof(ReaderRecord), event.size);
+		ReaderRecord r;
+		memcpy(&r, event.data, sizeof(r));
+		ASSERT_EQ(800 + record, r.rpm);
+		count++;
+	}
+	EXPECT_EQ(6000u, count);
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "object_pool.h"
+
+#include <thread>
+#include <vector>
+
+struct PoolObject {
+	static int alive;
+
+	explicit PoolObject(int p_value) : value(p_value) {
+		alive++;
+	}
+
+	~PoolObject() {
+		alive--;
+	}
+
+	int value;
+};
+
+int PoolObject::alive = 0;
+
+TEST(Util_ObjectPool, allocateFree) {
+	object_pool<PoolObject, 3> pool;
+
+	auto a = pool.allocate(1);
+	auto b = pool.allocate(2);
+	auto c = pool.allocate(3);
+	ASSERT_NE(nullptr, a);
+	ASSERT_NE(nullptr, b);
+	ASSERT_NE(nullptr, c);
+	EXPECT_EQ(3, PoolObject::alive);
+	EXPECT_EQ(2, b->value);
+	EXPECT_TRUE(pool.owns(b));
+
+	EXPECT_EQ(nullptr, pool.allocate(4));
+	EXPECT_EQ(1u, pool.failed());
+
+	pool.free(b);
+	EXPECT_EQ(2, PoolObject::alive);
+	EXPECT_EQ(2u, pool.used());
+
+	// freed slot is the next one handed out
+	auto d = pool.allocate(5);
+	EXPECT_EQ(static_cast<void*>(b), static_cast<void*>(d));
+	EXPECT_EQ(5, d->value);
+
+	pool.free(a);
+	pool.free(c);
+	pool.free(d);
+	pool.free(nullptr);
+	EXPECT_EQ(0, PoolObject::alive);
+	EXPECT_EQ(0u, pool.used());
+	EXPECT_EQ(3u, pool.highWater());
+
+	pool.resetStats();
+	EXPECT_EQ(0u, pool.highWater());
+	EXPECT_EQ(0u, pool.failed());
+}
+
+TEST(Util_ObjectPool, concurrent) {
+	static object_pool<int, 64> pool;
+	constexpr int threads = 4;
+	constexpr int rounds = 20000;
+
+	auto worker = [](int id) {
+		int* held[8] = {};
+		for (int round = 0; round < rounds; round++) {
+			int slot = round % 8;
+			if (held[slot]) {
+				// nobody else may have touched it while we held it
+				EXPECT_EQ(id * rounds + round - 8, *held[slot]);
+				pool.free(held[slot]);
+			}
+			held[slot] = pool.allocate(id * rounds + round);
+		}
+		for (auto p : held) {
+			pool.free(p);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < threads; i++) {
+		workers.emplace_back(worker, i);
+	}
+	for (auto& t : workers) {
+		t.join();
+	}
+
+	EXPECT_EQ(0u, pool.used());
+	EXPECT_LE(pool.highWater(), 32u);
+	EXPECT_EQ(0u, pool.failed());
+
+	// free list intact: every object can be allocated once
+	std::vector<int*> all;
+	while (auto p = pool.allocate(0)) {
+		all.push_back(p);
+	}
+	EXPECT_EQ(64u, all.size());
+	for (auto p : all) {
+		pool.free(p);
+	}
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include "static_vector.h"
+
+static constexpr int sumOfFirst(int n) {
+	static_vector<int, 8> v;
+	for (int i = 1; i <= n; i++) {
+		v.push_back(i);
+	}
+	int sum = 0;
+	for (int x : v) {
+		sum += x;
+	}
+	return sum;
+}
+
+static_assert(sumOfFirst(4) == 10);
+
+TEST(Util_StaticVector, pushFull) {
+	static_vector<int, 3> v;
+	EXPECT_TRUE(v.empty());
+	EXPECT_TRUE(v.push_back(1));
+	EXPECT_TRUE(v.push_back(2));
+	EXPECT_TRUE(v.push_back(3));
+	EXPECT_TRUE(v.full());
+	EXPECT_FALSE(v.push_back(4));
+	EXPECT_EQ(3u, v.size());
+	EXPECT_EQ(3, v.back());
+
+	v.pop_back();
+	EXPECT_EQ(2u, v.size());
+	v.clear();
+	EXPECT_TRUE(v.empty());
+}
+
+TEST(Util_StaticVector, insertErase) {
+	static_vector<int, 5> v;
+	v.push_back(1);
+	v.push_back(3);
+	EXPECT_TRUE(v.insert(v.begin() + 1, 2));
+	EXPECT_TRUE(v.insert(v.end(), 4));
+	EXPECT_TRUE(v.insert(v.begin(), 0));
+	EXPECT_FALSE(v.insert(v.begin(), -1));
+
+	for (size_t i = 0; i < v.size(); i++) {
+		EXPECT_EQ((int)i, v[i]);
+	}
+
+	auto next = v.erase(v.begin() + 1);
+	EXPECT_EQ(2, *next);
+	EXPECT_EQ(4u, v.size());
+	EXPECT_EQ(0, v[0]);
+	EXPECT_EQ(4, v[3]);
+
+	// last one moves in
+	v.erase_unordered(v.begin());
+	EXPECT_EQ(3u, v.size());
+	EXPECT_EQ(4, v[0]);
+	EXPECT_EQ(2, v[1]);
+}
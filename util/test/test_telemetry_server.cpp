@@ -0,0 +1,274 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/telemetry_server.h>
+
+#if defined(__linux__)
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+struct TelemetryBig {
+	uint8_t x[10000];
+};
+
+struct TelemetrySmall {
+	uint8_t x[16];
+};
+
+static TelemetryBig telemetryBig;
+static TelemetrySmall telemetrySmall;
+
+template<>
+const TelemetryBig* getLiveData(size_t) {
+	return &telemetryBig;
+}
+
+template<>
+const TelemetrySmall* getLiveData(size_t idx) {
+	// second one has no buffer
+	return idx == 0 ? &telemetrySmall : nullptr;
+}
+
+static FragmentEntry telemetryFragments[] = {
+	decl_frag<TelemetrySmall, 0>{},
+	decl_frag<TelemetrySmall, 1>{},
+	decl_frag<TelemetryBig>{},
+};
+
+static const FragmentList telemetryList = { telemetryFragments, 3 };
+static const size_t telemetryTotal = 16 + 16 + 10000;
+
+// unique per run, tests in parallel processes do not share the server socket
+static const std::string telemetrySocket = ::testing::TempDir() + "test_telemetry_" + std::to_string(getpid()) + ".sock";
+#define TELEMETRY_TEST_SOCKET telemetrySocket.c_str()
+
+static void fillTelemetry(uint8_t seed) {
+	for (size_t i = 0; i < sizeof(telemetrySmall.x); i++) {
+		telemetrySmall.x[i] = seed + i;
+	}
+	for (size_t i = 0; i < sizeof(telemetryBig.x); i++) {
+		telemetryBig.x[i] = seed + i * 7;
+	}
+}
+
+static std::vector<uint8_t> expected(size_t offset, size_t size) {
+	std::vector<uint8_t> data(size);
+	copyRange(data.data(), telemetryList, offset, size);
+	return data;
+}
+
+// Collect Data messages of one range until the last one
+static std::vector<uint8_t> receiveRange(TelemetryClient& client, uint32_t offset, size_t* messages = nullptr) {
+	std::vector<uint8_t> data;
+	TelemetryHeader header;
+	uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+	size_t count = 0;
+
+	while (client.receive(header, payload, sizeof(payload), 1000)) {
+		EXPECT_EQ(offset + data.size(), header.offset);
+		data.insert(data.end(), payload, payload + header.size);
+		count++;
+		if (header.flags & TELEMETRY_FLAG_LAST) {
+			break;
+		}
+	}
+
+	if (messages) {
+		*messages = count;
+	}
+	return data;
+}
+
+TEST(Util_TelemetryServer, readAcrossFragments) {
+	fillTelemetry(1);
+
+	TelemetryServer server(telemetryList);
+	ASSERT_TRUE(server.listenUnix(TELEMETRY_TEST_SOCKET));
+
+	TelemetryClient client;
+	ASSERT_TRUE(client.connectUnix(TELEMETRY_TEST_SOCKET));
+
+	// small, null one reads as zeros, start of big
+	ASSERT_TRUE(client.read(42, 10, 50));
+	server.poll(100);
+
+	TelemetryHeader header;
+	uint8_t payload[64];
+	ASSERT_TRUE(client.receive(header, payload, sizeof(payload), 1000));
+	EXPECT_EQ(42u, header.sequence);
+	EXPECT_EQ(10u, header.offset);
+	EXPECT_EQ(50u, header.size);
+	EXPECT_EQ(100u, header.timeUs);
+	EXPECT_EQ(TELEMETRY_FLAG_LAST, header.flags);
+	EXPECT_EQ(0, memcmp(expected(10, 50).data(), payload, 50));
+	EXPECT_EQ(0, payload[10]);
+
+	EXPECT_EQ(1u, server.getStats().requests);
+	EXPECT_EQ(1u, server.getStats().messages);
+	EXPECT_EQ(1u, server.getStats().batches);
+}
+
+TEST(Util_TelemetryServer, largeRangeIsSplit) {
+	fillTelemetry(2);
+
+	TelemetryServer server(telemetryList);
+	ASSERT_TRUE(server.listenUnix(TELEMETRY_TEST_SOCKET));
+
+	TelemetryClient client;
+	ASSERT_TRUE(client.connectUnix(TELEMETRY_TEST_SOCKET));
+
+	ASSERT_TRUE(client.read(1, 0, telemetryTotal));
+	server.poll(0);
+
+	size_t messages;
+	auto data = receiveRange(client, 0, &messages);
+	EXPECT_EQ(expected(0, telemetryTotal), data);
+	EXPECT_EQ(2u, messages);
+	// both go out in one sendmmsg
+	EXPECT_EQ(1u, server.getStats().batches);
+}
+
+TEST(Util_TelemetryServer, subscribe) {
+	fillTelemetry(3);
+
+	TelemetryServer server(telemetryList);
+	ASSERT_TRUE(server.listenUnix(TELEMETRY_TEST_SOCKET));
+
+	TelemetryClient client;
+	ASSERT_TRUE(client.connectUnix(TELEMETRY_TEST_SOCKET));
+
+	ASSERT_TRUE(client.subscribe(0, 16, 1000));
+	server.poll(5000);
+	EXPECT_EQ(1u, server.getSubscriberCount());
+
+	TelemetryHeader header;
+	uint8_t payload[16];
+	ASSERT_TRUE(client.receive(header, payload, sizeof(payload), 1000));
+	EXPECT_EQ(0u, header.sequence);
+	EXPECT_EQ(3, payload[0]);
+
+	// not due yet
+	server.poll(5500);
+	EXPECT_FALSE(client.receive(header, payload, sizeof(payload), 0));
+
+	// snapshot shows live data
+	telemetrySmall.x[0] = 99;
+	server.poll(6000);
+	ASSERT_TRUE(client.receive(header, payload, sizeof(payload), 1000));
+	EXPECT_EQ(1u, header.sequence);
+	EXPECT_EQ(6000u, header.timeUs);
+	EXPECT_EQ(99, payload[0]);
+
+	// far behind: one snapshot, not a burst
+	server.poll(20000);
+	ASSERT_TRUE(client.receive(header, payload, sizeof(payload), 1000));
+	EXPECT_FALSE(client.receive(header, payload, sizeof(payload), 0));
+
+	ASSERT_TRUE(client.unsubscribe());
+	server.poll(30000);
+	EXPECT_EQ(0u, server.getSubscriberCount());
+	EXPECT_FALSE(client.receive(header, payload, sizeof(payload), 0));
+	EXPECT_EQ(3u, server.getStats().snapshots);
+}
+
+TEST(Util_TelemetryServer, subscriberOfClosedClientExpires) {
+	TelemetryServer server(telemetryList);
+	ASSERT_TRUE(server.listenUnix(TELEMETRY_TEST_SOCKET));
+
+	TelemetryClient client;
+	ASSERT_TRUE(client.connectUnix(TELEMETRY_TEST_SOCKET));
+	ASSERT_TRUE(client.subscribe(0, 16, 1000));
+	server.poll(0);
+	EXPECT_EQ(1u, server.getSubscriberCount());
+
+	// no unsubscribe, its address is gone with it
+	client.close();
+	server.poll(1000);
+	EXPECT_EQ(0u, server.getSubscriberCount());
+	EXPECT_EQ(1u, server.getStats().expired);
+}
+
+TEST(Util_TelemetryServer, subscriberNotReadingExpires) {
+	TelemetryServer server(telemetryList);
+	ASSERT_TRUE(server.listenUnix(TELEMETRY_TEST_SOCKET));
+
+	TelemetryClient client;
+	ASSERT_TRUE(client.connectUnix(TELEMETRY_TEST_SOCKET));
+	ASSERT_TRUE(client.subscribe(0, 16, 1000));
+
+	server.poll(0);
+	EXPECT_EQ(1u, server.getSubscriberCount());
+
+	// receive queue fills up, then every snapshot fails
+	uint64_t now = 1000;
+	for (; now < 1000 * 1000 && server.getSubscriberCount() != 0; now += 1000) {
+		server.poll(now);
+	}
+	EXPECT_EQ(0u, server.getSubscriberCount());
+	EXPECT_EQ(1u, server.getStats().expired);
+	EXPECT_LE(TELEMETRY_MAX_SEND_ERRORS, server.getStats().sendErrors);
+
+	// a new subscription starts over
+	TelemetryHeader header;
+	uint8_t payload[16];
+	while (client.receive(header, payload, sizeof(payload), 0)) {
+	}
+	ASSERT_TRUE(client.subscribe(0, 16, 1000));
+	server.poll(now);
+	EXPECT_EQ(1u, server.getSubscriberCount());
+	ASSERT_TRUE(client.receive(header, payload, sizeof(payload), 1000));
+}
+
+TEST(Util_TelemetryServer, badRequests) {
+	TelemetryServer server(telemetryList);
+	ASSERT_TRUE(server.listenUnix(TELEMETRY_TEST_SOCKET));
+
+	TelemetryClient client;
+	ASSERT_TRUE(client.connectUnix(TELEMETRY_TEST_SOCKET));
+
+	// past the end, empty, no period
+	ASSERT_TRUE(client.read(1, telemetryTotal - 4, 5));
+	ASSERT_TRUE(client.read(2, 0, 0));
+	ASSERT_TRUE(client.subscribe(0, 4, 0));
+	server.poll(0);
+
+	TelemetryHeader header;
+	uint8_t payload[16];
+	EXPECT_FALSE(client.receive(header, payload, sizeof(payload), 0));
+	EXPECT_EQ(3u, server.getStats().badRequests);
+	EXPECT_EQ(0u, server.getSubscriberCount());
+
+	// all subscriber slots taken; poll each time, a Unix socket queues only a few datagrams
+	for (size_t i = 0; i <= TELEMETRY_MAX_SUBSCRIBERS; i++) {
+		ASSERT_TRUE(client.subscribe(i, 1, 1000000));
+		server.poll(0);
+		client.receive(header, payload, sizeof(payload), 0);
+	}
+	EXPECT_EQ(TELEMETRY_MAX_SUBSCRIBERS, server.getSubscriberCount());
+	EXPECT_EQ(4u, server.getStats().badRequests);
+}
+
+TEST(Util_TelemetryServer, udp) {
+	fillTelemetry(4);
+
+	TelemetryServer server(telemetryList);
+	ASSERT_TRUE(server.listenUdp(0));
+	ASSERT_NE(0, server.getPort());
+
+	TelemetryClient client;
+	ASSERT_TRUE(client.connectUdp("127.0.0.1", server.getPort()));
+
+	ASSERT_TRUE(client.read(7, 100, 9000));
+	// datagram may take a moment to arrive
+	for (int i = 0; i < 100 && server.getStats().requests == 0; i++) {
+		server.poll(0);
+		usleep(1000);
+	}
+
+	EXPECT_EQ(expected(100, 9000), receiveRange(client, 100));
+}
+
+#endif // __linux__
@@ -0,0 +1,13 @@
+// Scratch files for tests that go through the file system
+
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <unistd.h>
+
+// in the gtest temp dir, one name per process so parallel runs do not collide
+static inline std::string tempPath(const char* name) {
+	return ::testing::TempDir() + name + "_" + std::to_string(getpid()) + ".bin";
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <gerefi/timeline_merge.h>
+
+#include <algorithm>
+#include <vector>
+
+TEST(Util_TimelineMerge, merge) {
+	static const int a = 1, b = 2, c = 3;
+	TimelineSourceEvent sent[] = { { 10, &a, 1 }, { 20, &a, 2 }, { 30, &a, 3 }, { 30, &a, 4 } };
+	TimelineSourceEvent can[] = { { 5, &b, 1 }, { 30, &b, 2 }, { 100, &b, 3 } };
+	TimelineSourceEvent diag[] = { { 25, &c, 1 } };
+
+	TimelineArraySource s1(sent, 4), s2(can, 3), s3(diag, 1), empty(nullptr, 0);
+	TimelineMerge merge;
+	ASSERT_TRUE(merge.addSource(s1, TimelineClock::Ticks64));
+	ASSERT_TRUE(merge.addSource(s2, TimelineClock::Ticks64));
+	ASSERT_TRUE(merge.addSource(empty, TimelineClock::Ticks64));
+	ASSERT_TRUE(merge.addSource(s3, TimelineClock::Ticks64, 3));
+
+	struct Expected {
+		efitick_t time;
+		uint8_t stream;
+		size_t size;
+	};
+	// ties: order of streams, then order within stream
+	const Expected expected[] = {
+		{ 5, 1, 1 }, { 10, 0, 1 }, { 20, 0, 2 }, { 28, 3, 1 }, { 30, 0, 3 }, { 30, 0, 4 }, { 30, 1, 2 }, { 100, 1, 3 },
+	};
+
+	TimelineEvent event;
+	for (const auto& e : expected) {
+		ASSERT_TRUE(merge.next(event));
+		EXPECT_EQ(e.time, event.time);
+		EXPECT_EQ(e.stream, event.stream);
+		EXPECT_EQ(e.size, event.size);
+		EXPECT_EQ(event.stream == 0 ? &a : event.stream == 1 ? &b : &c, event.data);
+	}
+	EXPECT_FALSE(merge.next(event));
+	EXPECT_FALSE(merge.next(event));
+	EXPECT_EQ(8u, merge.getStats().events);
+	EXPECT_EQ(0u, merge.getStats().outOfOrder);
+
+	// too late to add
+	EXPECT_FALSE(merge.addSource(empty, TimelineClock::Ticks64));
+}
+
+TEST(Util_TimelineMerge, wrappedTicks) {
+	// 32 bit timer wrapping twice against a 64 bit stream
+	std::vector<TimelineSourceEvent> wrapped, full;
+	for (uint64_t t = 0; t < 3 * (1ull << 32); t += 0x1000000 + 3) {
+		wrapped.push_back({ t & 0xFFFFFFFF, nullptr, 0 });
+		full.push_back({ t + 1, nullptr, 1 });
+	}
+
+	TimelineArraySource s1(wrapped.data(), wrapped.size()), s2(full.data(), full.size());
+	TimelineMerge merge;
+	merge.addSource(s1, TimelineClock::Wrapped32);
+	merge.addSource(s2, TimelineClock::Ticks64);
+
+	TimelineEvent event;
+	efitick_t last = -1;
+	size_t count = 0;
+	while (merge.next(event)) {
+		EXPECT_GT(event.time, last);
+		EXPECT_EQ(count % 2, event.stream);
+		last = event.time;
+		count++;
+	}
+	EXPECT_EQ(2 * wrapped.size(), count);
+	EXPECT_EQ(static_cast<efitick_t>(full.back().timestamp), last);
+}
+
+TEST(Util_TimelineMerge, wrappedStartsHigh) {
+	// log started with the timer past 2^31, then it wraps
+	TimelineSourceEvent wrapped[] = { { 0xC0000000, nullptr, 0 }, { 0xC0000010, nullptr, 1 }, { 0x00000005, nullptr, 2 } };
+	TimelineSourceEvent full[] = { { 0xC0000008, nullptr, 3 }, { 0x200000000, nullptr, 4 } };
+
+	TimelineArraySource s1(wrapped, 3), s2(full, 2);
+	TimelineMerge merge;
+	merge.addSource(s1, TimelineClock::Wrapped32);
+	merge.addSource(s2, TimelineClock::Ticks64);
+
+	const efitick_t times[] = { 0xC0000000, 0xC0000008, 0xC0000010, 0x100000005, 0x200000000 };
+	const size_t sizes[] = { 0, 3, 1, 2, 4 };
+	TimelineEvent event;
+	for (size_t i = 0; i < 5; i++) {
+		ASSERT_TRUE(merge.next(event));
+		EXPECT_EQ(times[i], event.time);
+		EXPECT_EQ(sizes[i], event.size);
+	}
+	EXPECT_FALSE(merge.next(event));
+	EXPECT_EQ(0u, merge.getStats().outOfOrder);
+}
+
+TEST(Util_TimelineMerge, manyStreams) {
+	// every stream has its own rate, result matches a full sort
+	std::vector<std::vector<TimelineSourceEvent>> events(TIMELINE_MAX_STREAMS);
+	std::vector<TimelineArraySource> sources;
+	std::vector<std::pair<efitick_t, uint8_t>> sorted;
+	for (size_t s = 0; s < TIMELINE_MAX_STREAMS; s++) {
+		for (uint64_t t = s; t < 10000; t += 7 + s * 3) {
+			events[s].push_back({ t, nullptr, 0 });
+			sorted.push_back({ t, s });
+		}
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	TimelineMerge merge;
+	sources.reserve(TIMELINE_MAX_STREAMS);
+	for (size_t s = 0; s < TIMELINE_MAX_STREAMS; s++) {
+		sources.emplace_back(events[s].data(), events[s].size());
+		ASSERT_TRUE(merge.addSource(sources.back(), TimelineClock::Ticks64));
+	}
+	TimelineArraySource extra(nullptr, 0);
+	EXPECT_FALSE(merge.addSource(extra, TimelineClock::Ticks64));
+
+	TimelineEvent event;
+	for (const auto& e : sorted) {
+		ASSERT_TRUE(merge.next(event));
+		ASSERT_EQ(e.first, event.time);
+		ASSERT_EQ(e.second, event.stream);
+	}
+	EXPECT_FALSE(merge.next(event));
+}
+
+TEST(Util_TimelineMerge, outOfOrder) {
+	TimelineSourceEvent events[] = { { 10, nullptr, 0 }, { 5, nullptr, 0 }, { 20, nullptr, 0 } };
+	TimelineArraySource source(events, 3);
+	TimelineMerge merge;
+	merge.addSource(source, TimelineClock::Ticks64);
+
+	TimelineEvent event;
+	std::vector<efitick_t> times;
+	while (merge.next(event)) {
+		times.push_back(event.time);
+	}
+	EXPECT_EQ((std::vector<efitick_t>{ 10, 5, 20 }), times);
+	EXPECT_EQ(1u, merge.getStats().outOfOrder);
+}
@@ -0,0 +1,231 @@
+/*
+ * telemetry_load.cpp
+ *
+ * Load generator for TelemetryServer: clients subscribe to snapshots, then one client
+ * sends range requests back to back. Reports snapshots per second and latency.
+ *
+ * usage: telemetry_load [-c clients] [-p period_us] [-s size] [-t seconds] [-u] [server_socket]
+ *
+ * Without server_socket a server with synthetic output channels runs in a thread of
+ * this process, on a Unix socket or with -u on UDP loopback.
+ */
+
+#include <gerefi/telemetry_server.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+#define LOAD_FRAGMENT_SIZE 1024
+#define LOAD_FRAGMENTS 16
+#define LOAD_MAX_CLIENTS 64
+#define LOAD_SOCKET "/tmp/telemetry_load.sock"
+
+struct LoadChannels {
+	uint32_t counter;
+	uint8_t data[LOAD_FRAGMENT_SIZE - 4];
+};
+
+static LoadChannels channels[LOAD_FRAGMENTS];
+
+template<>
+const LoadChannels* getLiveData(size_t index) {
+	return &channels[index];
+}
+
+static const FragmentEntry fragments[LOAD_FRAGMENTS] = {
+	decl_frag<LoadChannels, 0>{}, decl_frag<LoadChannels, 1>{}, decl_frag<LoadChannels, 2>{}, decl_frag<LoadChannels, 3>{},
+	decl_frag<LoadChannels, 4>{}, decl_frag<LoadChannels, 5>{}, decl_frag<LoadChannels, 6>{}, decl_frag<LoadChannels, 7>{},
+	decl_frag<LoadChannels, 8>{}, decl_frag<LoadChannels, 9>{}, decl_frag<LoadChannels, 10>{}, decl_frag<LoadChannels, 11>{},
+	decl_frag<LoadChannels, 12>{}, decl_frag<LoadChannels, 13>{}, decl_frag<LoadChannels, 14>{}, decl_frag<LoadChannels, 15>{},
+};
+
+static void usage() {
+	fprintf(stderr, "usage: telemetry_load [-c clients] [-p period_us] [-s size] [-t seconds] [-u] [server_socket]\n");
+}
+
+static void printLatency(const char* name, std::vector<uint64_t>& latency) {
+	if (latency.empty()) {
+		fprintf(stderr, "%s: none\n", name);
+		return;
+	}
+
+	std::sort(latency.begin(), latency.end());
+	auto percentile = [&](double p) {
+		return (unsigned long)latency[std::min(latency.size() - 1, (size_t)(p * latency.size()))];
+	};
+	fprintf(stderr, "%s us: p50 %lu, p90 %lu, p99 %lu, max %lu\n", name,
+		percentile(0.5), percentile(0.9), percentile(0.99), (unsigned long)latency.back());
+}
+
+int main(int argc, char** argv) {
+	size_t clientCount = 4;
+	uint32_t periodUs = 1000;
+	uint32_t size = 4096;
+	double seconds = 2;
+	bool udp = false;
+	const char* external = nullptr;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			clientCount = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+			periodUs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			size = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			seconds = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-u") == 0) {
+			udp = true;
+		} else if (argv[i][0] != '-' && !external) {
+			external = argv[i];
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (clientCount == 0 || clientCount > LOAD_MAX_CLIENTS || periodUs == 0 || size == 0) {
+		usage();
+		return 1;
+	}
+
+	TelemetryServer server({ fragments, LOAD_FRAGMENTS });
+	std::atomic<bool> running(true);
+	std::thread serverThread;
+
+	if (!external) {
+		if (size > sizeof(channels)) {
+			fprintf(stderr, "telemetry_load: size is limited to %u\n", (unsigned)sizeof(channels));
+			return 1;
+		}
+		if (!(udp ? server.listenUdp(0) : server.listenUnix(LOAD_SOCKET))) {
+			fprintf(stderr, "telemetry_load: can not start server\n");
+			return 1;
+		}
+
+		// the simulator: outputs change between polls
+		serverThread = std::thread([&]() {
+			while (running) {
+				for (auto& channel : channels) {
+					channel.counter++;
+				}
+				server.poll();
+
+				pollfd pfd = { server.getFd(), POLLIN, 0 };
+				timespec wait = { 0, 50000 };
+				ppoll(&pfd, 1, &wait, nullptr);
+			}
+		});
+	}
+
+	auto connect = [&](TelemetryClient& client) {
+		if (external) {
+			return client.connectUnix(external);
+		}
+		return udp ? client.connectUdp("127.0.0.1", server.getPort()) : client.connectUnix(LOAD_SOCKET);
+	};
+
+	std::vector<TelemetryClient> clients(clientCount);
+	std::vector<pollfd> fds;
+	for (auto& client : clients) {
+		if (!connect(client)) {
+			fprintf(stderr, "telemetry_load: can not connect\n");
+			running = false;
+			if (serverThread.joinable()) {
+				serverThread.join();
+			}
+			return 1;
+		}
+
+		// room for bursts while this thread is not scheduled
+		int buffer = 4 << 20;
+		setsockopt(client.getFd(), SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+		client.subscribe(0, size, periodUs);
+		fds.push_back({ client.getFd(), POLLIN, 0 });
+	}
+
+	std::vector<uint8_t> payload(TELEMETRY_MAX_PAYLOAD);
+	TelemetryHeader header;
+
+	// snapshots: latency from server time of snapshot to its last message here
+	std::vector<uint64_t> snapshotLatency;
+	uint64_t snapshots = 0;
+	uint64_t bytes = 0;
+	uint64_t start = telemetryNowUs();
+	uint64_t end = start + seconds * 1e6;
+
+	while (telemetryNowUs() < end) {
+		if (::poll(fds.data(), fds.size(), 10) <= 0) {
+			continue;
+		}
+
+		for (auto& client : clients) {
+			while (client.receive(header, payload.data(), payload.size(), 0)) {
+				bytes += header.size;
+				if (header.flags & TELEMETRY_FLAG_LAST) {
+					snapshots++;
+					snapshotLatency.push_back(telemetryNowUs() - header.timeUs);
+				}
+			}
+		}
+	}
+	double elapsed = (telemetryNowUs() - start) / 1e6;
+
+	for (auto& client : clients) {
+		client.unsubscribe();
+	}
+
+	// range requests: one at a time, round trip
+	std::vector<uint64_t> roundTrip;
+	auto& requester = clients[0];
+	// let the unsubscribes land, drop snapshots still queued
+	::poll(nullptr, 0, 10);
+	while (requester.receive(header, payload.data(), payload.size(), 0)) {
+	}
+
+	start = telemetryNowUs();
+	end = start + seconds * 1e6;
+	uint32_t sequence = 1;
+	while (telemetryNowUs() < end) {
+		uint64_t sent = telemetryNowUs();
+		requester.read(sequence, 0, size);
+
+		bool done = false;
+		while (!done && requester.receive(header, payload.data(), payload.size(), 100)) {
+			done = header.sequence == sequence && (header.flags & TELEMETRY_FLAG_LAST);
+		}
+		if (done) {
+			roundTrip.push_back(telemetryNowUs() - sent);
+		}
+		sequence++;
+	}
+	double requestElapsed = (telemetryNowUs() - start) / 1e6;
+
+	running = false;
+	if (serverThread.joinable()) {
+		serverThread.join();
+	}
+
+	fprintf(stderr, "%lu clients, %u bytes every %u us\n", (unsigned long)clientCount, size, periodUs);
+	fprintf(stderr, "%.0f snapshots/s, %.1f MB/s, expected %.0f snapshots/s\n",
+		snapshots / elapsed, bytes / elapsed / 1e6, clientCount * 1e6 / periodUs);
+	printLatency("snapshot latency", snapshotLatency);
+	fprintf(stderr, "%.0f range requests/s, %lu of %u answered\n",
+		roundTrip.size() / requestElapsed, (unsigned long)roundTrip.size(), sequence - 1);
+	printLatency("request round trip", roundTrip);
+
+	if (!external) {
+		const auto& stats = server.getStats();
+		fprintf(stderr, "server: %u requests, %u snapshots, %u messages in %u sendmmsg calls, %u send errors, %u expired\n",
+			stats.requests, stats.snapshots, stats.messages, stats.batches, stats.sendErrors, stats.expired);
+	}
+
+	return 0;
+}
@@ -3,14 +3,37 @@ GEREFI_LIB_INC += $(GEREFI_LIB)/util/include $(GEREFI_LIB)/util/include/gerefi/c
 GEREFI_LIB_CPP += \
 	$(GEREFI_LIB)/util/src/util_dummy.cpp \
 	$(GEREFI_LIB)/util/src/crc.cpp \
+	$(GEREFI_LIB)/util/src/cpu_features.cpp \
+	$(GEREFI_LIB)/util/src/config_diff.cpp \
+	$(GEREFI_LIB)/util/src/config_store.cpp \
+	$(GEREFI_LIB)/util/src/log_codec.cpp \
+	$(GEREFI_LIB)/util/src/timeline_merge.cpp \
 	$(GEREFI_LIB)/util/src/efistringutil.cpp \
 	$(GEREFI_LIB)/util/src/fragments.cpp \
 	$(GEREFI_LIB)/util/src/math.cpp \
 
+# host only: flash emulation, log reading and live telemetry for tests, tools and benchmarks
+GEREFI_LIB_HOST_CPP += \
+	$(GEREFI_LIB)/util/src/flash_emulator.cpp \
+	$(GEREFI_LIB)/util/src/log_decoder.cpp \
+	$(GEREFI_LIB)/util/src/log_reader.cpp \
+	$(GEREFI_LIB)/util/src/telemetry_server.cpp \
+
 GEREFI_LIB_CPP_TEST += \
 	$(GEREFI_LIB)/util/test/test_arrays.cpp \
 	$(GEREFI_LIB)/util/test/test_crc.cpp \
+	$(GEREFI_LIB)/util/test/test_cpu_features.cpp \
+	$(GEREFI_LIB)/util/test/test_config_diff.cpp \
+	$(GEREFI_LIB)/util/test/test_config_store.cpp \
+	$(GEREFI_LIB)/util/test/test_log_codec.cpp \
+	$(GEREFI_LIB)/util/test/test_log_reader.cpp \
+	$(GEREFI_LIB)/util/test/test_timeline_merge.cpp \
+	$(GEREFI_LIB)/util/test/test_telemetry_server.cpp \
 	$(GEREFI_LIB)/util/test/test_cyclic_buffer.cpp \
+	$(GEREFI_LIB)/util/test/test_static_vector.cpp \
+	$(GEREFI_LIB)/util/test/test_flat_map.cpp \
+	$(GEREFI_LIB)/util/test/test_bitset.cpp \
+	$(GEREFI_LIB)/util/test/test_object_pool.cpp \
 	$(GEREFI_LIB)/util/test/test_efistringutil.cpp \
 	$(GEREFI_LIB)/util/test/test_fragments.cpp \
 	$(GEREFI_LIB)/util/test/test_interpolation.cpp \